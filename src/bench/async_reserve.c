@@ -0,0 +1,102 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "client/api.h"
+#include "common/constants.h"
+#include "common/io.h"
+#include "protocol.h"
+
+#define SEATS_PER_ROW 100  // Columns of the events the reservations are made in
+
+/**
+ * Counts the reservations that failed.
+ */
+static void count_failure(unsigned long ticket, int result, void* arg) {
+  (void)ticket;
+  *(size_t*)arg += (size_t)(result != 0);
+}
+
+/**
+ * Reserves every seat of an event, one at a time, either waiting for each reply or keeping many in flight.
+ *
+ * @return The elapsed time in microseconds, or -1 on failure.
+ */
+static long reserve_all(struct EmsSession* session, unsigned int event_id, size_t seats, int pipelined,
+                        size_t* failed) {
+  size_t rows = (seats + SEATS_PER_ROW - 1) / SEATS_PER_ROW;
+  if (ems_create(session, event_id, rows, SEATS_PER_ROW) != 0) {
+    return -1;
+  }
+
+  struct timespec start, end;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  unsigned long last = 0;
+  for (size_t i = 0; i < seats; i++) {
+    size_t x = i / SEATS_PER_ROW + 1, y = i % SEATS_PER_ROW + 1;
+    if (pipelined) {
+      last = ems_submit_reserve(session, event_id, 1, &x, &y, count_failure, failed);
+      if (last == 0) {
+        return -1;
+      }
+    } else if (ems_reserve(session, event_id, 1, &x, &y) != 0) {
+      (*failed)++;
+    }
+  }
+  if (pipelined && ems_wait(session, last) != 0) {
+    return -1;
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  return bench_elapsed_us(&start, &end);
+}
+
+/**
+ * Measures how many reservations a single client session gets through when it waits for each reply, and when
+ * it keeps up to ASYNC_MAX_IN_FLIGHT of them in flight with the asynchronous API.
+ *
+ * @param argc Number of command-line arguments.
+ * @param argv Array of command-line arguments.
+ * @return 0 if the benchmark ran, 1 otherwise.
+ */
+int main(int argc, char* argv[]) {
+  if (argc != 3) {
+    fprintf(stderr, "Usage: %s <server pipe path> <number of reservations>\n", argv[0]);
+    return 1;
+  }
+
+  long seats = strtol(argv[2], NULL, 10);
+  if (seats <= 0) {
+    print_error("Invalid number of reservations.\n");
+    return 1;
+  }
+
+  char req_path[MAX_PATH], resp_path[MAX_PATH];
+  snprintf(req_path, MAX_PATH, "/tmp/async_%d_req", (int)getpid());
+  snprintf(resp_path, MAX_PATH, "/tmp/async_%d_resp", (int)getpid());
+  struct EmsSession* session = ems_setup(req_path, resp_path, argv[1], 0);
+  if (session == NULL) {
+    print_error("Error setting up the session.\n");
+    return 1;
+  }
+
+  // Fresh events for every run, so that the reservations succeed against a server that keeps running
+  unsigned int event_id = (unsigned int)getpid() * 2;
+  const char* modes[2] = {"synchronous", "pipelined"};
+  for (int pipelined = 0; pipelined < 2; pipelined++) {
+    size_t failed = 0;
+    long elapsed = reserve_all(session, event_id + (unsigned int)pipelined, (size_t)seats, pipelined, &failed);
+    if (elapsed < 0) {
+      print_error("Error running the reservations.\n");
+      ems_quit(session);
+      return 1;
+    }
+
+    printf("%-11s: %ld reservations in %.3fs, %.0f reservations/s, %zu failed\n", modes[pipelined], seats,
+           (double)elapsed / 1e6, (double)seats * 1e6 / (double)(elapsed > 0 ? elapsed : 1), failed);
+  }
+
+  return ems_quit(session);
+}
@@ -0,0 +1,207 @@
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "common/io.h"
+#include "protocol.h"
+#include "server/checkpoint.h"
+#include "server/eventlist.h"
+#include "server/operations.h"
+#include "server/wal.h"
+
+// Events the log is replayed for at most: replaying a CREATE looks the event up in the whole list first
+#define LOG_MAX_EVENTS 10000
+
+/**
+ * Gets the number of seats of the first row each event has reserved, as a single reservation.
+ */
+static size_t reserved_seats(size_t cols) { return cols < MAX_RESERVATION_SIZE ? cols : MAX_RESERVATION_SIZE; }
+
+/**
+ * Builds a list of events, each with one reservation of its first seats, as a server that ran for a while holds.
+ *
+ * @return The list, or NULL on failure.
+ */
+static struct EventList* build_events(size_t events, size_t rows, size_t cols) {
+  struct EventList* list = create_list();
+  for (size_t i = 0; list != NULL && i < events; i++) {
+    struct Event* event = malloc(sizeof(struct Event));
+    unsigned int* data = calloc(rows * cols, sizeof(unsigned int));
+    if (event == NULL || data == NULL || pthread_mutex_init(&event->mutex, NULL) != 0) {
+      free(event);
+      free(data);
+      free_list(list);
+      return NULL;
+    }
+
+    event->id = (unsigned int)i + 1;
+    event->reservations = 1;
+    event->rows = rows;
+    event->cols = cols;
+    event->data = data;
+    event->storage = SEATS_HEAP;
+    event->lsn = 2 * i + 2;
+    event->seq = 0;
+    event->snapshot = NULL;
+    atomic_init(&event->waiting, 0);
+    atomic_init(&event->last_used, 0);
+    atomic_init(&event->cold, 0);
+    lockstats_init(&event->lock_stats);
+    for (size_t seat = 0; seat < reserved_seats(cols); seat++) {
+      data[seat] = 1;
+    }
+
+    if (append_to_list(list, event) != 0) {
+      free(data);
+      free(event);
+      free_list(list);
+      return NULL;
+    }
+  }
+  return list;
+}
+
+/**
+ * Replays nothing, for the log the benchmark writes.
+ */
+static int skip_record(const struct WalRecord* record) {
+  (void)record;
+  return 0;
+}
+
+/**
+ * Writes a log holding the changes of the same events: a CREATE and a RESERVE of their first seats per event.
+ *
+ * @return 0 on success, 1 on failure.
+ */
+static int write_log(const char* data_dir, size_t events, size_t rows, size_t cols) {
+  size_t xs[MAX_RESERVATION_SIZE], ys[MAX_RESERVATION_SIZE];
+  size_t seats = reserved_seats(cols);
+  for (size_t i = 0; i < seats; i++) {
+    xs[i] = 1;
+    ys[i] = i + 1;
+  }
+
+  if (wal_open(data_dir, WAL_SYNC_ASYNC, 0, 0, skip_record) != 0) {
+    return 1;
+  }
+  for (size_t i = 0; i < events; i++) {
+    struct WalRecord create = {WAL_CREATE, 0, (unsigned int)i + 1, rows, cols, 0, NULL, NULL};
+    struct WalRecord reserve = {WAL_RESERVE, 0, (unsigned int)i + 1, 0, 0, seats, xs, ys};
+    if (wal_append(&create) == 0 || wal_append(&reserve) == 0) {
+      wal_close();
+      return 1;
+    }
+  }
+  wal_close();
+  return 0;
+}
+
+/**
+ * Restores the state from the data directory and reads every seat once, timing both.
+ *
+ * @return 0 if the state holds the expected events, 1 otherwise.
+ */
+static int recover(const char* data_dir, const char* name, size_t events, size_t cols) {
+  struct timespec start, restored, end;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  if (ems_init(0) != 0 || ems_recover(data_dir, WAL_SYNC_GROUP) != 0) {
+    ems_terminate();
+    return 1;
+  }
+  clock_gettime(CLOCK_MONOTONIC, &restored);
+
+  // Seats of a mapped checkpoint are read from the file the first time they are touched
+  size_t found = 0, reserved = 0;
+  for (struct ListNode* node = get_event_list()->head; node != NULL; node = node->next) {
+    struct Event* event = node->event;
+    for (size_t i = 0; i < event->rows * event->cols; i++) {
+      reserved += event->data[i] != 0;
+    }
+    found++;
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  ems_terminate();
+
+  long startup = bench_elapsed_us(&start, &restored);
+  printf("%-10s: %zu events restored in %.3fs (%.2fus per event), every seat read in %.3fs more\n", name, found,
+         (double)startup / 1e6, (double)startup / (double)(found > 0 ? found : 1),
+         (double)bench_elapsed_us(&restored, &end) / 1e6);
+  return found != events || reserved != events * reserved_seats(cols);
+}
+
+/**
+ * Measures how long the server takes to restore its state at startup: from a checkpoint, which is mapped and used in
+ * place, and from a write-ahead log holding the same changes, which is replayed one change at a time.
+ *
+ * @param argc Number of command-line arguments.
+ * @param argv Array of command-line arguments.
+ * @return 0 if the benchmark ran, 1 otherwise.
+ */
+int main(int argc, char* argv[]) {
+  if (argc != 5) {
+    fprintf(stderr, "Usage: %s <data directory> <events> <rows> <columns>\n", argv[0]);
+    return 1;
+  }
+
+  long events = strtol(argv[2], NULL, 10);
+  long rows = strtol(argv[3], NULL, 10);
+  long cols = strtol(argv[4], NULL, 10);
+  if (events <= 0 || rows <= 0 || cols <= 0) {
+    print_error("Invalid number of events, rows or columns.\n");
+    return 1;
+  }
+
+  char data_dir[PATH_MAX], checkpoint_path[PATH_MAX];
+  int pid = (int)getpid();
+  if (snprintf(data_dir, sizeof(data_dir), "%s/checkpoint_bench_%d", argv[1], pid) >= (int)sizeof(data_dir) ||
+      snprintf(checkpoint_path, sizeof(checkpoint_path), "%s/checkpoint", data_dir) >= (int)sizeof(checkpoint_path)) {
+    print_error("The data directory path is too long.\n");
+    return 1;
+  }
+  if (mkdir(data_dir, 0777) != 0) {
+    print_error("Failed to create the data directory.\n");
+    return 1;
+  }
+
+  struct timespec start, end;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  struct EventList* list = build_events((size_t)events, (size_t)rows, (size_t)cols);
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  int failed = list == NULL;
+  if (!failed) {
+    printf("Built %ld events of %ldx%ld seats in %.3fs\n", events, rows, cols,
+           (double)bench_elapsed_us(&start, &end) / 1e6);
+
+    struct CheckpointStats stats;
+    failed = checkpoint_write(checkpoint_path, list->head, list->tail, 2 * (uint64_t)events, &stats) != 0;
+    free_list(list);
+    if (!failed) {
+      printf("Checkpoint of %zu bytes written and synced in %.3fs\n", stats.bytes, (double)stats.elapsed_us / 1e6);
+      failed = recover(data_dir, "checkpoint", (size_t)events, (size_t)cols);
+    }
+  }
+
+  // The log is replayed from scratch, in a directory without the checkpoint
+  bench_remove_data_dir(data_dir);
+  if (!failed && mkdir(data_dir, 0777) != 0) {
+    print_error("Failed to create the data directory.\n");
+    failed = 1;
+  }
+
+  // The log replays each change through the operations, so it is only measured for a prefix of the events
+  size_t log_events = events < LOG_MAX_EVENTS ? (size_t)events : LOG_MAX_EVENTS;
+  if (!failed) {
+    failed = write_log(data_dir, log_events, (size_t)rows, (size_t)cols) != 0 ||
+             recover(data_dir, "log", log_events, (size_t)cols) != 0;
+  }
+  bench_remove_data_dir(data_dir);
+
+  if (failed) {
+    print_error("Error restoring the state.\n");
+  }
+  return failed;
+}
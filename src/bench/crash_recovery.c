@@ -0,0 +1,299 @@
+#include <limits.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "common/io.h"
+#include "protocol.h"
+#include "server/eventlist.h"
+#include "server/operations.h"
+#include "server/wal.h"
+
+#define EVENT_ROWS 20                  // Rows of each event
+#define EVENT_COLS 20                  // Columns of each event
+#define BENCH_SEGMENT_SIZE (64 << 10)  // Log segments are kept small, so compaction runs many times per round
+#define BENCH_CHECKPOINT_MS 20         // Interval between checkpoints of the serving process
+#define CRASH_MIN_MS 50                // Shortest time a round serves before it is killed
+#define CRASH_MAX_MS 500               // Longest time a round serves before it is killed
+#define ACKS_PER_READ 1024             // Acknowledgements read from the pipe at a time
+
+/**
+ * @struct Ack
+ * @brief A change the serving process acknowledged: a CREATE if the row is 0, a RESERVE of one seat otherwise.
+ */
+struct Ack {
+  uint32_t event_id;
+  uint32_t x;
+  uint32_t y;
+};
+
+/**
+ * @struct Round
+ * @brief Events a serving process reserves seats in, and the pipe it tells of each change it acknowledged.
+ */
+struct Round {
+  unsigned int first_event;
+  unsigned int events;
+  int ack_fd;
+  atomic_size_t next_seat;  // Next seat of the events to reserve, counted across them
+};
+
+/**
+ * Tells the parent of an acknowledged change. Writes this small are atomic, so threads need no lock.
+ */
+static void acknowledge(const struct Round* round, unsigned int event_id, size_t x, size_t y) {
+  struct Ack ack = {event_id, (uint32_t)x, (uint32_t)y};
+  if (write(round->ack_fd, &ack, sizeof(ack)) != (ssize_t)sizeof(ack)) {
+    _exit(1);
+  }
+}
+
+/**
+ * Reserves the seats of the events of the round one at a time until the process is killed or none is left, telling
+ * the parent of each one once ems_reserve returned, as a worker would reply to its client.
+ *
+ * @param arg The Round.
+ * @return NULL.
+ */
+static void* reserve_seats(void* arg) {
+  struct Round* round = arg;
+  size_t seat;
+  while ((seat = atomic_fetch_add(&round->next_seat, 1)) < (size_t)round->events * EVENT_ROWS * EVENT_COLS) {
+    unsigned int event_id = round->first_event + (unsigned int)(seat / (EVENT_ROWS * EVENT_COLS));
+    size_t x = seat % (EVENT_ROWS * EVENT_COLS) / EVENT_COLS + 1, y = seat % EVENT_COLS + 1;
+    if (ems_reserve(event_id, 1, &x, &y) == 0) {
+      acknowledge(round, event_id, x, y);
+    }
+  }
+  return NULL;
+}
+
+/**
+ * Serves a round in the child process: restores the state, creates the events of the round, then reserves seats
+ * from many threads while checkpointing the state, until killed.
+ */
+static void serve(const char* data_dir, struct Round* round, long threads) {
+  wal_set_segment_size(BENCH_SEGMENT_SIZE);
+  if (ems_init(0) != 0 || ems_recover(data_dir, WAL_SYNC_GROUP) != 0) {
+    _exit(1);
+  }
+  for (unsigned int i = 0; i < round->events; i++) {
+    if (ems_create(round->first_event + i, EVENT_ROWS, EVENT_COLS) != 0) {
+      _exit(1);
+    }
+    acknowledge(round, round->first_event + i, 0, 0);
+  }
+
+  pthread_t worker;
+  for (long i = 0; i < threads; i++) {
+    if (pthread_create(&worker, NULL, reserve_seats, round) != 0) {
+      _exit(1);
+    }
+  }
+
+  struct timespec interval = {0, BENCH_CHECKPOINT_MS * 1000000L};
+  while (1) {
+    nanosleep(&interval, NULL);
+    if (ems_checkpoint(NULL) != 0) {
+      _exit(1);
+    }
+  }
+}
+
+/**
+ * Reads the acknowledgements of a serving process, and kills it once the given time passed.
+ *
+ * @param pid Process serving the round.
+ * @param fd Read end of its acknowledgement pipe.
+ * @param crash_ms Time after which the process is killed.
+ * @param acks Array of acknowledgements, grown as needed.
+ * @param count Number of acknowledgements in the array.
+ * @param capacity Capacity of the array.
+ * @return 0 if the process was killed, 1 if it exited on its own or could not be read from.
+ */
+static int collect_acks(pid_t pid, int fd, long crash_ms, struct Ack** acks, size_t* count, size_t* capacity) {
+  struct timespec start, now;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  char buffer[ACKS_PER_READ * sizeof(struct Ack)];
+  size_t pending = 0;
+  int killed = 0;
+
+  while (1) {
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    long left_ms = crash_ms - bench_elapsed_us(&start, &now) / 1000;
+    if (!killed && left_ms <= 0) {
+      kill(pid, SIGKILL);
+      killed = 1;
+    }
+
+    // Once killed, the pipe is drained until the process is gone
+    struct pollfd pfd = {fd, POLLIN, 0};
+    if (poll(&pfd, 1, killed ? -1 : (int)left_ms) == -1) {
+      return 1;
+    }
+    if (pfd.revents == 0) {
+      continue;
+    }
+    ssize_t got = read(fd, buffer + pending, sizeof(buffer) - pending);
+    if (got <= 0) {
+      return !killed || got < 0;
+    }
+
+    pending += (size_t)got;
+    size_t whole = pending / sizeof(struct Ack);
+    if (*count + whole > *capacity) {
+      size_t grown = 2 * (*count + whole);
+      struct Ack* more = realloc(*acks, grown * sizeof(struct Ack));
+      if (more == NULL) {
+        return 1;
+      }
+      *acks = more;
+      *capacity = grown;
+    }
+    memcpy(*acks + *count, buffer, whole * sizeof(struct Ack));
+    *count += whole;
+    pending -= whole * sizeof(struct Ack);
+    memmove(buffer, buffer + whole * sizeof(struct Ack), pending);
+  }
+}
+
+/**
+ * Restores the state as a restarted server would, timing it, then checks that every change acknowledged before
+ * the crashes is in it.
+ *
+ * @param elapsed_us Pointer to store the time the restore took in.
+ * @param lost Pointer to store the number of acknowledged changes missing from the state in.
+ * @return 0 if the state was restored and is consistent, 1 otherwise.
+ */
+static int recover(const char* data_dir, const struct Ack* acks, size_t count, unsigned int events,
+                   long* elapsed_us, size_t* lost) {
+  struct timespec start, end;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  if (ems_init(0) != 0 || ems_recover(data_dir, WAL_SYNC_GROUP) != 0) {
+    ems_terminate();
+    return 1;
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  *elapsed_us = bench_elapsed_us(&start, &end);
+
+  // Events are found by id, and each seat must hold one of the reservations its event counts
+  struct Event** by_id = calloc((size_t)events + 1, sizeof(struct Event*));
+  int inconsistent = by_id == NULL;
+  for (struct ListNode* node = get_event_list()->head; node != NULL && !inconsistent; node = node->next) {
+    struct Event* event = node->event;
+    inconsistent = event->id == 0 || event->id > events || by_id[event->id] != NULL;
+    for (size_t i = 0; i < event->rows * event->cols && !inconsistent; i++) {
+      inconsistent = event->data[i] > event->reservations;
+    }
+    if (!inconsistent) {
+      by_id[event->id] = event;
+    }
+  }
+
+  *lost = 0;
+  for (size_t i = 0; i < count && !inconsistent; i++) {
+    struct Event* event = by_id[acks[i].event_id];
+    if (event == NULL || (acks[i].x > 0 && event->data[(acks[i].x - 1) * event->cols + acks[i].y - 1] == 0)) {
+      (*lost)++;
+    }
+  }
+
+  struct WalStats log;
+  wal_get_stats(&log);
+  printf("recovered in %.3fs from %zu log segments", (double)*elapsed_us / 1e6, log.segments);
+  free(by_id);
+  ems_terminate();
+  return inconsistent;
+}
+
+/**
+ * Crashes a server state at random points while it serves reservations and checkpoints, then restores it as a
+ * restart would, timing recovery and checking that every change acknowledged before a crash survived it.
+ *
+ * @param argc Number of command-line arguments.
+ * @param argv Array of command-line arguments.
+ * @return 0 if every recovery succeeded without losing an acknowledged change, 1 otherwise.
+ */
+int main(int argc, char* argv[]) {
+  if (argc != 5) {
+    fprintf(stderr, "Usage: %s <data directory> <crashes> <threads> <events per round>\n", argv[0]);
+    return 1;
+  }
+
+  long crashes = strtol(argv[2], NULL, 10);
+  long threads = strtol(argv[3], NULL, 10);
+  long events = strtol(argv[4], NULL, 10);
+  if (crashes <= 0 || threads <= 0 || events <= 0 || events > UINT_MAX / crashes) {
+    print_error("Invalid number of crashes, threads or events.\n");
+    return 1;
+  }
+
+  char data_dir[PATH_MAX];
+  if (snprintf(data_dir, sizeof(data_dir), "%s/crash_bench_%d", argv[1], (int)getpid()) >= (int)sizeof(data_dir)) {
+    print_error("The data directory path is too long.\n");
+    return 1;
+  }
+  if (mkdir(data_dir, 0777) != 0) {
+    print_error("Failed to create the data directory.\n");
+    return 1;
+  }
+
+  struct Ack* acks = NULL;
+  size_t count = 0, capacity = 0, lost = 0;
+  long total_us = 0, worst_us = 0, recovered = 0;
+  int failed = 0;
+  srand((unsigned int)time(NULL));
+  for (long i = 0; i < crashes && !failed && lost == 0; i++) {
+    struct Round round = {(unsigned int)(i * events) + 1, (unsigned int)events, -1, 0};
+    long crash_ms = CRASH_MIN_MS + rand() % (CRASH_MAX_MS - CRASH_MIN_MS + 1);
+    int fds[2];
+    if (pipe(fds) != 0) {
+      failed = 1;
+      break;
+    }
+
+    // The parent holds no state while a round runs, so the child starts from the data directory alone
+    pid_t pid = fork();
+    if (pid == 0) {
+      close(fds[0]);
+      round.ack_fd = fds[1];
+      serve(data_dir, &round, threads);
+    }
+    close(fds[1]);
+    size_t before = count;
+    failed = pid == -1 || collect_acks(pid, fds[0], crash_ms, &acks, &count, &capacity) != 0;
+    close(fds[0]);
+    if (pid != -1) {
+      waitpid(pid, NULL, 0);
+    }
+    if (failed) {
+      print_error("The serving process failed.\n");
+      break;
+    }
+
+    printf("Crash %ld after %ldms and %zu acknowledged changes: ", i + 1, crash_ms, count - before);
+    long elapsed_us = 0;
+    failed = recover(data_dir, acks, count, round.first_event + round.events - 1, &elapsed_us, &lost);
+    printf(", %s\n", failed ? "inconsistent" : lost > 0 ? "acknowledged changes lost" : "every change found");
+    total_us += elapsed_us;
+    worst_us = elapsed_us > worst_us ? elapsed_us : worst_us;
+    recovered++;
+  }
+
+  if (recovered > 0) {
+    printf("%zu acknowledged changes checked, %zu lost; recovery took %.3fs on average, %.3fs at most\n", count, lost,
+           (double)total_us / 1e6 / (double)recovered, (double)worst_us / 1e6);
+  }
+  free(acks);
+  bench_remove_data_dir(data_dir);
+  return failed || lost > 0;
+}
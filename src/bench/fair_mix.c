@@ -0,0 +1,195 @@
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "common/constants.h"
+#include "common/io.h"
+#include "protocol.h"
+
+#define HEAVY_BURST 512           // SHOW requests a heavy session writes before reading any reply
+#define LIGHT_PAUSE_US 1000       // Pause of a light session between two requests
+#define MAX_LIGHT_SAMPLES 100000  // Latencies recorded by each light session
+
+/**
+ * Runs one client process until the deadline. A heavy client creates a one-seat event, so that each of
+ * its requests pays the state access delay, then writes HEAVY_BURST SHOW requests for it at a time, as a
+ * client replaying a large job file without waiting would, reads their replies, and reports the number of
+ * requests served. A light client sends one LIST at a time and reports the latency of each.
+ */
+static void run_client(const char* server_path, long index, long heavy, unsigned char weight,
+                       const struct timespec* deadline, int results_fd) {
+  struct BenchSession session;
+  snprintf(session.req_path, MAX_PATH, "/tmp/mix_%ld_req", index);
+  snprintf(session.resp_path, MAX_PATH, "/tmp/mix_%ld_resp", index);
+  int server_fd = open(server_path, O_WRONLY);
+  if (server_fd == -1 || bench_open_session(&session, server_fd, weight) != 0) {
+    unlink(session.req_path);
+    unlink(session.resp_path);
+    long header[2] = {heavy, -1};
+    my_write(results_fd, header, sizeof(header));
+    _exit(1);
+  }
+  close(server_fd);
+
+  // Heavy sessions show an event of their own
+  unsigned int event_id = (unsigned int)index + 1;
+  char show[1 + sizeof(int) + sizeof(unsigned int)];
+  show[0] = 5;
+  memcpy(show + 1, &session.session_id, sizeof(int));
+  memcpy(show + 1 + sizeof(int), &event_id, sizeof(unsigned int));
+
+  char* burst = malloc(HEAVY_BURST * sizeof(show));
+  long* latencies = malloc(MAX_LIGHT_SAMPLES * sizeof(long));
+  for (size_t i = 0; burst != NULL && i < HEAVY_BURST; i++) {
+    memcpy(burst + i * sizeof(show), show, sizeof(show));
+  }
+
+  char create[sizeof(unsigned int) + 2 * sizeof(size_t)];
+  size_t size[2] = {1, 1};
+  memcpy(create, &event_id, sizeof(unsigned int));
+  memcpy(create + sizeof(unsigned int), size, sizeof(size));
+  if (heavy && (bench_send(&session, 3, &create, sizeof(create)) != 0 || bench_read_result(&session) == -1)) {
+    free(burst);
+    burst = NULL;
+  }
+
+  long count = 0;
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  while (burst != NULL && latencies != NULL && bench_elapsed_us(&now, deadline) > 0) {
+    if (heavy) {
+      if (my_write(session.req_fd, burst, HEAVY_BURST * sizeof(show)) == -1) {
+        break;
+      }
+      int failed = 0;
+      for (size_t i = 0; i < HEAVY_BURST && !failed; i++) {
+        failed = bench_read_show(&session) < 0;
+      }
+      if (failed) {
+        break;
+      }
+      count += HEAVY_BURST;
+      clock_gettime(CLOCK_MONOTONIC, &now);
+    } else {
+      struct timespec sent_at;
+      clock_gettime(CLOCK_MONOTONIC, &sent_at);
+      if (bench_send(&session, 6, NULL, 0) != 0 || bench_read_list(&session) != 0) {
+        break;
+      }
+      clock_gettime(CLOCK_MONOTONIC, &now);
+      if (count < MAX_LIGHT_SAMPLES) {
+        latencies[count++] = bench_elapsed_us(&sent_at, &now);
+      }
+
+      struct timespec pause = {0, LIGHT_PAUSE_US * 1000L};
+      nanosleep(&pause, NULL);
+      clock_gettime(CLOCK_MONOTONIC, &now);
+    }
+  }
+
+  long header[2] = {heavy, count};
+  my_write(results_fd, header, sizeof(header));
+  if (!heavy && latencies != NULL) {
+    my_write(results_fd, latencies, (size_t)count * sizeof(long));
+  }
+
+  bench_close_session(&session);
+  free(burst);
+  free(latencies);
+  _exit(0);
+}
+
+/**
+ * Measures how a running server shares its workers between heavy sessions, which keep many requests
+ * buffered, and light interactive sessions, which send one request at a time. Run the server with a small
+ * state access delay so that operations have a cost.
+ *
+ * Reports the latency percentiles of the light sessions and the throughput of the heavy ones.
+ *
+ * @param argc Number of command-line arguments.
+ * @param argv Array of command-line arguments.
+ * @return 0 if the benchmark ran, 1 otherwise.
+ */
+int main(int argc, char* argv[]) {
+  if (argc < 4 || argc > 6) {
+    fprintf(stderr, "Usage: %s <server pipe path> <heavy sessions> <light sessions> [seconds] [heavy weight]\n",
+            argv[0]);
+    return 1;
+  }
+
+  long heavy = strtol(argv[2], NULL, 10);
+  long light = strtol(argv[3], NULL, 10);
+  long seconds = argc > 4 ? strtol(argv[4], NULL, 10) : 5;
+  long heavy_weight = argc > 5 ? strtol(argv[5], NULL, 10) : 1;
+  if (heavy < 0 || light <= 0 || seconds <= 0 || heavy_weight <= 0 || heavy_weight > SESSION_MAX_WEIGHT) {
+    print_error("Invalid number of sessions, duration or weight.\n");
+    return 1;
+  }
+
+  int results[2];
+  if (pipe(results) == -1) {
+    print_error("Error creating pipe.\n");
+    return 1;
+  }
+
+  struct timespec deadline;
+  clock_gettime(CLOCK_MONOTONIC, &deadline);
+  deadline.tv_sec += seconds;
+
+  // Heavy clients start first, so light ones arrive while the workers are already busy
+  for (long i = 0; i < heavy + light; i++) {
+    pid_t pid = fork();
+    if (pid == -1) {
+      print_error("Error forking client.\n");
+      return 1;
+    }
+    if (pid == 0) {
+      close(results[0]);
+      run_client(argv[1], i, i < heavy, (unsigned char)(i < heavy ? heavy_weight : 1), &deadline, results[1]);
+    }
+  }
+  close(results[1]);
+
+  long* latencies = malloc((size_t)light * MAX_LIGHT_SAMPLES * sizeof(long));
+  size_t samples = 0;
+  long heavy_requests = 0, failed = 0;
+  long header[2];  // Whether the client was heavy, and its request count or -1 if it failed
+  while (latencies != NULL && my_read(results[0], header, sizeof(header)) == sizeof(header)) {
+    if (header[1] < 0) {
+      failed++;
+      continue;
+    }
+
+    // Heavy clients only send their count; light clients follow it with their latencies
+    if (header[0]) {
+      heavy_requests += header[1];
+      continue;
+    }
+    size_t size = (size_t)header[1] * sizeof(long);
+    if (my_read(results[0], latencies + samples, size) != (ssize_t)size) {
+      break;
+    }
+    samples += (size_t)header[1];
+  }
+  while (wait(NULL) > 0)
+    ;
+
+  if (samples == 0) {
+    printf("no light request completed (%ld sessions failed)\n", failed);
+    free(latencies);
+    return 1;
+  }
+
+  qsort(latencies, samples, sizeof(long), bench_compare_us);
+  printf("%ld heavy sessions (weight %ld): %.0f requests/s\n", heavy, heavy_weight,
+         (double)heavy_requests / (double)seconds);
+  printf("%ld light sessions: %zu requests, latency p50 %ldus, p99 %ldus, max %ldus, %ld sessions failed\n", light,
+         samples, latencies[samples / 2], latencies[(samples * 99) / 100], latencies[samples - 1], failed);
+
+  free(latencies);
+  return 0;
+}
@@ -0,0 +1,220 @@
+// MAP_ANONYMOUS is not part of POSIX
+#define _DEFAULT_SOURCE
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "common/constants.h"
+#include "common/io.h"
+#include "protocol.h"
+
+#define OVERLOAD_EVENT_ID 1        // One-seat event every client shows, so each request pays the state access delay
+#define REFUSED_PAUSE_US 1000      // Pause of a client told the server is overloaded before it tries again
+#define MAX_SERVED_SAMPLES 100000  // Latencies recorded by each client
+
+/**
+ * @enum Outcome
+ * @brief What became of a request, as counted by each client.
+ */
+enum Outcome {
+  OUTCOME_ON_TIME,     // Served before its deadline
+  OUTCOME_LATE,        // Served after its deadline, so the client had already given up on it
+  OUTCOME_OVERLOADED,  // Refused by the server
+  OUTCOME_EXPIRED,     // Dropped by the server
+  OUTCOME_COUNT,
+};
+
+/**
+ * @struct ClientResults
+ * @brief Results of one client, in memory shared with the parent.
+ */
+struct ClientResults {
+  long outcomes[OUTCOME_COUNT];        // Requests per outcome
+  long samples;                        // Latencies recorded, or -1 if the client failed
+  long latencies[MAX_SERVED_SAMPLES];  // Latency of the requests served
+};
+
+/**
+ * Opens a session for a client process.
+ *
+ * @return 0 on success, 1 on failure.
+ */
+static int open_client(struct BenchSession* session, const char* server_path, long index) {
+  snprintf(session->req_path, MAX_PATH, "/tmp/overload_%ld_req", index);
+  snprintf(session->resp_path, MAX_PATH, "/tmp/overload_%ld_resp", index);
+  int server_fd = open(server_path, O_WRONLY);
+  if (server_fd == -1) {
+    return 1;
+  }
+
+  int failed = bench_open_session(session, server_fd, 0);
+  close(server_fd);
+  if (failed) {
+    unlink(session->req_path);
+    unlink(session->resp_path);
+  }
+  return failed;
+}
+
+/**
+ * Runs one client until the end of the run: sends one SHOW at a time, each of which it waits timeout_us for,
+ * telling the server its deadline if send_deadlines is set. Reports how many requests had each outcome, and the
+ * latency of the ones served.
+ */
+static void run_client(const char* server_path, long index, long timeout_us, int send_deadlines,
+                       const struct timespec* end, struct ClientResults* results) {
+  struct BenchSession session;
+  if (open_client(&session, server_path, index) != 0) {
+    results->samples = -1;
+    _exit(1);
+  }
+
+  unsigned int event_id = OVERLOAD_EVENT_ID;
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  while (bench_elapsed_us(&now, end) > 0) {
+    struct timespec sent_at = now;
+    struct timespec deadline = now;
+    deadline.tv_sec += timeout_us / 1000000;
+    deadline.tv_nsec += (timeout_us % 1000000) * 1000;
+    if (deadline.tv_nsec >= 1000000000L) {
+      deadline.tv_sec++;
+      deadline.tv_nsec -= 1000000000L;
+    }
+
+    if ((send_deadlines && bench_send(&session, 7, &deadline, sizeof(struct timespec)) != 0) ||
+        bench_send(&session, 5, &event_id, sizeof(unsigned int)) != 0) {
+      break;
+    }
+    int result = bench_read_show(&session);
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    if (result == 0) {
+      long latency = bench_elapsed_us(&sent_at, &now);
+      results->outcomes[latency <= timeout_us ? OUTCOME_ON_TIME : OUTCOME_LATE]++;
+      if (results->samples < MAX_SERVED_SAMPLES) {
+        results->latencies[results->samples++] = latency;
+      }
+    } else if (result == OP_OVERLOADED) {
+      results->outcomes[OUTCOME_OVERLOADED]++;
+      struct timespec pause = {0, REFUSED_PAUSE_US * 1000L};
+      nanosleep(&pause, NULL);
+      clock_gettime(CLOCK_MONOTONIC, &now);
+    } else if (result == OP_EXPIRED) {
+      results->outcomes[OUTCOME_EXPIRED]++;
+    } else {
+      break;
+    }
+  }
+
+  bench_close_session(&session);
+  _exit(0);
+}
+
+/**
+ * Measures goodput, the requests served before their deadline, when more closed-loop clients than the server can
+ * serve in time each wait a fixed timeout for their requests. Compare runs that send the deadlines to the server
+ * with runs that do not, and servers with and without a queueing delay limit (-o).
+ *
+ * @param argc Number of command-line arguments.
+ * @param argv Array of command-line arguments.
+ * @return 0 if the benchmark ran, 1 otherwise.
+ */
+int main(int argc, char* argv[]) {
+  if (argc < 4 || argc > 6) {
+    fprintf(stderr, "Usage: %s <server pipe path> <clients> <timeout_us> [seconds] [send deadlines (0 or 1)]\n",
+            argv[0]);
+    return 1;
+  }
+
+  long clients = strtol(argv[2], NULL, 10);
+  long timeout_us = strtol(argv[3], NULL, 10);
+  long seconds = argc > 4 ? strtol(argv[4], NULL, 10) : 5;
+  int send_deadlines = argc > 5 ? strtol(argv[5], NULL, 10) != 0 : 1;
+  if (clients <= 0 || timeout_us <= 0 || seconds <= 0) {
+    print_error("Invalid number of clients, timeout or duration.\n");
+    return 1;
+  }
+
+  // Create the event every client shows
+  struct BenchSession setup;
+  char create[sizeof(unsigned int) + 2 * sizeof(size_t)];
+  unsigned int event_id = OVERLOAD_EVENT_ID;
+  size_t size[2] = {1, 1};
+  memcpy(create, &event_id, sizeof(unsigned int));
+  memcpy(create + sizeof(unsigned int), size, sizeof(size));
+  if (open_client(&setup, argv[1], -1) != 0 || bench_send(&setup, 3, create, sizeof(create)) != 0 ||
+      bench_read_result(&setup) != 0) {
+    print_error("Error creating the event.\n");
+    return 1;
+  }
+  bench_close_session(&setup);
+
+  // Clients write their results straight into shared memory, which stays zeroed until they do
+  size_t results_size = (size_t)clients * sizeof(struct ClientResults);
+  struct ClientResults* results = mmap(NULL, results_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (results == MAP_FAILED) {
+    print_error("Error mapping results.\n");
+    return 1;
+  }
+
+  struct timespec end;
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  end.tv_sec += seconds;
+
+  for (long i = 0; i < clients; i++) {
+    pid_t pid = fork();
+    if (pid == -1) {
+      print_error("Error forking client.\n");
+      return 1;
+    }
+    if (pid == 0) {
+      run_client(argv[1], i, timeout_us, send_deadlines, &end, &results[i]);
+    }
+  }
+  while (wait(NULL) > 0)
+    ;
+
+  // Gather the latencies of every client
+  long* latencies = malloc((size_t)clients * MAX_SERVED_SAMPLES * sizeof(long));
+  size_t samples = 0;
+  long totals[OUTCOME_COUNT] = {0};
+  long failed = 0;
+  for (long i = 0; i < clients && latencies != NULL; i++) {
+    if (results[i].samples < 0) {
+      failed++;
+      continue;
+    }
+
+    for (int j = 0; j < OUTCOME_COUNT; j++) {
+      totals[j] += results[i].outcomes[j];
+    }
+    memcpy(latencies + samples, results[i].latencies, (size_t)results[i].samples * sizeof(long));
+    samples += (size_t)results[i].samples;
+  }
+  munmap(results, results_size);
+
+  printf("%ld clients, %ldus timeout, deadlines %s: goodput %.0f/s, late %.0f/s, overloaded %.0f/s, "
+         "expired %.0f/s, %ld clients failed\n",
+         clients, timeout_us, send_deadlines ? "sent" : "not sent", (double)totals[OUTCOME_ON_TIME] / (double)seconds,
+         (double)totals[OUTCOME_LATE] / (double)seconds, (double)totals[OUTCOME_OVERLOADED] / (double)seconds,
+         (double)totals[OUTCOME_EXPIRED] / (double)seconds, failed);
+  if (samples == 0) {
+    printf("no request served\n");
+    free(latencies);
+    return 1;
+  }
+
+  qsort(latencies, samples, sizeof(long), bench_compare_us);
+  printf("served: latency p50 %ldus, p99 %ldus, max %ldus\n", latencies[samples / 2],
+         latencies[(samples * 99) / 100], latencies[samples - 1]);
+
+  free(latencies);
+  return 0;
+}
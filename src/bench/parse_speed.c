@@ -0,0 +1,226 @@
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "client/compiled_jobs.h"
+#include "client/parser.h"
+#include "common/constants.h"
+#include "common/io.h"
+#include "protocol.h"
+
+#define MAX_BUFFER_SIZES 8  // Buffer sizes a single run compares
+
+/**
+ * Writes a .jobs file of about the given size, with the mix of commands a long replay holds: mostly single
+ * and multi-seat reservations, some SHOW and LIST requests, and a few CREATE, WAIT and comment lines.
+ *
+ * @return 0 on success, 1 on failure.
+ */
+static int generate(const char* path, size_t megabytes) {
+  FILE* file = fopen(path, "w");
+  if (file == NULL) {
+    return 1;
+  }
+
+  unsigned int seed = 1;
+  size_t target = megabytes * 1024 * 1024;
+  long written = 0;
+  while (written >= 0 && (size_t)written < target) {
+    unsigned int event_id = (unsigned int)rand_r(&seed) % 1000 + 1;
+    int kind = rand_r(&seed) % 100;
+    if (kind < 60) {
+      int seats = rand_r(&seed) % 8 + 1;
+      fprintf(file, "RESERVE %u [", event_id);
+      for (int i = 0; i < seats; i++) {
+        fprintf(file, i == 0 ? "(%d,%d)" : " (%d,%d)", rand_r(&seed) % 100 + 1, rand_r(&seed) % 100 + 1);
+      }
+      fputs("]\n", file);
+    } else if (kind < 80) {
+      fprintf(file, "SHOW %u\n", event_id);
+    } else if (kind < 90) {
+      fputs("LIST\n", file);
+    } else if (kind < 95) {
+      fprintf(file, "CREATE %u %d %d\n", event_id, rand_r(&seed) % 100 + 1, rand_r(&seed) % 100 + 1);
+    } else if (kind < 98) {
+      fputs("WAIT 0\n", file);
+    } else {
+      fputs("# replayed from the nightly trace\n", file);
+    }
+    written = ftell(file);
+  }
+
+  return fclose(file) != 0 || written < 0;
+}
+
+/**
+ * Parses a .jobs file the way the client does, without sending anything, and prints the parser throughput.
+ *
+ * @return 0 on success, 1 on failure.
+ */
+static int parse(const char* path, size_t buffer_size) {
+  char* buffer = malloc(buffer_size);
+  int fd = open(path, O_RDONLY);
+  struct stat info;
+  if (buffer == NULL || fd == -1 || fstat(fd, &info) == -1) {
+    free(buffer);
+    return 1;
+  }
+
+  struct Reader reader;
+  reader_init(&reader, fd, buffer, buffer_size);
+
+  struct timespec start, end;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  size_t commands = 0, seats = 0, invalid = 0;
+  enum Command command;
+  while ((command = get_next(&reader)) != EOC) {
+    unsigned int event_id, delay;
+    size_t num_rows, num_cols;
+    size_t xs[MAX_RESERVATION_SIZE], ys[MAX_RESERVATION_SIZE];
+    int failed = 0;
+
+    switch (command) {
+      case CMD_CREATE:
+        failed = parse_create(&reader, &event_id, &num_rows, &num_cols) != 0;
+        break;
+      case CMD_RESERVE: {
+        size_t num_coords = parse_reserve(&reader, MAX_RESERVATION_SIZE, &event_id, xs, ys);
+        failed = num_coords == 0;
+        seats += num_coords;
+        break;
+      }
+      case CMD_SHOW:
+        failed = parse_show(&reader, &event_id) != 0;
+        break;
+      case CMD_WAIT:
+        failed = parse_wait(&reader, &delay, NULL) == -1;
+        break;
+      case CMD_INVALID:
+        failed = 1;
+        break;
+      case CMD_LIST_EVENTS:
+      case CMD_STATS:
+      case CMD_HELP:
+      case CMD_EMPTY:
+      case EOC:
+        break;
+    }
+
+    commands++;
+    invalid += (size_t)failed;
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  close(fd);
+  free(buffer);
+
+  double seconds = (double)bench_elapsed_us(&start, &end) / 1e6;
+  printf("%zu byte buffer: %.1f MB/s, %.0f commands/s (%zu commands, %zu seats, %zu invalid, %.2fs)\n", buffer_size,
+         (double)info.st_size / (1024.0 * 1024.0) / seconds, (double)commands / seconds, commands, seats, invalid,
+         seconds);
+  return 0;
+}
+
+/**
+ * Compiles a .jobs file and decodes the compiled file the way the client replays it, without sending anything, and
+ * prints the decoding throughput.
+ *
+ * @return 0 on success, 1 on failure.
+ */
+static int decode(const char* path) {
+  struct timespec start, end;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  if (jobs_compile(path, NULL) != 0) {
+    return 1;
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  double compile_seconds = (double)bench_elapsed_us(&start, &end) / 1e6;
+
+  char jobc_path[MAX_JOB_FILE_NAME_SIZE];
+  snprintf(jobc_path, sizeof(jobc_path), "%.*sjobc", (int)(strlen(path) - 4), path);
+  int fd = open(jobc_path, O_RDONLY);
+  struct stat info;
+  struct CompiledJobs jobs;
+  if (fd == -1 || fstat(fd, &info) == -1 || compiled_jobs_open(&jobs, fd) != 0) {
+    if (fd != -1) {
+      close(fd);
+    }
+    return 1;
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  size_t commands = 0, seats = 0;
+  struct JobCommand command;
+  int failed;
+  while ((failed = compiled_jobs_next(&jobs, &command)) == 0 && command.command != EOC) {
+    commands++;
+    seats += command.command == CMD_RESERVE ? command.num_coords : 0;
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  compiled_jobs_close(&jobs);
+  close(fd);
+
+  double seconds = (double)bench_elapsed_us(&start, &end) / 1e6;
+  printf("compiled (%.1f MB, %.2fs to compile): %.1f MB/s, %.0f commands/s (%zu commands, %zu seats, %.2fs)\n",
+         (double)info.st_size / (1024.0 * 1024.0), compile_seconds, (double)info.st_size / (1024.0 * 1024.0) / seconds,
+         (double)commands / seconds, commands, seats, seconds);
+  return failed;
+}
+
+/**
+ * Measures how fast the client parses large .jobs files. Generates a file of the given size, unless the size is
+ * 0, then parses it once per buffer size given; a 1 byte buffer costs a read() per byte, as unbuffered parsing did.
+ * Last, compiles the file and decodes the compiled file.
+ *
+ * @param argc Number of command-line arguments.
+ * @param argv Array of command-line arguments.
+ * @return 0 if the benchmark ran, 1 otherwise.
+ */
+int main(int argc, char* argv[]) {
+  if (argc < 3 || argc > 3 + MAX_BUFFER_SIZES) {
+    fprintf(stderr, "Usage: %s <.jobs file path> <megabytes to generate, 0 to keep the file> [buffer sizes...]\n",
+            argv[0]);
+    return 1;
+  }
+
+  long megabytes = strtol(argv[2], NULL, 10);
+  if (megabytes < 0) {
+    print_error("Invalid file size.\n");
+    return 1;
+  }
+  if (megabytes > 0 && generate(argv[1], (size_t)megabytes) != 0) {
+    print_error("Error generating the .jobs file.\n");
+    return 1;
+  }
+
+  size_t buffer_sizes[MAX_BUFFER_SIZES] = {1, READER_BUFFER_SIZE};
+  int count = argc > 3 ? argc - 3 : 2;
+  for (int i = 3; i < argc; i++) {
+    long size = strtol(argv[i], NULL, 10);
+    if (size <= 0) {
+      print_error("Invalid buffer size.\n");
+      return 1;
+    }
+    buffer_sizes[i - 3] = (size_t)size;
+  }
+
+  for (int i = 0; i < count; i++) {
+    if (parse(argv[1], buffer_sizes[i]) != 0) {
+      print_error("Error parsing the .jobs file.\n");
+      return 1;
+    }
+  }
+
+  if (decode(argv[1]) != 0) {
+    print_error("Error decoding the compiled .jobs file.\n");
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,205 @@
+#include "protocol.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "common/io.h"
+
+#define SETUP_ATTEMPTS 100  // Setups sent for one session before giving up on a busy server
+
+/**
+ * Returns the elapsed time between two instants in microseconds.
+ */
+long bench_elapsed_us(const struct timespec* start, const struct timespec* end) {
+  return (end->tv_sec - start->tv_sec) * 1000000L + (end->tv_nsec - start->tv_nsec) / 1000;
+}
+
+/**
+ * Compares two latencies for qsort.
+ */
+int bench_compare_us(const void* a, const void* b) {
+  long x = *(const long*)a;
+  long y = *(const long*)b;
+  return (x > y) - (x < y);
+}
+
+/**
+ * Removes a data directory and the files in it.
+ */
+void bench_remove_data_dir(const char* path) {
+  DIR* directory = opendir(path);
+  if (directory == NULL) {
+    return;
+  }
+  struct dirent* entry;
+  char file[PATH_MAX];
+  while ((entry = readdir(directory)) != NULL) {
+    if (strcmp(entry->d_name, ".") != 0 && strcmp(entry->d_name, "..") != 0 &&
+        snprintf(file, sizeof(file), "%s/%s", path, entry->d_name) < (int)sizeof(file)) {
+      unlink(file);
+    }
+  }
+  closedir(directory);
+  rmdir(path);
+}
+
+/**
+ * Opens a session: creates its pipes, sends the setup and waits for the reply, retrying while the
+ * server is busy.
+ *
+ * @param session Session whose pipe paths are set.
+ * @param server_fd Server pipe, opened for writing.
+ * @param weight Scheduling weight asked for, 0 for the default.
+ * @return 0 on success, 1 on failure.
+ */
+int bench_open_session(struct BenchSession* session, int server_fd, unsigned char weight) {
+  unlink(session->req_path);
+  unlink(session->resp_path);
+  if (mkfifo(session->req_path, 0666) != 0 || mkfifo(session->resp_path, 0666) != 0) {
+    return 1;
+  }
+
+  char message[SETUP_MESSAGE_SIZE];
+  memset(message, 0, SETUP_MESSAGE_SIZE);
+  message[0] = 1;
+  memcpy(message + 1, session->req_path, strlen(session->req_path));
+  memcpy(message + 1 + MAX_PATH, session->resp_path, strlen(session->resp_path));
+  message[1 + 2 * MAX_PATH] = (char)weight;
+
+  for (int attempt = 0; attempt < SETUP_ATTEMPTS; attempt++) {
+    session->resp_fd = open(session->resp_path, O_RDONLY | O_NONBLOCK);
+    if (session->resp_fd == -1 || my_write(server_fd, message, SETUP_MESSAGE_SIZE) == -1) {
+      return 1;
+    }
+
+    struct pollfd reply_poll = {.fd = session->resp_fd, .events = POLLIN, .revents = 0};
+    int status;
+    if (poll(&reply_poll, 1, SETUP_REPLY_TIMEOUT_MS) <= 0 ||
+        my_read(session->resp_fd, &status, sizeof(int)) != sizeof(int)) {
+      close(session->resp_fd);
+      return 1;
+    }
+
+    if (status == SETUP_ACCEPTED) {
+      if (my_read(session->resp_fd, &session->session_id, sizeof(int)) != sizeof(int) ||
+          fcntl(session->resp_fd, F_SETFL, 0) == -1) {
+        close(session->resp_fd);
+        return 1;
+      }
+
+      session->req_fd = open(session->req_path, O_WRONLY);
+      return session->req_fd == -1;
+    }
+
+    close(session->resp_fd);
+    struct timespec backoff = {0, SETUP_BACKOFF_US * 1000L};
+    nanosleep(&backoff, NULL);
+  }
+
+  return 1;
+}
+
+/**
+ * Sends a request in a single write.
+ *
+ * @return 0 on success, 1 on failure.
+ */
+int bench_send(const struct BenchSession* session, char op_code, const void* args, size_t size) {
+  // Large enough for a CREATE, or a RESERVE of a single seat
+  char request[1 + sizeof(int) + sizeof(unsigned int) + 3 * sizeof(size_t)];
+  if (size > sizeof(request) - 1 - sizeof(int)) {
+    return 1;
+  }
+
+  request[0] = op_code;
+  memcpy(request + 1, &session->session_id, sizeof(int));
+  if (size > 0) {
+    memcpy(request + 1 + sizeof(int), args, size);
+  }
+  return my_write(session->req_fd, request, 1 + sizeof(int) + size) == -1;
+}
+
+/**
+ * Reads the result of a CREATE or RESERVE.
+ *
+ * @return The result, or -1 on failure.
+ */
+int bench_read_result(const struct BenchSession* session) {
+  int result;
+  return my_read(session->resp_fd, &result, sizeof(int)) == sizeof(int) ? result : -1;
+}
+
+/**
+ * Reads a LIST reply.
+ *
+ * @return 0 on success, 1 on failure.
+ */
+int bench_read_list(const struct BenchSession* session) {
+  int result;
+  if (my_read(session->resp_fd, &result, sizeof(int)) != sizeof(int)) {
+    return 1;
+  }
+  if (result != 0) {
+    return 0;
+  }
+
+  size_t count;
+  if (my_read(session->resp_fd, &count, sizeof(size_t)) != sizeof(size_t)) {
+    return 1;
+  }
+  for (size_t i = 0; i < count; i++) {
+    unsigned int id;
+    if (my_read(session->resp_fd, &id, sizeof(unsigned int)) != sizeof(unsigned int)) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/**
+ * Reads a SHOW reply.
+ *
+ * @return The result, or -1 on failure.
+ */
+int bench_read_show(const struct BenchSession* session) {
+  int result;
+  if (my_read(session->resp_fd, &result, sizeof(int)) != sizeof(int)) {
+    return -1;
+  }
+  if (result != 0) {
+    return result;
+  }
+
+  size_t size[2];
+  if (my_read(session->resp_fd, size, sizeof(size)) != sizeof(size)) {
+    return -1;
+  }
+
+  unsigned int seats[1024];
+  size_t remaining = size[0] * size[1];
+  while (remaining > 0) {
+    size_t count = remaining < 1024 ? remaining : 1024;
+    if (my_read(session->resp_fd, seats, count * sizeof(unsigned int)) != (ssize_t)(count * sizeof(unsigned int))) {
+      return -1;
+    }
+    remaining -= count;
+  }
+  return 0;
+}
+
+/**
+ * Sends QUIT, closes the session pipes and removes them.
+ */
+void bench_close_session(struct BenchSession* session) {
+  bench_send(session, 2, NULL, 0);
+  close(session->req_fd);
+  close(session->resp_fd);
+  unlink(session->req_path);
+  unlink(session->resp_path);
+}
@@ -0,0 +1,60 @@
+#ifndef BENCH_PROTOCOL_H
+#define BENCH_PROTOCOL_H
+
+#include <stddef.h>
+#include <time.h>
+
+#include "common/constants.h"
+
+/**
+ * @struct BenchSession
+ * @brief A session opened by a benchmark, speaking the raw protocol so that requests can be pipelined.
+ */
+struct BenchSession {
+  int session_id;
+  int req_fd;
+  int resp_fd;
+  char req_path[MAX_PATH];  // Filled in by the caller before the session is opened
+  char resp_path[MAX_PATH];
+};
+
+/// Returns the elapsed time between two instants in microseconds.
+long bench_elapsed_us(const struct timespec* start, const struct timespec* end);
+
+/// Compares two latencies in microseconds, for qsort.
+int bench_compare_us(const void* a, const void* b);
+
+/// Removes a data directory a benchmark ran a server state in, with the checkpoint and log segments it holds.
+void bench_remove_data_dir(const char* path);
+
+/// Opens a session: creates its pipes, sends the setup and waits for the reply, retrying while the server is busy.
+/// @param session Session whose pipe paths are set.
+/// @param server_fd Server pipe, opened for writing.
+/// @param weight Scheduling weight asked for, 0 for the default.
+/// @return 0 on success, 1 on failure.
+int bench_open_session(struct BenchSession* session, int server_fd, unsigned char weight);
+
+/// Sends a request: the op code and session id, followed by the operation's arguments.
+/// @param session The session.
+/// @param op_code Op code of the operation.
+/// @param args Arguments of the operation, or NULL.
+/// @param size Size of the arguments.
+/// @return 0 on success, 1 on failure.
+int bench_send(const struct BenchSession* session, char op_code, const void* args, size_t size);
+
+/// Reads the result of a CREATE or RESERVE.
+/// @return The result, or -1 on failure.
+int bench_read_result(const struct BenchSession* session);
+
+/// Reads a LIST reply, discarding the ids.
+/// @return 0 on success, 1 on failure.
+int bench_read_list(const struct BenchSession* session);
+
+/// Reads a SHOW reply, discarding the seats.
+/// @return The result, or -1 on failure.
+int bench_read_show(const struct BenchSession* session);
+
+/// Sends QUIT, closes the session pipes and removes them.
+void bench_close_session(struct BenchSession* session);
+
+#endif  // BENCH_PROTOCOL_H
@@ -0,0 +1,262 @@
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "common/io.h"
+#include "protocol.h"
+#include "server/operations.h"
+#include "server/replication.h"
+
+#define EVENT_ROWS 20          // Rows of each event
+#define EVENT_COLS 20          // Columns of each event
+#define LATE_FOLLOWER_MS 20    // Time the second follower waits before connecting, so it starts from a snapshot
+#define SAMPLE_INTERVAL_MS 1   // Interval between samples of the lag of a follower
+#define CATCH_UP_TIMEOUT_S 30  // Time a follower gets to apply every change once the primary is done
+
+/**
+ * @struct Workload
+ * @brief Seats the threads of the primary reserve, one at a time, across the events.
+ */
+struct Workload {
+  size_t seats;        // Seats to reserve
+  atomic_size_t next;  // Next seat to reserve
+};
+
+/**
+ * Reserves seats until there are none left, as the workers of a server do.
+ *
+ * @param arg The Workload.
+ * @return NULL.
+ */
+static void* reserve_seats(void* arg) {
+  struct Workload* workload = arg;
+  size_t seat;
+  while ((seat = atomic_fetch_add(&workload->next, 1)) < workload->seats) {
+    unsigned int event_id = (unsigned int)(seat / (EVENT_ROWS * EVENT_COLS)) + 1;
+    size_t x = seat % (EVENT_ROWS * EVENT_COLS) / EVENT_COLS + 1, y = seat % EVENT_COLS + 1;
+    ems_reserve(event_id, 1, &x, &y);
+  }
+  return NULL;
+}
+
+/**
+ * Writes every event of the state to a file, as SHOW replies print them.
+ *
+ * @return 0 on success, 1 on failure.
+ */
+static int dump_events(const char* path, unsigned int events) {
+  int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+  if (fd == -1) {
+    return 1;
+  }
+  char buffer[WRITER_BUFFER_SIZE];
+  struct Writer out;
+  writer_init(&out, fd, buffer, sizeof(buffer));
+  int failed = 0;
+  for (unsigned int id = 1; id <= events && !failed; id++) {
+    failed = ems_show_stdout(&out, id) != 0;
+  }
+  failed = writer_flush(&out) != 0 || failed;
+  close(fd);
+  return failed;
+}
+
+/**
+ * Tells whether two files hold the same bytes.
+ *
+ * @return 1 if they do, 0 otherwise.
+ */
+static int same_contents(const char* path, const char* other_path) {
+  FILE* file = fopen(path, "r");
+  FILE* other = fopen(other_path, "r");
+  int same = file != NULL && other != NULL;
+  while (same) {
+    int c = fgetc(file);
+    same = c == fgetc(other);
+    if (c == EOF) {
+      break;
+    }
+  }
+  if (file != NULL) {
+    fclose(file);
+  }
+  if (other != NULL) {
+    fclose(other);
+  }
+  return same;
+}
+
+/**
+ * Follows the primary in a child process: samples its lag until told the last sequence number the primary
+ * published, waits until it applied that one, then writes its events to a file and prints what it saw.
+ */
+static void follow(const char* socket_path, const char* dump_path, const char* name, long delay_ms, int seq_fd,
+                   unsigned int events) {
+  struct timespec delay = {delay_ms / 1000, delay_ms % 1000 * 1000000L};
+  nanosleep(&delay, NULL);
+  if (ems_init(0) != 0 || ems_follow(socket_path) != 0) {
+    _exit(1);
+  }
+
+  // Lag is sampled while the primary reserves, and the wait for the last change timed once it is done
+  uint64_t last_seq = 0;
+  int told = 0;
+  long max_lag_us = 0, samples = 0, total_lag_us = 0;
+  struct timespec done, now;
+  struct ReplStats stats;
+  while (1) {
+    struct pollfd pfd = {seq_fd, POLLIN, 0};
+    if (!told && poll(&pfd, 1, SAMPLE_INTERVAL_MS) == 1) {
+      told = read(seq_fd, &last_seq, sizeof(last_seq)) == (ssize_t)sizeof(last_seq);
+      if (!told) {
+        _exit(1);
+      }
+      clock_gettime(CLOCK_MONOTONIC, &done);
+    }
+    repl_get_stats(&stats);
+    if (stats.ready && stats.applied > 0) {
+      max_lag_us = stats.lag_us > max_lag_us ? stats.lag_us : max_lag_us;
+      total_lag_us += stats.lag_us;
+      samples++;
+    }
+    if (told && stats.ready && stats.seq >= last_seq) {
+      break;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if (told && bench_elapsed_us(&done, &now) > CATCH_UP_TIMEOUT_S * 1000000L) {
+      print_error("The follower did not catch up with the primary.\n");
+      _exit(1);
+    }
+    if (told) {
+      struct timespec interval = {0, SAMPLE_INTERVAL_MS * 1000000L};
+      nanosleep(&interval, NULL);
+    }
+  }
+  clock_gettime(CLOCK_MONOTONIC, &now);
+
+  printf("%-15s: %zu changes applied after the snapshot, lag %.3fms on average, %.3fms at most; caught up %.3fs "
+         "after the primary\n",
+         name, stats.applied, samples ? (double)total_lag_us / 1e3 / (double)samples : 0.0, (double)max_lag_us / 1e3,
+         (double)bench_elapsed_us(&done, &now) / 1e6);
+  fflush(stdout);
+  _exit(dump_events(dump_path, events));
+}
+
+/**
+ * Reserves seats on a primary from many threads while two followers apply its changes, one from the start and one
+ * from a snapshot taken under load, measuring how far behind they fall, then checks that both end up with the state
+ * of the primary.
+ *
+ * @param argc Number of command-line arguments.
+ * @param argv Array of command-line arguments.
+ * @return 0 if both followers ended up with the state of the primary, 1 otherwise.
+ */
+int main(int argc, char* argv[]) {
+  if (argc != 4) {
+    fprintf(stderr, "Usage: %s <directory> <threads> <events>\n", argv[0]);
+    return 1;
+  }
+
+  long threads = strtol(argv[2], NULL, 10);
+  long events = strtol(argv[3], NULL, 10);
+  if (threads <= 0 || events <= 0 || events > UINT_MAX / (EVENT_ROWS * EVENT_COLS)) {
+    print_error("Invalid number of threads or events.\n");
+    return 1;
+  }
+
+  char dir[PATH_MAX], socket_path[PATH_MAX + 16], dumps[3][PATH_MAX + 16];
+  if (snprintf(dir, sizeof(dir), "%s/repl_bench_%d", argv[1], (int)getpid()) >= (int)sizeof(dir) ||
+      mkdir(dir, 0777) != 0) {
+    print_error("Failed to create the directory.\n");
+    return 1;
+  }
+  snprintf(socket_path, sizeof(socket_path), "%s/socket", dir);
+  const char* names[3] = {"primary", "early follower", "late follower"};
+  for (int i = 0; i < 3; i++) {
+    snprintf(dumps[i], sizeof(dumps[i]), "%s/%d", dir, i);
+  }
+
+  // A follower that is done goes away while the primary may still send it heartbeats
+  signal(SIGPIPE, SIG_IGN);
+
+  // Followers are forked before the primary holds any state or thread; they wait for its socket, the late one
+  // connecting while it reserves
+  int seq_fds[2][2];
+  pid_t followers[2] = {-1, -1};
+  int failed = 0;
+  for (int i = 0; i < 2 && !failed; i++) {
+    failed = pipe(seq_fds[i]) != 0 || (followers[i] = fork()) == -1;
+    if (!failed && followers[i] == 0) {
+      close(seq_fds[i][1]);
+      follow(socket_path, dumps[i + 1], names[i + 1], i == 0 ? 0 : LATE_FOLLOWER_MS, seq_fds[i][0],
+             (unsigned int)events);
+    }
+    if (!failed) {
+      close(seq_fds[i][0]);
+    }
+  }
+
+  if (!failed && (ems_init(0) != 0 || ems_replicate(socket_path) != 0)) {
+    failed = 1;
+  }
+
+  struct Workload workload = {(size_t)events * EVENT_ROWS * EVENT_COLS, 0};
+  struct timespec start, end;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (long i = 0; i < events && !failed; i++) {
+    failed = ems_create((unsigned int)i + 1, EVENT_ROWS, EVENT_COLS) != 0;
+  }
+  pthread_t* workers = malloc((size_t)threads * sizeof(pthread_t));
+  failed = failed || workers == NULL;
+  long started = 0;
+  for (; started < threads && !failed; started++) {
+    failed = pthread_create(&workers[started], NULL, reserve_seats, &workload) != 0;
+  }
+  for (long i = 0; i < started - failed; i++) {
+    pthread_join(workers[i], NULL);
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  free(workers);
+
+  struct ReplStats stats;
+  repl_get_stats(&stats);
+  printf("%-15s: %llu changes published in %.3fs\n", names[0], (unsigned long long)stats.seq,
+         (double)bench_elapsed_us(&start, &end) / 1e6);
+  fflush(stdout);
+  failed = failed || dump_events(dumps[0], (unsigned int)events) != 0;
+
+  // Each follower is told the last sequence number, and is done once it applied it and wrote its events out
+  for (int i = 0; i < 2; i++) {
+    if (followers[i] <= 0) {
+      failed = 1;
+      continue;
+    }
+    int status = 1;
+    if (write(seq_fds[i][1], &stats.seq, sizeof(stats.seq)) != (ssize_t)sizeof(stats.seq)) {
+      kill(followers[i], SIGKILL);
+    }
+    close(seq_fds[i][1]);
+    waitpid(followers[i], &status, 0);
+    int same = !failed && WIFEXITED(status) && WEXITSTATUS(status) == 0 && same_contents(dumps[0], dumps[i + 1]);
+    printf("%-15s: %s\n", names[i + 1], same ? "same events as the primary" : "events differ from the primary");
+    failed = failed || !same;
+  }
+
+  ems_terminate();
+  for (int i = 0; i < 3; i++) {
+    unlink(dumps[i]);
+  }
+  rmdir(dir);
+  return failed;
+}
@@ -0,0 +1,144 @@
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "common/constants.h"
+#include "common/io.h"
+#include "protocol.h"
+#include "server/operations.h"
+
+/**
+ * Gets the resident memory of the process, file-backed pages it maps included.
+ *
+ * @return Resident memory in KiB, or 0 if it could not be read.
+ */
+static size_t resident_kib(void) {
+  FILE* statm = fopen("/proc/self/statm", "r");
+  size_t total = 0, resident = 0;
+  if (statm == NULL) {
+    return 0;
+  }
+  if (fscanf(statm, "%zu %zu", &total, &resident) != 2) {
+    resident = 0;
+  }
+  fclose(statm);
+  return resident * (size_t)sysconf(_SC_PAGESIZE) / 1024;
+}
+
+/**
+ * Shows a range of events, as SHOW requests do, reading every seat of each.
+ *
+ * @return Time taken in microseconds, or -1 on failure.
+ */
+static long show_events(struct Writer* out, unsigned int first, unsigned int last) {
+  struct timespec start, end;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (unsigned int id = first; id <= last; id++) {
+    if (ems_show_stdout(out, id) != 0) {
+      return -1;
+    }
+  }
+  writer_flush(out);
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  return bench_elapsed_us(&start, &end);
+}
+
+/**
+ * Creates the events, each with a reservation of a seat per page of its seats, then shows all of them once and the
+ * hot ones again after a while, printing the memory the process holds at each step.
+ *
+ * @return 0 if the run completed, 1 otherwise.
+ */
+static int run(const char* name, const char* seat_file, int prefault, unsigned int events, size_t rows, size_t cols,
+               unsigned int hot) {
+  int null_fd = open("/dev/null", O_WRONLY);
+  char buffer[WRITER_BUFFER_SIZE];
+  struct Writer out;
+  writer_init(&out, null_fd, buffer, sizeof(buffer));
+
+  size_t before = resident_kib();
+  if (null_fd == -1 || ems_init(0) != 0 || (seat_file != NULL && ems_open_seat_file(seat_file, prefault) != 0)) {
+    if (null_fd != -1) {
+      close(null_fd);
+    }
+    return 1;
+  }
+
+  // Seats that were never written take no memory on the heap, so every page gets one reserved
+  size_t xs[MAX_RESERVATION_SIZE], ys[MAX_RESERVATION_SIZE];
+  size_t seats_per_page = (size_t)sysconf(_SC_PAGESIZE) / sizeof(unsigned int), reserved = 0;
+  for (size_t seat = 0; seat < rows * cols && reserved < MAX_RESERVATION_SIZE; seat += seats_per_page) {
+    xs[reserved] = seat / cols + 1;
+    ys[reserved++] = seat % cols + 1;
+  }
+
+  struct timespec start, end;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  int failed = 0;
+  for (unsigned int id = 1; id <= events && !failed; id++) {
+    failed = ems_create(id, rows, cols) != 0 || ems_reserve(id, reserved, xs, ys) != 0;
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  long created = bench_elapsed_us(&start, &end);
+
+  long shown_all = failed ? -1 : show_events(&out, 1, events);
+  long all_kib = (long)resident_kib() - (long)before;
+
+  // Only the hot events are used after this; the others go cold
+  struct timespec idle = {2, 0};
+  nanosleep(&idle, NULL);
+  long shown_hot = show_events(&out, 1, hot);
+  size_t paged_out = ems_sweep_cold_seats(1);
+  long hot_kib = (long)resident_kib() - (long)before;
+
+  // Cold events are read back in when used again
+  long shown_cold = show_events(&out, events - hot + 1, events);
+
+  if (shown_all < 0 || shown_hot < 0 || shown_cold < 0) {
+    failed = 1;
+  } else {
+    printf("%-13s: created in %.3fs, all shown in %.3fs, resident %ld MiB; %zu paged out, resident %ld MiB; "
+           "%u hot shown in %.3fs, %u cold in %.3fs\n",
+           name, (double)created / 1e6, (double)shown_all / 1e6, all_kib / 1024, paged_out, hot_kib / 1024, hot,
+           (double)shown_hot / 1e6, hot, (double)shown_cold / 1e6);
+  }
+
+  ems_terminate();
+  close(null_fd);
+  return failed;
+}
+
+/**
+ * Measures the memory the server holds for events of which only a few are used, with seats on the heap and in a
+ * seat file, where the seats of unused events are paged out, and the cost of reading cold events back.
+ *
+ * @param argc Number of command-line arguments.
+ * @param argv Array of command-line arguments.
+ * @return 0 if the benchmark ran, 1 otherwise.
+ */
+int main(int argc, char* argv[]) {
+  if (argc != 6) {
+    fprintf(stderr, "Usage: %s <seat file> <events> <rows> <columns> <hot events>\n", argv[0]);
+    return 1;
+  }
+
+  long events = strtol(argv[2], NULL, 10);
+  long rows = strtol(argv[3], NULL, 10);
+  long cols = strtol(argv[4], NULL, 10);
+  long hot = strtol(argv[5], NULL, 10);
+  if (events <= 0 || events > UINT_MAX || rows <= 0 || cols <= 0 || hot <= 0 || hot > events) {
+    print_error("Invalid number of events, rows, columns or hot events.\n");
+    return 1;
+  }
+
+  int failed = run("heap", NULL, 0, (unsigned int)events, (size_t)rows, (size_t)cols, (unsigned int)hot) ||
+               run("file", argv[1], 0, (unsigned int)events, (size_t)rows, (size_t)cols, (unsigned int)hot) ||
+               run("file prefault", argv[1], 1, (unsigned int)events, (size_t)rows, (size_t)cols, (unsigned int)hot);
+  if (failed) {
+    print_error("Error running the events.\n");
+  }
+  return failed;
+}
@@ -0,0 +1,206 @@
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "common/constants.h"
+#include "common/io.h"
+#include "protocol.h"
+
+#define SESSIONS_PER_PROCESS 1000  // Sessions opened by each client process, which holds two pipes for each
+
+/**
+ * Prints the resident memory and thread count of the server, read from /proc.
+ */
+static void print_server_usage(long pid, const char* when) {
+  char path[64];
+  snprintf(path, sizeof(path), "/proc/%ld/status", pid);
+  FILE* status = fopen(path, "r");
+  if (status == NULL) {
+    return;
+  }
+
+  long rss_kb = 0, threads = 0;
+  char line[256];
+  while (fgets(line, sizeof(line), status) != NULL) {
+    sscanf(line, "VmRSS: %ld", &rss_kb);
+    sscanf(line, "Threads: %ld", &threads);
+  }
+  fclose(status);
+  printf("server %s: %ld kB resident, %ld threads\n", when, rss_kb, threads);
+}
+
+/**
+ * Runs one client process: opens its sessions and reports how many it opened, waits for the go signal,
+ * then sends a LIST on every session before reading any reply, for each round. Every latency is sent to
+ * the parent, followed by the session count.
+ */
+static void run_client(const char* server_path, long first, long count, long rounds, int ready_fd, int go_fd,
+                       int results_fd) {
+  struct BenchSession* sessions = calloc((size_t)count, sizeof(struct BenchSession));
+  struct timespec* sent_at = calloc((size_t)count, sizeof(struct timespec));
+  int server_fd = open(server_path, O_WRONLY);
+  if (sessions == NULL || sent_at == NULL || server_fd == -1) {
+    long opened = 0;
+    my_write(ready_fd, &opened, sizeof(long));
+    _exit(1);
+  }
+
+  long opened = 0;
+  for (long i = 0; i < count; i++) {
+    struct BenchSession* session = &sessions[opened];
+    snprintf(session->req_path, MAX_PATH, "/tmp/flood_%ld_req", first + i);
+    snprintf(session->resp_path, MAX_PATH, "/tmp/flood_%ld_resp", first + i);
+    if (bench_open_session(session, server_fd, 0) == 0) {
+      opened++;
+    } else {
+      unlink(session->req_path);
+      unlink(session->resp_path);
+    }
+  }
+  close(server_fd);
+  my_write(ready_fd, &opened, sizeof(long));
+
+  // Every session is open; wait until every other process is ready too
+  char go;
+  my_read(go_fd, &go, sizeof(char));
+
+  for (long round = 0; round < rounds; round++) {
+    for (long i = 0; i < opened; i++) {
+      clock_gettime(CLOCK_MONOTONIC, &sent_at[i]);
+      if (bench_send(&sessions[i], 6, NULL, 0) != 0) {
+        print_error("Error sending request.\n");
+      }
+    }
+
+    for (long i = 0; i < opened; i++) {
+      struct timespec end;
+      long latency = -1;
+      if (bench_read_list(&sessions[i]) == 0) {
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        latency = bench_elapsed_us(&sent_at[i], &end);
+      }
+      my_write(results_fd, &latency, sizeof(long));
+    }
+  }
+
+  for (long i = 0; i < opened; i++) {
+    bench_close_session(&sessions[i]);
+  }
+
+  free(sessions);
+  free(sent_at);
+  _exit(0);
+}
+
+/**
+ * Opens many sessions at once against a running server, keeps them all open, and measures LIST requests
+ * sent on all of them concurrently.
+ *
+ * Sessions are spread over client processes of SESSIONS_PER_PROCESS sessions each, to stay within the
+ * per-process file limit. With the server's pid, its memory and thread count are reported before the
+ * sessions are opened and while all of them are live.
+ *
+ * @param argc Number of command-line arguments.
+ * @param argv Array of command-line arguments.
+ * @return 0 if the benchmark ran, 1 otherwise.
+ */
+int main(int argc, char* argv[]) {
+  if (argc < 3 || argc > 5) {
+    fprintf(stderr, "Usage: %s <server pipe path> <number of sessions> [rounds] [server pid]\n", argv[0]);
+    return 1;
+  }
+
+  long sessions = strtol(argv[2], NULL, 10);
+  long rounds = argc > 3 ? strtol(argv[3], NULL, 10) : 10;
+  long server_pid = argc > 4 ? strtol(argv[4], NULL, 10) : 0;
+  if (sessions <= 0 || rounds <= 0) {
+    print_error("Invalid number of sessions or rounds.\n");
+    return 1;
+  }
+
+  int ready[2], go[2], results[2];
+  if (pipe(ready) == -1 || pipe(go) == -1 || pipe(results) == -1) {
+    print_error("Error creating pipe.\n");
+    return 1;
+  }
+
+  if (server_pid > 0) {
+    print_server_usage(server_pid, "before");
+  }
+
+  struct timespec setup_start, setup_end, run_end;
+  clock_gettime(CLOCK_MONOTONIC, &setup_start);
+
+  long processes = 0;
+  for (long first = 0; first < sessions; first += SESSIONS_PER_PROCESS) {
+    long count = sessions - first < SESSIONS_PER_PROCESS ? sessions - first : SESSIONS_PER_PROCESS;
+    pid_t pid = fork();
+    if (pid == -1) {
+      print_error("Error forking client.\n");
+      return 1;
+    }
+    if (pid == 0) {
+      close(ready[0]);
+      close(go[1]);
+      close(results[0]);
+      run_client(argv[1], first, count, rounds, ready[1], go[0], results[1]);
+    }
+    processes++;
+  }
+  close(ready[1]);
+  close(go[0]);
+  close(results[1]);
+
+  long opened = 0;
+  for (long i = 0; i < processes; i++) {
+    long count = 0;
+    if (my_read(ready[0], &count, sizeof(long)) == sizeof(long)) {
+      opened += count;
+    }
+  }
+  clock_gettime(CLOCK_MONOTONIC, &setup_end);
+  printf("%ld/%ld sessions open in %.3fs\n", opened, sessions,
+         (double)bench_elapsed_us(&setup_start, &setup_end) / 1e6);
+  if (server_pid > 0) {
+    print_server_usage(server_pid, "with every session open");
+  }
+
+  // Closing the go pipe releases every client process at once
+  struct timespec run_start;
+  clock_gettime(CLOCK_MONOTONIC, &run_start);
+  close(go[1]);
+
+  long* latencies = malloc((size_t)(opened * rounds + 1) * sizeof(long));
+  size_t completed = 0, failed = 0;
+  long latency;
+  while (my_read(results[0], &latency, sizeof(long)) == sizeof(long)) {
+    if (latency < 0) {
+      failed++;
+    } else if (completed < (size_t)(opened * rounds)) {
+      latencies[completed++] = latency;
+    }
+  }
+  clock_gettime(CLOCK_MONOTONIC, &run_end);
+  while (wait(NULL) > 0)
+    ;
+
+  if (completed == 0) {
+    printf("no request completed (%zu failed)\n", failed);
+    free(latencies);
+    return 1;
+  }
+
+  qsort(latencies, completed, sizeof(long), bench_compare_us);
+  double seconds = (double)bench_elapsed_us(&run_start, &run_end) / 1e6;
+  printf("%zu LIST requests over %ld sessions in %.3fs (%.0f requests/s), %zu failed\n", completed, opened,
+         seconds, (double)completed / seconds, failed);
+  printf("request latency p50 %ldus, p99 %ldus, max %ldus\n", latencies[completed / 2],
+         latencies[(completed * 99) / 100], latencies[completed - 1]);
+
+  free(latencies);
+  return 0;
+}
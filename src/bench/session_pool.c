@@ -0,0 +1,124 @@
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "client/api.h"
+#include "client/session_pool.h"
+#include "common/constants.h"
+#include "common/io.h"
+#include "protocol.h"
+
+#define SEATS_PER_ROW 100  // Columns of the event the reservations are made in
+
+/**
+ * @struct Gateway
+ * @brief State shared by the threads of a run: the pool they serve requests over and the seats left to reserve.
+ */
+struct Gateway {
+  struct EmsPool* pool;   // Sessions the threads share
+  unsigned int event_id;  // Event whose seats are reserved
+  size_t seats;           // Seats to reserve
+  atomic_size_t next;     // Next seat to reserve
+  atomic_size_t failed;   // Reservations that failed
+};
+
+/**
+ * Serves requests the way a gateway thread does: checks a session out for each reservation and hands it back.
+ *
+ * @param arg The Gateway.
+ * @return NULL.
+ */
+static void* serve(void* arg) {
+  struct Gateway* gateway = arg;
+  size_t seat;
+  while ((seat = atomic_fetch_add(&gateway->next, 1)) < gateway->seats) {
+    size_t x = seat / SEATS_PER_ROW + 1, y = seat % SEATS_PER_ROW + 1;
+    struct EmsSession* session = ems_pool_acquire(gateway->pool);
+    if (ems_reserve(session, gateway->event_id, 1, &x, &y) != 0) {
+      atomic_fetch_add(&gateway->failed, 1);
+    }
+    ems_pool_release(gateway->pool, session);
+  }
+  return NULL;
+}
+
+/**
+ * Measures how many reservations a multi-threaded client gets through over a pool of sessions, for pools of 1 up to
+ * the given number of sessions, doubling the size every run.
+ *
+ * @param argc Number of command-line arguments.
+ * @param argv Array of command-line arguments.
+ * @return 0 if the benchmark ran, 1 otherwise.
+ */
+int main(int argc, char* argv[]) {
+  if (argc != 5) {
+    fprintf(stderr, "Usage: %s <server pipe path> <threads> <largest pool size> <reservations per run>\n", argv[0]);
+    return 1;
+  }
+
+  long threads = strtol(argv[2], NULL, 10);
+  long max_sessions = strtol(argv[3], NULL, 10);
+  long seats = strtol(argv[4], NULL, 10);
+  if (threads <= 0 || max_sessions <= 0 || seats <= 0) {
+    print_error("Invalid number of threads, sessions or reservations.\n");
+    return 1;
+  }
+
+  pthread_t* workers = malloc((size_t)threads * sizeof(pthread_t));
+  if (workers == NULL) {
+    print_error("Error allocating the threads.\n");
+    return 1;
+  }
+
+  char prefix[MAX_PATH];
+  snprintf(prefix, MAX_PATH, "/tmp/pool_%d", (int)getpid());
+
+  // Fresh events for every run, so that the reservations succeed against a server that keeps running
+  unsigned int event_id = (unsigned int)getpid() * 64;
+  for (long sessions = 1; sessions <= max_sessions; sessions *= 2, event_id++) {
+    struct EmsPool* pool = ems_pool_create(prefix, argv[1], (size_t)sessions, 0);
+    if (pool == NULL) {
+      print_error("Error opening the session pool.\n");
+      free(workers);
+      return 1;
+    }
+
+    struct EmsSession* session = ems_pool_acquire(pool);
+    int created = ems_create(session, event_id, ((size_t)seats + SEATS_PER_ROW - 1) / SEATS_PER_ROW, SEATS_PER_ROW);
+    ems_pool_release(pool, session);
+    if (created != 0) {
+      print_error("Error creating the event.\n");
+      ems_pool_destroy(pool);
+      free(workers);
+      return 1;
+    }
+
+    struct Gateway gateway = {pool, event_id, (size_t)seats, 0, 0};
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    long started = 0;
+    while (started < threads && pthread_create(&workers[started], NULL, serve, &gateway) == 0) {
+      started++;
+    }
+    for (long i = 0; i < started; i++) {
+      pthread_join(workers[i], NULL);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    long elapsed = bench_elapsed_us(&start, &end);
+    printf("%ld threads over %3ld sessions: %.0f reservations/s (%zu failed, %.3fs)\n", started, sessions,
+           (double)seats * 1e6 / (double)(elapsed > 0 ? elapsed : 1), atomic_load(&gateway.failed),
+           (double)elapsed / 1e6);
+
+    if (ems_pool_destroy(pool) != 0) {
+      print_error("Error closing the session pool.\n");
+    }
+  }
+
+  free(workers);
+  return 0;
+}
@@ -0,0 +1,125 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "client/api.h"
+#include "common/constants.h"
+#include "common/io.h"
+
+/**
+ * Compares two latencies for qsort.
+ */
+static int compare_us(const void* a, const void* b) {
+  long x = *(const long*)a;
+  long y = *(const long*)b;
+  return (x > y) - (x < y);
+}
+
+/**
+ * Returns the elapsed time between two instants in microseconds.
+ */
+static long elapsed_us(const struct timespec* start, const struct timespec* end) {
+  return (end->tv_sec - start->tv_sec) * 1000000L + (end->tv_nsec - start->tv_nsec) / 1000;
+}
+
+/**
+ * Starts many clients at once against a running server and reports how quickly their setups are accepted.
+ *
+ * Every client is a separate process that sets up a session and quits right away. Each one reports its
+ * setup latency (including any busy retries) to the parent through a pipe.
+ *
+ * @param argc Number of command-line arguments.
+ * @param argv Array of command-line arguments.
+ * @return 0 if the benchmark ran, 1 otherwise.
+ */
+int main(int argc, char* argv[]) {
+  if (argc != 3) {
+    fprintf(stderr, "Usage: %s <server pipe path> <number of clients>\n", argv[0]);
+    return 1;
+  }
+
+  long clients = strtol(argv[2], NULL, 10);
+  if (clients <= 0) {
+    print_error("Invalid number of clients.\n");
+    return 1;
+  }
+
+  // Allocated before any client is forked, so a failure leaves none behind
+  long* latencies = malloc((size_t)clients * sizeof(long));
+  if (latencies == NULL) {
+    print_error("Error allocating the latencies.\n");
+    return 1;
+  }
+
+  int results[2];
+  if (pipe(results) == -1) {
+    print_error("Error creating pipe.\n");
+    free(latencies);
+    return 1;
+  }
+
+  struct timespec storm_start, storm_end;
+  clock_gettime(CLOCK_MONOTONIC, &storm_start);
+
+  for (long i = 0; i < clients; i++) {
+    pid_t pid = fork();
+    if (pid == -1) {
+      print_error("Error forking client.\n");
+      return 1;
+    }
+    if (pid != 0) {
+      continue;
+    }
+
+    close(results[0]);
+    char req_path[MAX_PATH], resp_path[MAX_PATH];
+    snprintf(req_path, MAX_PATH, "/tmp/storm_%ld_req", i);
+    snprintf(resp_path, MAX_PATH, "/tmp/storm_%ld_resp", i);
+    unlink(req_path);
+    unlink(resp_path);
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    long latency = -1;
+    struct EmsSession* session = ems_setup(req_path, resp_path, argv[1], 0);
+    if (session != NULL) {
+      clock_gettime(CLOCK_MONOTONIC, &end);
+      latency = elapsed_us(&start, &end);
+      ems_quit(session);
+    }
+
+    my_write(results[1], &latency, sizeof(long));
+    _exit(0);
+  }
+  close(results[1]);
+
+  size_t accepted = 0;
+  long latency;
+  while (my_read(results[0], &latency, sizeof(long)) == sizeof(long)) {
+    if (latency >= 0) {
+      latencies[accepted++] = latency;
+    }
+  }
+  while (wait(NULL) > 0)
+    ;
+  clock_gettime(CLOCK_MONOTONIC, &storm_end);
+
+  if (accepted == 0) {
+    printf("0/%ld setups accepted\n", clients);
+    free(latencies);
+    return 0;
+  }
+
+  qsort(latencies, accepted, sizeof(long), compare_us);
+  double seconds = (double)elapsed_us(&storm_start, &storm_end) / 1e6;
+  printf("%zu/%ld setups accepted in %.3fs (%.1f setups/s)\n", accepted, clients, seconds,
+         (double)accepted / seconds);
+  printf("setup latency p50 %ldus, p99 %ldus, max %ldus\n", latencies[accepted / 2],
+         latencies[(accepted * 99) / 100], latencies[accepted - 1]);
+
+  free(latencies);
+  return 0;
+}
@@ -0,0 +1,225 @@
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "common/constants.h"
+#include "common/io.h"
+#include "protocol.h"
+
+#define STORM_EVENT_ID 1            // Event shown by the pollers and reserved by the reservers
+#define RESERVE_PAUSE_US 1000       // Pause of a reserver between two reservations
+#define MAX_RESERVE_SAMPLES 100000  // Latencies recorded by each reserver
+
+/**
+ * Opens a session for a client process.
+ *
+ * @return 0 on success, 1 on failure.
+ */
+static int open_client(struct BenchSession* session, const char* server_path, long index) {
+  snprintf(session->req_path, MAX_PATH, "/tmp/storm_show_%ld_req", index);
+  snprintf(session->resp_path, MAX_PATH, "/tmp/storm_show_%ld_resp", index);
+  int server_fd = open(server_path, O_WRONLY);
+  if (server_fd == -1) {
+    return 1;
+  }
+
+  int failed = bench_open_session(session, server_fd, 0);
+  close(server_fd);
+  if (failed) {
+    unlink(session->req_path);
+    unlink(session->resp_path);
+  }
+  return failed;
+}
+
+/**
+ * Runs one poller until the deadline: sends SHOW requests for the event back to back, and reports how
+ * many were served.
+ */
+static void run_poller(const char* server_path, long index, const struct timespec* deadline, int results_fd) {
+  struct BenchSession session;
+  long header[2] = {1, -1};  // Poller, request count
+  if (open_client(&session, server_path, index) != 0) {
+    my_write(results_fd, header, sizeof(header));
+    _exit(1);
+  }
+
+  unsigned int event_id = STORM_EVENT_ID;
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  header[1] = 0;
+  while (bench_elapsed_us(&now, deadline) > 0) {
+    if (bench_send(&session, 5, &event_id, sizeof(unsigned int)) != 0 || bench_read_show(&session) < 0) {
+      break;
+    }
+    header[1]++;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+  }
+
+  my_write(results_fd, header, sizeof(header));
+  bench_close_session(&session);
+  _exit(0);
+}
+
+/**
+ * Runs one reserver until the deadline or until its seats run out: reserves one seat at a time in the rows
+ * given to it, and reports the latency of each reservation.
+ */
+static void run_reserver(const char* server_path, long index, long reservers, size_t rows, size_t cols,
+                         const struct timespec* deadline, int results_fd) {
+  struct BenchSession session;
+  long header[2] = {0, -1};  // Reserver, latency count
+  long* latencies = malloc(MAX_RESERVE_SAMPLES * sizeof(long));
+  if (latencies == NULL || open_client(&session, server_path, index) != 0) {
+    my_write(results_fd, header, sizeof(header));
+    _exit(1);
+  }
+
+  unsigned int event_id = STORM_EVENT_ID;
+  size_t num_seats = 1;
+  char reserve[sizeof(unsigned int) + 3 * sizeof(size_t)];
+  memcpy(reserve, &event_id, sizeof(unsigned int));
+  memcpy(reserve + sizeof(unsigned int), &num_seats, sizeof(size_t));
+
+  // Reserver k takes rows k + 1, k + 1 + reservers, and so on
+  size_t row = (size_t)index + 1, col = 1;
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  header[1] = 0;
+  while (row <= rows && header[1] < MAX_RESERVE_SAMPLES && bench_elapsed_us(&now, deadline) > 0) {
+    memcpy(reserve + sizeof(unsigned int) + sizeof(size_t), &row, sizeof(size_t));
+    memcpy(reserve + sizeof(unsigned int) + 2 * sizeof(size_t), &col, sizeof(size_t));
+
+    struct timespec sent_at;
+    clock_gettime(CLOCK_MONOTONIC, &sent_at);
+    if (bench_send(&session, 4, reserve, sizeof(reserve)) != 0 || bench_read_result(&session) != 0) {
+      break;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    latencies[header[1]++] = bench_elapsed_us(&sent_at, &now);
+
+    if (++col > cols) {
+      col = 1;
+      row += (size_t)reservers;
+    }
+
+    struct timespec pause = {0, RESERVE_PAUSE_US * 1000L};
+    nanosleep(&pause, NULL);
+    clock_gettime(CLOCK_MONOTONIC, &now);
+  }
+
+  my_write(results_fd, header, sizeof(header));
+  my_write(results_fd, latencies, (size_t)header[1] * sizeof(long));
+  bench_close_session(&session);
+  free(latencies);
+  _exit(0);
+}
+
+/**
+ * Measures reservation latency on a running server while pollers flood it with SHOW requests for the same
+ * event. Compare runs of the server with and without workers reserved for writes (-r) and SHOW preemption
+ * points (-p), with a small state access delay.
+ *
+ * @param argc Number of command-line arguments.
+ * @param argv Array of command-line arguments.
+ * @return 0 if the benchmark ran, 1 otherwise.
+ */
+int main(int argc, char* argv[]) {
+  if (argc < 4 || argc > 7) {
+    fprintf(stderr, "Usage: %s <server pipe path> <pollers> <reservers> [seconds] [rows] [cols]\n", argv[0]);
+    return 1;
+  }
+
+  long pollers = strtol(argv[2], NULL, 10);
+  long reservers = strtol(argv[3], NULL, 10);
+  long seconds = argc > 4 ? strtol(argv[4], NULL, 10) : 5;
+  long rows = argc > 5 ? strtol(argv[5], NULL, 10) : 120;
+  long cols = argc > 6 ? strtol(argv[6], NULL, 10) : 120;
+  if (pollers < 0 || reservers <= 0 || seconds <= 0 || rows < reservers || cols <= 0) {
+    print_error("Invalid number of clients, duration or event size.\n");
+    return 1;
+  }
+
+  // Create the event every client uses
+  struct BenchSession setup;
+  char create[sizeof(unsigned int) + 2 * sizeof(size_t)];
+  unsigned int event_id = STORM_EVENT_ID;
+  size_t size[2] = {(size_t)rows, (size_t)cols};
+  memcpy(create, &event_id, sizeof(unsigned int));
+  memcpy(create + sizeof(unsigned int), size, sizeof(size));
+  if (open_client(&setup, argv[1], -1) != 0 || bench_send(&setup, 3, create, sizeof(create)) != 0 ||
+      bench_read_result(&setup) != 0) {
+    print_error("Error creating the event.\n");
+    return 1;
+  }
+  bench_close_session(&setup);
+
+  int results[2];
+  if (pipe(results) == -1) {
+    print_error("Error creating pipe.\n");
+    return 1;
+  }
+
+  struct timespec deadline;
+  clock_gettime(CLOCK_MONOTONIC, &deadline);
+  deadline.tv_sec += seconds;
+
+  for (long i = 0; i < pollers + reservers; i++) {
+    pid_t pid = fork();
+    if (pid == -1) {
+      print_error("Error forking client.\n");
+      return 1;
+    }
+    if (pid == 0) {
+      close(results[0]);
+      if (i < reservers) {
+        run_reserver(argv[1], i, reservers, (size_t)rows, (size_t)cols, &deadline, results[1]);
+      }
+      run_poller(argv[1], i, &deadline, results[1]);
+    }
+  }
+  close(results[1]);
+
+  long* latencies = malloc((size_t)reservers * MAX_RESERVE_SAMPLES * sizeof(long));
+  size_t samples = 0;
+  long shows = 0, failed = 0;
+  long header[2];  // Whether the client was a poller, and its request count or -1 if it failed
+  while (latencies != NULL && my_read(results[0], header, sizeof(header)) == sizeof(header)) {
+    if (header[1] < 0) {
+      failed++;
+      continue;
+    }
+
+    // Pollers only send their count; reservers follow it with their latencies
+    if (header[0]) {
+      shows += header[1];
+      continue;
+    }
+    size_t bytes = (size_t)header[1] * sizeof(long);
+    if (my_read(results[0], latencies + samples, bytes) != (ssize_t)bytes) {
+      break;
+    }
+    samples += (size_t)header[1];
+  }
+  while (wait(NULL) > 0)
+    ;
+
+  printf("%ld pollers: %.0f SHOW/s of a %ldx%ld event\n", pollers, (double)shows / (double)seconds, rows, cols);
+  if (samples == 0) {
+    printf("no reservation completed (%ld clients failed)\n", failed);
+    free(latencies);
+    return 1;
+  }
+
+  qsort(latencies, samples, sizeof(long), bench_compare_us);
+  printf("%ld reservers: %zu reservations, latency p50 %ldus, p99 %ldus, max %ldus, %ld clients failed\n",
+         reservers, samples, latencies[samples / 2], latencies[(samples * 99) / 100], latencies[samples - 1],
+         failed);
+
+  free(latencies);
+  return 0;
+}
@@ -0,0 +1,146 @@
+#include <limits.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "common/io.h"
+#include "protocol.h"
+#include "server/operations.h"
+#include "server/wal.h"
+
+#define SEATS_PER_EVENT 100  // Seats of each event, kept small since a reservation scans its whole event
+#define SEATS_PER_ROW 10     // Columns of each event
+
+/**
+ * @struct Workload
+ * @brief Seats the threads of a run reserve, one at a time, each in the event it belongs to.
+ */
+struct Workload {
+  size_t seats;          // Seats to reserve
+  atomic_size_t next;    // Next seat to reserve
+  atomic_size_t failed;  // Reservations that failed
+};
+
+/**
+ * Reserves seats until there are none left, as the workers of a server do.
+ *
+ * @param arg The Workload.
+ * @return NULL.
+ */
+static void* reserve_seats(void* arg) {
+  struct Workload* workload = arg;
+  size_t seat;
+  while ((seat = atomic_fetch_add(&workload->next, 1)) < workload->seats) {
+    unsigned int event_id = (unsigned int)(seat / SEATS_PER_EVENT) + 1;
+    size_t x = seat % SEATS_PER_EVENT / SEATS_PER_ROW + 1, y = seat % SEATS_PER_ROW + 1;
+    if (ems_reserve(event_id, 1, &x, &y) != 0) {
+      atomic_fetch_add(&workload->failed, 1);
+    }
+  }
+  return NULL;
+}
+
+/**
+ * Reserves seats from many threads with the write-ahead log in the given durability mode, or without a log.
+ *
+ * @return 0 if the run completed, 1 otherwise.
+ */
+static int run(const char* data_dir, const char* name, int logged, enum WalDurability durability, long threads,
+               size_t seats) {
+  // Each run starts from an empty data directory of its own
+  if (mkdir(data_dir, 0777) != 0) {
+    print_error("Failed to create the data directory.\n");
+    return 1;
+  }
+  if (ems_init(0) != 0 || (logged && ems_recover(data_dir, durability) != 0)) {
+    bench_remove_data_dir(data_dir);
+    return 1;
+  }
+
+  for (size_t i = 0; i < (seats + SEATS_PER_EVENT - 1) / SEATS_PER_EVENT; i++) {
+    if (ems_create((unsigned int)i + 1, SEATS_PER_EVENT / SEATS_PER_ROW, SEATS_PER_ROW) != 0) {
+      ems_terminate();
+      bench_remove_data_dir(data_dir);
+      return 1;
+    }
+  }
+
+  struct WalStats before;
+  wal_get_stats(&before);
+  struct Workload workload = {seats, 0, 0};
+  pthread_t* workers = malloc((size_t)threads * sizeof(pthread_t));
+  if (workers == NULL) {
+    ems_terminate();
+    bench_remove_data_dir(data_dir);
+    return 1;
+  }
+
+  struct timespec start, end;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  long started = 0;
+  while (started < threads && pthread_create(&workers[started], NULL, reserve_seats, &workload) == 0) {
+    started++;
+  }
+  for (long i = 0; i < started; i++) {
+    pthread_join(workers[i], NULL);
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  struct WalStats after;
+  wal_get_stats(&after);
+  size_t syncs = after.syncs - before.syncs;
+  long elapsed = bench_elapsed_us(&start, &end);
+  printf("%-6s: %.0f reservations/s, %zu syncs, %.1f reservations per sync (%zu failed, %.3fs)\n", name,
+         (double)seats * 1e6 / (double)(elapsed > 0 ? elapsed : 1), syncs,
+         syncs > 0 ? (double)seats / (double)syncs : 0.0, atomic_load(&workload.failed), (double)elapsed / 1e6);
+
+  free(workers);
+  ems_terminate();
+  bench_remove_data_dir(data_dir);
+  return 0;
+}
+
+/**
+ * Measures the reservation throughput of the server state from many threads, as workers make them, without a
+ * write-ahead log and with it in each durability mode: an fdatasync per reservation, one per group of reservations
+ * made while the previous one ran, and one every WAL_ASYNC_SYNC_MS.
+ *
+ * @param argc Number of command-line arguments.
+ * @param argv Array of command-line arguments.
+ * @return 0 if the benchmark ran, 1 otherwise.
+ */
+int main(int argc, char* argv[]) {
+  if (argc != 4) {
+    fprintf(stderr, "Usage: %s <data directory> <threads> <reservations per run>\n", argv[0]);
+    return 1;
+  }
+
+  long threads = strtol(argv[2], NULL, 10);
+  long seats = strtol(argv[3], NULL, 10);
+  if (threads <= 0 || seats <= 0) {
+    print_error("Invalid number of threads or reservations.\n");
+    return 1;
+  }
+
+  char data_dir[PATH_MAX];
+  if (snprintf(data_dir, sizeof(data_dir), "%s/wal_bench_%d", argv[1], (int)getpid()) >= (int)sizeof(data_dir)) {
+    print_error("The data directory path is too long.\n");
+    return 1;
+  }
+
+  const char* names[3] = {"each", "group", "async"};
+  const enum WalDurability modes[3] = {WAL_SYNC_EACH, WAL_SYNC_GROUP, WAL_SYNC_ASYNC};
+  int failed = run(data_dir, "none", 0, WAL_SYNC_GROUP, threads, (size_t)seats);
+  for (int i = 0; i < 3 && !failed; i++) {
+    failed = run(data_dir, names[i], 1, modes[i], threads, (size_t)seats);
+  }
+
+  if (failed) {
+    print_error("Error running the reservations.\n");
+  }
+  return failed;
+}
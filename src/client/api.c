@@ -1,35 +1,187 @@
+#include "api.h"
+
+#include <errno.h>
 #include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
+#include <time.h>
 #include <unistd.h>
 
 #include "common/constants.h"
 #include "common/io.h"
 
+/**
+ * An operation sent to the server whose reply was not read yet.
+ */
+struct Pending {
+  unsigned long ticket;   // The ticket returned when the operation was sent.
+  char op_code;           // The operation.
+  int out_fd;             // Where SHOW and LIST write their reply.
+  size_t size;            // Bytes of the request, its deadline included.
+  ems_callback callback;  // The function told the result, or NULL.
+  void *arg;              // The argument passed to the callback.
+};
+
 /**
  * Represents a session in the Event Management System (EMS), storing the
  * session ID and paths to the named pipes for requests and responses.
+ * Replies come back in the order the requests were sent, so the operations
+ * in flight are kept in a ring, oldest first.
+ */
+struct EmsSession {
+  int session_id;                               // The unique identifier for the session.
+  int req_fd;                                   // The request pipe, open for the whole session.
+  int resp_fd;                                  // The response pipe, open for the whole session.
+  char req_pipe_path[MAX_PATH];                 // The path to the named pipe for requests.
+  char resp_pipe_path[MAX_PATH];                // The path to the named pipe for responses.
+  unsigned int timeout_ms;                      // How long the server may take to answer each operation, 0 for ever.
+  struct Pending pending[ASYNC_MAX_IN_FLIGHT];  // The operations in flight.
+  size_t pending_head;                          // Index of the oldest operation in flight.
+  size_t pending_count;                         // Number of operations in flight.
+  size_t pending_bytes;                         // Bytes of the requests in flight.
+  unsigned long last_ticket;                    // Ticket of the last operation sent.
+};
+
+/**
+ * Picks the server pipe to send the session start request to.
+ *
+ * A server with several listeners reads setups from "<path>", "<path>.1", ..., "<path>.N-1". The
+ * client counts the listeners and hashes its request pipe path (FNV-1a) to spread setups among them.
+ *
+ * @param server_pipe_path The path given for the server pipe.
+ * @param req_pipe_path    The path to the request pipe.
+ * @param listener_path    Buffer of MAX_PATH bytes to store the chosen server pipe path in.
  */
-typedef struct {
-  int session_id;                 // The unique identifier for the session.
-  char req_pipe_path[MAX_PATH];   // The path to the named pipe for requests.
-  char resp_pipe_path[MAX_PATH];  // The path to the named pipe for responses.
-} Session;
+static void pick_listener(char const *server_pipe_path, char const *req_pipe_path, char *listener_path) {
+  char path[MAX_PATH];
+  struct stat info;
+  unsigned int listeners = 1;
+  while (1) {
+    snprintf(path, MAX_PATH, "%s.%u", server_pipe_path, listeners);
+    if (stat(path, &info) != 0 || !S_ISFIFO(info.st_mode)) {
+      break;
+    }
+    listeners++;
+  }
+
+  uint32_t hash = 2166136261u;
+  for (const char *c = req_pipe_path; *c != '\0'; c++) {
+    hash ^= (unsigned char)*c;
+    hash *= 16777619u;
+  }
 
-// Global variable to store session information
-Session session;
+  unsigned int listener = hash % listeners;
+  if (listener == 0) {
+    snprintf(listener_path, MAX_PATH, "%s", server_pipe_path);
+  } else {
+    snprintf(listener_path, MAX_PATH, "%s.%u", server_pipe_path, listener);
+  }
+}
+
+/**
+ * Sends one session start request and waits for the server's reply on the response pipe.
+ *
+ * The response pipe is opened for reading before the request is sent, so the server can answer without
+ * blocking and the client waits on the reply instead of on an open() call.
+ *
+ * @param server_pipe_path The path to the server pipe.
+ * @param req_pipe_path    The padded path to the request pipe.
+ * @param resp_pipe_path   The padded path to the response pipe.
+ * @param weight           The scheduling weight asked for.
+ * @return                 SETUP_ACCEPTED or SETUP_BUSY, or -1 on failure.
+ */
+static int try_setup(struct EmsSession *session, char const *server_pipe_path, char const *req_pipe_path,
+                     char const *resp_pipe_path, unsigned char weight) {
+  int resp_fd = open(resp_pipe_path, O_RDONLY | O_NONBLOCK);
+  if (resp_fd < 0) {
+    print_error("Failed to open response pipe.\n");
+    return -1;
+  }
+
+  // Connect to server pipe
+  int server_fd = open(server_pipe_path, O_WRONLY);
+  if (server_fd < 0) {
+    print_error("Failed to connect to server pipe.\n");
+    close(resp_fd);
+    return -1;
+  }
+
+  // Send session start request to server: op_code | req_pipe_path | resp_pipe_path | weight
+  char message[SETUP_MESSAGE_SIZE];
+  message[0] = 1;  // op_code for session start
+  memcpy(message + 1, req_pipe_path, MAX_PATH);
+  memcpy(message + 1 + MAX_PATH, resp_pipe_path, MAX_PATH);
+  message[1 + 2 * MAX_PATH] = (char)weight;
+
+#if SETUP_MESSAGE_SIZE > PIPE_BUF
+  // Writes this large are not atomic, so keep other clients out of the pipe until the message is complete
+  struct flock lock = {.l_type = F_WRLCK, .l_whence = SEEK_SET, .l_start = 0, .l_len = 0};
+  if (fcntl(server_fd, F_SETLKW, &lock) == -1) {
+    print_error("Failed to lock server pipe.\n");
+    close(server_fd);
+    close(resp_fd);
+    return -1;
+  }
+#endif
+
+  // A single write of at most PIPE_BUF bytes cannot interleave with other clients' setups
+  if (my_write(server_fd, message, SETUP_MESSAGE_SIZE) == -1) {
+    print_error("Failed to write session start request.\n");
+    close(server_fd);
+    close(resp_fd);
+    return -1;
+  }
+
+  if (close(server_fd) < 0) {
+    print_error("Failed to close server pipe.\n");
+  }
+
+  // Wait for the server to answer
+  struct pollfd reply_poll = {.fd = resp_fd, .events = POLLIN, .revents = 0};
+  int status;
+  if (poll(&reply_poll, 1, SETUP_REPLY_TIMEOUT_MS) <= 0 || my_read(resp_fd, &status, sizeof(int)) != sizeof(int)) {
+    print_error("Server did not answer the session start request.\n");
+    close(resp_fd);
+    return -1;
+  }
+
+  if (status != SETUP_ACCEPTED) {
+    close(resp_fd);
+    return status == SETUP_BUSY ? SETUP_BUSY : -1;
+  }
+
+  // The session id is written together with the status
+  if (my_read(resp_fd, &session->session_id, sizeof(int)) != sizeof(int) || fcntl(resp_fd, F_SETFL, 0) == -1) {
+    print_error("Failed to read session_id.\n");
+    close(resp_fd);
+    return -1;
+  }
+
+  session->resp_fd = resp_fd;
+  return SETUP_ACCEPTED;
+}
 
 /**
  * Set up a connection to the Event Management System (EMS) server by creating
  * named pipes for communication and sending a session start request.
  *
+ * While the server answers that it is busy, the request is sent again after an
+ * exponentially growing, jittered delay.
+ *
+ * @param session      The session to connect.
  * @param req_pipe_p   The path to the request pipe.
  * @param resp_pipe_p  The path to the response pipe.
  * @param server_pipe_p The path to the server pipe.
+ * @param weight       The scheduling weight asked for, 0 for the default.
  * @return             0 on success, 1 on failure.
  */
-int ems_setup(char const *req_pipe_p, char const *resp_pipe_p, char const *server_pipe_p) {
+static int open_session(struct EmsSession *session, char const *req_pipe_p, char const *resp_pipe_p,
+                        char const *server_pipe_p, unsigned int weight) {
   // Create buffer for pipe path with size MAX_PATH
   char resp_pipe_path[MAX_PATH];
   char req_pipe_path[MAX_PATH];
@@ -52,9 +204,9 @@ int ems_setup(char const *req_pipe_p, char const *resp_pipe_p, char const *serve
   }
 
   // Copy the pipe path to the buffer
-  strcpy(server_pipe_path, server_pipe_p);
   strcpy(resp_pipe_path, resp_pipe_p);
   strcpy(req_pipe_path, req_pipe_p);
+  pick_listener(server_pipe_p, req_pipe_path, server_pipe_path);
 
   // Create request and response pipes with permissions read and write
   if (mkfifo(resp_pipe_path, 0666) < 0) {
@@ -66,182 +218,321 @@ int ems_setup(char const *req_pipe_p, char const *resp_pipe_p, char const *serve
     return 1;
   }
 
-  // Connect to server pipe
-  int server_fd = open(server_pipe_path, O_WRONLY);
-  if (server_fd < 0) {
-    print_error("Failed to connect to server pipe.\n");
-    return 1;
-  }
+  // Sessions of the same client back off independently
+  unsigned int seed = (unsigned int)getpid() ^ (unsigned int)(uintptr_t)session;
+  long backoff_us = SETUP_BACKOFF_US;
+  int status = SETUP_BUSY;
 
-  // Send session start request to server
-  char op_code = 1;  // op_code for session start
+  for (int attempt = 0; attempt < SETUP_MAX_ATTEMPTS; attempt++) {
+    status = try_setup(session, server_pipe_path, req_pipe_path, resp_pipe_path,
+                       (unsigned char)(weight < SESSION_MAX_WEIGHT ? weight : SESSION_MAX_WEIGHT));
+    if (status != SETUP_BUSY || attempt + 1 == SETUP_MAX_ATTEMPTS) {
+      break;
+    }
 
-  if (my_write(server_fd, &op_code, sizeof(char)) == -1) {
-    print_error("Failed to write op_code.\n");
-    return 1;
+    // Back off for a random delay in [backoff / 2, backoff) before trying again
+    long delay_us = backoff_us / 2 + rand_r(&seed) % (backoff_us / 2);
+    struct timespec delay = {delay_us / 1000000, (delay_us % 1000000) * 1000};
+    nanosleep(&delay, NULL);
+    backoff_us *= 2;
   }
-  if (my_write(server_fd, req_pipe_path, MAX_PATH) == -1) {
-    print_error("Failed to write req_pipe_path.\n");
-    return 1;
+
+  if (status == SETUP_BUSY) {
+    print_error("Server is busy.\n");
   }
-  if (my_write(server_fd, resp_pipe_path, MAX_PATH) == -1) {
-    print_error("Failed to write resp_pipe_path.\n");
+  if (status != SETUP_ACCEPTED) {
+    unlink(req_pipe_path);
+    unlink(resp_pipe_path);
     return 1;
   }
 
-  int req_fd = open(req_pipe_path, O_WRONLY);
-  if (req_fd < 0) {
+  // The server opened the read end when it accepted the session, so this does not block
+  session->req_fd = open(req_pipe_path, O_WRONLY);
+  if (session->req_fd < 0) {
     print_error("Failed to open request pipe.\n");
+    close(session->resp_fd);
     return 1;
   }
 
-  int resp_fd = open(resp_pipe_path, O_RDONLY);
-  if (resp_fd < 0) {
-    print_error("Failed to open response pipe.\n");
-    return 1;
+  // Copy named pipe paths to session struct
+  strcpy(session->req_pipe_path, req_pipe_path);
+  strcpy(session->resp_pipe_path, resp_pipe_path);
+
+  return 0;
+}
+
+/**
+ * Connects to an EMS server.
+ *
+ * @param req_pipe_path    The path to the request pipe.
+ * @param resp_pipe_path   The path to the response pipe.
+ * @param server_pipe_path The path to the server pipe.
+ * @param weight           The scheduling weight asked for, 0 for the default.
+ * @return                 The session, or NULL on failure.
+ */
+struct EmsSession *ems_setup(char const *req_pipe_path, char const *resp_pipe_path, char const *server_pipe_path,
+                             unsigned int weight) {
+  struct EmsSession *session = calloc(1, sizeof(struct EmsSession));
+  if (session == NULL) {
+    print_error("Failed to allocate session.\n");
+    return NULL;
   }
 
-  // Read session_id from server
-  if (my_read(resp_fd, &session.session_id, sizeof(int)) == -1) {
-    print_error("Failed to read session_id.\n");
-    return 1;
+  if (open_session(session, req_pipe_path, resp_pipe_path, server_pipe_path, weight) != 0) {
+    free(session);
+    return NULL;
   }
+  return session;
+}
 
-  // Copy named pipe paths to session struct
-  strcpy(session.req_pipe_path, req_pipe_path);
-  strcpy(session.resp_pipe_path, resp_pipe_path);
+/**
+ * Sets how long the server may take to answer each of the following operations.
+ *
+ * @param session    The session.
+ * @param timeout_ms The timeout in milliseconds, or 0 to wait for ever.
+ */
+void ems_set_timeout(struct EmsSession *session, unsigned int timeout_ms) { session->timeout_ms = timeout_ms; }
 
-  // Close named pipes
-  if (close(server_fd) < 0) {
-    print_error("Failed to close server pipe.\n");
+/**
+ * Sends the deadline of the operation about to be sent, when the session has a timeout. The deadline is a
+ * CLOCK_MONOTONIC instant, which the server shares since it runs on the same machine.
+ *
+ * @return 0 on success, 1 on failure.
+ */
+static int send_deadline(struct EmsSession *session) {
+  if (session->timeout_ms == 0) {
+    return 0;
+  }
+
+  struct timespec deadline;
+  clock_gettime(CLOCK_MONOTONIC, &deadline);
+  deadline.tv_sec += session->timeout_ms / 1000;
+  deadline.tv_nsec += (long)(session->timeout_ms % 1000) * 1000000L;
+  if (deadline.tv_nsec >= 1000000000L) {
+    deadline.tv_sec++;
+    deadline.tv_nsec -= 1000000000L;
+  }
+
+  // op_code | session_id | deadline
+  char message[1 + sizeof(int) + sizeof(struct timespec)];
+  message[0] = 7;  // op_code for the deadline of the next operation
+  memcpy(message + 1, &session->session_id, sizeof(int));
+  memcpy(message + 1 + sizeof(int), &deadline, sizeof(struct timespec));
+  if (my_write(session->req_fd, message, sizeof(message)) == -1) {
+    print_error("Failed to write deadline.\n");
     return 1;
   }
-  if (close(resp_fd) < 0) {
-    print_error("Failed to close response pipe.\n");
+  return 0;
+}
+
+/**
+ * Tells whether the server refused to run an operation, printing why.
+ *
+ * @param result The result read from the server.
+ * @return 1 if the operation was refused or dropped, 0 otherwise.
+ */
+static int refused(int result) {
+  if (result == OP_OVERLOADED) {
+    print_error("Server is overloaded.\n");
+    return 1;
+  }
+  if (result == OP_EXPIRED) {
+    print_error("Server did not answer in time.\n");
     return 1;
   }
-
   return 0;
 }
 
 /**
- * Sends a session end message to the Event Management System (EMS) server,
- * closes named pipes, and deletes client named pipes to terminate
- * the connection with the server.
+ * Reads the reply to a create request.
  *
  * @return 0 on success, 1 on failure.
  */
-int ems_quit() {
-  // Open request pipe
-  int req_fd = open(session.req_pipe_path, O_WRONLY);
-  if (req_fd < 0) {
+static int read_create_reply(struct EmsSession *session) {
+  // Handle server response
+  int result;
+
+  if (my_read(session->resp_fd, &result, sizeof(int)) == -1) {
+    print_error("Failed to read result.\n");
     return 1;
   }
 
-  // Send session end request to server
-  char op_code = 2;  // op_code for session end
-
-  if (my_write(req_fd, &op_code, sizeof(char)) == -1) {
-    print_error("Failed to write op_code.\n");
+  if (result == 1) {
+    print_error("Server couldn't create.");
     return 1;
   }
 
-  if (my_write(req_fd, &session.session_id, sizeof(int)) == -1) {
-    print_error("Failed to write session_id.\n");
+  if (refused(result)) {
     return 1;
   }
 
-  // Close named pipes
-  if (close(req_fd) < 0) {
-    print_error("Failed to close request pipe.\n");
+  return result;
+}
+
+/**
+ * Reads the reply to a reserve request.
+ *
+ * @return 0 on success, 1 on failure.
+ */
+static int read_reserve_reply(struct EmsSession *session) {
+  // Handle server response
+  int result;
+
+  if (my_read(session->resp_fd, &result, sizeof(int)) == -1) {
+    print_error("Failed to read result.\n");
     return 1;
   }
 
-  // Open response pipe
-  int resp_fd = open(session.resp_pipe_path, O_RDONLY);
-  if (resp_fd >= 0) {
-    if (close(resp_fd) < 0) {
-      print_error("Failed to close response pipe.\n");
-      return 1;
-    }
+  if (result == 1) {
+    print_error("Server couldn't reserve.");
+    return 1;
   }
 
-  // Delete client named pipes
-  unlink(session.req_pipe_path);
-  unlink(session.resp_pipe_path);
+  if (refused(result)) {
+    return 1;
+  }
 
-  return 0;
+  return result;
 }
 
 /**
- * Sends a create request to the Event Management System (EMS) server through
- * named pipes, providing information about the event to be created.
+ * Reads the reply to a show request and writes the seat layout to the specified output file descriptor.
  *
- * @param event_id   The unique identifier for the event.
- * @param num_rows   The number of rows in the event.
- * @param num_cols   The number of columns in the event.
+ * @param out_fd     The file descriptor for the output where the seat layout
+ *                   information will be written.
  * @return           0 on success, 1 on failure.
  */
-int ems_create(unsigned int event_id, size_t num_rows, size_t num_cols) {
-  // Open request and response pipes
-  int req_fd = open(session.req_pipe_path, O_WRONLY);
-  if (req_fd < 0) {
+static int read_show_reply(struct EmsSession *session, int out_fd) {
+  // Handle server response
+  int result;
+
+  if (my_read(session->resp_fd, &result, sizeof(int)) == -1) {
+    print_error("Failed to read result.\n");
     return 1;
   }
 
-  // Send create request to server and event information
-  char op_code = 3;  // op_code for create
+  if (result == 1) {
+    print_error("Server couldn't show.");
+    return 1;
+  }
 
-  if (my_write(req_fd, &op_code, sizeof(char)) == -1) {
-    print_error("Failed to write op_code.\n");
+  if (refused(result)) {
     return 1;
   }
 
-  if (my_write(req_fd, &session.session_id, sizeof(int)) == -1) {
-    print_error("Failed to write session_id.\n");
+  // Read seat layout from server and write it to out_fd
+  size_t num_rows;
+  size_t num_cols;
+
+  if (my_read(session->resp_fd, &num_rows, sizeof(size_t)) == -1) {
+    print_error("Failed to read num_rows.\n");
     return 1;
   }
 
-  if (my_write(req_fd, &event_id, sizeof(unsigned int)) == -1) {
-    print_error("Failed to write event_id.\n");
+  if (my_read(session->resp_fd, &num_cols, sizeof(size_t)) == -1) {
+    print_error("Failed to read num_cols.\n");
     return 1;
   }
 
-  if (my_write(req_fd, &num_rows, sizeof(size_t)) == -1) {
-    print_error("Failed to write num_rows.\n");
+  // Read the whole seat map at once, since large maps arrive as whole pages spliced into the pipe
+  size_t seats_size = num_rows * num_cols * sizeof(unsigned int);
+  unsigned int* seats = malloc(seats_size);
+  if (seats == NULL && seats_size > 0) {
+    print_error("Failed to allocate seats.\n");
     return 1;
   }
 
-  if (my_write(req_fd, &num_cols, sizeof(size_t)) == -1) {
-    print_error("Failed to write num_cols.\n");
+  if (my_read(session->resp_fd, seats, seats_size) != (ssize_t)seats_size) {
+    print_error("Failed to read seats.\n");
+    free(seats);
     return 1;
   }
 
-  // Handle server response
-  int resp_fd = open(session.resp_pipe_path, O_RDONLY);
-  if (resp_fd < 0) {
+  // Every seat is followed by a space, and every row by a newline
+  char out_buffer[WRITER_BUFFER_SIZE];
+  struct Writer out;
+  writer_init(&out, out_fd, out_buffer, sizeof(out_buffer));
+  for (size_t i = 0; i < num_rows; i++) {
+    for (size_t j = 0; j < num_cols; j++) {
+      if (writer_uint(&out, seats[i * num_cols + j]) || writer_char(&out, ' ')) {
+        print_error("Failed to print seat.\n");
+        free(seats);
+        return 1;
+      }
+    }
+
+    if (writer_char(&out, '\n')) {
+      print_error("Failed to write newline.\n");
+      free(seats);
+      return 1;
+    }
+  }
+
+  if (writer_flush(&out)) {
+    print_error("Failed to print seats.\n");
+    free(seats);
     return 1;
   }
 
+  free(seats);
+  return result;
+}
+
+/**
+ * Reads the reply to a list request and writes the events to the specified output file descriptor.
+ *
+ * @param out_fd     The file descriptor for the output where the list of events
+ *                   information will be written.
+ * @return           0 on success, 1 on failure.
+ */
+static int read_list_reply(struct EmsSession *session, int out_fd) {
+  // Handle server response
   int result;
 
-  if (my_read(resp_fd, &result, sizeof(int)) == -1) {
+  if (my_read(session->resp_fd, &result, sizeof(int)) == -1) {
     print_error("Failed to read result.\n");
     return 1;
   }
 
   if (result == 1) {
-    print_error("Server couldn't create.");
+    print_error("Server couldn't list events.");
     return 1;
   }
 
-  // Close named pipes
-  if (close(req_fd) < 0) {
-    print_error("Failed to close request pipe.\n");
+  if (refused(result)) {
     return 1;
   }
-  if (close(resp_fd) < 0) {
-    print_error("Failed to close response pipe.\n");
+
+  if (result == 2) {
+    print_str(out_fd, "No events\n");
+    return 1;
+  }
+
+  // Read events from server and write them to out_fd
+  size_t num_events;
+  if (my_read(session->resp_fd, &num_events, sizeof(size_t)) == -1) {
+    print_error("Failed to read num_events.\n");
+    return 1;
+  }
+
+  char out_buffer[WRITER_BUFFER_SIZE];
+  struct Writer out;
+  writer_init(&out, out_fd, out_buffer, sizeof(out_buffer));
+  for (size_t i = 0; i < num_events; i++) {
+    unsigned int event_id;
+    if (my_read(session->resp_fd, &event_id, sizeof(unsigned int)) == -1) {
+      print_error("Failed to read event_id.\n");
+      return 1;
+    }
+    // Add a newline after each event, except for the last one
+    if (writer_str(&out, "Event: ") || writer_uint(&out, event_id) || (i < num_events - 1 && writer_char(&out, '\n'))) {
+      return 1;
+    }
+  }
+
+  // Add a newline after listing all events
+  if (writer_char(&out, '\n') || writer_flush(&out)) {
+    print_error("Failed to write newline.\n");
     return 1;
   }
 
@@ -249,289 +540,547 @@ int ems_create(unsigned int event_id, size_t num_rows, size_t num_cols) {
 }
 
 /**
- * Sends a reserve request to the Event Management System (EMS) server through
- * named pipes, providing information about the seats to be reserved.
+ * Writes a time in nanoseconds as microseconds with three decimals.
+ */
+static int write_micros(struct Writer *out, size_t ns) {
+  unsigned int fraction = (unsigned int)(ns % 1000);
+  return writer_uint(out, (unsigned int)(ns / 1000)) || writer_char(out, '.') ||
+         writer_char(out, (char)('0' + fraction / 100)) || writer_char(out, (char)('0' + fraction / 10 % 10)) ||
+         writer_char(out, (char)('0' + fraction % 10));
+}
+
+/**
+ * Reads the reply to a stats request and writes, for each operation the server ran, the p50, p99, p999 and largest
+ * times of each of its phases to the specified output file descriptor.
  *
- * @param event_id   The unique identifier for the event.
- * @param num_seats  The number of seats to be reserved.
- * @param xs         An array of X coordinates for the reserved seats.
- * @param ys         An array of Y coordinates for the reserved seats.
+ * @param out_fd     The file descriptor for the output where the times will be written.
  * @return           0 on success, 1 on failure.
  */
-int ems_reserve(unsigned int event_id, size_t num_seats, size_t *xs, size_t *ys) {
-  // Send reserve request to server through named pipe
-  int req_fd = open(session.req_pipe_path, O_WRONLY);
-  if (req_fd < 0) {
+static int read_stats_reply(struct EmsSession *session, int out_fd) {
+  int result;
+  if (my_read(session->resp_fd, &result, sizeof(int)) == -1) {
+    print_error("Failed to read result.\n");
     return 1;
   }
 
-  // Send reserve request to server and seat information
-  char op_code = 4;
-  if (my_write(req_fd, &op_code, sizeof(char)) == -1) {
-    print_error("Failed to write op_code.\n");
+  if (result != 0) {
+    print_error("Server couldn't report its stats.\n");
     return 1;
   }
 
-  if (my_write(req_fd, &session.session_id, sizeof(int)) == -1) {
-    print_error("Failed to write session_id.\n");
+  size_t values[STATS_OPS * STATS_PHASES * STATS_VALUES];
+  if (my_read(session->resp_fd, values, sizeof(values)) == -1) {
+    print_error("Failed to read stats.\n");
     return 1;
   }
 
-  if (my_write(req_fd, &event_id, sizeof(unsigned int)) == -1) {
-    print_error("Failed to write event_id.\n");
-    return 1;
+  const char *ops[STATS_OPS] = {"CREATE", "RESERVE", "SHOW", "LIST"};
+  const char *phases[STATS_PHASES] = {"queue", "lookup", "lock", "execute", "respond", "total"};
+  char out_buffer[WRITER_BUFFER_SIZE];
+  struct Writer out;
+  writer_init(&out, out_fd, out_buffer, sizeof(out_buffer));
+  int failed = 0;
+  for (size_t op = 0; op < STATS_OPS && !failed; op++) {
+    const size_t *phase = values + op * STATS_PHASES * STATS_VALUES;
+    failed = writer_str(&out, ops[op]) || writer_str(&out, ": ") || writer_uint(&out, (unsigned int)phase[0]) ||
+             writer_str(&out, " ops");
+    if (phase[0] > 0) {
+      failed = failed || writer_str(&out, ", p50/p99/p999/max (us):");
+      for (size_t i = 0; i < STATS_PHASES && !failed; i++, phase += STATS_VALUES) {
+        failed = writer_str(&out, i == 0 ? " " : ", ") || writer_str(&out, phases[i]);
+        for (size_t value = 1; value < STATS_VALUES && !failed; value++) {
+          failed = writer_char(&out, value == 1 ? ' ' : '/') || write_micros(&out, phase[value]);
+        }
+      }
+    }
+    failed = failed || writer_char(&out, '\n');
   }
 
-  if (my_write(req_fd, &num_seats, sizeof(size_t)) == -1) {
-    print_error("Failed to write num_seats.\n");
+  if (failed || writer_flush(&out)) {
+    print_error("Failed to print stats.\n");
     return 1;
   }
+  return 0;
+}
 
-  if (my_write(req_fd, xs, num_seats * sizeof(size_t)) == -1) {
-    print_error("Failed to write xs.\n");
-    return 1;
+/**
+ * Removes the oldest operation in flight, reads its reply and reports it to its callback.
+ */
+static void complete_next(struct EmsSession *session) {
+  struct Pending pending = session->pending[session->pending_head];
+  session->pending_head = (session->pending_head + 1) % ASYNC_MAX_IN_FLIGHT;
+  session->pending_count--;
+  session->pending_bytes -= pending.size;
+
+  int result = 1;
+  switch (pending.op_code) {
+    case 3:
+      result = read_create_reply(session);
+      break;
+    case 4:
+      result = read_reserve_reply(session);
+      break;
+    case 5:
+      result = read_show_reply(session, pending.out_fd);
+      break;
+    case 6:
+      result = read_list_reply(session, pending.out_fd);
+      break;
+    case 8:
+      result = read_stats_reply(session, pending.out_fd);
+      break;
+    default:
+      break;
+  }
+
+  if (pending.callback != NULL) {
+    pending.callback(pending.ticket, result, pending.arg);
   }
+}
 
-  if (my_write(req_fd, ys, num_seats * sizeof(size_t)) == -1) {
-    print_error("Failed to write ys.\n");
-    return 1;
+/**
+ * Completes the oldest operations in flight until a request of the given size can be sent. Requests in flight
+ * never take more than ASYNC_MAX_REQUEST_BYTES, so the request pipe always has room for them and a write never
+ * waits for a server that is itself waiting for its replies to be read.
+ *
+ * @param size Size of the request, its deadline included.
+ */
+static void make_room(struct EmsSession *session, size_t size) {
+  while (session->pending_count > 0 &&
+         (session->pending_count == ASYNC_MAX_IN_FLIGHT || session->pending_bytes + size > ASYNC_MAX_REQUEST_BYTES)) {
+    complete_next(session);
   }
+}
 
-  // Handle server response
-  int resp_fd = open(session.resp_pipe_path, O_RDONLY);
-  if (resp_fd < 0) {
-    return 1;
-  }
+/**
+ * Records an operation just sent as in flight.
+ *
+ * @return The ticket of the operation.
+ */
+static unsigned long add_pending(struct EmsSession *session, char op_code, int out_fd, size_t size,
+                                 ems_callback callback, void *arg) {
+  size_t slot = (session->pending_head + session->pending_count) % ASYNC_MAX_IN_FLIGHT;
+  unsigned long ticket = ++session->last_ticket;
+  session->pending[slot] = (struct Pending){ticket, op_code, out_fd, size, callback, arg};
+  session->pending_count++;
+  session->pending_bytes += size;
+  return ticket;
+}
 
-  int result;
+/**
+ * Returns the size of a request, with the deadline sent before it.
+ */
+static size_t request_size(const struct EmsSession *session, size_t size) {
+  return session->timeout_ms == 0 ? size : size + 1 + sizeof(int) + sizeof(struct timespec);
+}
 
-  if (my_read(resp_fd, &result, sizeof(int)) == -1) {
-    print_error("Failed to read result.\n");
-    return 1;
+/**
+ * Stores the result of an operation run synchronously.
+ */
+static void store_result(unsigned long ticket, int result, void *arg) {
+  (void)ticket;
+  *(int *)arg = result;
+}
+
+/**
+ * Sends a session end message to the Event Management System (EMS) server,
+ * closes named pipes, and deletes client named pipes to terminate
+ * the connection with the server. Operations still in flight are completed first,
+ * and the session is freed even on failure.
+ *
+ * @param session The session.
+ * @return 0 on success, 1 on failure.
+ */
+int ems_quit(struct EmsSession *session) {
+  while (session->pending_count > 0) {
+    complete_next(session);
   }
 
-  if (result == 1) {
-    print_error("Server couldn't reserve.");
-    return 1;
+  // Send session end request to server
+  char op_code = 2;  // op_code for session end
+  int result = 0;
+
+  if (my_write(session->req_fd, &op_code, sizeof(char)) == -1) {
+    print_error("Failed to write op_code.\n");
+    result = 1;
+  } else if (my_write(session->req_fd, &session->session_id, sizeof(int)) == -1) {
+    print_error("Failed to write session_id.\n");
+    result = 1;
   }
 
-  // Close named pipes
-  if (close(req_fd) < 0) {
+  // Close named pipes, even if the server could not be told, so that the session releases them
+  if (close(session->req_fd) < 0) {
     print_error("Failed to close request pipe.\n");
-    return 1;
+    result = 1;
   }
-  if (close(resp_fd) < 0) {
+
+  if (close(session->resp_fd) < 0) {
     print_error("Failed to close response pipe.\n");
-    return 1;
+    result = 1;
   }
 
+  // Delete client named pipes
+  unlink(session->req_pipe_path);
+  unlink(session->resp_pipe_path);
+
+  free(session);
   return result;
 }
 
 /**
- * Sends a show request to the Event Management System (EMS) server through
- * named pipes, requesting information about a specific event, and writes the
- * seat layout to the specified output file descriptor.
+ * Sends a create request to the Event Management System (EMS) server through
+ * named pipes, providing information about the event to be created, without
+ * waiting for the reply.
  *
- * @param out_fd     The file descriptor for the output where the seat layout
- *                   information will be written.
- * @param event_id   The unique identifier for the event to show.
- * @return           0 on success, 1 on failure.
+ * @param session    The session.
+ * @param event_id   The unique identifier for the event.
+ * @param num_rows   The number of rows in the event.
+ * @param num_cols   The number of columns in the event.
+ * @param callback   The function told the result, or NULL.
+ * @param arg        The argument passed to the callback.
+ * @return           The ticket of the operation, or 0 on failure.
  */
-int ems_show(int out_fd, int event_id) {
-  // Send show request to server through named pipe
-  int req_fd = open(session.req_pipe_path, O_WRONLY);
-  if (req_fd < 0) {
-    return 1;
-  }
+unsigned long ems_submit_create(struct EmsSession *session, unsigned int event_id, size_t num_rows, size_t num_cols,
+                                ems_callback callback, void *arg) {
+  size_t size = request_size(session, 1 + sizeof(int) + sizeof(unsigned int) + 2 * sizeof(size_t));
+  make_room(session, size);
 
-  char op_code = 5;  // op_code for show
+  // Send create request to server and event information
+  char op_code = 3;  // op_code for create
+
+  if (send_deadline(session) != 0) {
+    return 0;
+  }
 
-  if (my_write(req_fd, &op_code, sizeof(char)) == -1) {
+  if (my_write(session->req_fd, &op_code, sizeof(char)) == -1) {
     print_error("Failed to write op_code.\n");
-    return 1;
+    return 0;
   }
 
-  if (my_write(req_fd, &session.session_id, sizeof(int)) == -1) {
+  if (my_write(session->req_fd, &session->session_id, sizeof(int)) == -1) {
     print_error("Failed to write session_id.\n");
-    return 1;
+    return 0;
   }
 
-  if (my_write(req_fd, &event_id, sizeof(unsigned int)) == -1) {
+  if (my_write(session->req_fd, &event_id, sizeof(unsigned int)) == -1) {
     print_error("Failed to write event_id.\n");
-    return 1;
+    return 0;
   }
 
-  // Handle server response
-  int resp_fd = open(session.resp_pipe_path, O_RDONLY);
-  if (resp_fd < 0) {
-    return 1;
+  if (my_write(session->req_fd, &num_rows, sizeof(size_t)) == -1) {
+    print_error("Failed to write num_rows.\n");
+    return 0;
   }
 
-  int result;
+  if (my_write(session->req_fd, &num_cols, sizeof(size_t)) == -1) {
+    print_error("Failed to write num_cols.\n");
+    return 0;
+  }
 
-  if (my_read(resp_fd, &result, sizeof(int)) == -1) {
-    print_error("Failed to read result.\n");
-    return 1;
+  return add_pending(session, op_code, -1, size, callback, arg);
+}
+
+/**
+ * Creates an event and waits for the server to answer.
+ *
+ * @param session    The session.
+ * @param event_id   The unique identifier for the event.
+ * @param num_rows   The number of rows in the event.
+ * @param num_cols   The number of columns in the event.
+ * @return           0 on success, 1 on failure.
+ */
+int ems_create(struct EmsSession *session, unsigned int event_id, size_t num_rows, size_t num_cols) {
+  int result = 1;
+  unsigned long ticket = ems_submit_create(session, event_id, num_rows, num_cols, store_result, &result);
+  return ticket != 0 && ems_wait(session, ticket) == 0 ? result : 1;
+}
+
+/**
+ * Sends a reserve request to the Event Management System (EMS) server through
+ * named pipes, providing information about the seats to be reserved, without
+ * waiting for the reply.
+ *
+ * @param session    The session.
+ * @param event_id   The unique identifier for the event.
+ * @param num_seats  The number of seats to be reserved.
+ * @param xs         An array of X coordinates for the reserved seats.
+ * @param ys         An array of Y coordinates for the reserved seats.
+ * @param callback   The function told the result, or NULL.
+ * @param arg        The argument passed to the callback.
+ * @return           The ticket of the operation, or 0 on failure.
+ */
+unsigned long ems_submit_reserve(struct EmsSession *session, unsigned int event_id, size_t num_seats, size_t *xs,
+                                 size_t *ys, ems_callback callback, void *arg) {
+  size_t size =
+      request_size(session, 1 + sizeof(int) + sizeof(unsigned int) + sizeof(size_t) + 2 * num_seats * sizeof(size_t));
+  make_room(session, size);
+
+  // Send reserve request to server and seat information
+  char op_code = 4;
+  if (send_deadline(session) != 0) {
+    return 0;
   }
 
-  if (result == 1) {
-    print_error("Server couldn't show.");
-    return 1;
+  if (my_write(session->req_fd, &op_code, sizeof(char)) == -1) {
+    print_error("Failed to write op_code.\n");
+    return 0;
   }
-  // Read seat layout from server and write it to out_fd
-  size_t num_rows;
-  size_t num_cols;
 
-  if (my_read(resp_fd, &num_rows, sizeof(size_t)) == -1) {
-    print_error("Failed to read num_rows.\n");
-    return 1;
+  if (my_write(session->req_fd, &session->session_id, sizeof(int)) == -1) {
+    print_error("Failed to write session_id.\n");
+    return 0;
   }
 
-  if (my_read(resp_fd, &num_cols, sizeof(size_t)) == -1) {
-    print_error("Failed to read num_cols.\n");
-    return 1;
+  if (my_write(session->req_fd, &event_id, sizeof(unsigned int)) == -1) {
+    print_error("Failed to write event_id.\n");
+    return 0;
   }
 
-  for (size_t i = 0; i < num_rows; i++) {
-    for (size_t j = 0; j < num_cols; j++) {
-      unsigned int seat;
-      if (my_read(resp_fd, &seat, sizeof(unsigned int)) == -1) {
-        print_error("Failed to read seat.\n");
-        return 1;
-      }
-      if (print_uint(out_fd, seat)) {
-        print_error("Failed to print seat.\n");
-        return 1;
-      }
+  if (my_write(session->req_fd, &num_seats, sizeof(size_t)) == -1) {
+    print_error("Failed to write num_seats.\n");
+    return 0;
+  }
 
-      if (j < num_cols) {
-        if (print_str(out_fd, " ")) {
-          print_error("Error writing to file descriptor");
-          return 1;
-        }
-      }
-    }
+  if (my_write(session->req_fd, xs, num_seats * sizeof(size_t)) == -1) {
+    print_error("Failed to write xs.\n");
+    return 0;
+  }
 
-    // Add a newline after each row
-    char newline = '\n';
-    if (my_write(out_fd, &newline, 1) == -1) {
-      print_error("Failed to write newline.\n");
-      return 1;
-    }
+  if (my_write(session->req_fd, ys, num_seats * sizeof(size_t)) == -1) {
+    print_error("Failed to write ys.\n");
+    return 0;
   }
 
-  // Close named pipes
-  if (close(req_fd) < 0) {
-    print_error("Failed to close request pipe.\n");
-    return 1;
+  return add_pending(session, op_code, -1, size, callback, arg);
+}
+
+/**
+ * Reserves seats of an event and waits for the server to answer.
+ *
+ * @param session    The session.
+ * @param event_id   The unique identifier for the event.
+ * @param num_seats  The number of seats to be reserved.
+ * @param xs         An array of X coordinates for the reserved seats.
+ * @param ys         An array of Y coordinates for the reserved seats.
+ * @return           0 on success, 1 on failure.
+ */
+int ems_reserve(struct EmsSession *session, unsigned int event_id, size_t num_seats, size_t *xs, size_t *ys) {
+  int result = 1;
+  unsigned long ticket = ems_submit_reserve(session, event_id, num_seats, xs, ys, store_result, &result);
+  return ticket != 0 && ems_wait(session, ticket) == 0 ? result : 1;
+}
+
+/**
+ * Sends a show request to the Event Management System (EMS) server through
+ * named pipes, requesting information about a specific event, without waiting
+ * for the reply. The seat layout is written to the specified output file
+ * descriptor once the reply is read.
+ *
+ * @param session    The session.
+ * @param out_fd     The file descriptor for the output where the seat layout
+ *                   information will be written.
+ * @param event_id   The unique identifier for the event to show.
+ * @param callback   The function told the result, or NULL.
+ * @param arg        The argument passed to the callback.
+ * @return           The ticket of the operation, or 0 on failure.
+ */
+unsigned long ems_submit_show(struct EmsSession *session, int out_fd, unsigned int event_id, ems_callback callback,
+                              void *arg) {
+  size_t size = request_size(session, 1 + sizeof(int) + sizeof(unsigned int));
+  make_room(session, size);
+
+  char op_code = 5;  // op_code for show
+
+  if (send_deadline(session) != 0) {
+    return 0;
   }
-  if (close(resp_fd) < 0) {
-    print_error("Failed to close response pipe.\n");
-    return 1;
+
+  if (my_write(session->req_fd, &op_code, sizeof(char)) == -1) {
+    print_error("Failed to write op_code.\n");
+    return 0;
   }
 
-  return result;
+  if (my_write(session->req_fd, &session->session_id, sizeof(int)) == -1) {
+    print_error("Failed to write session_id.\n");
+    return 0;
+  }
+
+  if (my_write(session->req_fd, &event_id, sizeof(unsigned int)) == -1) {
+    print_error("Failed to write event_id.\n");
+    return 0;
+  }
+
+  return add_pending(session, op_code, out_fd, size, callback, arg);
+}
+
+/**
+ * Shows an event and waits for the server to answer.
+ *
+ * @param session    The session.
+ * @param out_fd     The file descriptor for the output where the seat layout
+ *                   information will be written.
+ * @param event_id   The unique identifier for the event to show.
+ * @return           0 on success, 1 on failure.
+ */
+int ems_show(struct EmsSession *session, int out_fd, unsigned int event_id) {
+  int result = 1;
+  unsigned long ticket = ems_submit_show(session, out_fd, event_id, store_result, &result);
+  return ticket != 0 && ems_wait(session, ticket) == 0 ? result : 1;
 }
 
 /**
  * Sends a request to the Event Management System (EMS) server to list available
- * events through named pipes and writes the result to the specified output file descriptor.
+ * events through named pipes, without waiting for the reply. The list is written
+ * to the specified output file descriptor once the reply is read.
  *
+ * @param session    The session.
  * @param out_fd     The file descriptor for the output where the list of events
  *                   information will be written.
- * @return           0 on success, 1 on failure.
+ * @param callback   The function told the result, or NULL.
+ * @param arg        The argument passed to the callback.
+ * @return           The ticket of the operation, or 0 on failure.
  */
-int ems_list_events(int out_fd) {
-  // Open request pipe
-  int req_fd = open(session.req_pipe_path, O_WRONLY);
-  if (req_fd < 0) {
-    print_error("Failed to open request pipe.\n");
-    return 1;
-  }
+unsigned long ems_submit_list_events(struct EmsSession *session, int out_fd, ems_callback callback, void *arg) {
+  size_t size = request_size(session, 1 + sizeof(int));
+  make_room(session, size);
 
   // Send list events request to server
   char op_code = 6;  // op_code for list events
 
-  if (my_write(req_fd, &op_code, sizeof(char)) == -1) {
+  if (send_deadline(session) != 0) {
+    return 0;
+  }
+
+  if (my_write(session->req_fd, &op_code, sizeof(char)) == -1) {
     print_error("Failed to write op_code.\n");
-    return 1;
+    return 0;
   }
 
-  if (my_write(req_fd, &session.session_id, sizeof(int)) == -1) {
+  if (my_write(session->req_fd, &session->session_id, sizeof(int)) == -1) {
     print_error("Failed to write session_id.\n");
-    return 1;
+    return 0;
   }
 
-  // Handle server response
-  int resp_fd = open(session.resp_pipe_path, O_RDONLY);
-  if (resp_fd < 0) {
-    print_error("Failed to open response pipe.\n");
-    return 1;
-  }
+  return add_pending(session, op_code, out_fd, size, callback, arg);
+}
 
-  int result;
+/**
+ * Lists the events and waits for the server to answer.
+ *
+ * @param session    The session.
+ * @param out_fd     The file descriptor for the output where the list of events
+ *                   information will be written.
+ * @return           0 on success, 1 on failure.
+ */
+int ems_list_events(struct EmsSession *session, int out_fd) {
+  int result = 1;
+  unsigned long ticket = ems_submit_list_events(session, out_fd, store_result, &result);
+  return ticket != 0 && ems_wait(session, ticket) == 0 ? result : 1;
+}
 
-  if (my_read(resp_fd, &result, sizeof(int)) == -1) {
-    print_error("Failed to read result.\n");
-    return 1;
+/**
+ * Sends a request to the Event Management System (EMS) server for the times of
+ * the operations it ran, without waiting for the reply. The times are written
+ * to the specified output file descriptor once the reply is read. The server
+ * answers it right away, so no deadline is sent before it.
+ *
+ * @param session    The session.
+ * @param out_fd     The file descriptor for the output where the times will be written.
+ * @param callback   The function told the result, or NULL.
+ * @param arg        The argument passed to the callback.
+ * @return           The ticket of the operation, or 0 on failure.
+ */
+unsigned long ems_submit_stats(struct EmsSession *session, int out_fd, ems_callback callback, void *arg) {
+  size_t size = 1 + sizeof(int);
+  make_room(session, size);
+
+  char op_code = 8;  // op_code for stats
+
+  if (my_write(session->req_fd, &op_code, sizeof(char)) == -1) {
+    print_error("Failed to write op_code.\n");
+    return 0;
   }
 
-  if (result == 1) {
-    print_error("Server couldn't list events.");
-    return 1;
+  if (my_write(session->req_fd, &session->session_id, sizeof(int)) == -1) {
+    print_error("Failed to write session_id.\n");
+    return 0;
   }
 
-  if (result == 2) {
-    print_str(out_fd, "No events\n");
+  return add_pending(session, op_code, out_fd, size, callback, arg);
+}
+
+/**
+ * Prints the times of the operations the server ran and waits for it to answer.
+ *
+ * @param session    The session.
+ * @param out_fd     The file descriptor for the output where the times will be written.
+ * @return           0 on success, 1 on failure.
+ */
+int ems_stats(struct EmsSession *session, int out_fd) {
+  int result = 1;
+  unsigned long ticket = ems_submit_stats(session, out_fd, store_result, &result);
+  return ticket != 0 && ems_wait(session, ticket) == 0 ? result : 1;
+}
+
+/**
+ * Completes, in the order they were sent, every operation in flight up to the given one.
+ *
+ * @param session    The session.
+ * @param ticket     The ticket of the operation.
+ * @return           0 on success, 1 if no operation has that ticket.
+ */
+int ems_wait(struct EmsSession *session, unsigned long ticket) {
+  if (ticket == 0 || ticket > session->last_ticket) {
     return 1;
   }
 
-  // Read events from server and write them to out_fd
-  size_t num_events;
-  if (my_read(resp_fd, &num_events, sizeof(size_t)) == -1) {
-    print_error("Failed to read num_events.\n");
-    return 1;
+  while (session->pending_count > 0 && session->pending[session->pending_head].ticket <= ticket) {
+    complete_next(session);
   }
+  return 0;
+}
 
-  for (size_t i = 0; i < num_events; i++) {
-    unsigned int event_id;
-    if (my_read(resp_fd, &event_id, sizeof(unsigned int)) == -1) {
-      print_error("Failed to read event_id.\n");
-      return 1;
+/**
+ * Completes the operations whose replies arrived, waiting up to the given time for the first one.
+ *
+ * @param session    The session.
+ * @param timeout_ms How long to wait for a reply in milliseconds, 0 not to wait, or -1 to wait for ever.
+ * @return           The number of operations completed, or -1 on failure.
+ */
+int ems_poll(struct EmsSession *session, int timeout_ms) {
+  int completed = 0;
+  while (session->pending_count > 0) {
+    struct pollfd response = {session->resp_fd, POLLIN, 0};
+    int ready = poll(&response, 1, completed == 0 ? timeout_ms : 0);
+    if (ready == -1 && errno == EINTR) {
+      continue;
     }
-    if (print_str(out_fd, "Event: ") == -1) {
-      return 1;
+    if (ready == -1) {
+      print_error("Failed to poll response pipe.\n");
+      return -1;
     }
-    if (print_uint(out_fd, event_id) == -1) {
-      return 1;
+    if (ready == 0) {
+      break;
     }
-    // Add a newline after each event, except for the last one
-    if (i < num_events - 1) {
-      char newline = '\n';
-      if (my_write(out_fd, &newline, 1) == -1) {
-        print_error("Failed to write newline.\n");
-        return 1;
-      }
-    }
-  }
 
-  // Add a newline after listing all events
-  char newline = '\n';
-  if (my_write(out_fd, &newline, 1) == -1) {
-    print_error("Failed to write newline.\n");
-    return 1;
+    complete_next(session);
+    completed++;
   }
+  return completed;
+}
 
-  // Close named pipes
-  if (close(req_fd) < 0) {
-    print_error("Failed to close request pipe.\n");
-    return 1;
-  }
-  if (close(resp_fd) < 0) {
-    print_error("Failed to close response pipe.\n");
-    return 1;
-  }
+/**
+ * Returns the number of operations in flight.
+ *
+ * @param session    The session.
+ * @return           The number of operations sent whose replies were not read yet.
+ */
+size_t ems_pending(const struct EmsSession *session) { return session->pending_count; }
 
-  return result;
-}
\ No newline at end of file
+/**
+ * Returns a file descriptor that becomes readable when a reply arrives.
+ *
+ * @param session    The session.
+ * @return           The response pipe of the session.
+ */
+int ems_async_fd(const struct EmsSession *session) { return session->resp_fd; }
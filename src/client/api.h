@@ -3,41 +3,147 @@
 
 #include <stddef.h>
 
+/// A connection to an EMS server, returned by ems_setup and passed to every other call. Sessions share no state, so
+/// each thread may use its own; a session must not be used by two threads at once.
+struct EmsSession;
+
+/// Called when an operation sent with one of the ems_submit_* functions completes, from within the API call that
+/// read its reply: ems_poll, ems_wait, a later ems_submit_* call or ems_quit.
+/// @param ticket Ticket returned when the operation was sent.
+/// @param result 0 if the operation succeeded, 1 otherwise, as its synchronous variant would have returned.
+/// @param arg Argument given when the operation was sent.
+typedef void (*ems_callback)(unsigned long ticket, int result, void* arg);
+
 /// Connects to an EMS server.
 /// @param req_pipe_path Path to the name pipe to be created for requests.
 /// @param resp_pipe_path Path to the name pipe to be created for responses.
 /// @param server_pipe_path Path to the name pipe where the server is listening.
-/// @return 0 if the connection was established successfully, 1 otherwise.
-int ems_setup(char const* req_pipe_path, char const* resp_pipe_path, char const* server_pipe_path);
+/// @param weight Scheduling weight of the session, up to SESSION_MAX_WEIGHT, or 0 for the default of 1. A
+///               session of weight w runs up to w times as many operations in a row as a session of weight 1.
+/// @return The session, or NULL if the connection could not be established.
+struct EmsSession* ems_setup(char const* req_pipe_path, char const* resp_pipe_path, char const* server_pipe_path,
+                             unsigned int weight);
+
+/// Sets how long the server may take to answer each of the following operations. The server drops an operation
+/// whose deadline passed before it ran, and may refuse one it does not expect to finish in time; the operation then
+/// fails without changing the server state.
+/// @param session The session.
+/// @param timeout_ms Timeout of each operation in milliseconds, or 0 to wait for ever.
+void ems_set_timeout(struct EmsSession* session, unsigned int timeout_ms);
 
-/// Disconnects from an EMS server.
+/// Disconnects from an EMS server, once the operations in flight completed, and frees the session.
+/// @param session The session.
 /// @return 0 in case of success, 1 otherwise.
-int ems_quit(void);
+int ems_quit(struct EmsSession* session);
 
 /// Creates a new event with the given id and dimensions.
+/// @param session The session.
 /// @param event_id Id of the event to be created.
 /// @param num_rows Number of rows of the event to be created.
 /// @param num_cols Number of columns of the event to be created.
 /// @return 0 if the event was created successfully, 1 otherwise.
-int ems_create(unsigned int event_id, size_t num_rows, size_t num_cols);
+int ems_create(struct EmsSession* session, unsigned int event_id, size_t num_rows, size_t num_cols);
 
 /// Creates a new reservation for the given event.
+/// @param session The session.
 /// @param event_id Id of the event to create a reservation for.
 /// @param num_seats Number of seats to reserve.
 /// @param xs Array of rows of the seats to reserve.
 /// @param ys Array of columns of the seats to reserve.
 /// @return 0 if the reservation was created successfully, 1 otherwise.
-int ems_reserve(unsigned int event_id, size_t num_seats, size_t* xs, size_t* ys);
+int ems_reserve(struct EmsSession* session, unsigned int event_id, size_t num_seats, size_t* xs, size_t* ys);
 
 /// Prints the given event to the given file.
+/// @param session The session.
 /// @param out_fd File descriptor to print the event to.
 /// @param event_id Id of the event to print.
 /// @return 0 if the event was printed successfully, 1 otherwise.
-int ems_show(int out_fd, unsigned int event_id);
+int ems_show(struct EmsSession* session, int out_fd, unsigned int event_id);
 
 /// Prints all the events to the given file.
+/// @param session The session.
 /// @param out_fd File descriptor to print the events to.
 /// @return 0 if the events were printed successfully, 1 otherwise.
-int ems_list_events(int out_fd);
+int ems_list_events(struct EmsSession* session, int out_fd);
+
+/// Prints where the time of each operation the server ran went: for each phase, its p50, p99, p999 and largest
+/// times.
+/// @param session The session.
+/// @param out_fd File descriptor to print the times to.
+/// @return 0 if the times were printed successfully, 1 otherwise.
+int ems_stats(struct EmsSession* session, int out_fd);
+
+/// Sends a create request without waiting for the reply. Operations sent this way complete in the order they were
+/// sent; the synchronous functions may be mixed with them, and wait for the operations sent before.
+/// @param session The session.
+/// @param event_id Id of the event to be created.
+/// @param num_rows Number of rows of the event to be created.
+/// @param num_cols Number of columns of the event to be created.
+/// @param callback Function told the result, or NULL.
+/// @param arg Argument passed to the callback.
+/// @return The ticket of the operation, or 0 if it could not be sent.
+unsigned long ems_submit_create(struct EmsSession* session, unsigned int event_id, size_t num_rows, size_t num_cols,
+                                ems_callback callback, void* arg);
+
+/// Sends a reserve request without waiting for the reply.
+/// @param session The session.
+/// @param event_id Id of the event to create a reservation for.
+/// @param num_seats Number of seats to reserve.
+/// @param xs Array of rows of the seats to reserve.
+/// @param ys Array of columns of the seats to reserve.
+/// @param callback Function told the result, or NULL.
+/// @param arg Argument passed to the callback.
+/// @return The ticket of the operation, or 0 if it could not be sent.
+unsigned long ems_submit_reserve(struct EmsSession* session, unsigned int event_id, size_t num_seats, size_t* xs,
+                                 size_t* ys, ems_callback callback, void* arg);
+
+/// Sends a show request without waiting for the reply. The event is printed once the reply is read.
+/// @param session The session.
+/// @param out_fd File descriptor to print the event to.
+/// @param event_id Id of the event to print.
+/// @param callback Function told the result, or NULL.
+/// @param arg Argument passed to the callback.
+/// @return The ticket of the operation, or 0 if it could not be sent.
+unsigned long ems_submit_show(struct EmsSession* session, int out_fd, unsigned int event_id, ems_callback callback,
+                              void* arg);
+
+/// Sends a list request without waiting for the reply. The events are printed once the reply is read.
+/// @param session The session.
+/// @param out_fd File descriptor to print the events to.
+/// @param callback Function told the result, or NULL.
+/// @param arg Argument passed to the callback.
+/// @return The ticket of the operation, or 0 if it could not be sent.
+unsigned long ems_submit_list_events(struct EmsSession* session, int out_fd, ems_callback callback, void* arg);
+
+/// Sends a stats request without waiting for the reply. The times are printed once the reply is read.
+/// @param session The session.
+/// @param out_fd File descriptor to print the times to.
+/// @param callback Function told the result, or NULL.
+/// @param arg Argument passed to the callback.
+/// @return The ticket of the operation, or 0 if it could not be sent.
+unsigned long ems_submit_stats(struct EmsSession* session, int out_fd, ems_callback callback, void* arg);
+
+/// Completes every operation in flight up to the given one, in the order they were sent.
+/// @param session The session.
+/// @param ticket Ticket of the operation.
+/// @return 0 once the operation completed, 1 if no operation was sent with that ticket.
+int ems_wait(struct EmsSession* session, unsigned long ticket);
+
+/// Completes the operations whose replies arrived.
+/// @param session The session.
+/// @param timeout_ms How long to wait for the first reply in milliseconds, 0 not to wait, or -1 to wait for ever.
+/// @return The number of operations completed, or -1 on failure.
+int ems_poll(struct EmsSession* session, int timeout_ms);
+
+/// Returns the number of operations in flight.
+/// @param session The session.
+/// @return The number of operations sent whose replies were not read yet.
+size_t ems_pending(const struct EmsSession* session);
+
+/// Returns a file descriptor that becomes readable when a reply arrives, to wait for replies in an event loop
+/// along with other descriptors and call ems_poll(session, 0) when it is readable.
+/// @param session The session.
+/// @return The file descriptor.
+int ems_async_fd(const struct EmsSession* session);
 
 #endif  // CLIENT_API_H
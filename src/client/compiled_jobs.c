@@ -0,0 +1,276 @@
+#include "compiled_jobs.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "common/constants.h"
+#include "common/io.h"
+
+#define FNV_OFFSET_BASIS 14695981039346656037ull
+#define FNV_PRIME 1099511628211ull
+
+/**
+ * @struct JobcWriter
+ * @brief Records of a .jobc file being compiled, and the running totals its header holds.
+ */
+struct JobcWriter {
+  struct Writer out;      // Writer over the .jobc file
+  uint64_t commands;      // Records written
+  uint64_t payload_size;  // Bytes of records written
+  uint64_t checksum;      // FNV-1a hash of the records written
+};
+
+/**
+ * Hashes bytes into a running FNV-1a hash.
+ */
+static uint64_t fnv1a(uint64_t hash, const unsigned char* bytes, size_t size) {
+  for (size_t i = 0; i < size; i++) {
+    hash ^= bytes[i];
+    hash *= FNV_PRIME;
+  }
+  return hash;
+}
+
+/**
+ * Appends bytes to the records.
+ *
+ * @return 0 on success, 1 on failure.
+ */
+static int jobc_append(struct JobcWriter* writer, const void* bytes, size_t size) {
+  writer->checksum = fnv1a(writer->checksum, bytes, size);
+  writer->payload_size += size;
+  return writer_write(&writer->out, bytes, size);
+}
+
+/**
+ * Appends the record of a command.
+ *
+ * @return 0 on success, 1 on failure.
+ */
+static int jobc_command(struct JobcWriter* writer, const struct JobCommand* command) {
+  struct JobcRecord record = {(uint8_t)command->command, 0, 0, 0};
+  if (command->command == CMD_RESERVE) {
+    record.seats = (uint16_t)command->num_coords;
+  }
+  if (command->command == CMD_WAIT) {
+    record.argument = command->delay;
+  } else if (command->command == CMD_CREATE || command->command == CMD_RESERVE || command->command == CMD_SHOW) {
+    record.argument = command->event_id;
+  }
+  if (jobc_append(writer, &record, sizeof(record)) != 0) {
+    return 1;
+  }
+
+  // The parser reads every value as an unsigned int, so none is lost
+  uint32_t values[2 * MAX_RESERVATION_SIZE];
+  size_t count = 0;
+  if (command->command == CMD_CREATE) {
+    values[count++] = (uint32_t)command->num_rows;
+    values[count++] = (uint32_t)command->num_cols;
+  } else if (command->command == CMD_RESERVE) {
+    for (size_t i = 0; i < command->num_coords; i++) {
+      values[count++] = (uint32_t)command->xs[i];
+    }
+    for (size_t i = 0; i < command->num_coords; i++) {
+      values[count++] = (uint32_t)command->ys[i];
+    }
+  }
+
+  writer->commands++;
+  return jobc_append(writer, values, count * sizeof(uint32_t));
+}
+
+/**
+ * Compiles a .jobs file into a file named after it with the .jobc extension. Empty and comment lines are left out;
+ * invalid commands are kept, so that a replay reports them like the .jobs file would.
+ *
+ * @param jobs_path Path to the .jobs file.
+ * @param commands Pointer to the variable to store the number of commands compiled in, or NULL.
+ * @return 0 on success, 1 on failure.
+ */
+int jobs_compile(const char* jobs_path, size_t* commands) {
+  const char* dot = strrchr(jobs_path, '.');
+  if (dot == NULL || dot == jobs_path || strcmp(dot, ".jobs") != 0 || strlen(jobs_path) >= MAX_JOB_FILE_NAME_SIZE) {
+    fprintf(stderr, "The provided .jobs file path is not valid. Path: %s\n", jobs_path);
+    return 1;
+  }
+
+  char jobc_path[MAX_JOB_FILE_NAME_SIZE];
+  strcpy(jobc_path, jobs_path);
+  strcpy(strrchr(jobc_path, '.'), ".jobc");
+
+  int in_fd = open(jobs_path, O_RDONLY);
+  if (in_fd == -1) {
+    fprintf(stderr, "Failed to open input file. Path: %s\n", jobs_path);
+    return 1;
+  }
+
+  // Written to a temporary file renamed over the .jobc file once complete, so a replay never maps half a file
+  char temp_path[MAX_JOB_FILE_NAME_SIZE + 8];
+  snprintf(temp_path, sizeof(temp_path), "%s.tmp", jobc_path);
+  int out_fd = open(temp_path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+  if (out_fd == -1) {
+    fprintf(stderr, "Failed to open output file. Path: %s\n", temp_path);
+    close(in_fd);
+    return 1;
+  }
+
+  char out_buffer[WRITER_BUFFER_SIZE];
+  struct JobcWriter writer;
+  writer_init(&writer.out, out_fd, out_buffer, sizeof(out_buffer));
+  writer.commands = 0;
+  writer.payload_size = 0;
+  writer.checksum = FNV_OFFSET_BASIS;
+
+  char in_buffer[READER_BUFFER_SIZE];
+  struct Reader reader;
+  reader_init(&reader, in_fd, in_buffer, sizeof(in_buffer));
+
+  // Room for the header, written once the records are
+  struct JobcHeader header = {JOBC_MAGIC, JOBC_VERSION, 0, 0, 0, 0};
+  int failed = my_write(out_fd, &header, sizeof(header)) == -1;
+
+  struct JobCommand command;
+  size_t xs[MAX_RESERVATION_SIZE], ys[MAX_RESERVATION_SIZE];
+  while (!failed && parse_command(&reader, &command, xs, ys) != EOC) {
+    if (command.command != CMD_EMPTY) {
+      failed = jobc_command(&writer, &command);
+    }
+  }
+
+  header.commands = writer.commands;
+  header.payload_size = writer.payload_size;
+  header.checksum = writer.checksum;
+  failed = failed || writer_flush(&writer.out) != 0 || pwrite(out_fd, &header, sizeof(header), 0) != sizeof(header);
+
+  close(in_fd);
+  if (close(out_fd) == -1 || failed || rename(temp_path, jobc_path) == -1) {
+    fprintf(stderr, "Failed to write compiled file. Path: %s\n", jobc_path);
+    unlink(temp_path);
+    return 1;
+  }
+
+  if (commands != NULL) {
+    *commands = (size_t)header.commands;
+  }
+  return 0;
+}
+
+/**
+ * Maps a compiled .jobs file and checks its header and checksum.
+ *
+ * @param jobs The compiled file to fill in.
+ * @param fd File descriptor of the file.
+ * @return 0 on success, 1 if the file could not be mapped or is not a valid compiled .jobs file.
+ */
+int compiled_jobs_open(struct CompiledJobs* jobs, int fd) {
+  struct stat info;
+  if (fstat(fd, &info) == -1 || (size_t)info.st_size < sizeof(struct JobcHeader)) {
+    print_error("The compiled .jobs file is truncated.\n");
+    return 1;
+  }
+
+  jobs->size = (size_t)info.st_size;
+  jobs->offset = sizeof(struct JobcHeader);
+  void* data = mmap(NULL, jobs->size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (data == MAP_FAILED) {
+    print_error("Failed to map the compiled .jobs file.\n");
+    return 1;
+  }
+  jobs->data = data;
+  posix_madvise(data, jobs->size, POSIX_MADV_SEQUENTIAL);
+
+  struct JobcHeader header;
+  memcpy(&header, jobs->data, sizeof(header));
+  if (header.magic != JOBC_MAGIC || header.version != JOBC_VERSION ||
+      header.payload_size != jobs->size - sizeof(header)) {
+    print_error("The compiled .jobs file was written by another version or machine. Compile it again.\n");
+    compiled_jobs_close(jobs);
+    return 1;
+  }
+
+  if (fnv1a(FNV_OFFSET_BASIS, jobs->data + sizeof(header), jobs->size - sizeof(header)) != header.checksum) {
+    print_error("The compiled .jobs file is corrupt. Compile it again.\n");
+    compiled_jobs_close(jobs);
+    return 1;
+  }
+  return 0;
+}
+
+/**
+ * Reads values at the current position, widening them to size_t.
+ *
+ * @return 0 on success, 1 if the file ends first.
+ */
+static int next_values(struct CompiledJobs* jobs, size_t* values, size_t count) {
+  if ((jobs->size - jobs->offset) / sizeof(uint32_t) < count) {
+    return 1;
+  }
+  for (size_t i = 0; i < count; i++) {
+    uint32_t value;
+    memcpy(&value, jobs->data + jobs->offset, sizeof(uint32_t));
+    values[i] = value;
+    jobs->offset += sizeof(uint32_t);
+  }
+  return 0;
+}
+
+/**
+ * Decodes the next command.
+ *
+ * @param jobs The compiled file.
+ * @param command Pointer to the command to fill in, EOC after the last one.
+ * @return 0 on success, 1 if the record is malformed.
+ */
+int compiled_jobs_next(struct CompiledJobs* jobs, struct JobCommand* command) {
+  if (jobs->offset == jobs->size) {
+    command->command = EOC;
+    return 0;
+  }
+
+  struct JobcRecord record;
+  if (jobs->size - jobs->offset < sizeof(record)) {
+    return 1;
+  }
+  memcpy(&record, jobs->data + jobs->offset, sizeof(record));
+  jobs->offset += sizeof(record);
+
+  command->command = (enum Command)record.command;
+  command->event_id = record.argument;
+  command->delay = record.argument;
+  switch (command->command) {
+    case CMD_CREATE:
+      return next_values(jobs, &command->num_rows, 1) || next_values(jobs, &command->num_cols, 1);
+
+    case CMD_RESERVE:
+      command->num_coords = record.seats;
+      command->xs = jobs->xs;
+      command->ys = jobs->ys;
+      return record.seats == 0 || record.seats >= MAX_RESERVATION_SIZE ||
+             next_values(jobs, jobs->xs, record.seats) || next_values(jobs, jobs->ys, record.seats);
+
+    case CMD_SHOW:
+    case CMD_LIST_EVENTS:
+    case CMD_STATS:
+    case CMD_WAIT:
+    case CMD_HELP:
+    case CMD_INVALID:
+      return 0;
+
+    case CMD_EMPTY:
+    case EOC:
+      break;
+  }
+  return 1;
+}
+
+/**
+ * Unmaps a compiled .jobs file.
+ *
+ * @param jobs The compiled file.
+ */
+void compiled_jobs_close(struct CompiledJobs* jobs) { munmap((void*)(uintptr_t)jobs->data, jobs->size); }
@@ -0,0 +1,73 @@
+#ifndef CLIENT_COMPILED_JOBS_H
+#define CLIENT_COMPILED_JOBS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "common/constants.h"
+#include "parser.h"
+
+#define JOBC_MAGIC 0x434a4d45u  // "EMJC" when written in little-endian order, which also gives away the byte order
+#define JOBC_VERSION 2          // Version of the compiled .jobs format
+
+/**
+ * @struct JobcHeader
+ * @brief Header of a compiled .jobs (.jobc) file. Values are stored in the byte order of the machine that compiled
+ * the file, and a file written in the other order is rejected.
+ */
+struct JobcHeader {
+  uint32_t magic;         // JOBC_MAGIC
+  uint16_t version;       // JOBC_VERSION
+  uint16_t reserved;      // Zero
+  uint64_t commands;      // Number of records
+  uint64_t payload_size;  // Bytes of records after the header
+  uint64_t checksum;      // FNV-1a hash of the records
+};
+
+/**
+ * @struct JobcRecord
+ * @brief A command of a compiled .jobs file. CREATE is followed by its number of rows and of columns, and RESERVE by
+ * the rows of its seats and then their columns, each a uint32_t, which holds any value the parser accepts.
+ */
+struct JobcRecord {
+  uint8_t command;    // The enum Command
+  uint8_t reserved;   // Zero
+  uint16_t seats;     // Seats of a RESERVE
+  uint32_t argument;  // Event id, or delay of a WAIT
+};
+
+/**
+ * @struct CompiledJobs
+ * @brief A compiled .jobs file mapped in memory, the position of the next record and the seats of the last RESERVE.
+ */
+struct CompiledJobs {
+  const unsigned char* data;        // The mapped file
+  size_t size;                      // Size of the file
+  size_t offset;                    // Offset of the next record
+  size_t xs[MAX_RESERVATION_SIZE];  // Rows of the seats of the last RESERVE
+  size_t ys[MAX_RESERVATION_SIZE];  // Columns of the seats of the last RESERVE
+};
+
+/// Compiles a .jobs file into a file named after it with the .jobc extension.
+/// @param jobs_path Path to the .jobs file.
+/// @param commands Pointer to the variable to store the number of commands compiled in, or NULL.
+/// @return 0 on success, 1 on failure.
+int jobs_compile(const char* jobs_path, size_t* commands);
+
+/// Maps a compiled .jobs file and checks its header and checksum.
+/// @param jobs The compiled file to fill in.
+/// @param fd File descriptor of the file.
+/// @return 0 on success, 1 if the file could not be mapped or is not a valid compiled .jobs file.
+int compiled_jobs_open(struct CompiledJobs* jobs, int fd);
+
+/// Decodes the next command. The coordinates of a RESERVE are valid until the next call.
+/// @param jobs The compiled file.
+/// @param command Pointer to the command to fill in, EOC after the last one.
+/// @return 0 on success, 1 if the record is malformed.
+int compiled_jobs_next(struct CompiledJobs* jobs, struct JobCommand* command);
+
+/// Unmaps a compiled .jobs file.
+/// @param jobs The compiled file.
+void compiled_jobs_close(struct CompiledJobs* jobs);
+
+#endif  // CLIENT_COMPILED_JOBS_H
@@ -0,0 +1,271 @@
+#include "driver.h"
+
+#include <dirent.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "api.h"
+#include "common/constants.h"
+#include "common/io.h"
+#include "jobs.h"
+
+/**
+ * @struct JobList
+ * @brief Growable list of .jobs file paths, each allocated with malloc.
+ */
+struct JobList {
+  char** paths;     // The paths
+  size_t count;     // Paths in the list
+  size_t capacity;  // Paths the list holds before it grows
+};
+
+/**
+ * @struct Driver
+ * @brief State shared by the threads of a driver run.
+ */
+struct Driver {
+  const char* server_pipe_path;  // Path to the server pipe
+  struct JobList* jobs;          // Files to run
+  atomic_size_t next;            // Index of the next file a thread takes
+  atomic_size_t failed;          // Files that could not be run to their end
+};
+
+/**
+ * @struct DriverThread
+ * @brief A thread of a driver run and the statistics of the files it ran.
+ */
+struct DriverThread {
+  pthread_t thread;       // The thread
+  size_t index;           // Index of the thread, which names its pipes
+  struct Driver* driver;  // State shared by every thread
+  struct JobStats stats;  // Latencies of the operations the thread sent
+};
+
+static const char* const op_names[JOB_OP_COUNT] = {"CREATE", "RESERVE", "SHOW", "LIST"};
+
+/**
+ * Adds a copy of a path to a list.
+ *
+ * @return 0 on success, 1 on failure.
+ */
+static int add_job(struct JobList* jobs, const char* path) {
+  if (jobs->count == jobs->capacity) {
+    size_t capacity = jobs->capacity == 0 ? 16 : 2 * jobs->capacity;
+    char** paths = realloc(jobs->paths, capacity * sizeof(char*));
+    if (paths == NULL) {
+      return 1;
+    }
+    jobs->paths = paths;
+    jobs->capacity = capacity;
+  }
+
+  jobs->paths[jobs->count] = strdup(path);
+  if (jobs->paths[jobs->count] == NULL) {
+    return 1;
+  }
+  jobs->count++;
+  return 0;
+}
+
+/**
+ * Orders two paths of a list alphabetically.
+ */
+static int compare_paths(const void* a, const void* b) { return strcmp(*(char* const*)a, *(char* const*)b); }
+
+/**
+ * Adds a path to a list: a directory adds its .jobs files, in alphabetical order, and anything else is added as is.
+ *
+ * @return 0 on success, 1 on failure.
+ */
+static int expand(struct JobList* jobs, const char* path) {
+  struct stat info;
+  if (stat(path, &info) == -1 || !S_ISDIR(info.st_mode)) {
+    return add_job(jobs, path);
+  }
+
+  DIR* dir = opendir(path);
+  if (dir == NULL) {
+    fprintf(stderr, "Failed to open jobs directory. Path: %s\n", path);
+    return 1;
+  }
+
+  size_t first = jobs->count;
+  struct dirent* entry;
+  while ((entry = readdir(dir)) != NULL) {
+    const char* dot = strrchr(entry->d_name, '.');
+    if (dot == NULL || dot == entry->d_name || strcmp(dot, ".jobs") != 0) {
+      continue;
+    }
+
+    char job_path[MAX_JOB_FILE_NAME_SIZE];
+    int length = snprintf(job_path, sizeof(job_path), "%s/%s", path, entry->d_name);
+    if (length < 0 || (size_t)length >= sizeof(job_path)) {
+      fprintf(stderr, "The provided .jobs file path is not valid. Path: %s/%s\n", path, entry->d_name);
+      continue;
+    }
+    if (add_job(jobs, job_path) != 0) {
+      closedir(dir);
+      return 1;
+    }
+  }
+  closedir(dir);
+
+  qsort(jobs->paths + first, jobs->count - first, sizeof(char*), compare_paths);
+  return 0;
+}
+
+/**
+ * Runs files of a driver run, one after the other, each over a new session, until none is left.
+ *
+ * @param arg The DriverThread.
+ * @return NULL.
+ */
+static void* driver_thread(void* arg) {
+  struct DriverThread* self = arg;
+  struct Driver* driver = self->driver;
+
+  // Pipes of this thread, named after the process and the thread so that concurrent drivers do not collide
+  char req_pipe_path[MAX_PATH], resp_pipe_path[MAX_PATH];
+  snprintf(req_pipe_path, MAX_PATH, "/tmp/ems_%d_%zu_req", (int)getpid(), self->index);
+  snprintf(resp_pipe_path, MAX_PATH, "/tmp/ems_%d_%zu_resp", (int)getpid(), self->index);
+
+  size_t job;
+  while ((job = atomic_fetch_add(&driver->next, 1)) < driver->jobs->count) {
+    const char* path = driver->jobs->paths[job];
+    struct EmsSession* session = ems_setup(req_pipe_path, resp_pipe_path, driver->server_pipe_path, 1);
+    if (session == NULL) {
+      fprintf(stderr, "Failed to set up EMS. Path: %s\n", path);
+      atomic_fetch_add(&driver->failed, 1);
+      continue;
+    }
+
+    int failed = jobs_run(session, path, &self->stats);
+    if (ems_quit(session)) {
+      print_error("Failed to quit EMS\n");
+      failed = 1;
+    }
+    if (failed) {
+      atomic_fetch_add(&driver->failed, 1);
+    }
+  }
+  return NULL;
+}
+
+/**
+ * Prints the throughput and the latency percentiles of the operations of a driver run.
+ */
+static void print_report(struct DriverThread* workers, size_t threads, size_t files, size_t failed, double seconds) {
+  struct JobStats total;
+  size_t operations = 0;
+  for (size_t op = 0; op < JOB_OP_COUNT; op++) {
+    histogram_init(&total.latencies[op]);
+    for (size_t i = 0; i < threads; i++) {
+      histogram_merge(&total.latencies[op], &workers[i].stats.latencies[op]);
+    }
+    operations += total.latencies[op].count;
+  }
+
+  printf("%zu files (%zu failed) over %zu threads in %.2fs: %.0f operations/s\n", files, failed, threads, seconds,
+         seconds > 0 ? (double)operations / seconds : 0.0);
+  printf("%-8s %10s %10s %10s %10s %10s\n", "op", "count", "p50 (us)", "p90 (us)", "p99 (us)", "max (us)");
+  for (size_t op = 0; op < JOB_OP_COUNT; op++) {
+    const struct Histogram* latencies = &total.latencies[op];
+    printf("%-8s %10zu %10zu %10zu %10zu %10zu\n", op_names[op], latencies->count,
+           histogram_percentile(latencies, 50), histogram_percentile(latencies, 90),
+           histogram_percentile(latencies, 99), latencies->max);
+  }
+}
+
+/**
+ * Frees the paths of a list.
+ */
+static void free_jobs(struct JobList* jobs) {
+  for (size_t i = 0; i < jobs->count; i++) {
+    free(jobs->paths[i]);
+  }
+  free(jobs->paths);
+}
+
+/**
+ * Runs the files of a list over the given number of threads and prints the report.
+ *
+ * @return 0 if every file was run, 1 otherwise.
+ */
+static int run_jobs(const char* server_pipe_path, size_t threads, struct JobList* jobs) {
+  // No point in more threads than files
+  if (threads > jobs->count) {
+    threads = jobs->count;
+  }
+
+  struct DriverThread* workers = calloc(threads, sizeof(struct DriverThread));
+  if (workers == NULL) {
+    print_error("Failed to allocate the driver threads\n");
+    return 1;
+  }
+
+  struct Driver driver = {server_pipe_path, jobs, 0, 0};
+  struct timespec start, end;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  // Files left by a thread that could not be created are run by the others
+  size_t started = 0;
+  for (; started < threads; started++) {
+    workers[started].index = started;
+    workers[started].driver = &driver;
+    for (size_t op = 0; op < JOB_OP_COUNT; op++) {
+      histogram_init(&workers[started].stats.latencies[op]);
+    }
+    if (pthread_create(&workers[started].thread, NULL, driver_thread, &workers[started]) != 0) {
+      print_error("Failed to create a driver thread\n");
+      break;
+    }
+  }
+  for (size_t i = 0; i < started; i++) {
+    pthread_join(workers[i].thread, NULL);
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  double seconds = (double)(end.tv_sec - start.tv_sec) + (double)(end.tv_nsec - start.tv_nsec) / 1e9;
+
+  size_t failed = atomic_load(&driver.failed);
+  if (started > 0) {
+    print_report(workers, started, jobs->count, failed, seconds);
+  }
+  free(workers);
+  return started == 0 || failed > 0;
+}
+
+/**
+ * Runs many .jobs files concurrently, each over its own session, and prints the throughput and the latency
+ * percentiles of each operation once they all ran.
+ *
+ * @param server_pipe_path Path to the server pipe.
+ * @param threads Number of files run at once.
+ * @param paths Paths to .jobs files, or to directories whose .jobs files are run.
+ * @param count Number of paths.
+ * @return 0 if every file was run, 1 otherwise.
+ */
+int driver_run(const char* server_pipe_path, size_t threads, char* const paths[], size_t count) {
+  struct JobList jobs = {NULL, 0, 0};
+  for (size_t i = 0; i < count; i++) {
+    if (expand(&jobs, paths[i]) != 0) {
+      print_error("Failed to list the .jobs files\n");
+      free_jobs(&jobs);
+      return 1;
+    }
+  }
+  if (jobs.count == 0) {
+    print_error("No .jobs files to run\n");
+    return 1;
+  }
+
+  int result = run_jobs(server_pipe_path, threads, &jobs);
+  free_jobs(&jobs);
+  return result;
+}
@@ -0,0 +1,15 @@
+#ifndef CLIENT_DRIVER_H
+#define CLIENT_DRIVER_H
+
+#include <stddef.h>
+
+/// Runs many .jobs files concurrently, each over its own session, and prints the throughput and the latency
+/// percentiles of each operation once they all ran.
+/// @param server_pipe_path Path to the server pipe.
+/// @param threads Number of files run at once.
+/// @param paths Paths to .jobs files, or to directories whose .jobs files are run.
+/// @param count Number of paths.
+/// @return 0 if every file was run, 1 otherwise.
+int driver_run(const char* server_pipe_path, size_t threads, char* const paths[], size_t count);
+
+#endif  // CLIENT_DRIVER_H
@@ -0,0 +1,199 @@
+#include "jobs.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "api.h"
+#include "compiled_jobs.h"
+#include "common/constants.h"
+#include "common/io.h"
+#include "parser.h"
+
+/**
+ * Records the latency of an operation sent at the given instant.
+ *
+ * @param stats Statistics to record it in, or NULL.
+ * @param op The operation.
+ * @param sent_at When it was sent.
+ */
+static void record(struct JobStats* stats, enum JobOp op, const struct timespec* sent_at) {
+  if (stats == NULL) {
+    return;
+  }
+
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  long long elapsed = (now.tv_sec - sent_at->tv_sec) * 1000000LL + (now.tv_nsec - sent_at->tv_nsec) / 1000;
+  histogram_record(&stats->latencies[op], elapsed > 0 ? (size_t)elapsed : 0);
+}
+
+/**
+ * Runs a command over a session.
+ *
+ * @param session The session.
+ * @param out_fd File descriptor to write the output of SHOW and LIST to.
+ * @param command The command.
+ * @param stats Statistics to record the latency of each operation in, or NULL.
+ */
+static void execute(struct EmsSession* session, int out_fd, const struct JobCommand* command, struct JobStats* stats) {
+  struct timespec sent_at;
+
+  switch (command->command) {
+    case CMD_CREATE:
+      clock_gettime(CLOCK_MONOTONIC, &sent_at);
+      if (ems_create(session, command->event_id, command->num_rows, command->num_cols)) {
+        print_error("Failed to create event\n");
+      }
+      record(stats, JOB_OP_CREATE, &sent_at);
+      break;
+
+    case CMD_RESERVE:
+      clock_gettime(CLOCK_MONOTONIC, &sent_at);
+      if (ems_reserve(session, command->event_id, command->num_coords, command->xs, command->ys)) {
+        print_error("Failed to reserve seats\n");
+      }
+      record(stats, JOB_OP_RESERVE, &sent_at);
+      break;
+
+    case CMD_SHOW:
+      clock_gettime(CLOCK_MONOTONIC, &sent_at);
+      if (ems_show(session, out_fd, command->event_id)) print_error("Failed to show event\n");
+      record(stats, JOB_OP_SHOW, &sent_at);
+      break;
+
+    case CMD_LIST_EVENTS:
+      clock_gettime(CLOCK_MONOTONIC, &sent_at);
+      if (ems_list_events(session, out_fd)) print_error("Failed to list events\n");
+      record(stats, JOB_OP_LIST, &sent_at);
+      break;
+
+    case CMD_STATS:
+      if (ems_stats(session, out_fd)) print_error("Failed to get server stats\n");
+      break;
+
+    case CMD_WAIT:
+      if (command->delay > 0) {
+        printf("Waiting...\n");
+        sleep(command->delay);
+      }
+      break;
+
+    case CMD_INVALID:
+      print_error("Invalid command. See HELP for usage\n");
+      break;
+
+    case CMD_HELP:
+      printf(
+          "Available commands:\n"
+          "  CREATE <event_id> <num_rows> <num_columns>\n"
+          "  RESERVE <event_id> [(<x1>,<y1>) (<x2>,<y2>) ...]\n"
+          "  SHOW <event_id>\n"
+          "  LIST\n"
+          "  STATS\n"
+          "  WAIT <delay_ms>\n"
+          "  HELP\n");
+
+      break;
+
+    case CMD_EMPTY:
+    case EOC:
+      break;
+  }
+}
+
+/**
+ * Parses a .jobs file from a buffer refilled a chunk at a time and runs its commands.
+ *
+ * @return 0.
+ */
+static int run_text(struct EmsSession* session, int in_fd, int out_fd, struct JobStats* stats) {
+  char in_buffer[READER_BUFFER_SIZE];
+  struct Reader reader;
+  reader_init(&reader, in_fd, in_buffer, sizeof(in_buffer));
+
+  struct JobCommand command;
+  size_t xs[MAX_RESERVATION_SIZE], ys[MAX_RESERVATION_SIZE];
+  while (parse_command(&reader, &command, xs, ys) != EOC) {
+    execute(session, out_fd, &command, stats);
+  }
+  return 0;
+}
+
+/**
+ * Maps a compiled .jobs file and runs its commands, which need no parsing.
+ *
+ * @return 0 on success, 1 if the file is not a valid compiled .jobs file.
+ */
+static int run_compiled(struct EmsSession* session, int in_fd, int out_fd, struct JobStats* stats) {
+  struct CompiledJobs jobs;
+  if (compiled_jobs_open(&jobs, in_fd) != 0) {
+    return 1;
+  }
+
+  struct JobCommand command;
+  int failed;
+  while ((failed = compiled_jobs_next(&jobs, &command)) == 0 && command.command != EOC) {
+    execute(session, out_fd, &command, stats);
+  }
+  if (failed) {
+    print_error("The compiled .jobs file is malformed. Compile it again.\n");
+  }
+
+  compiled_jobs_close(&jobs);
+  return failed;
+}
+
+/**
+ * Runs the commands of a .jobs file, or of a compiled .jobc file, one at a time, over a session.
+ *
+ * @param session The session.
+ * @param jobs_path Path to the .jobs or .jobc file.
+ * @param stats Statistics to record the latency of each operation in, or NULL.
+ * @return 0 if the file was run to its end, 1 otherwise.
+ */
+int jobs_run(struct EmsSession* session, const char* jobs_path, struct JobStats* stats) {
+  // Validate the provided .jobs file path
+  const char* dot = strrchr(jobs_path, '.');
+  if (dot == NULL || dot == jobs_path || strlen(dot) != 5 || (strcmp(dot, ".jobs") && strcmp(dot, ".jobc")) ||
+      strlen(jobs_path) >= MAX_JOB_FILE_NAME_SIZE) {
+    fprintf(stderr, "The provided .jobs file path is not valid. Path: %s\n", jobs_path);
+    return 1;
+  }
+  int compiled = strcmp(dot, ".jobc") == 0;
+
+  // Create an output file path by replacing the extension with .out
+  char out_path[MAX_JOB_FILE_NAME_SIZE];
+  strcpy(out_path, jobs_path);
+  strcpy(strrchr(out_path, '.'), ".out");
+
+  // Open input file
+  int in_fd = open(jobs_path, O_RDONLY);
+  if (in_fd == -1) {
+    fprintf(stderr, "Failed to open input file. Path: %s\n", jobs_path);
+    return 1;
+  }
+
+  // Open output file;
+  int out_fd = open(out_path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+  if (out_fd == -1) {
+    fprintf(stderr, "Failed to open output file. Path: %s\n", out_path);
+    close(in_fd);
+    return 1;
+  }
+
+  int failed = compiled ? run_compiled(session, in_fd, out_fd, stats) : run_text(session, in_fd, out_fd, stats);
+
+  if (close(in_fd) == -1) {
+    fprintf(stderr, "Failed to close input file. Path: %s\n", jobs_path);
+    close(out_fd);
+    return 1;
+  }
+  if (close(out_fd) == -1) {
+    fprintf(stderr, "Failed to close output file. Path: %s\n", out_path);
+    return 1;
+  }
+  return failed;
+}
@@ -0,0 +1,35 @@
+#ifndef CLIENT_JOBS_H
+#define CLIENT_JOBS_H
+
+#include "api.h"
+#include "common/histogram.h"
+
+/**
+ * @enum JobOp
+ * @brief Operations a .jobs file sends to the server.
+ */
+enum JobOp {
+  JOB_OP_CREATE,
+  JOB_OP_RESERVE,
+  JOB_OP_SHOW,
+  JOB_OP_LIST,
+  JOB_OP_COUNT,  // Number of operations
+};
+
+/**
+ * @struct JobStats
+ * @brief Latency in microseconds of the operations a client sent, per operation.
+ */
+struct JobStats {
+  struct Histogram latencies[JOB_OP_COUNT];
+};
+
+/// Runs the commands of a .jobs file, or of a .jobc file compiled from one, over a session, writing the output of
+/// SHOW and LIST to a file named after it with the .out extension.
+/// @param session The session.
+/// @param jobs_path Path to the .jobs or .jobc file.
+/// @param stats Statistics to record the latency of each operation in, or NULL.
+/// @return 0 if the file was run to its end, 1 otherwise.
+int jobs_run(struct EmsSession* session, const char* jobs_path, struct JobStats* stats);
+
+#endif  // CLIENT_JOBS_H
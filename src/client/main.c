@@ -1,12 +1,26 @@
-#include <fcntl.h>
+#include <limits.h>
 #include <stdio.h>
-#include <string.h>
+#include <stdlib.h>
 #include <unistd.h>
 
 #include "api.h"
 #include "common/constants.h"
 #include "common/io.h"
-#include "parser.h"
+#include "compiled_jobs.h"
+#include "driver.h"
+#include "jobs.h"
+
+/**
+ * Prints how to run the client.
+ */
+static void usage(const char* program) {
+  fprintf(stderr,
+          "Usage: %s <request pipe path> <response pipe path> <server pipe path> <.jobs file path> [weight] "
+          "[timeout_ms]\n"
+          "       %s -p <threads> <server pipe path> <.jobs file or directory path>...\n"
+          "       %s -c <.jobs file path>...\n",
+          program, program, program);
+}
 
 /**
  * The main function for the EMS client program.
@@ -16,131 +30,95 @@
  * @return 0 if the program executed successfully, 1 otherwise.
  */
 int main(int argc, char* argv[]) {
-  // Check if the required number of command-line arguments is provided
-  if (argc < 5) {
-    fprintf(stderr, "Usage: %s <request pipe path> <response pipe path> <server pipe path> <.jobs file path>\n",
-            argv[0]);
-    return 1;
-  }
+  // Driver mode: run many .jobs files at once, each over its own session
+  int option;
+  unsigned long threads = 0;
+  int compile = 0;
+  while ((option = getopt(argc, argv, "p:c")) != -1) {
+    if (option == 'c') {
+      compile = 1;
+      continue;
+    }
+    if (option != 'p') {
+      usage(argv[0]);
+      return 1;
+    }
 
-  // Set up communication with the EMS server
-  if (ems_setup(argv[1], argv[2], argv[3])) {
-    print_error("Failed to set up EMS\n");
-    return 1;
+    char* threads_end;
+    threads = strtoul(optarg, &threads_end, 10);
+    if (*threads_end != '\0' || threads == 0 || threads > MAX_LIVE_SESSIONS) {
+      fprintf(stderr, "The number of threads must be between 1 and %d.\n", MAX_LIVE_SESSIONS);
+      return 1;
+    }
   }
 
-  // Validate the provided .jobs file path
-  const char* dot = strrchr(argv[4], '.');
-  if (dot == NULL || dot == argv[4] || strlen(dot) != 5 || strcmp(dot, ".jobs") ||
-      strlen(argv[4]) > MAX_JOB_FILE_NAME_SIZE) {
-    fprintf(stderr, "The provided .jobs file path is not valid. Path: %s\n", argv[1]);
-    return 1;
-  }
+  // Compile mode: turn .jobs files into .jobc files that replay without parsing
+  if (compile) {
+    if (threads > 0 || argc - optind < 1) {
+      usage(argv[0]);
+      return 1;
+    }
 
-  // Create an output file path by replacing the extension with .out
-  char out_path[MAX_JOB_FILE_NAME_SIZE];
-  strcpy(out_path, argv[4]);
-  strcpy(strrchr(out_path, '.'), ".out");
+    int failed = 0;
+    for (int i = optind; i < argc; i++) {
+      size_t commands;
+      if (jobs_compile(argv[i], &commands) != 0) {
+        failed = 1;
+        continue;
+      }
+      printf("Compiled %s: %zu commands\n", argv[i], commands);
+    }
+    return failed;
+  }
 
-  // Open input file
-  int in_fd = open(argv[4], O_RDONLY);
-  if (in_fd == -1) {
-    fprintf(stderr, "Failed to open input file. Path: %s\n", argv[4]);
-    return 1;
+  if (threads > 0) {
+    if (argc - optind < 2) {
+      usage(argv[0]);
+      return 1;
+    }
+    return driver_run(argv[optind], threads, argv + optind + 1, (size_t)(argc - optind - 1));
   }
 
-  // Open output file;
-  int out_fd = open(out_path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
-  if (out_fd == -1) {
-    fprintf(stderr, "Failed to open output file. Path: %s\n", out_path);
+  // Check if the required number of command-line arguments is provided
+  if (argc < 5 || argc > 7) {
+    usage(argv[0]);
     return 1;
   }
 
-  // Main command processing loop
-  while (1) {
-    unsigned int event_id;
-    size_t num_rows, num_columns, num_coords;
-    unsigned int delay = 0;
-    size_t xs[MAX_RESERVATION_SIZE], ys[MAX_RESERVATION_SIZE];
-
-    switch (get_next(in_fd)) {
-      case CMD_CREATE:
-        if (parse_create(in_fd, &event_id, &num_rows, &num_columns) != 0) {
-          print_error("Invalid command. See HELP for usage\n");
-          continue;
-        }
-
-        if (ems_create(event_id, num_rows, num_columns)) print_error("Failed to create event\n");
-        break;
-      case CMD_RESERVE:
-        num_coords = parse_reserve(in_fd, MAX_RESERVATION_SIZE, &event_id, xs, ys);
-
-        if (num_coords == 0) {
-          print_error("Invalid command. See HELP for usage\n");
-          continue;
-        }
-
-        if (ems_reserve(event_id, num_coords, xs, ys)) print_error("Failed to reserve seats\n");
-        break;
-
-      case CMD_SHOW:
-        if (parse_show(in_fd, &event_id) != 0) {
-          print_error("Invalid command. See HELP for usage\n");
-          continue;
-        }
-
-        if (ems_show(out_fd, event_id)) print_error("Failed to show event\n");
-        break;
-
-      case CMD_LIST_EVENTS:
-        if (ems_list_events(out_fd)) print_error("Failed to list events\n");
-        break;
-
-      case CMD_WAIT:
-        if (parse_wait(in_fd, &delay, NULL) == -1) {
-          print_error("Invalid command. See HELP for usage\n");
-          continue;
-        }
-
-        if (delay > 0) {
-          printf("Waiting...\n");
-          sleep(delay);
-        }
-        break;
-
-      case CMD_INVALID:
-        print_error("Invalid command. See HELP for usage\n");
-        break;
-
-      case CMD_HELP:
-        printf(
-            "Available commands:\n"
-            "  CREATE <event_id> <num_rows> <num_columns>\n"
-            "  RESERVE <event_id> [(<x1>,<y1>) (<x2>,<y2>) ...]\n"
-            "  SHOW <event_id>\n"
-            "  LIST\n"
-            "  WAIT <delay_ms>\n"
-            "  HELP\n");
+  // Scheduling weight of the session, 1 unless given
+  unsigned long weight = 0;
+  if (argc >= 6) {
+    char* weight_end;
+    weight = strtoul(argv[5], &weight_end, 10);
+    if (*weight_end != '\0' || weight == 0 || weight > SESSION_MAX_WEIGHT) {
+      fprintf(stderr, "The weight must be between 1 and %d.\n", SESSION_MAX_WEIGHT);
+      return 1;
+    }
+  }
 
-        break;
+  // Timeout of each operation, none unless given
+  unsigned long timeout_ms = 0;
+  if (argc == 7) {
+    char* timeout_end;
+    timeout_ms = strtoul(argv[6], &timeout_end, 10);
+    if (*timeout_end != '\0' || timeout_ms > UINT_MAX) {
+      fprintf(stderr, "The timeout must be a number of milliseconds, 0 for none.\n");
+      return 1;
+    }
+  }
 
-      case CMD_EMPTY:
-        break;
+  // Set up communication with the EMS server
+  struct EmsSession* session = ems_setup(argv[1], argv[2], argv[3], (unsigned int)weight);
+  if (session == NULL) {
+    print_error("Failed to set up EMS\n");
+    return 1;
+  }
+  ems_set_timeout(session, (unsigned int)timeout_ms);
 
-      case EOC:
-        if (close(in_fd) == -1) {
-          fprintf(stderr, "Failed to close input file. Path: %s\n", argv[4]);
-          return 1;
-        }
-        if (close(out_fd) == -1) {
-          fprintf(stderr, "Failed to close output file. Path: %s\n", out_path);
-          return 1;
-        }
-        if (ems_quit()) {
-          print_error("Failed to quit EMS\n");
-          return 1;
-        }
-        return 0;
-    }
+  int failed = jobs_run(session, argv[4], NULL);
+  if (ems_quit(session)) {
+    print_error("Failed to quit EMS\n");
+    return 1;
   }
-}
\ No newline at end of file
+  return failed;
+}
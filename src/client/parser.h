@@ -3,11 +3,14 @@
 
 #include <stddef.h>
 
+#include "common/io.h"
+
 enum Command {
   CMD_CREATE,
   CMD_RESERVE,
   CMD_SHOW,
   CMD_LIST_EVENTS,
+  CMD_STATS,
   CMD_WAIT,
   CMD_HELP,
   CMD_EMPTY,
@@ -15,39 +18,63 @@ enum Command {
   EOC  // End of commands
 };
 
+/**
+ * @struct JobCommand
+ * @brief A command of a .jobs file with its arguments decoded.
+ */
+struct JobCommand {
+  enum Command command;   // The command
+  unsigned int event_id;  // Event of a CREATE, RESERVE or SHOW
+  size_t num_rows;        // Rows of a CREATE
+  size_t num_cols;        // Columns of a CREATE
+  size_t num_coords;      // Seats of a RESERVE
+  size_t *xs;             // Rows of the seats of a RESERVE
+  size_t *ys;             // Columns of the seats of a RESERVE
+  unsigned int delay;     // Delay of a WAIT
+};
+
 /// Reads a line and returns the corresponding command.
-/// @param fd File descriptor to read from.
+/// @param reader Reader over the .jobs file.
 /// @return The command read.
-enum Command get_next(int fd);
+enum Command get_next(struct Reader *reader);
 
 /// Parses a CREATE command.
-/// @param fd File descriptor to read from.
+/// @param reader Reader over the .jobs file.
 /// @param event_id Pointer to the variable to store the event ID in.
 /// @param num_rows Pointer to the variable to store the number of rows in.
 /// @param num_cols Pointer to the variable to store the number of columns in.
 /// @return 0 if the command was parsed successfully, 1 otherwise.
-int parse_create(int fd, unsigned int *event_id, size_t *num_rows, size_t *num_cols);
+int parse_create(struct Reader *reader, unsigned int *event_id, size_t *num_rows, size_t *num_cols);
 
 /// Parses a RESERVE command.
-/// @param fd File descriptor to read from.
+/// @param reader Reader over the .jobs file.
 /// @param max Maximum number of coordinates to read.
 /// @param event_id Pointer to the variable to store the event ID in.
 /// @param xs Pointer to the array to store the X coordinates in.
 /// @param ys Pointer to the array to store the Y coordinates in.
 /// @return Number of coordinates read. 0 on failure.
-size_t parse_reserve(int fd, size_t max, unsigned int *event_id, size_t *xs, size_t *ys);
+size_t parse_reserve(struct Reader *reader, size_t max, unsigned int *event_id, size_t *xs, size_t *ys);
 
 /// Parses a SHOW command.
-/// @param fd File descriptor to read from.
+/// @param reader Reader over the .jobs file.
 /// @param event_id Pointer to the variable to store the event ID in.
 /// @return 0 if the command was parsed successfully, 1 otherwise.
-int parse_show(int fd, unsigned int *event_id);
+int parse_show(struct Reader *reader, unsigned int *event_id);
 
 /// Parses a WAIT command.
-/// @param fd File descriptor to read from.
+/// @param reader Reader over the .jobs file.
 /// @param delay Pointer to the variable to store the wait delay in.
 /// @param thread_id Pointer to the variable to store the thread ID in. May not be set.
 /// @return 0 if no thread was specified, 1 if a thread was specified, -1 on error.
-int parse_wait(int fd, unsigned int *delay, unsigned int *thread_id);
+int parse_wait(struct Reader *reader, unsigned int *delay, unsigned int *thread_id);
+
+/// Reads a line and decodes the command with its arguments. A command whose arguments are not valid is returned
+/// as CMD_INVALID.
+/// @param reader Reader over the .jobs file.
+/// @param command Pointer to the command to fill in.
+/// @param xs Array of MAX_RESERVATION_SIZE elements to store the X coordinates of a RESERVE in.
+/// @param ys Array of MAX_RESERVATION_SIZE elements to store the Y coordinates of a RESERVE in.
+/// @return The command read.
+enum Command parse_command(struct Reader *reader, struct JobCommand *command, size_t *xs, size_t *ys);
 
 #endif  // CLIENT_PARSER_H
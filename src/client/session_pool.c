@@ -0,0 +1,117 @@
+#include "session_pool.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "common/constants.h"
+#include "common/io.h"
+
+/**
+ * @struct EmsPool
+ * @brief Sessions to one server and the stack of those not checked out.
+ */
+struct EmsPool {
+  pthread_mutex_t lock;      // Protects the idle stack
+  pthread_cond_t released;   // Signaled when a session is returned
+  size_t size;               // Number of sessions
+  size_t idle_count;         // Sessions not checked out
+  struct EmsSession** idle;  // Sessions not checked out, the most recently returned last
+};
+
+/**
+ * Opens the sessions of a pool.
+ *
+ * @param pipe_prefix Prefix of the session pipe paths.
+ * @param server_pipe_path Path to the server pipe.
+ * @param size Number of sessions.
+ * @param weight Scheduling weight of each session, 0 for the default.
+ * @return The pool, or NULL if a session could not be opened.
+ */
+struct EmsPool* ems_pool_create(const char* pipe_prefix, const char* server_pipe_path, size_t size,
+                                unsigned int weight) {
+  struct EmsPool* pool = malloc(sizeof(struct EmsPool));
+  struct EmsSession** idle = calloc(size, sizeof(struct EmsSession*));
+  if (pool == NULL || idle == NULL || size == 0) {
+    print_error("Failed to allocate the session pool.\n");
+    free(pool);
+    free(idle);
+    return NULL;
+  }
+
+  pool->size = size;
+  pool->idle_count = 0;
+  pool->idle = idle;
+  pthread_mutex_init(&pool->lock, NULL);
+  pthread_cond_init(&pool->released, NULL);
+
+  for (size_t i = 0; i < size; i++) {
+    char req_pipe_path[MAX_PATH], resp_pipe_path[MAX_PATH];
+    int req_length = snprintf(req_pipe_path, MAX_PATH, "%s_%zu_req", pipe_prefix, i);
+    int resp_length = snprintf(resp_pipe_path, MAX_PATH, "%s_%zu_resp", pipe_prefix, i);
+    if (req_length < 0 || resp_length < 0 || resp_length >= MAX_PATH) {
+      print_error("The session pipe prefix is too long.\n");
+      ems_pool_destroy(pool);
+      return NULL;
+    }
+
+    struct EmsSession* session = ems_setup(req_pipe_path, resp_pipe_path, server_pipe_path, weight);
+    if (session == NULL) {
+      ems_pool_destroy(pool);
+      return NULL;
+    }
+    pool->idle[pool->idle_count++] = session;
+  }
+
+  return pool;
+}
+
+/**
+ * Checks out a session, waiting until one is free.
+ *
+ * @param pool The pool.
+ * @return The session.
+ */
+struct EmsSession* ems_pool_acquire(struct EmsPool* pool) {
+  pthread_mutex_lock(&pool->lock);
+  while (pool->idle_count == 0) {
+    pthread_cond_wait(&pool->released, &pool->lock);
+  }
+  struct EmsSession* session = pool->idle[--pool->idle_count];
+  pthread_mutex_unlock(&pool->lock);
+  return session;
+}
+
+/**
+ * Returns a session to its pool.
+ *
+ * @param pool The pool.
+ * @param session A session checked out of the pool.
+ */
+void ems_pool_release(struct EmsPool* pool, struct EmsSession* session) {
+  pthread_mutex_lock(&pool->lock);
+  pool->idle[pool->idle_count++] = session;
+  pthread_cond_signal(&pool->released);
+  pthread_mutex_unlock(&pool->lock);
+}
+
+/**
+ * Closes every session of a pool and frees it.
+ *
+ * @param pool The pool.
+ * @return 0 if every session was closed cleanly, 1 otherwise.
+ */
+int ems_pool_destroy(struct EmsPool* pool) {
+  int result = 0;
+  for (size_t i = 0; i < pool->idle_count; i++) {
+    if (ems_quit(pool->idle[i]) != 0) {
+      result = 1;
+    }
+  }
+
+  pthread_cond_destroy(&pool->released);
+  pthread_mutex_destroy(&pool->lock);
+  free(pool->idle);
+  free(pool);
+  return result;
+}
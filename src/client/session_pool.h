@@ -0,0 +1,36 @@
+#ifndef CLIENT_SESSION_POOL_H
+#define CLIENT_SESSION_POOL_H
+
+#include <stddef.h>
+
+#include "api.h"
+
+/// A fixed set of sessions to one server, which threads check out for a while and hand back, so that a process
+/// serving many requests keeps several sessions busy without opening one per request.
+struct EmsPool;
+
+/// Opens the sessions of a pool. Their pipes are named "<pipe prefix>_<n>_req" and "<pipe prefix>_<n>_resp".
+/// @param pipe_prefix Prefix of the session pipe paths.
+/// @param server_pipe_path Path to the server pipe.
+/// @param size Number of sessions.
+/// @param weight Scheduling weight of each session, 0 for the default.
+/// @return The pool, or NULL if a session could not be opened.
+struct EmsPool* ems_pool_create(const char* pipe_prefix, const char* server_pipe_path, size_t size,
+                                unsigned int weight);
+
+/// Checks out a session, waiting until one is free. The calling thread has it to itself until it returns it.
+/// @param pool The pool.
+/// @return The session.
+struct EmsSession* ems_pool_acquire(struct EmsPool* pool);
+
+/// Returns a session to its pool.
+/// @param pool The pool.
+/// @param session A session checked out of the pool.
+void ems_pool_release(struct EmsPool* pool, struct EmsSession* session);
+
+/// Closes every session of a pool and frees it. No session may be checked out.
+/// @param pool The pool.
+/// @return 0 if every session was closed cleanly, 1 otherwise.
+int ems_pool_destroy(struct EmsPool* pool);
+
+#endif  // CLIENT_SESSION_POOL_H
@@ -3,3 +3,63 @@
 #define MAX_JOB_FILE_NAME_SIZE 256
 #define MAX_SESSION_COUNT 2
 #define MAX_PATH 40
+
+#define SETUP_ACCEPTED 0              // Setup reply: the session was queued, its id follows
+#define SETUP_BUSY 3                  // Setup reply: every session slot is taken, retry later
+#define SETUP_REPLY_TIMEOUT_MS 5000   // How long a client waits for the setup reply
+#define SETUP_MAX_ATTEMPTS 8          // Setups sent before a client gives up on a busy server
+#define SETUP_BACKOFF_US 10000        // Initial delay between setup attempts, doubled on every retry
+#define SESSION_OPEN_TIMEOUT_MS 5000  // How long a session waits for the client to open its request pipe
+
+#define OP_OVERLOADED 4               // Operation reply: refused without running, the server is overloaded
+#define OP_EXPIRED 5                  // Operation reply: dropped without running, its deadline had passed
+
+#define STATS_OPS 4     // Operations a STATS reply breaks down: CREATE, RESERVE, SHOW and LIST
+#define STATS_PHASES 6  // Phases of each: queue wait, lookup, lock wait, execution, response write, and in total
+#define STATS_VALUES 5  // Values of each phase: operations timed, then p50, p99, p999 and max in nanoseconds
+
+#define SESSION_BUFFER_SIZE 4096    // Size of the input buffer, and initial size of the output buffer, of each session
+#define SHOW_SPLICE_MIN_SIZE 65536  // Seat maps of at least this many bytes are sent with vmsplice
+#define READER_BUFFER_SIZE 65536    // Bytes of a .jobs file read at a time by the client parser
+#define WRITER_BUFFER_SIZE 65536    // Bytes of SHOW and LIST output gathered before each write to a .out file or stdout
+
+#define ASYNC_MAX_IN_FLIGHT 256        // Operations a client session sends before it waits for the oldest reply
+#define ASYNC_MAX_REQUEST_BYTES 65536  // Request bytes a client session has in flight, at most a pipe's capacity
+
+#define WAL_ASYNC_SYNC_MS 10           // Interval between syncs of the write-ahead log in async durability mode
+#define WAL_SEGMENT_SIZE (64UL << 20)  // Bytes after which the write-ahead log moves on to a new segment file
+#define WAL_COMPACT_SEGMENTS 4         // Full log segments that trigger a checkpoint, which then removes them
+#define CHECKPOINT_INTERVAL_S 60       // Default interval between checkpoints of the state, taken once it changed
+#define CHECKPOINT_POLL_S 1            // Interval between checks of whether a checkpoint is due
+
+#define REPL_MAX_BACKLOG (64UL << 20)  // Bytes of changes queued for a follower before it is dropped as too far behind
+#define REPL_HEARTBEAT_MS 100          // Interval of heartbeats to idle followers, telling them how far behind they are
+#define REPL_RETRY_MS 100              // Interval between attempts of a follower to connect to its primary
+
+#define LOCK_TOP_EVENTS 5      // Most contended events the lock profiler reports
+#define TRACE_RING_SPANS 8192  // Spans each thread keeps for the trace, its oldest overwritten first
+
+#define SEAT_STORE_MAX_SIZE (1UL << 40)    // Address space reserved for the seat file, the most seats it can hold
+#define SEAT_STORE_GROW_SIZE (64UL << 20)  // Bytes the seat file grows by at a time
+#define SEAT_STORE_ALIGNMENT 64            // Alignment of seat maps smaller than a page in the seat file
+#define SEAT_COLD_AFTER_S 60               // Default time after which unused events in the seat file are paged out
+#define SEAT_SWEEP_INTERVAL_S 10           // Interval between checks for unused events in the seat file
+
+#define MAX_LIVE_SESSIONS 1024      // Default maximum number of sessions served at once
+#define SESSION_STACK_SIZE 65536    // Stack reserved for each session coroutine, committed as it is touched
+#define POLLER_RING_ENTRIES 64      // Submission queue entries of the io_uring shared by all workers
+#define POLLER_BATCH 64             // Events taken by the poller thread per epoll_wait call
+#define POLLER_TICK_MS 100          // Longest time between two checks of the session open timeouts
+#define SESSION_TURN_OPS 8          // Operations a session of weight 1 runs in a row before others get a turn
+#define SESSION_MAX_WEIGHT 16       // Largest scheduling weight a client may ask for at setup
+#define RESERVED_WRITE_WORKERS 1    // Default number of workers SHOW and LIST may not use, kept for reservations
+#define SHOW_PREEMPT_SEATS 1024     // Default seats copied by a SHOW between two chances for reservations to run
+#define SHOW_MAX_RESTARTS 4         // Times a SHOW starts over because of reservations before it stops yielding
+#define MAX_QUEUE_DELAY_US 0        // Default queueing delay above which work is refused as overloaded, 0 for never
+#define QUEUE_DELAY_SMOOTHING 8     // Weight of the history in the moving averages of queueing and service times
+
+#define POOL_SAMPLE_MS 100        // Interval between samples of the queue in adaptive pool mode
+#define POOL_GROW_WAIT_US 10000   // Average queue wait above which the adaptive pool grows
+#define POOL_IDLE_SAMPLES 20      // Samples in a row with idle workers before the adaptive pool shrinks
+
+#define SETUP_MESSAGE_SIZE (2 + 2 * MAX_PATH)  // op_code | request pipe path | response pipe path | weight
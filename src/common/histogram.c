@@ -0,0 +1,96 @@
+#include "histogram.h"
+
+#include <string.h>
+
+/**
+ * Returns the bucket of a value. Values below HISTOGRAM_SUB_BUCKETS have a bucket each; a larger value whose
+ * highest bit is bit b falls in one of the HISTOGRAM_SUB_BUCKETS buckets that split [2^b, 2^(b+1)) evenly.
+ */
+static size_t bucket_of(size_t value) {
+  if (value < HISTOGRAM_SUB_BUCKETS) {
+    return value;
+  }
+
+  size_t shift = 0;
+  while ((value >> shift) >= 2 * HISTOGRAM_SUB_BUCKETS) {
+    shift++;
+  }
+  return HISTOGRAM_SUB_BUCKETS * (shift + 1) + (value >> shift) - HISTOGRAM_SUB_BUCKETS;
+}
+
+/**
+ * Returns the largest value that falls in a bucket.
+ */
+static size_t bucket_upper_bound(size_t bucket) {
+  if (bucket < HISTOGRAM_SUB_BUCKETS) {
+    return bucket;
+  }
+
+  size_t shift = bucket / HISTOGRAM_SUB_BUCKETS - 1;
+  size_t lower = (HISTOGRAM_SUB_BUCKETS + bucket % HISTOGRAM_SUB_BUCKETS) << shift;
+  return lower + ((size_t)1 << shift) - 1;
+}
+
+/**
+ * Empties a histogram.
+ *
+ * @param histogram The histogram.
+ */
+void histogram_init(struct Histogram* histogram) { memset(histogram, 0, sizeof(struct Histogram)); }
+
+/**
+ * Records a value.
+ *
+ * @param histogram The histogram.
+ * @param value The value.
+ */
+void histogram_record(struct Histogram* histogram, size_t value) {
+  histogram->count++;
+  histogram->total += value;
+  if (value > histogram->max) {
+    histogram->max = value;
+  }
+  histogram->buckets[bucket_of(value)]++;
+}
+
+/**
+ * Adds the values recorded in one histogram to another.
+ *
+ * @param into The histogram to add to.
+ * @param from The histogram to add.
+ */
+void histogram_merge(struct Histogram* into, const struct Histogram* from) {
+  into->count += from->count;
+  into->total += from->total;
+  if (from->max > into->max) {
+    into->max = from->max;
+  }
+  for (size_t i = 0; i < HISTOGRAM_BUCKETS; i++) {
+    into->buckets[i] += from->buckets[i];
+  }
+}
+
+/**
+ * Returns the upper bound of the bucket holding a percentile, clamped to the largest value.
+ *
+ * @param histogram The histogram.
+ * @param percent The percentile, between 0 and 100.
+ * @return The percentile, or 0 if no value was recorded.
+ */
+size_t histogram_percentile(const struct Histogram* histogram, double percent) {
+  // Rank of the value, counting from 1
+  size_t target = (size_t)((double)histogram->count * percent / 100.0);
+  if ((double)target < (double)histogram->count * percent / 100.0 || target == 0) {
+    target++;
+  }
+
+  size_t seen = 0;
+  for (size_t i = 0; i < HISTOGRAM_BUCKETS && histogram->count > 0; i++) {
+    seen += histogram->buckets[i];
+    if (seen >= target) {
+      size_t bound = bucket_upper_bound(i);
+      return bound < histogram->max ? bound : histogram->max;
+    }
+  }
+  return histogram->max;
+}
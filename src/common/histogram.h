@@ -0,0 +1,44 @@
+#ifndef COMMON_HISTOGRAM_H
+#define COMMON_HISTOGRAM_H
+
+#include <stddef.h>
+
+#define HISTOGRAM_SUB_BUCKETS 16                                              // Buckets per power of two
+#define HISTOGRAM_BUCKETS (HISTOGRAM_SUB_BUCKETS + 60 * HISTOGRAM_SUB_BUCKETS)  // Enough for any size_t
+
+/**
+ * @struct Histogram
+ * @brief Distribution of a value, such as a latency in microseconds, kept in a fixed amount of memory. Values
+ * below HISTOGRAM_SUB_BUCKETS are counted exactly; larger ones fall in one of HISTOGRAM_SUB_BUCKETS buckets per
+ * power of two, so percentiles are off by at most 1/HISTOGRAM_SUB_BUCKETS. Not thread-safe: each thread records
+ * into its own histogram, and the histograms are merged to be read.
+ */
+struct Histogram {
+  size_t count;                       // Values recorded
+  size_t total;                       // Sum of the values
+  size_t max;                         // Largest value
+  size_t buckets[HISTOGRAM_BUCKETS];  // Values recorded in each bucket
+};
+
+/// Empties a histogram.
+/// @param histogram The histogram.
+void histogram_init(struct Histogram* histogram);
+
+/// Records a value.
+/// @param histogram The histogram.
+/// @param value The value.
+void histogram_record(struct Histogram* histogram, size_t value);
+
+/// Adds the values recorded in one histogram to another.
+/// @param into The histogram to add to.
+/// @param from The histogram to add.
+void histogram_merge(struct Histogram* into, const struct Histogram* from);
+
+/// Returns a value at least as large as the given percentage of the values recorded: the upper bound of the bucket
+/// holding the percentile, or the largest value if that is smaller.
+/// @param histogram The histogram.
+/// @param percent The percentile, between 0 and 100.
+/// @return The percentile, or 0 if no value was recorded.
+size_t histogram_percentile(const struct Histogram* histogram, double percent);
+
+#endif  // COMMON_HISTOGRAM_H
@@ -1,5 +1,6 @@
 #include "io.h"
 
+#include <fcntl.h>
 #include <limits.h>
 #include <stdlib.h>
 #include <string.h>
@@ -90,24 +91,135 @@ ssize_t my_write(int fd, const void* buffer, size_t size) {
 }
 
 /**
- * Parses an unsigned integer from a file descriptor.
+ * Syncs the directory holding a file, so that the file survives a crash once created or renamed.
+ *
+ * @param path Path to the file.
+ */
+void sync_directory(const char* path) {
+  char directory[PATH_MAX];
+  snprintf(directory, sizeof(directory), "%s", path);
+  char* slash = strrchr(directory, '/');
+  if (slash == NULL) {
+    strcpy(directory, ".");
+  } else {
+    slash[slash == directory] = '\0';
+  }
+
+  int fd = open(directory, O_RDONLY);
+  if (fd != -1) {
+    fsync(fd);
+    close(fd);
+  }
+}
+
+/**
+ * Sets up a reader over a file descriptor, with an empty buffer.
+ *
+ * @param reader The reader.
+ * @param fd The file descriptor to read from.
+ * @param buffer The buffer the reader fills.
+ * @param capacity The size of the buffer.
+ */
+void reader_init(struct Reader* reader, int fd, char* buffer, size_t capacity) {
+  reader->fd = fd;
+  reader->buffer = buffer;
+  reader->capacity = capacity;
+  reader->start = 0;
+  reader->end = 0;
+}
+
+/**
+ * Refills the buffer of a reader once every byte in it was returned.
+ *
+ * @param reader The reader.
+ * @return 1 if bytes were read, 0 at the end of the file, or -1 if an error occurred.
+ */
+static int reader_fill(struct Reader* reader) {
+  ssize_t bytes_read;
+  do {
+    bytes_read = read(reader->fd, reader->buffer, reader->capacity);
+  } while (bytes_read == -1 && errno == EINTR);
+
+  if (bytes_read <= 0) {
+    return bytes_read == 0 ? 0 : -1;
+  }
+
+  reader->start = 0;
+  reader->end = (size_t)bytes_read;
+  return 1;
+}
+
+/**
+ * Reads one byte, refilling the buffer when it is empty.
+ *
+ * @param reader The reader.
+ * @param ch Pointer to store the byte in.
+ * @return 1 if a byte was read, 0 at the end of the file, or -1 if an error occurred.
+ */
+int reader_getc(struct Reader* reader, char* ch) {
+  if (reader->start == reader->end) {
+    int filled = reader_fill(reader);
+    if (filled != 1) {
+      return filled;
+    }
+  }
+
+  *ch = reader->buffer[reader->start++];
+  return 1;
+}
+
+/**
+ * Reads up to size bytes, refilling the buffer as many times as needed.
+ *
+ * @param reader The reader.
+ * @param buffer The buffer to read into.
+ * @param size The number of bytes to read.
+ * @return The number of bytes read, fewer than size only at the end of the file, or -1 if an error occurred.
+ */
+ssize_t reader_read(struct Reader* reader, char* buffer, size_t size) {
+  size_t done = 0;
+  while (done < size) {
+    if (reader->start == reader->end) {
+      int filled = reader_fill(reader);
+      if (filled == -1) {
+        return -1;
+      }
+      if (filled == 0) {
+        break;
+      }
+    }
+
+    size_t count = reader->end - reader->start;
+    if (count > size - done) {
+      count = size - done;
+    }
+    memcpy(buffer + done, reader->buffer + reader->start, count);
+    reader->start += count;
+    done += count;
+  }
+
+  return (ssize_t)done;
+}
+
+/**
+ * Parses an unsigned integer from a reader.
  * 
- * This function reads characters from the file descriptor `fd` until it encounters
+ * This function reads characters from the reader until it encounters
  * a character that is not a digit. It then converts the characters read into an
  * unsigned integer and stores it in `value`. The character that caused the parsing
  * to stop is stored in `next`.
  * 
- * @param fd The file descriptor to read from.
+ * @param reader The reader to read from.
  * @param value Pointer to an unsigned int where the parsed value will be stored.
  * @param next Pointer to a char where the next non-digit character will be stored.
  * @return 0 if the parsing was successful, or 1 if an error occurred.
 */
-int parse_uint(int fd, unsigned int *value, char *next) {
+int parse_uint(struct Reader* reader, unsigned int *value, char *next) {
   char buf[16];
 
   int i = 0;
   while (1) {
-    ssize_t read_bytes = read(fd, buf + i, 1);
+    int read_bytes = reader_getc(reader, buf + i);
     if (read_bytes == -1) {
       return 1;
     } else if (read_bytes == 0) {
@@ -137,40 +249,47 @@ int parse_uint(int fd, unsigned int *value, char *next) {
 }
 
 /**
- * Parses an unsigned integer from a file descriptor.
+ * Formats an unsigned integer in decimal into the bytes that end at end, two digits per step from a table of the
+ * hundred digit pairs, so that a seat map of small numbers costs few divisions.
  *
- * This function reads characters from the file descriptor `fd` until it encounters
- * a character that is not a digit. It then converts the characters read into an
- * unsigned integer and stores it in `value`. The character that caused the parsing
- * to stop is stored in `next`.
- *
- * @param fd The file descriptor to read from.
- * @param value Pointer to an unsigned int where the parsed value will be stored.
- * @param next Pointer to a char where the next non-digit character will be stored.
- * @return 0 if the parsing was successful, or 1 if an error occurred.
+ * @param end One past the last byte to write; there must be room for 10 digits before it.
+ * @param value The value to format.
+ * @return Pointer to the first digit.
  */
-int print_uint(int fd, unsigned int value) {
-  char buffer[16];
-  size_t i = 16;
-
-  for (; value > 0; value /= 10) {
-    buffer[--i] = (char)('0' + (value % 10));
-  }
+static char* format_uint(char* end, unsigned int value) {
+  static const char pairs[201] =
+      "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+      "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+      "8081828384858687888990919293949596979899";
 
-  if (i == 16) {
-    buffer[--i] = '0';
+  char* start = end;
+  while (value >= 100) {
+    unsigned int pair = (value % 100) * 2;
+    value /= 100;
+    *--start = pairs[pair + 1];
+    *--start = pairs[pair];
   }
 
-  while (i < 16) {
-    ssize_t written = write(fd, buffer + i, 16 - i);
-    if (written == -1) {
-      return 1;
-    }
-
-    i += (size_t)written;
+  if (value >= 10) {
+    *--start = pairs[value * 2 + 1];
+    *--start = pairs[value * 2];
+  } else {
+    *--start = (char)('0' + value);
   }
+  return start;
+}
 
-  return 0;
+/**
+ * Prints an unsigned integer to a file descriptor, in a single write.
+ *
+ * @param fd The file descriptor to write to.
+ * @param value The value to print.
+ * @return 0 if the integer was written successfully, or 1 if an error occurred.
+ */
+int print_uint(int fd, unsigned int value) {
+  char buffer[16];
+  char* start = format_uint(buffer + sizeof(buffer), value);
+  return my_write(fd, start, (size_t)(buffer + sizeof(buffer) - start)) == -1;
 }
 
 /**
@@ -197,3 +316,95 @@ int print_str(int fd, const char *str) {
 
   return 0;
 }
+
+/**
+ * Sets up a writer over a file descriptor, with an empty buffer.
+ *
+ * @param writer The writer.
+ * @param fd The file descriptor to write to.
+ * @param buffer The buffer the writer fills.
+ * @param capacity The size of the buffer.
+ */
+void writer_init(struct Writer* writer, int fd, char* buffer, size_t capacity) {
+  writer->fd = fd;
+  writer->buffer = buffer;
+  writer->capacity = capacity;
+  writer->used = 0;
+}
+
+/**
+ * Writes the buffered bytes to the file descriptor and empties the buffer.
+ *
+ * @param writer The writer.
+ * @return 0 on success, or 1 if an error occurred.
+ */
+int writer_flush(struct Writer* writer) {
+  size_t used = writer->used;
+  writer->used = 0;
+  return used > 0 && my_write(writer->fd, writer->buffer, used) == -1;
+}
+
+/**
+ * Appends bytes to the buffer. Bytes that do not fit are written out with the buffer, and bytes that would not fit
+ * in an empty buffer are written straight to the file descriptor.
+ *
+ * @param writer The writer.
+ * @param data The bytes to append.
+ * @param size The number of bytes to append.
+ * @return 0 on success, or 1 if an error occurred.
+ */
+int writer_write(struct Writer* writer, const void* data, size_t size) {
+  if (size > writer->capacity - writer->used && writer_flush(writer) != 0) {
+    return 1;
+  }
+  if (size > writer->capacity) {
+    return my_write(writer->fd, data, size) == -1;
+  }
+
+  memcpy(writer->buffer + writer->used, data, size);
+  writer->used += size;
+  return 0;
+}
+
+/**
+ * Appends a string to the buffer.
+ *
+ * @param writer The writer.
+ * @param str The string to append.
+ * @return 0 on success, or 1 if an error occurred.
+ */
+int writer_str(struct Writer* writer, const char* str) { return writer_write(writer, str, strlen(str)); }
+
+/**
+ * Appends one character to the buffer.
+ *
+ * @param writer The writer.
+ * @param ch The character to append.
+ * @return 0 on success, or 1 if an error occurred.
+ */
+int writer_char(struct Writer* writer, char ch) {
+  if (writer->used == writer->capacity && writer_flush(writer) != 0) {
+    return 1;
+  }
+  writer->buffer[writer->used++] = ch;
+  return 0;
+}
+
+/**
+ * Appends an unsigned integer in decimal to the buffer.
+ *
+ * @param writer The writer.
+ * @param value The value to append.
+ * @return 0 on success, or 1 if an error occurred.
+ */
+int writer_uint(struct Writer* writer, unsigned int value) {
+  char digits[16];
+  char* start = format_uint(digits + sizeof(digits), value);
+  size_t length = (size_t)(digits + sizeof(digits) - start);
+  if (length > writer->capacity - writer->used && writer_flush(writer) != 0) {
+    return 1;
+  }
+  memcpy(writer->buffer + writer->used, start, length);
+  writer->used += length;
+  return 0;
+}
@@ -4,6 +4,31 @@
 #include <stddef.h>
 #include <sys/types.h>
 
+/**
+ * @struct Reader
+ * @brief Reads a file descriptor through a buffer, refilled a chunk at a time, so that parsing it byte by byte
+ * does not cost a system call per byte.
+ */
+struct Reader {
+  int fd;           // File descriptor read from
+  char* buffer;     // Buffer owned by the caller
+  size_t capacity;  // Size of the buffer
+  size_t start;     // Next byte to return
+  size_t end;       // End of the bytes read into the buffer
+};
+
+/**
+ * @struct Writer
+ * @brief Writes to a file descriptor through a buffer, written out when full and on writer_flush, so that output
+ * built a number and a separator at a time does not cost a system call for each.
+ */
+struct Writer {
+  int fd;           // File descriptor written to
+  char* buffer;     // Buffer owned by the caller
+  size_t capacity;  // Size of the buffer
+  size_t used;      // Bytes in the buffer not written yet
+};
+
 /// Prints an error message to stderr.
 /// @param msg The message to print.
 void print_error(const char* msg);
@@ -22,12 +47,36 @@ ssize_t my_write(int fd, const void* buffer, size_t size);
 /// @return The number of bytes read, or -1 if an error occurred.
 ssize_t my_read(int fd, void* buffer, size_t size);
 
-/// Parses an unsigned integer from the given file descriptor.
+/// Syncs the directory holding a file, so that the file, once created or renamed, survives a crash.
+/// @param path Path to the file.
+void sync_directory(const char* path);
+
+/// Sets up a reader over a file descriptor.
+/// @param reader The reader.
 /// @param fd The file descriptor to read from.
+/// @param buffer Buffer the reader fills, which must outlive it.
+/// @param capacity Size of the buffer, at least 1.
+void reader_init(struct Reader* reader, int fd, char* buffer, size_t capacity);
+
+/// Reads one byte.
+/// @param reader The reader.
+/// @param ch Pointer to store the byte in.
+/// @return 1 if a byte was read, 0 at the end of the file, or -1 if an error occurred.
+int reader_getc(struct Reader* reader, char* ch);
+
+/// Reads bytes until size bytes were read or the end of the file is reached, as read() does on a regular file.
+/// @param reader The reader.
+/// @param buffer The buffer to read into.
+/// @param size The number of bytes to read.
+/// @return The number of bytes read, or -1 if an error occurred.
+ssize_t reader_read(struct Reader* reader, char* buffer, size_t size);
+
+/// Parses an unsigned integer from the given reader.
+/// @param reader The reader to read from.
 /// @param value Pointer to the variable to store the value in.
 /// @param next Pointer to the variable to store the next character in.
 /// @return 0 if the integer was read successfully, 1 otherwise.
-int parse_uint(int fd, unsigned int *value, char *next);
+int parse_uint(struct Reader* reader, unsigned int *value, char *next);
 
 /// Prints an unsigned integer to the given file descriptor.
 /// @param fd The file descriptor to write to.
@@ -41,4 +90,41 @@ int print_uint(int fd, unsigned int value);
 /// @return 0 if the string was written successfully, 1 otherwise.
 int print_str(int fd, const char *str);
 
+/// Sets up a writer over a file descriptor.
+/// @param writer The writer.
+/// @param fd The file descriptor to write to.
+/// @param buffer Buffer the writer fills, which must outlive it.
+/// @param capacity Size of the buffer, at least 16 bytes.
+void writer_init(struct Writer* writer, int fd, char* buffer, size_t capacity);
+
+/// Writes the buffered bytes to the file descriptor.
+/// @param writer The writer.
+/// @return 0 on success, 1 if an error occurred.
+int writer_flush(struct Writer* writer);
+
+/// Appends bytes, writing the buffer out first if they do not fit in it.
+/// @param writer The writer.
+/// @param data The bytes to append.
+/// @param size The number of bytes to append.
+/// @return 0 on success, 1 if an error occurred.
+int writer_write(struct Writer* writer, const void* data, size_t size);
+
+/// Appends a string.
+/// @param writer The writer.
+/// @param str The string to append.
+/// @return 0 on success, 1 if an error occurred.
+int writer_str(struct Writer* writer, const char* str);
+
+/// Appends one character.
+/// @param writer The writer.
+/// @param ch The character to append.
+/// @return 0 on success, 1 if an error occurred.
+int writer_char(struct Writer* writer, char ch);
+
+/// Appends an unsigned integer in decimal.
+/// @param writer The writer.
+/// @param value The value to append.
+/// @return 0 on success, 1 if an error occurred.
+int writer_uint(struct Writer* writer, unsigned int value);
+
 #endif  // COMMON_IO_H
@@ -0,0 +1,114 @@
+#include "admission.h"
+
+#include <stdatomic.h>
+
+#include "common/constants.h"
+#include "scheduler.h"
+
+static size_t max_queue_delay = 0;
+
+// Moving average of the time admitted operations of each class took, and how many of them are running
+static atomic_size_t service_us[OP_CLASS_COUNT];
+static atomic_size_t running[OP_CLASS_COUNT];
+
+static atomic_size_t admitted = 0;
+static atomic_size_t overloaded = 0;
+static atomic_size_t expired = 0;
+static atomic_size_t setups_refused = 0;
+
+/**
+ * Returns the time from one instant to another in microseconds, which is negative if the second one comes first.
+ */
+static long long elapsed_us(const struct timespec* from, const struct timespec* to) {
+  return (to->tv_sec - from->tv_sec) * 1000000LL + (to->tv_nsec - from->tv_nsec) / 1000;
+}
+
+/**
+ * Sets up admission control.
+ *
+ * @param max_queue_delay_us Queueing delay above which new work is refused, 0 for no limit.
+ */
+void admission_init(size_t max_queue_delay_us) { max_queue_delay = max_queue_delay_us; }
+
+/**
+ * Returns 1 if the expected queueing delay is above the limit.
+ */
+static int queue_too_long(void) { return max_queue_delay > 0 && scheduler_queue_delay_us() > max_queue_delay; }
+
+/**
+ * Tells whether a new session should be refused because the queue is too long.
+ *
+ * @return 1 if it should be refused, 0 otherwise.
+ */
+int admission_refuse_setup(void) {
+  if (!queue_too_long()) {
+    return 0;
+  }
+  atomic_fetch_add(&setups_refused, 1);
+  return 1;
+}
+
+/**
+ * Decides whether an operation may run.
+ *
+ * Operations are only refused on the estimate of their class while another one of the class is running: that one
+ * refreshes the estimate, which would otherwise stay stale once every operation is refused.
+ *
+ * @param op_class Class of the operation.
+ * @param deadline When the client stops waiting for the reply, or NULL.
+ * @param admitted_at Pointer to store the time of the decision in.
+ * @return 0 if the operation may run, OP_OVERLOADED or OP_EXPIRED otherwise.
+ */
+int admission_check(enum OpClass op_class, const struct timespec* deadline, struct timespec* admitted_at) {
+  clock_gettime(CLOCK_MONOTONIC, admitted_at);
+  long long left_us = deadline != NULL ? elapsed_us(admitted_at, deadline) : 0;
+
+  if (deadline != NULL && left_us <= 0) {
+    atomic_fetch_add(&expired, 1);
+    return OP_EXPIRED;
+  }
+
+  if (queue_too_long() || (deadline != NULL && atomic_load(&running[op_class]) > 0 &&
+                           (long long)atomic_load(&service_us[op_class]) > left_us)) {
+    atomic_fetch_add(&overloaded, 1);
+    return OP_OVERLOADED;
+  }
+
+  atomic_fetch_add(&running[op_class], 1);
+  atomic_fetch_add(&admitted, 1);
+  return 0;
+}
+
+/**
+ * Records how long an admitted operation took.
+ *
+ * @param op_class Class of the operation.
+ * @param admitted_at When it was admitted.
+ */
+void admission_done(enum OpClass op_class, const struct timespec* admitted_at) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  long long took = elapsed_us(admitted_at, &now);
+  size_t took_us = took > 0 ? (size_t)took : 0;
+
+  // The first operation seeds the average; updates racing between workers are lost, which only smooths it further
+  size_t service = atomic_load(&service_us[op_class]);
+  if (service == 0) {
+    service = took_us;
+  }
+  atomic_store(&service_us[op_class], service - service / QUEUE_DELAY_SMOOTHING + took_us / QUEUE_DELAY_SMOOTHING);
+  atomic_fetch_sub(&running[op_class], 1);
+}
+
+/**
+ * Copies the admission counters.
+ *
+ * @param stats Pointer to store the counters in.
+ */
+void admission_get_stats(struct AdmissionStats* stats) {
+  stats->admitted = atomic_load(&admitted);
+  stats->overloaded = atomic_load(&overloaded);
+  stats->expired = atomic_load(&expired);
+  stats->setups_refused = atomic_load(&setups_refused);
+  stats->queue_delay_us = scheduler_queue_delay_us();
+}
@@ -0,0 +1,49 @@
+#ifndef SERVER_ADMISSION_H
+#define SERVER_ADMISSION_H
+
+#include <stddef.h>
+#include <time.h>
+
+#include "lanes.h"
+
+/**
+ * @struct AdmissionStats
+ * @brief Counters of the work the server accepted, refused, or dropped.
+ */
+struct AdmissionStats {
+  size_t admitted;        // Operations allowed to run
+  size_t overloaded;      // Operations refused with OP_OVERLOADED
+  size_t expired;         // Operations dropped with OP_EXPIRED
+  size_t setups_refused;  // Setups answered with SETUP_BUSY because the queue was too long
+  size_t queue_delay_us;  // Current expected queueing delay
+};
+
+/// Sets up admission control.
+/// @param max_queue_delay_us Expected queueing delay above which new sessions and operations are refused, or 0 to
+///                           only refuse operations that would miss their deadline.
+void admission_init(size_t max_queue_delay_us);
+
+/// Tells whether the expected queueing delay is above the limit, counting a refused setup if it is.
+/// @return 1 if new work should be refused, 0 otherwise.
+int admission_refuse_setup(void);
+
+/// Decides whether an operation whose arguments were read may run.
+///
+/// An operation whose deadline has passed is dropped. One is refused when the queue is longer than the limit,
+/// or when operations of its class recently took longer than the time left until its deadline.
+/// @param op_class Class of the operation.
+/// @param deadline CLOCK_MONOTONIC instant the client stops waiting for the reply, or NULL if it waits for ever.
+/// @param admitted_at Pointer to store the time of the decision in.
+/// @return 0 if the operation may run, OP_OVERLOADED or OP_EXPIRED otherwise.
+int admission_check(enum OpClass op_class, const struct timespec* deadline, struct timespec* admitted_at);
+
+/// Records that an admitted operation finished, to predict how long the next ones of its class take.
+/// @param op_class Class of the operation, as given to admission_check.
+/// @param admitted_at Time admission_check stored.
+void admission_done(enum OpClass op_class, const struct timespec* admitted_at);
+
+/// Copies the admission counters.
+/// @param stats Pointer to store the counters in.
+void admission_get_stats(struct AdmissionStats* stats);
+
+#endif  // SERVER_ADMISSION_H
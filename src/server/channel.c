@@ -0,0 +1,376 @@
+// vmsplice() is Linux-specific
+#define _GNU_SOURCE
+
+#include "channel.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "common/io.h"
+#include "poller.h"
+#include "uring.h"
+
+static enum IoEngine engine = IO_ENGINE_BLOCKING;
+
+/**
+ * Chooses the engine used by every channel.
+ *
+ * @param requested Engine asked for on the command line.
+ * @return The engine that will be used.
+ */
+enum IoEngine channel_engine_init(enum IoEngine requested) {
+  engine = IO_ENGINE_BLOCKING;
+  if (requested == IO_ENGINE_URING && uring_supported()) {
+    engine = IO_ENGINE_URING;
+  }
+
+  return engine;
+}
+
+/**
+ * Returns a printable name for an engine.
+ */
+const char* channel_engine_name(enum IoEngine io_engine) {
+  switch (io_engine) {
+    case IO_ENGINE_URING:
+      return "io_uring";
+    case IO_ENGINE_BLOCKING:
+      return "blocking";
+  }
+
+  return "unknown";
+}
+
+/**
+ * Reads from or writes to a pipe once, without waiting.
+ *
+ * errno is only read here. The function is kept out of line because the coroutines calling it may move to
+ * another carrier thread between two calls, and the compiler would otherwise keep using the errno of the
+ * previous thread.
+ *
+ * @param fd File descriptor.
+ * @param buffer Buffer to read into or write from.
+ * @param size Number of bytes.
+ * @param write_op 1 to write, 0 to read.
+ * @return The number of bytes transferred, or a negative errno.
+ */
+__attribute__((noinline)) static ssize_t transfer(int fd, void* buffer, size_t size, int write_op) {
+  ssize_t done;
+  do {
+    done = write_op ? write(fd, buffer, size) : read(fd, buffer, size);
+  } while (done == -1 && errno == EINTR);
+
+  return done == -1 ? -errno : done;
+}
+
+/**
+ * Waits for the client to open its end of the request pipe, then prepares a channel over the session's
+ * pipes.
+ *
+ * The request pipe is still non-blocking, as the admission thread opened it. A client that sends nothing
+ * within SESSION_OPEN_TIMEOUT_MS is kept if it holds the pipe open: reading then reports that no data is
+ * available yet, whereas a pipe nobody opened for writing reads as end-of-file.
+ *
+ * With the blocking engine the pipes stay non-blocking, so a system call that would block returns and the
+ * coroutine waits on the poller instead. io_uring waits for the pipes itself, and would fail such
+ * operations right away instead, so the pipes are made blocking.
+ *
+ * @param channel Pointer to the channel to initialize.
+ * @param request_fd Request pipe, opened for reading.
+ * @param response_fd Response pipe, opened for writing.
+ * @return 0 on success, 1 if the client never opened its request pipe or the pipes could not be configured.
+ */
+int channel_open(struct Channel* channel, int request_fd, int response_fd) {
+  channel->request_fd = request_fd;
+  channel->response_fd = response_fd;
+  channel->input_start = 0;
+  channel->input_end = 0;
+  channel->output = NULL;
+  channel->output_size = 0;
+  channel->output_capacity = 0;
+
+  if (poller_wait(request_fd, EPOLLIN, SESSION_OPEN_TIMEOUT_MS) != 0) {
+    ssize_t first = transfer(request_fd, channel->input, 1, 0);
+    if (first != -EAGAIN && first != 1) {
+      return 1;
+    }
+
+    // The request may have started to arrive right after the timeout
+    channel->input_end = first == 1 ? 1 : 0;
+  }
+
+  int flags = engine == IO_ENGINE_URING ? 0 : O_NONBLOCK;
+  if (fcntl(request_fd, F_SETFL, flags) == -1 || fcntl(response_fd, F_SETFL, flags) == -1) {
+    print_error("Error configuring session pipes.\n");
+    return 1;
+  }
+
+  return 0;
+}
+
+void channel_destroy(struct Channel* channel) {
+  free(channel->output);
+  channel->output = NULL;
+  channel->output_capacity = 0;
+}
+
+/**
+ * Writes bytes to the response pipe, bypassing the output buffer.
+ *
+ * @return 0 on success, 1 on failure.
+ */
+static int send_bytes(struct Channel* channel, const char* buffer, size_t size) {
+  while (size > 0) {
+    ssize_t written;
+    if (engine == IO_ENGINE_URING) {
+      struct PollerOp op = {1, channel->response_fd, (void*)buffer, size, 0, 0, NULL};
+      if (poller_submit(&op, 1) != 0) {
+        return 1;
+      }
+      written = op.result;
+    } else {
+      written = transfer(channel->response_fd, (void*)buffer, size, 1);
+      if (written == -EAGAIN) {
+        if (poller_wait(channel->response_fd, EPOLLOUT, -1) != 0) {
+          return 1;
+        }
+        continue;
+      }
+    }
+
+    if (written <= 0) {
+      return 1;
+    }
+
+    buffer += written;
+    size -= (size_t)written;
+  }
+
+  return 0;
+}
+
+/**
+ * Writes the pending reply to the response pipe.
+ *
+ * @param channel Pointer to the channel.
+ * @return 0 on success, 1 on failure.
+ */
+int channel_flush(struct Channel* channel) {
+  if (channel->output_size == 0) {
+    return 0;
+  }
+
+  size_t size = channel->output_size;
+  channel->output_size = 0;
+  return send_bytes(channel, channel->output, size);
+}
+
+/**
+ * Sends the pending reply and reads the next bytes from the request pipe into the empty input buffer.
+ *
+ * With io_uring the write and the read are linked in a single submission, so the kernel only starts the
+ * read once the reply went out, and the coroutine is resumed once both completed.
+ *
+ * @return The number of bytes read, 0 if the client closed the pipe, or -1 on error.
+ */
+static ssize_t fill(struct Channel* channel) {
+  channel->input_start = 0;
+  channel->input_end = 0;
+
+  ssize_t bytes_read;
+  if (engine == IO_ENGINE_BLOCKING) {
+    if (channel_flush(channel) != 0) {
+      return -1;
+    }
+
+    while ((bytes_read = transfer(channel->request_fd, channel->input, SESSION_BUFFER_SIZE, 0)) == -EAGAIN) {
+      if (poller_wait(channel->request_fd, EPOLLIN, -1) != 0) {
+        return -1;
+      }
+    }
+  } else {
+    size_t pending = channel->output_size;
+    struct PollerOp ops[2];
+    unsigned count = 0;
+    if (pending > 0) {
+      ops[count++] = (struct PollerOp){1, channel->response_fd, channel->output, pending, 1, 0, NULL};
+    }
+    struct PollerOp* read_op = &ops[count];
+    ops[count++] = (struct PollerOp){0, channel->request_fd, channel->input, SESSION_BUFFER_SIZE, 0, 0, NULL};
+
+    if (poller_submit(ops, count) != 0) {
+      return -1;
+    }
+
+    if (pending > 0) {
+      if (ops[0].result < 0) {
+        return -1;
+      }
+
+      channel->output_size = 0;
+
+      // A short write cancels the linked read, so send the rest of the reply and read again
+      if ((size_t)ops[0].result < pending) {
+        size_t written = (size_t)ops[0].result;
+        if (send_bytes(channel, channel->output + written, pending - written) != 0 ||
+            poller_submit(read_op, 1) != 0) {
+          return -1;
+        }
+      }
+    }
+
+    bytes_read = read_op->result;
+  }
+
+  if (bytes_read < 0) {
+    return -1;
+  }
+
+  channel->input_end = (size_t)bytes_read;
+  return bytes_read;
+}
+
+/**
+ * Reads data from the request pipe, with the same semantics as my_read. Small reads are served from the
+ * input buffer, which is only refilled once it is empty.
+ *
+ * @param channel Pointer to the channel.
+ * @param buffer The buffer to read into.
+ * @param size The number of bytes to read.
+ * @return The number of bytes read, less than size if the client closed the pipe, or -1 on error.
+ */
+ssize_t channel_read(struct Channel* channel, void* buffer, size_t size) {
+  size_t done = 0;
+  while (done < size) {
+    if (channel->input_start == channel->input_end) {
+      ssize_t bytes_read = fill(channel);
+      if (bytes_read < 0) {
+        return -1;
+      }
+
+      // The client closed the pipe
+      if (bytes_read == 0) {
+        break;
+      }
+    }
+
+    size_t available = channel->input_end - channel->input_start;
+    size_t count = available < size - done ? available : size - done;
+    memcpy((char*)buffer + done, channel->input + channel->input_start, count);
+    channel->input_start += count;
+    done += count;
+  }
+
+  return (ssize_t)done;
+}
+
+/**
+ * Adds data to the pending reply, growing the output buffer when it would not fit.
+ *
+ * @param channel Pointer to the channel.
+ * @param buffer The buffer to write from.
+ * @param size The number of bytes to write.
+ * @return The number of bytes written, or -1 on error.
+ */
+ssize_t channel_write(struct Channel* channel, const void* buffer, size_t size) {
+  if (channel->output_size + size > channel->output_capacity) {
+    size_t capacity = channel->output_capacity > 0 ? channel->output_capacity : SESSION_BUFFER_SIZE;
+    while (capacity < channel->output_size + size) {
+      capacity *= 2;
+    }
+
+    char* output = realloc(channel->output, capacity);
+    if (output == NULL) {
+      print_error("Error allocating reply buffer.\n");
+      return -1;
+    }
+    channel->output = output;
+    channel->output_capacity = capacity;
+  }
+
+  memcpy(channel->output + channel->output_size, buffer, size);
+  channel->output_size += size;
+  return (ssize_t)size;
+}
+
+size_t channel_pending(const struct Channel* channel) { return channel->output_size; }
+
+void channel_truncate(struct Channel* channel, size_t size) {
+  if (size < channel->output_size) {
+    channel->output_size = size;
+  }
+}
+
+#ifdef SPLICE_F_GIFT
+/**
+ * Splices pages into a pipe once, without waiting. Kept out of line for the same reason as transfer.
+ *
+ * @return The number of bytes spliced, or a negative errno.
+ */
+__attribute__((noinline)) static ssize_t splice_pages(int fd, const void* pages, size_t size, unsigned int flags) {
+  struct iovec iov = {.iov_base = (void*)pages, .iov_len = size};
+  ssize_t spliced;
+  do {
+    spliced = vmsplice(fd, &iov, 1, flags | SPLICE_F_NONBLOCK);
+  } while (spliced == -1 && errno == EINTR);
+
+  return spliced == -1 ? -errno : spliced;
+}
+#endif
+
+/**
+ * Sends a buffer by mapping its pages into the response pipe instead of copying them. Whole pages are
+ * gifted to the kernel, so a reader splicing them on can take them over; the last partial page is not.
+ *
+ * Builds without vmsplice, and response pipes it rejects, fall back to a plain write.
+ *
+ * @param channel Pointer to the channel.
+ * @param pages Page-aligned buffer, which must never be written again.
+ * @param size Number of bytes to send.
+ * @return 0 on success, 1 on failure.
+ */
+int channel_splice(struct Channel* channel, const void* pages, size_t size) {
+  if (channel_flush(channel) != 0) {
+    return 1;
+  }
+
+#ifdef SPLICE_F_GIFT
+  size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+  size_t done = 0;
+  while (done < size) {
+    size_t remaining = size - done;
+    unsigned int flags = 0;
+    if (done % page_size == 0 && remaining >= page_size) {
+      remaining -= remaining % page_size;
+      flags = SPLICE_F_GIFT;
+    }
+
+    ssize_t spliced = splice_pages(channel->response_fd, (const char*)pages + done, remaining, flags);
+    if (spliced == -EAGAIN) {
+      if (poller_wait(channel->response_fd, EPOLLOUT, -1) != 0) {
+        return 1;
+      }
+      continue;
+    }
+    if (spliced < 0) {
+      if (done == 0 && (spliced == -EINVAL || spliced == -ENOSYS)) {
+        break;
+      }
+      return 1;
+    }
+
+    done += (size_t)spliced;
+  }
+
+  if (done == size) {
+    return 0;
+  }
+#endif
+
+  return send_bytes(channel, pages, size);
+}
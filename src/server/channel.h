@@ -0,0 +1,98 @@
+#ifndef SERVER_CHANNEL_H
+#define SERVER_CHANNEL_H
+
+#include <stddef.h>
+#include <sys/types.h>
+
+#include "common/constants.h"
+
+/**
+ * @enum IoEngine
+ * @brief How session pipes are read and written.
+ */
+enum IoEngine {
+  IO_ENGINE_BLOCKING,  // Non-blocking read and write system calls, waiting on the poller when they would block
+  IO_ENGINE_URING,     // Batched io_uring submissions, completed by the poller
+};
+
+/**
+ * @struct Channel
+ * @brief Buffered reads from a session's request pipe and writes to its response pipe.
+ *
+ * Channels are used from session coroutines: whenever a pipe is not ready, the coroutine is suspended and
+ * its carrier thread moves on to another session. Replies are kept in the output buffer, which grows to
+ * hold them whole, until the session needs more input. Writing a reply therefore never suspends the
+ * coroutine, so operations can build it while holding event locks, and the reply and the read of the next
+ * request go out together: as a linked write and read in one io_uring submission, or back to back with the
+ * blocking engine.
+ */
+struct Channel {
+  int request_fd;                       // Request pipe, read by the session
+  int response_fd;                      // Response pipe, written by the session
+  char input[SESSION_BUFFER_SIZE];      // Bytes read from the request pipe
+  size_t input_start;                   // First byte of input not consumed yet
+  size_t input_end;                     // End of the bytes read into input
+  char* output;                         // Reply bytes not written yet
+  size_t output_size;                   // Number of bytes in output
+  size_t output_capacity;               // Size of the output allocation
+};
+
+/// Chooses the engine used by every channel. Falls back to the blocking engine when io_uring is not available.
+/// @param requested Engine asked for on the command line.
+/// @return The engine that will be used.
+enum IoEngine channel_engine_init(enum IoEngine requested);
+
+/// Returns a printable name for an engine.
+const char* channel_engine_name(enum IoEngine engine);
+
+/// Waits for the client to open its end of the request pipe, then prepares a channel over the session's pipes,
+/// switching them to the mode the engine needs. Suspends the calling coroutine while waiting.
+/// @param channel Pointer to the channel to initialize.
+/// @param request_fd Request pipe, opened for reading in non-blocking mode.
+/// @param response_fd Response pipe, opened for writing.
+/// @return 0 if the channel was opened successfully, 1 if the client never opened the pipe or on failure.
+int channel_open(struct Channel* channel, int request_fd, int response_fd);
+
+/// Frees the buffers of a channel. The pipes are left open.
+/// @param channel Pointer to the channel.
+void channel_destroy(struct Channel* channel);
+
+/// Reads data from the request pipe, sending any pending reply first if more input has to be read.
+/// Suspends the calling coroutine until the data arrives.
+/// @param channel Pointer to the channel.
+/// @param buffer The buffer to read into.
+/// @param size The number of bytes to read.
+/// @return The number of bytes read, less than size if the client closed the pipe, or -1 on error.
+ssize_t channel_read(struct Channel* channel, void* buffer, size_t size);
+
+/// Adds data to the pending reply. Never suspends the calling coroutine.
+/// @param channel Pointer to the channel.
+/// @param buffer The buffer to write from.
+/// @param size The number of bytes to write.
+/// @return The number of bytes written, or -1 on error.
+ssize_t channel_write(struct Channel* channel, const void* buffer, size_t size);
+
+/// Returns the number of reply bytes not written to the response pipe yet.
+/// @param channel Pointer to the channel.
+size_t channel_pending(const struct Channel* channel);
+
+/// Drops the end of the pending reply, down to a size returned by channel_pending earlier. Nothing may have
+/// been read from the channel since, or the reply may already have been sent.
+/// @param channel Pointer to the channel.
+/// @param size Number of bytes to keep.
+void channel_truncate(struct Channel* channel, size_t size);
+
+/// Writes the pending reply to the response pipe, suspending the calling coroutine while the pipe is full.
+/// @param channel Pointer to the channel.
+/// @return 0 on success, 1 on failure.
+int channel_flush(struct Channel* channel);
+
+/// Writes the pending reply, then sends a buffer to the response pipe with vmsplice, without copying it.
+/// @param channel Pointer to the channel.
+/// @param pages Page-aligned buffer. The kernel keeps referencing its pages after the call returns, so it
+///              must never be written again.
+/// @param size Number of bytes to send.
+/// @return 0 on success, 1 on failure.
+int channel_splice(struct Channel* channel, const void* pages, size_t size);
+
+#endif  // SERVER_CHANNEL_H
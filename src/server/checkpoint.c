@@ -0,0 +1,317 @@
+#include "checkpoint.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "common/constants.h"
+#include "common/io.h"
+#include "lockstats.h"
+#include "snapshot.h"
+
+static void* mapped = NULL;  // The loaded checkpoint, which the seats of its events point into
+static size_t mapped_size = 0;
+
+/**
+ * Copies the seats of an event to the checkpoint, with its reservation count and LSN as of the same instant.
+ *
+ * @param out Writer over the checkpoint, positioned at the seats of the event.
+ * @param event The event.
+ * @param entry Entry of the event to fill in.
+ * @return 0 on success, 1 on failure.
+ */
+static int write_seats(struct Writer* out, struct Event* event, struct CheckpointEvent* entry) {
+  size_t count = event->rows * event->cols;
+  size_t size = count * sizeof(unsigned int);
+
+  // Small seat maps are copied straight into the buffer, which is flushed first so nothing is written under the mutex
+  if (size < SHOW_SPLICE_MIN_SIZE && size <= out->capacity) {
+    if (size > out->capacity - out->used && writer_flush(out) != 0) {
+      return 1;
+    }
+    if (lockstats_mutex_lock(&event->mutex, &event->lock_stats) != 0) {
+      print_error("Error locking mutex.\n");
+      return 1;
+    }
+    memcpy(out->buffer + out->used, event->data, size);
+    out->used += size;
+    entry->reservations = event->reservations;
+    entry->lsn = event->lsn;
+    if (lockstats_mutex_unlock(&event->mutex, &event->lock_stats) != 0) {
+      print_error("Error unlocking mutex.\n");
+    }
+    return 0;
+  }
+
+  // Large ones are written from the snapshot SHOW replies share, which stays valid once the mutex is released
+  if (lockstats_mutex_lock(&event->mutex, &event->lock_stats) != 0) {
+    print_error("Error locking mutex.\n");
+    return 1;
+  }
+  if (event->snapshot == NULL) {
+    event->snapshot = snapshot_create(event->data, count);
+  }
+  entry->reservations = event->reservations;
+  entry->lsn = event->lsn;
+
+  struct SeatSnapshot* snapshot = event->snapshot;
+  if (snapshot == NULL) {
+    int failed = writer_write(out, event->data, size);
+    if (lockstats_mutex_unlock(&event->mutex, &event->lock_stats) != 0) {
+      print_error("Error unlocking mutex.\n");
+    }
+    return failed;
+  }
+
+  snapshot_acquire(snapshot);
+  if (lockstats_mutex_unlock(&event->mutex, &event->lock_stats) != 0) {
+    print_error("Error unlocking mutex.\n");
+  }
+  int failed = writer_write(out, snapshot->seats, size);
+  snapshot_release(snapshot);
+  return failed;
+}
+
+/**
+ * Writes the seats of every event after the table, then the table and the header, and syncs the file.
+ *
+ * @param fd File descriptor of the new checkpoint.
+ * @param head First node of the events.
+ * @param tail Last node of the events.
+ * @param header Header to complete with the size and the largest LSN, and to write.
+ * @param table Table to fill in and write, with an entry per event.
+ * @return 0 on success, 1 on failure.
+ */
+static int write_checkpoint(int fd, struct ListNode* head, struct ListNode* tail, struct CheckpointHeader* header,
+                            struct CheckpointEvent* table) {
+  uint64_t offset = sizeof(*header) + header->events * sizeof(*table);
+  if (lseek(fd, (off_t)offset, SEEK_SET) == -1) {
+    return 1;
+  }
+
+  char buffer[WRITER_BUFFER_SIZE];
+  struct Writer out;
+  writer_init(&out, fd, buffer, sizeof(buffer));
+
+  size_t i = 0;
+  for (struct ListNode* node = tail != NULL ? head : NULL; node != NULL; node = node == tail ? NULL : node->next) {
+    struct Event* event = node->event;
+    struct CheckpointEvent* entry = &table[i++];
+    entry->id = event->id;
+    entry->rows = event->rows;
+    entry->cols = event->cols;
+    entry->seats_offset = offset;
+    if (write_seats(&out, event, entry) != 0) {
+      return 1;
+    }
+
+    offset += event->rows * event->cols * sizeof(unsigned int);
+    if (entry->lsn > header->max_lsn) {
+      header->max_lsn = entry->lsn;
+    }
+  }
+
+  header->size = offset;
+  if (writer_flush(&out) != 0 || lseek(fd, 0, SEEK_SET) == -1 || my_write(fd, header, sizeof(*header)) == -1 ||
+      (header->events > 0 && my_write(fd, table, header->events * sizeof(*table)) == -1)) {
+    return 1;
+  }
+  return fdatasync(fd) != 0;
+}
+
+/**
+ * Writes a checkpoint of the events from head to tail next to the current one, then renames it over it, so a crash
+ * leaves either checkpoint whole.
+ *
+ * @param path Path to the checkpoint.
+ * @param head First node of the events.
+ * @param tail Last node of the events, or NULL if there are none.
+ * @param lsn LSN up to which every change is applied to the events.
+ * @param stats Pointer to store what the checkpoint held in, or NULL.
+ * @return 0 on success, 1 on failure.
+ */
+int checkpoint_write(const char* path, struct ListNode* head, struct ListNode* tail, uint64_t lsn,
+                     struct CheckpointStats* stats) {
+  struct timespec start, end;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  // Events are only ever appended, so the nodes up to the tail stay put while they are copied
+  size_t count = 0;
+  for (struct ListNode* node = tail != NULL ? head : NULL; node != NULL; node = node == tail ? NULL : node->next) {
+    count++;
+  }
+
+  char temp_path[PATH_MAX];
+  if (snprintf(temp_path, sizeof(temp_path), "%s.tmp", path) >= (int)sizeof(temp_path)) {
+    print_error("The checkpoint path is too long.\n");
+    return 1;
+  }
+
+  struct CheckpointEvent* table = calloc(count > 0 ? count : 1, sizeof(struct CheckpointEvent));
+  int fd = open(temp_path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+  if (table == NULL || fd == -1) {
+    print_error("Failed to create the checkpoint.\n");
+    free(table);
+    if (fd != -1) {
+      close(fd);
+      unlink(temp_path);
+    }
+    return 1;
+  }
+
+  // Changes after the LSN may be in the checkpoint too, so the largest LSN of an event is kept as well
+  struct CheckpointHeader header = {CHECKPOINT_MAGIC, CHECKPOINT_VERSION, 0, lsn, lsn, count, 0};
+  int failed = write_checkpoint(fd, head, tail, &header, table);
+  failed |= close(fd) != 0;
+  free(table);
+  if (failed || rename(temp_path, path) != 0) {
+    print_error("Failed to write the checkpoint.\n");
+    unlink(temp_path);
+    return 1;
+  }
+  sync_directory(path);
+
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  if (stats != NULL) {
+    stats->events = count;
+    stats->bytes = (size_t)header.size;
+    stats->lsn = lsn;
+    stats->elapsed_us = (end.tv_sec - start.tv_sec) * 1000000L + (end.tv_nsec - start.tv_nsec) / 1000L;
+    stats->compacted = 0;
+  }
+  return 0;
+}
+
+/**
+ * Creates an event of a loaded checkpoint, with its seats in the mapping.
+ *
+ * @param entry Entry of the event.
+ * @return The event, or NULL on failure.
+ */
+static struct Event* map_event(const struct CheckpointEvent* entry) {
+  struct Event* event = malloc(sizeof(struct Event));
+  if (event == NULL) {
+    return NULL;
+  }
+
+  event->id = entry->id;
+  event->rows = (size_t)entry->rows;
+  event->cols = (size_t)entry->cols;
+  event->reservations = entry->reservations;
+  event->data = (unsigned int*)(void*)((char*)mapped + entry->seats_offset);
+  event->storage = SEATS_CHECKPOINT;
+  event->lsn = entry->lsn;
+  event->seq = 0;
+  event->snapshot = NULL;
+  atomic_init(&event->waiting, 0);
+  atomic_init(&event->last_used, 0);
+  atomic_init(&event->cold, 0);
+  lockstats_init(&event->lock_stats);
+  if (pthread_mutex_init(&event->mutex, NULL) != 0) {
+    free(event);
+    return NULL;
+  }
+  return event;
+}
+
+/**
+ * Checks that an entry of a checkpoint describes seats within the file.
+ *
+ * @param entry The entry.
+ * @param seats_start Offset where the seats start, after the table.
+ * @param size Size of the file.
+ * @return 1 if the entry is valid, 0 otherwise.
+ */
+static int valid_entry(const struct CheckpointEvent* entry, uint64_t seats_start, uint64_t size) {
+  if (entry->seats_offset < seats_start || entry->seats_offset > size ||
+      entry->seats_offset % sizeof(unsigned int) != 0) {
+    return 0;
+  }
+  uint64_t seats = (size - entry->seats_offset) / sizeof(unsigned int);
+  return entry->cols == 0 || entry->rows <= seats / entry->cols;
+}
+
+/**
+ * Maps a checkpoint and appends its events to a list, their seats pointing into the mapping.
+ *
+ * @param path Path to the checkpoint.
+ * @param list List to append the events to.
+ * @param lsn Pointer to store the LSN of the checkpoint in.
+ * @param max_lsn Pointer to store the largest LSN of a change in the checkpoint in.
+ * @return 0 on success or without a checkpoint, 1 on failure.
+ */
+int checkpoint_load(const char* path, struct EventList* list, uint64_t* lsn, uint64_t* max_lsn) {
+  *lsn = 0;
+  *max_lsn = 0;
+  int fd = open(path, O_RDONLY);
+  if (fd == -1) {
+    if (errno == ENOENT) {
+      return 0;
+    }
+    print_error("Failed to open the checkpoint.\n");
+    return 1;
+  }
+
+  struct stat info;
+  if (fstat(fd, &info) == -1 || (size_t)info.st_size < sizeof(struct CheckpointHeader)) {
+    print_error("The checkpoint is incomplete.\n");
+    close(fd);
+    return 1;
+  }
+
+  // Writable but private: a reservation copies the page it changes, and the file is never written
+  void* base = mmap(NULL, (size_t)info.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (base == MAP_FAILED) {
+    print_error("Failed to map the checkpoint.\n");
+    return 1;
+  }
+  mapped = base;
+  mapped_size = (size_t)info.st_size;
+
+  const struct CheckpointHeader* header = base;
+  uint64_t table_size = (mapped_size - sizeof(*header)) / sizeof(struct CheckpointEvent);
+  if (header->magic != CHECKPOINT_MAGIC || header->version != CHECKPOINT_VERSION || header->size != mapped_size ||
+      header->events > table_size) {
+    print_error("The checkpoint was written by another version or machine, or is damaged.\n");
+    return 1;
+  }
+
+  const struct CheckpointEvent* table = (const void*)(header + 1);
+  uint64_t seats_start = sizeof(*header) + header->events * sizeof(*table);
+  for (uint64_t i = 0; i < header->events; i++) {
+    if (!valid_entry(&table[i], seats_start, header->size)) {
+      print_error("The checkpoint is damaged.\n");
+      return 1;
+    }
+
+    struct Event* event = map_event(&table[i]);
+    if (event == NULL || append_to_list(list, event) != 0) {
+      print_error("Error allocating memory for event.\n");
+      free(event);
+      return 1;
+    }
+  }
+
+  *lsn = header->lsn;
+  *max_lsn = header->max_lsn;
+  return 0;
+}
+
+/**
+ * Unmaps the loaded checkpoint.
+ */
+void checkpoint_unload(void) {
+  if (mapped != NULL) {
+    munmap(mapped, mapped_size);
+    mapped = NULL;
+    mapped_size = 0;
+  }
+}
@@ -0,0 +1,77 @@
+#ifndef SERVER_CHECKPOINT_H
+#define SERVER_CHECKPOINT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "eventlist.h"
+
+#define CHECKPOINT_MAGIC 0x43534d45u  // "EMSC" when written in little-endian order
+#define CHECKPOINT_VERSION 1          // Version of the checkpoint format
+
+/**
+ * @struct CheckpointHeader
+ * @brief Header of a checkpoint file, followed by a CheckpointEvent per event and then by the seats of every event.
+ *
+ * Values are stored in the byte order and layout of the machine that wrote the file, so that the seats are used in
+ * place once the file is mapped.
+ */
+struct CheckpointHeader {
+  uint32_t magic;     // CHECKPOINT_MAGIC
+  uint16_t version;   // CHECKPOINT_VERSION
+  uint16_t reserved;  // Zero
+  uint64_t lsn;       // Every change up to this LSN is in the checkpoint
+  uint64_t max_lsn;   // Largest LSN of a change in the checkpoint; later ones may be too, for the events they changed
+  uint64_t events;    // Number of events
+  uint64_t size;      // Size of the file
+};
+
+/**
+ * @struct CheckpointEvent
+ * @brief An event of a checkpoint.
+ */
+struct CheckpointEvent {
+  uint32_t id;            // Event id
+  uint32_t reservations;  // Reservations made for the event
+  uint64_t rows;          // Number of rows
+  uint64_t cols;          // Number of columns
+  uint64_t lsn;           // LSN of the last change to the event in the checkpoint
+  uint64_t seats_offset;  // Offset of the rows * cols seats of the event in the file
+};
+
+/**
+ * @struct CheckpointStats
+ * @brief What a checkpoint held and how long it took.
+ */
+struct CheckpointStats {
+  size_t events;     // Events written
+  size_t bytes;      // Size of the file
+  uint64_t lsn;      // LSN up to which every change is in the checkpoint
+  long elapsed_us;   // Time taken to write and sync the file
+  size_t compacted;  // Segments of the write-ahead log removed since the checkpoint holds all of their changes
+};
+
+/// Writes the events from head to tail to a checkpoint, replacing the file at path once it is complete and synced.
+/// Each event is copied under its own mutex, so reservations only wait for the copy of their event.
+/// @param path Path to the checkpoint.
+/// @param head First node of the events.
+/// @param tail Last node of the events, or NULL if there are none.
+/// @param lsn LSN up to which every change is applied to the events.
+/// @param stats Pointer to store what the checkpoint held in, or NULL.
+/// @return 0 on success, 1 on failure, in which case the previous checkpoint is kept.
+int checkpoint_write(const char* path, struct ListNode* head, struct ListNode* tail, uint64_t lsn,
+                     struct CheckpointStats* stats);
+
+/// Maps a checkpoint and appends its events to a list. Their seats stay in the mapping, which is private, so pages
+/// are only read from the file once used and are copied the first time a reservation writes to them.
+/// @param path Path to the checkpoint.
+/// @param list List to append the events to.
+/// @param lsn Pointer to store the LSN up to which every change is in the checkpoint in, 0 without a checkpoint.
+/// @param max_lsn Pointer to store the largest LSN of a change in the checkpoint in, 0 without a checkpoint.
+/// @return 0 if the checkpoint was loaded or does not exist, 1 if it could not be mapped or is not valid.
+int checkpoint_load(const char* path, struct EventList* list, uint64_t* lsn, uint64_t* max_lsn);
+
+/// Unmaps the loaded checkpoint, once the events using it were freed.
+void checkpoint_unload(void);
+
+#endif  // SERVER_CHECKPOINT_H
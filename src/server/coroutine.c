@@ -0,0 +1,112 @@
+// MAP_ANONYMOUS and MAP_NORESERVE are not part of POSIX
+#define _DEFAULT_SOURCE
+
+#include "coroutine.h"
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "common/constants.h"
+#include "common/io.h"
+
+// Coroutine running on each carrier thread
+static _Thread_local struct Coroutine* current = NULL;
+
+/**
+ * Returns the coroutine running on the calling thread.
+ *
+ * Coroutines move between carrier threads when they are resumed, so the thread-local variable must be read
+ * again after every suspension. Keeping the access out of line stops the compiler from reusing the address of
+ * another thread's variable.
+ */
+__attribute__((noinline)) struct Coroutine* coroutine_current(void) { return current; }
+
+/**
+ * First function run on a coroutine stack. Returning from it switches back to the caller context.
+ */
+static void trampoline(void) {
+  struct Coroutine* coroutine = coroutine_current();
+  coroutine->entry(coroutine->arg);
+
+  // The coroutine may have been resumed on a different thread than the one it started on
+  coroutine = coroutine_current();
+  coroutine->finished = 1;
+}
+
+/**
+ * Prepares a coroutine and maps its stack.
+ *
+ * The stack is reserved but not committed: only the pages the coroutine touches use memory. The lowest
+ * page is left inaccessible, so an overflow crashes instead of corrupting other memory.
+ *
+ * @param coroutine Pointer to the coroutine to initialize.
+ * @param entry Function to run.
+ * @param arg Argument of entry.
+ * @return 0 on success, 1 on failure.
+ */
+int coroutine_create(struct Coroutine* coroutine, void (*entry)(void*), void* arg) {
+  size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+  coroutine->stack_size = SESSION_STACK_SIZE;
+  coroutine->stack = mmap(NULL, coroutine->stack_size, PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if (coroutine->stack == MAP_FAILED) {
+    print_error("Error allocating coroutine stack.\n");
+    coroutine->stack = NULL;
+    return 1;
+  }
+
+  if (mprotect(coroutine->stack, page_size, PROT_NONE) != 0 || getcontext(&coroutine->context) != 0) {
+    print_error("Error preparing coroutine.\n");
+    munmap(coroutine->stack, coroutine->stack_size);
+    coroutine->stack = NULL;
+    return 1;
+  }
+
+  coroutine->context.uc_stack.ss_sp = coroutine->stack;
+  coroutine->context.uc_stack.ss_size = coroutine->stack_size;
+  coroutine->context.uc_link = &coroutine->caller;
+  makecontext(&coroutine->context, trampoline, 0);
+
+  coroutine->entry = entry;
+  coroutine->arg = arg;
+  coroutine->finished = 0;
+  coroutine->park = NULL;
+  coroutine->park_arg = NULL;
+  return 0;
+}
+
+void coroutine_destroy(struct Coroutine* coroutine) {
+  if (coroutine->stack != NULL) {
+    munmap(coroutine->stack, coroutine->stack_size);
+    coroutine->stack = NULL;
+  }
+}
+
+/**
+ * Switches to a coroutine, then runs its park function once it suspends itself.
+ *
+ * @param coroutine Pointer to the coroutine.
+ * @return 1 if the coroutine finished, 0 if it suspended itself.
+ */
+int coroutine_resume(struct Coroutine* coroutine) {
+  current = coroutine;
+  swapcontext(&coroutine->caller, &coroutine->context);
+  current = NULL;
+
+  if (coroutine->finished) {
+    return 1;
+  }
+
+  // Only now can another thread safely resume the coroutine
+  void (*park)(void*) = coroutine->park;
+  coroutine->park = NULL;
+  park(coroutine->park_arg);
+  return 0;
+}
+
+void coroutine_yield(void (*park)(void*), void* arg) {
+  struct Coroutine* coroutine = coroutine_current();
+  coroutine->park = park;
+  coroutine->park_arg = arg;
+  swapcontext(&coroutine->context, &coroutine->caller);
+}
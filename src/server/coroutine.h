@@ -0,0 +1,49 @@
+#ifndef SERVER_COROUTINE_H
+#define SERVER_COROUTINE_H
+
+#include <stddef.h>
+#include <ucontext.h>
+
+/**
+ * @struct Coroutine
+ * @brief A function running on its own small stack, which can suspend itself and be resumed later by any
+ * carrier thread.
+ */
+struct Coroutine {
+  ucontext_t context;         // Registers of the coroutine while it is suspended
+  ucontext_t caller;          // Registers of the carrier thread while the coroutine runs
+  void* stack;                // Stack mapping, with a guard page at its low end
+  size_t stack_size;          // Size of the stack mapping
+  void (*entry)(void*);       // Function run by the coroutine
+  void* arg;                  // Argument of entry
+  int finished;               // 1 once entry returned
+  void (*park)(void*);        // Run by the carrier right after the coroutine suspends itself
+  void* park_arg;             // Argument of park
+};
+
+/// Prepares a coroutine that will run entry(arg) on a new stack of SESSION_STACK_SIZE bytes when first resumed.
+/// @param coroutine Pointer to the coroutine to initialize.
+/// @param entry Function to run.
+/// @param arg Argument of entry.
+/// @return 0 if the coroutine was created successfully, 1 otherwise.
+int coroutine_create(struct Coroutine* coroutine, void (*entry)(void*), void* arg);
+
+/// Frees the stack of a coroutine that is not running.
+/// @param coroutine Pointer to the coroutine.
+void coroutine_destroy(struct Coroutine* coroutine);
+
+/// Runs a coroutine on the calling thread until it suspends itself or finishes.
+/// @param coroutine Pointer to the coroutine.
+/// @return 1 if the coroutine finished, 0 if it suspended itself.
+int coroutine_resume(struct Coroutine* coroutine);
+
+/// Suspends the calling coroutine. Once it no longer runs, park(arg) is called on the carrier thread; it
+/// must arrange for the coroutine to be resumed later, and may do so from any thread.
+/// @param park Function that hands the suspended coroutine over to whoever will resume it.
+/// @param arg Argument of park.
+void coroutine_yield(void (*park)(void*), void* arg);
+
+/// Returns the coroutine running on the calling thread, or NULL outside of coroutines.
+struct Coroutine* coroutine_current(void);
+
+#endif  // SERVER_COROUTINE_H
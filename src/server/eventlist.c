@@ -2,6 +2,7 @@
 #include <stdlib.h>
 
 #include "eventlist.h"
+#include "snapshot.h"
 
 /**
  * @brief Creates a new event list.
@@ -20,6 +21,7 @@ struct EventList* create_list() {
   }
   list->head = NULL;
   list->tail = NULL;
+  lockstats_init(&list->lock_stats);
   return list;
 }
 
@@ -56,14 +58,15 @@ int append_to_list(struct EventList* list, struct Event* event) {
 /**
  * @brief Frees the memory used by an event.
  *
- * This function frees the memory used by the event's data field, then frees the event itself.
- * If the event is NULL, the function does nothing.
+ * This function frees the memory used by the event's data field, unless it lives in the mapped checkpoint or in the
+ * seat file, and drops its seat snapshot, then frees the event itself. If the event is NULL, the function does nothing.
  *
  * @param event The event to free.
  */
 static void free_event(struct Event* event) {
   if (!event) return;
-  free(event->data);
+  if (event->snapshot) snapshot_release(event->snapshot);
+  if (event->storage == SEATS_HEAP) free(event->data);
   free(event);
 }
 
@@ -2,7 +2,23 @@
 #define SERVER_EVENT_LIST_H
 
 #include <pthread.h>
+#include <stdatomic.h>
 #include <stddef.h>
+#include <stdint.h>
+
+#include "lockstats.h"
+
+struct SeatSnapshot;
+
+/**
+ * @enum SeatStorage
+ * @brief Where the seats of an event live, which decides how they are freed.
+ */
+enum SeatStorage {
+  SEATS_HEAP,        // Allocated with calloc
+  SEATS_CHECKPOINT,  // In the mapped checkpoint, unmapped with it
+  SEATS_FILE,        // In the seat file, which the kernel pages in and out, unmapped with it
+};
 
 struct Event {
   unsigned int id;            /// Event id
@@ -11,8 +27,18 @@ struct Event {
   size_t cols;  /// Number of columns.
   size_t rows;  /// Number of rows.
 
-  unsigned int* data;     /// Array of size rows * cols with the reservations for each seat.
-  pthread_mutex_t mutex;  // Mutex to protect the event
+  unsigned int* data;           /// Array of size rows * cols with the reservations for each seat.
+  enum SeatStorage storage;     /// Where data lives.
+  uint64_t lsn;                 /// LSN of the last change to the event the write-ahead log holds, 0 if none.
+  uint64_t seq;                 /// Sequence number of the last change sent to followers, or of the snapshot received.
+  pthread_mutex_t mutex;        // Mutex to protect the event
+  struct LockStats lock_stats;  /// Contention of the mutex, counted while lock profiling is on.
+  atomic_uint waiting;          /// Reservations waiting for the mutex, which SHOW replies being built make way for.
+
+  struct SeatSnapshot* snapshot;  /// Copy of data for SHOW replies, NULL until one needs it and after a reservation.
+
+  atomic_uint last_used;  /// Seconds since the seat file was opened when seats in it were last used.
+  atomic_int cold;        /// 1 while seats in the seat file are paged out for being unused.
 };
 
 struct ListNode {
@@ -22,9 +48,10 @@ struct ListNode {
 
 // Linked list structure
 struct EventList {
-  struct ListNode* head;  // Head of the list
-  struct ListNode* tail;  // Tail of the list
-  pthread_rwlock_t rwl;   // Mutex to protect the list
+  struct ListNode* head;        // Head of the list
+  struct ListNode* tail;        // Tail of the list
+  pthread_rwlock_t rwl;         // Mutex to protect the list
+  struct LockStats lock_stats;  // Contention of rwl, counted while lock profiling is on
 };
 
 /// Creates a new event list.
@@ -0,0 +1,197 @@
+#include "lanes.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "scheduler.h"
+
+#define LATENCY_BUCKETS 32  // Power-of-two latency buckets, from 1us to over half an hour
+
+/**
+ * @struct LaneWait
+ * @brief A read waiting for its turn. It lives on the coroutine's stack until it is resumed.
+ */
+struct LaneWait {
+  struct Coroutine* coroutine;  // Coroutine to resume
+  struct LaneWait* next;        // Next read in arrival order
+};
+
+/**
+ * @struct LaneLatency
+ * @brief Latency counters of one class.
+ */
+struct LaneLatency {
+  atomic_size_t count;
+  atomic_size_t total_us;
+  atomic_size_t max_us;
+  atomic_size_t buckets[LATENCY_BUCKETS];  // Bucket i counts latencies below 2^i microseconds
+};
+
+static void (*wake_function)(struct Coroutine*) = NULL;
+static size_t reserved = 0;
+
+// Reads running, and reads waiting for one of them to finish
+static pthread_mutex_t read_mutex = PTHREAD_MUTEX_INITIALIZER;
+static size_t running_reads = 0;
+static struct LaneWait* waiting_head = NULL;
+static struct LaneWait* waiting_tail = NULL;
+
+static struct LaneLatency latencies[OP_CLASS_COUNT];
+
+/**
+ * Returns the number of reads allowed to run at once, which follows the size of the pool.
+ */
+static size_t read_limit(void) {
+  size_t active = scheduler_active();
+  return active > reserved ? active - reserved : 1;
+}
+
+/**
+ * Sets up the lanes.
+ *
+ * @param wake Called with each coroutine whose read may run.
+ * @param reserved_workers Workers kept for writes.
+ */
+void lanes_init(void (*wake)(struct Coroutine*), size_t reserved_workers) {
+  wake_function = wake;
+  reserved = reserved_workers;
+}
+
+/**
+ * Returns the class of an operation.
+ */
+enum OpClass lanes_classify(char op_code) {
+  switch (op_code) {
+    case 3:  // ems_create
+    case 4:  // ems_reserve
+      return OP_CLASS_WRITE;
+    case 5:  // ems_show
+    case 6:  // ems_list_events
+      return OP_CLASS_READ;
+    default:
+      return OP_CLASS_COUNT;
+  }
+}
+
+/**
+ * Queues a read that found every read slot taken, once its coroutine is suspended. A slot may have been
+ * freed since, in which case the read runs right away.
+ *
+ * @param arg The wait.
+ */
+static void park_read(void* arg) {
+  struct LaneWait* wait = arg;
+  struct Coroutine* coroutine = wait->coroutine;
+
+  pthread_mutex_lock(&read_mutex);
+  if (waiting_head == NULL && running_reads < read_limit()) {
+    running_reads++;
+    pthread_mutex_unlock(&read_mutex);
+    wake_function(coroutine);
+    return;
+  }
+
+  wait->next = NULL;
+  if (waiting_tail != NULL) {
+    waiting_tail->next = wait;
+  } else {
+    waiting_head = wait;
+  }
+  waiting_tail = wait;
+  pthread_mutex_unlock(&read_mutex);
+}
+
+/**
+ * Enters the lane of an operation, waiting for a read slot when every one is taken.
+ *
+ * @param op_class Class of the operation.
+ */
+void lanes_enter(enum OpClass op_class) {
+  if (op_class != OP_CLASS_READ || reserved == 0) {
+    return;
+  }
+
+  pthread_mutex_lock(&read_mutex);
+  if (waiting_head == NULL && running_reads < read_limit()) {
+    running_reads++;
+    pthread_mutex_unlock(&read_mutex);
+    return;
+  }
+  pthread_mutex_unlock(&read_mutex);
+
+  struct LaneWait wait = {coroutine_current(), NULL};
+  coroutine_yield(park_read, &wait);
+}
+
+/**
+ * Leaves the lane of an operation. A finished read hands its slot straight to the oldest waiting read.
+ *
+ * @param op_class Class of the operation.
+ * @param started When the op code of the operation was read.
+ */
+void lanes_leave(enum OpClass op_class, const struct timespec* started) {
+  if (op_class == OP_CLASS_COUNT) {
+    return;
+  }
+
+  if (op_class == OP_CLASS_READ && reserved > 0) {
+    pthread_mutex_lock(&read_mutex);
+    struct LaneWait* next = waiting_head;
+    if (next != NULL) {
+      waiting_head = next->next;
+      if (waiting_head == NULL) {
+        waiting_tail = NULL;
+      }
+    } else {
+      running_reads--;
+    }
+    pthread_mutex_unlock(&read_mutex);
+
+    if (next != NULL) {
+      wake_function(next->coroutine);
+    }
+  }
+
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  long long elapsed = (now.tv_sec - started->tv_sec) * 1000000LL + (now.tv_nsec - started->tv_nsec) / 1000;
+  size_t latency_us = elapsed > 0 ? (size_t)elapsed : 0;
+
+  size_t bucket = 0;
+  while (bucket < LATENCY_BUCKETS - 1 && latency_us >= ((size_t)1 << bucket)) {
+    bucket++;
+  }
+
+  struct LaneLatency* latency = &latencies[op_class];
+  atomic_fetch_add(&latency->count, 1);
+  atomic_fetch_add(&latency->total_us, latency_us);
+  atomic_fetch_add(&latency->buckets[bucket], 1);
+  size_t max = atomic_load(&latency->max_us);
+  while (latency_us > max && !atomic_compare_exchange_weak(&latency->max_us, &max, latency_us))
+    ;
+}
+
+/**
+ * Copies the latency counters of a class.
+ *
+ * @param op_class The class.
+ * @param stats Pointer to store the counters in.
+ */
+void lanes_get_stats(enum OpClass op_class, struct LaneStats* stats) {
+  struct LaneLatency* latency = &latencies[op_class];
+  stats->count = atomic_load(&latency->count);
+  stats->total_us = atomic_load(&latency->total_us);
+  stats->max_us = atomic_load(&latency->max_us);
+
+  // Walk the buckets up to the one holding the 99th percentile
+  size_t target = stats->count - stats->count / 100;
+  size_t seen = 0;
+  stats->p99_us = 0;
+  for (size_t i = 0; i < LATENCY_BUCKETS && stats->count > 0; i++) {
+    seen += atomic_load(&latency->buckets[i]);
+    if (seen >= target) {
+      stats->p99_us = ((size_t)1 << i) < stats->max_us ? (size_t)1 << i : stats->max_us;
+      break;
+    }
+  }
+}
@@ -0,0 +1,57 @@
+#ifndef SERVER_LANES_H
+#define SERVER_LANES_H
+
+#include <stddef.h>
+#include <time.h>
+
+#include "coroutine.h"
+
+/**
+ * @enum OpClass
+ * @brief Priority class of an operation.
+ */
+enum OpClass {
+  OP_CLASS_READ,   // SHOW and LIST, which only read the state and may be large
+  OP_CLASS_WRITE,  // CREATE and RESERVE, which change the state and which clients wait on
+  OP_CLASS_COUNT,  // Number of classes; also used for operations that are neither
+};
+
+/**
+ * @struct LaneStats
+ * @brief Latency of the operations of one class, from the moment their op code was read until their reply
+ * was ready.
+ */
+struct LaneStats {
+  size_t count;     // Operations completed
+  size_t total_us;  // Sum of their latencies
+  size_t p99_us;    // Latency below which 99% of them completed, rounded up to a power of two or to max_us
+  size_t max_us;    // Longest latency
+};
+
+/// Sets up the lanes. Reads are limited to the active workers minus reserved_workers, so that many workers
+/// are always left for writes.
+/// @param wake Called with each coroutine whose read may run, once another read finished.
+/// @param reserved_workers Workers kept for writes, or 0 to let reads use every worker.
+void lanes_init(void (*wake)(struct Coroutine*), size_t reserved_workers);
+
+/// Returns the class of an operation.
+/// @param op_code Op code read from the request pipe.
+/// @return The class, or OP_CLASS_COUNT for operations that are neither reads nor writes.
+enum OpClass lanes_classify(char op_code);
+
+/// Enters the lane of an operation about to run. A read suspends the calling coroutine while as many reads
+/// as allowed are running; it is resumed once it may run, after the reads that were waiting before it.
+/// @param op_class Class of the operation.
+void lanes_enter(enum OpClass op_class);
+
+/// Leaves the lane of an operation that finished, letting the next waiting read run, and records its latency.
+/// @param op_class Class of the operation, as given to lanes_enter.
+/// @param started When the op code of the operation was read.
+void lanes_leave(enum OpClass op_class, const struct timespec* started);
+
+/// Copies the latency counters of a class.
+/// @param op_class The class.
+/// @param stats Pointer to store the counters in.
+void lanes_get_stats(enum OpClass op_class, struct LaneStats* stats);
+
+#endif  // SERVER_LANES_H
@@ -0,0 +1,249 @@
+#include "lockstats.h"
+
+#include <string.h>
+
+// Set once before any profiled lock is taken; when 0, profiled locks cost a branch over plain ones
+static int enabled = 0;
+
+// When the calling thread took the read lock it holds, and whether it holds one
+static _Thread_local struct timespec read_since;
+static _Thread_local int reading = 0;
+
+/**
+ * Gets the time between two instants in nanoseconds, 0 if the clock went backwards.
+ */
+static size_t between_ns(const struct timespec* from, const struct timespec* to) {
+  long long elapsed = (to->tv_sec - from->tv_sec) * 1000000000LL + (to->tv_nsec - from->tv_nsec);
+  return elapsed > 0 ? (size_t)elapsed : 0;
+}
+
+/**
+ * Records that a lock was taken, and how long it was waited for.
+ *
+ * @param stats Counters of the lock.
+ * @param asked When the lock was asked for, or NULL if it was free.
+ * @param acquired Pointer to store when it was taken in.
+ */
+static void record_acquired(struct LockStats* stats, const struct timespec* asked, struct timespec* acquired) {
+  clock_gettime(CLOCK_MONOTONIC, acquired);
+  atomic_fetch_add_explicit(&stats->acquisitions, 1, memory_order_relaxed);
+  if (asked != NULL) {
+    atomic_fetch_add_explicit(&stats->contended, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&stats->wait_ns, between_ns(asked, acquired), memory_order_relaxed);
+  }
+}
+
+/**
+ * Records how long a lock about to be released was held.
+ *
+ * @param stats Counters of the lock.
+ * @param since When it was taken.
+ */
+static void record_held(struct LockStats* stats, const struct timespec* since) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  size_t held = between_ns(since, &now);
+  size_t max = atomic_load_explicit(&stats->max_hold_ns, memory_order_relaxed);
+  while (held > max &&
+         !atomic_compare_exchange_weak_explicit(&stats->max_hold_ns, &max, held, memory_order_relaxed,
+                                                memory_order_relaxed)) {
+  }
+}
+
+/**
+ * Turns lock profiling on. Called before any profiled lock is taken; it then stays on.
+ */
+void lockstats_enable(void) { enabled = 1; }
+
+/**
+ * Tells whether lock profiling is on.
+ *
+ * @return 1 if it is, 0 otherwise.
+ */
+int lockstats_enabled(void) { return enabled; }
+
+/**
+ * Zeroes the counters of a lock.
+ *
+ * @param stats The counters.
+ */
+void lockstats_init(struct LockStats* stats) {
+  atomic_init(&stats->acquisitions, 0);
+  atomic_init(&stats->contended, 0);
+  atomic_init(&stats->wait_ns, 0);
+  atomic_init(&stats->max_hold_ns, 0);
+  memset(&stats->held_since, 0, sizeof(stats->held_since));
+}
+
+/**
+ * Locks a mutex, counting its contention if lock profiling is on. A lock that cannot be taken right away is
+ * contended, and the time until it is taken counts as waiting.
+ *
+ * @param mutex The mutex.
+ * @param stats Counters of the mutex.
+ * @return 0 on success, an error number otherwise.
+ */
+int lockstats_mutex_lock(pthread_mutex_t* mutex, struct LockStats* stats) {
+  if (!enabled) {
+    return pthread_mutex_lock(mutex);
+  }
+
+  struct timespec asked;
+  int contended = pthread_mutex_trylock(mutex) != 0;
+  if (contended) {
+    clock_gettime(CLOCK_MONOTONIC, &asked);
+    int error = pthread_mutex_lock(mutex);
+    if (error != 0) {
+      return error;
+    }
+  }
+
+  // Only the holder writes when it took the mutex
+  record_acquired(stats, contended ? &asked : NULL, &stats->held_since);
+  return 0;
+}
+
+/**
+ * Unlocks a mutex taken with lockstats_mutex_lock, recording how long it was held.
+ *
+ * @param mutex The mutex.
+ * @param stats Counters of the mutex.
+ * @return 0 on success, an error number otherwise.
+ */
+int lockstats_mutex_unlock(pthread_mutex_t* mutex, struct LockStats* stats) {
+  if (enabled) {
+    record_held(stats, &stats->held_since);
+  }
+  return pthread_mutex_unlock(mutex);
+}
+
+/**
+ * Read-locks a rwlock, counting its contention if lock profiling is on.
+ *
+ * @param rwl The rwlock.
+ * @param stats Counters of the rwlock.
+ * @return 0 on success, an error number otherwise.
+ */
+int lockstats_rdlock(pthread_rwlock_t* rwl, struct LockStats* stats) {
+  if (!enabled) {
+    return pthread_rwlock_rdlock(rwl);
+  }
+
+  struct timespec asked;
+  int contended = pthread_rwlock_tryrdlock(rwl) != 0;
+  if (contended) {
+    clock_gettime(CLOCK_MONOTONIC, &asked);
+    int error = pthread_rwlock_rdlock(rwl);
+    if (error != 0) {
+      return error;
+    }
+  }
+
+  // Readers hold the lock together, so each keeps when it took it
+  record_acquired(stats, contended ? &asked : NULL, &read_since);
+  reading = 1;
+  return 0;
+}
+
+/**
+ * Write-locks a rwlock, counting its contention if lock profiling is on.
+ *
+ * @param rwl The rwlock.
+ * @param stats Counters of the rwlock.
+ * @return 0 on success, an error number otherwise.
+ */
+int lockstats_wrlock(pthread_rwlock_t* rwl, struct LockStats* stats) {
+  if (!enabled) {
+    return pthread_rwlock_wrlock(rwl);
+  }
+
+  struct timespec asked;
+  int contended = pthread_rwlock_trywrlock(rwl) != 0;
+  if (contended) {
+    clock_gettime(CLOCK_MONOTONIC, &asked);
+    int error = pthread_rwlock_wrlock(rwl);
+    if (error != 0) {
+      return error;
+    }
+  }
+
+  record_acquired(stats, contended ? &asked : NULL, &stats->held_since);
+  return 0;
+}
+
+/**
+ * Unlocks a rwlock taken with lockstats_rdlock or lockstats_wrlock, recording how long it was held.
+ *
+ * @param rwl The rwlock.
+ * @param stats Counters of the rwlock.
+ * @return 0 on success, an error number otherwise.
+ */
+int lockstats_rwlock_unlock(pthread_rwlock_t* rwl, struct LockStats* stats) {
+  if (enabled) {
+    record_held(stats, reading ? &read_since : &stats->held_since);
+    reading = 0;
+  }
+  return pthread_rwlock_unlock(rwl);
+}
+
+/**
+ * Copies the counters of a lock.
+ *
+ * @param stats The counters.
+ * @param counts Pointer to store the copy in.
+ */
+void lockstats_read(struct LockStats* stats, struct LockCounts* counts) {
+  counts->acquisitions = atomic_load_explicit(&stats->acquisitions, memory_order_relaxed);
+  counts->contended = atomic_load_explicit(&stats->contended, memory_order_relaxed);
+  counts->wait_ns = atomic_load_explicit(&stats->wait_ns, memory_order_relaxed);
+  counts->max_hold_ns = atomic_load_explicit(&stats->max_hold_ns, memory_order_relaxed);
+}
+
+/**
+ * Adds the counters of a lock to a sum.
+ *
+ * @param sum The sum.
+ * @param counts Counters of the lock.
+ */
+void lockstats_add(struct LockCounts* sum, const struct LockCounts* counts) {
+  sum->acquisitions += counts->acquisitions;
+  sum->contended += counts->contended;
+  sum->wait_ns += counts->wait_ns;
+  sum->max_hold_ns = counts->max_hold_ns > sum->max_hold_ns ? counts->max_hold_ns : sum->max_hold_ns;
+}
+
+/**
+ * Keeps an event among the top events of a report if it was contended more than one of them, ties going to the
+ * longest wait. Events never contended are left out.
+ *
+ * @param report The report.
+ * @param event_id ID of the event.
+ * @param counts Counters of its mutex.
+ */
+void lockstats_rank(struct LockReport* report, unsigned int event_id, const struct LockCounts* counts) {
+  if (counts->contended == 0) {
+    return;
+  }
+
+  // Find where the event goes, then shift the less contended ones down, dropping the last if the top is full
+  size_t rank = report->top_count;
+  while (rank > 0 && (counts->contended > report->top[rank - 1].contended ||
+                      (counts->contended == report->top[rank - 1].contended &&
+                       counts->wait_ns > report->top[rank - 1].wait_ns))) {
+    rank--;
+  }
+  if (rank == LOCK_TOP_EVENTS) {
+    return;
+  }
+
+  size_t last = report->top_count < LOCK_TOP_EVENTS ? report->top_count : LOCK_TOP_EVENTS - 1;
+  for (size_t i = last; i > rank; i--) {
+    report->top[i] = report->top[i - 1];
+    report->top_ids[i] = report->top_ids[i - 1];
+  }
+  report->top[rank] = *counts;
+  report->top_ids[rank] = event_id;
+  if (report->top_count < LOCK_TOP_EVENTS) {
+    report->top_count++;
+  }
+}
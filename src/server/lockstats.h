@@ -0,0 +1,105 @@
+#ifndef SERVER_LOCKSTATS_H
+#define SERVER_LOCKSTATS_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <time.h>
+
+#include "common/constants.h"
+
+/**
+ * @struct LockStats
+ * @brief Contention counters of one lock, updated only while lock profiling is on.
+ */
+struct LockStats {
+  atomic_size_t acquisitions;  // Times the lock was taken
+  atomic_size_t contended;     // Times it was held by another thread when asked for
+  atomic_size_t wait_ns;       // Nanoseconds spent waiting for it
+  atomic_size_t max_hold_ns;   // Longest it was held at once, in nanoseconds
+  struct timespec held_since;  // When its exclusive holder took it
+};
+
+/**
+ * @struct LockCounts
+ * @brief Copy of the counters of a lock, or of several added up.
+ */
+struct LockCounts {
+  size_t acquisitions;
+  size_t contended;
+  size_t wait_ns;
+  size_t max_hold_ns;  // Largest of the locks added up
+};
+
+/**
+ * @struct LockReport
+ * @brief Contention of the event list lock, of the event mutexes added up, and of the events waited for the most.
+ */
+struct LockReport {
+  struct LockCounts list;                  // Event list lock
+  struct LockCounts events;                // Every event mutex
+  size_t top_count;                        // Events in top, most contended first
+  unsigned int top_ids[LOCK_TOP_EVENTS];   // Their IDs
+  struct LockCounts top[LOCK_TOP_EVENTS];  // Their counters
+};
+
+/// Turns lock profiling on. Called before any profiled lock is taken; it then stays on.
+void lockstats_enable(void);
+
+/// Tells whether lock profiling is on.
+/// @return 1 if it is, 0 otherwise.
+int lockstats_enabled(void);
+
+/// Zeroes the counters of a lock.
+/// @param stats The counters.
+void lockstats_init(struct LockStats* stats);
+
+/// Locks a mutex, counting its contention if lock profiling is on.
+/// @param mutex The mutex.
+/// @param stats Counters of the mutex.
+/// @return 0 on success, an error number otherwise, as pthread_mutex_lock.
+int lockstats_mutex_lock(pthread_mutex_t* mutex, struct LockStats* stats);
+
+/// Unlocks a mutex taken with lockstats_mutex_lock, recording how long it was held.
+/// @param mutex The mutex.
+/// @param stats Counters of the mutex.
+/// @return 0 on success, an error number otherwise, as pthread_mutex_unlock.
+int lockstats_mutex_unlock(pthread_mutex_t* mutex, struct LockStats* stats);
+
+/// Read-locks a rwlock, counting its contention if lock profiling is on. A thread holds at most one profiled read
+/// lock at a time.
+/// @param rwl The rwlock.
+/// @param stats Counters of the rwlock.
+/// @return 0 on success, an error number otherwise, as pthread_rwlock_rdlock.
+int lockstats_rdlock(pthread_rwlock_t* rwl, struct LockStats* stats);
+
+/// Write-locks a rwlock, counting its contention if lock profiling is on.
+/// @param rwl The rwlock.
+/// @param stats Counters of the rwlock.
+/// @return 0 on success, an error number otherwise, as pthread_rwlock_wrlock.
+int lockstats_wrlock(pthread_rwlock_t* rwl, struct LockStats* stats);
+
+/// Unlocks a rwlock taken with lockstats_rdlock or lockstats_wrlock, recording how long it was held.
+/// @param rwl The rwlock.
+/// @param stats Counters of the rwlock.
+/// @return 0 on success, an error number otherwise, as pthread_rwlock_unlock.
+int lockstats_rwlock_unlock(pthread_rwlock_t* rwl, struct LockStats* stats);
+
+/// Copies the counters of a lock.
+/// @param stats The counters.
+/// @param counts Pointer to store the copy in.
+void lockstats_read(struct LockStats* stats, struct LockCounts* counts);
+
+/// Adds the counters of a lock to a sum.
+/// @param sum The sum.
+/// @param counts Counters of the lock.
+void lockstats_add(struct LockCounts* sum, const struct LockCounts* counts);
+
+/// Keeps an event among the top events of a report if it was contended more than one of them, ties going to the
+/// longest wait.
+/// @param report The report.
+/// @param event_id ID of the event.
+/// @param counts Counters of its mutex.
+void lockstats_rank(struct LockReport* report, unsigned int event_id, const struct LockCounts* counts);
+
+#endif  // SERVER_LOCKSTATS_H
@@ -1,3 +1,4 @@
+#include <errno.h>
 #include <fcntl.h>
 #include <limits.h>
 #include <pthread.h>
@@ -8,209 +9,260 @@
 #include <sys/types.h>
 #include <unistd.h>
 #include <signal.h>
-
+#include <stdatomic.h>
+#include <sys/resource.h>
+#include <sys/signalfd.h>
+#include <time.h>
+
+#include "admission.h"
+#include "channel.h"
+#include "checkpoint.h"
 #include "common/constants.h"
 #include "common/io.h"
+#include "coroutine.h"
 #include "operations.h"
 #include "eventlist.h"
+#include "lanes.h"
+#include "lockstats.h"
+#include "opstats.h"
+#include "poller.h"
+#include "pool.h"
+#include "replication.h"
+#include "scheduler.h"
+#include "seatstore.h"
+#include "trace.h"
+#include "wal.h"
+
+// Struct to store the arguments for each admission thread
+struct MainThreadArgs {
+  char server_pipe_path[MAX_PATH];  // Server pipe this thread listens on
+  int server_fd;                    // Server pipe file descriptor
+};
 
 /**
- * @struct Request
- * @brief Struct to store thread arguments.
+ * @struct Session
+ * @brief A live session: the request it was admitted with, its channel, and the coroutine serving it.
+ *
+ * The request comes first, so the scheduler's request pointers can be turned back into sessions.
  */
-struct Request {
-  int session_id;                     // Session ID
-  char request_pipe_path[MAX_PATH];   // Request pipe path
-  char response_pipe_path[MAX_PATH];  // Response pipe path
-  char server_pipe_path[MAX_PATH];    // Server pipe path
+struct Session {
+  struct Request request;       // Session as admitted, queued in the scheduler whenever it can run
+  struct Channel channel;       // Buffered session pipes
+  struct Coroutine coroutine;   // Runs handle_client, with no stack until a worker first takes the session
+  struct OpTimes times;         // Where the time of its running operation went so far
+  struct timespec span_start;   // Start of the decode or execute span of its running operation, when tracing
 };
 
-// Shared buffer
-struct Request buffer[MAX_SESSION_COUNT];
-int in = 0;     // Index to insert a new request
-int out = 0;    // Index to remove a request
-int count = 0;  // Number of requests in the buffer
-
-// Mutex to protect the producer-consumer queue
-pthread_mutex_t buffer_mutex = PTHREAD_MUTEX_INITIALIZER;
+// File SIGUSR1 dumps are written to, replaced whole by each; NULL for the standard output
+static const char* dump_path = NULL;
 
-// Condition variable to signal that the buffer is not empty
-pthread_cond_t not_empty_cond = PTHREAD_COND_INITIALIZER;
+// File SIGUSR1 writes the trace to, replaced whole each time; NULL unless tracing
+static const char* trace_path = NULL;
 
-// Condition variable to signal that the buffer is not full
-pthread_cond_t not_full_cond = PTHREAD_COND_INITIALIZER;
+// Sessions admitted and not finished yet, bounded by max_live_sessions
+static atomic_size_t live_sessions = 0;
+static size_t max_live_sessions = MAX_LIVE_SESSIONS;
 
-// Mutex to protect the sessions array
-pthread_mutex_t sessions_mutex = PTHREAD_MUTEX_INITIALIZER;
+// Turns sessions gave up with requests still buffered, so that other sessions could run
+static atomic_size_t turns_yielded = 0;
 
-// Server pipe file descriptor
-int server_fd;
-
-// Struct to store the arguments for the main thread
-struct MainThreadArgs {
-  char server_pipe_path[MAX_PATH];
-};
-
-// int to store the number of active threads
-int session_counter = 0;
-
-// int to store the flag to print event info
-int print_flag = 0;
+// Times a SHOW let a waiting reservation run before finishing its reply
+static atomic_size_t shows_preempted = 0;
 
 /**
- * @brief Signal handler for SIGUSR1.
- *
- * This function sets the print_flag to 1 when SIGUSR1 is received.
+ * Ends a suspended session that could not be queued again: its pipes are closed, so the client sees the session
+ * end, and the session is freed with its coroutine, which never runs again. Only happens when memory runs out;
+ * an operation it was in the middle of is not finished, so whatever lane or admission slot it held stays taken.
  *
- * @param signum The signal number.
+ * @param session The session.
  */
-void sigusr1_handler(int signum ) {
-  // Set the flag to print event info
-  if (signum == SIGUSR1) {
-    print_flag = 1; 
-  }
-  
-  // Re-register the signal handler
-  signal(SIGUSR1, sigusr1_handler);
+static void abandon_session(struct Session* session) {
+  channel_destroy(&session->channel);
+  close(session->request.request_fd);
+  close(session->request.response_fd);
+  coroutine_destroy(&session->coroutine);
+  free(session);
+  atomic_fetch_sub(&live_sessions, 1);
 }
 
 /**
- * @brief Removes a session from the buffer.
+ * Queues a session that ended its turn behind the sessions waiting for a worker. Runs once its coroutine is
+ * suspended.
  *
- * @param session_id The ID of the session to be removed.
+ * @param arg The session.
  */
-void remove_session(int session_id) {
-  // Lock the buffer mutex to protect the buffer and the session counter
-  if (pthread_mutex_lock(&buffer_mutex) != 0) {
-    print_error("Error locking mutex.\n");
-  }
-
-  // Find the session in the buffer
-  int i;
-  for (i = 0; i < MAX_SESSION_COUNT; ++i) {
-    if (buffer[i].session_id == session_id) {
-      break;
-    }
-  }
-
-  // Remove the session from the buffer
-  buffer[i].session_id = -1;
-  buffer[i].request_pipe_path[0] = '\0';
-  buffer[i].response_pipe_path[0] = '\0';
-  buffer[i].server_pipe_path[0] = '\0';
-
-  // Decrement the number of active sessions
-  session_counter--;
-  count--;
-
-  // Signal that the buffer is not full
-  pthread_cond_signal(&not_full_cond);
-
-  if (pthread_mutex_unlock(&buffer_mutex) != 0) {
-    print_error("Error unlocking mutex.\n");
+static void requeue_session(void* arg) {
+  struct Session* session = (struct Session*)arg;
+  if (scheduler_resume(&session->request) != 0) {
+    abandon_session(session);
   }
 }
 
 /**
- * Inserts a request into the buffer, allocating a session ID.
+ * Charges one operation to the session's turn, ending the turn first when its quantum is spent.
  *
- * @param request The pointer to the Request structure containing the request details.
- * @return The session ID assigned to the inserted request.
+ * Sessions are scheduled with deficit round robin at operation granularity. Every turn a worker gives a
+ * session grants it weight * SESSION_TURN_OPS operations; a session that suspends itself to wait for a pipe
+ * starts its next turn with a fresh quantum, as an idle flow does. A client that keeps requests buffered
+ * would otherwise hold the worker for as long as its job file lasts, so once the quantum is spent the
+ * session goes to the back of the queue, unless no other session is waiting.
+ *
+ * @param session The session.
+ * @param turn Turn the quantum was last granted in.
+ * @param quantum Operations left in that turn.
  */
-void *insert_request(void *req) {
-  struct Request* request = (struct Request*)req;
-
-  // Lock the buffer mutex for thread safety
-  if (pthread_mutex_lock(&buffer_mutex) != 0) {
-    print_error("Error locking mutex.\n");
+static void charge_operation(struct Session* session, size_t* turn, size_t* quantum) {
+  if (session->request.turns == *turn && *quantum == 0 && scheduler_pending() > 0) {
+    atomic_fetch_add(&turns_yielded, 1);
+    coroutine_yield(requeue_session, session);
   }
 
-  // Wait if the buffer is full
-  while (count == MAX_SESSION_COUNT) {
-    pthread_cond_wait(&not_full_cond, &buffer_mutex);
+  if (session->request.turns != *turn || *quantum == 0) {
+    *turn = session->request.turns;
+    *quantum = (size_t)session->request.weight * SESSION_TURN_OPS;
   }
+  (*quantum)--;
+}
 
-  int session_id = session_counter;
-
-  // Insert the request into the buffer
-  buffer[in] = *request;
-  buffer[in].session_id = session_id;  // Assign the session_id
-  in = (in + 1) % MAX_SESSION_COUNT;
-  count++;
-  // Increment the session counter and assign the session ID
-  session_counter++;
-
-  // Signal that the buffer is not empty
-  pthread_cond_signal(&not_empty_cond);
-
-  // Unlock the buffer mutex
-  if (pthread_mutex_unlock(&buffer_mutex) != 0) {
-    print_error("Error unlocking mutex.\n");
-  }
+/**
+ * Lets a reservation waiting for the event a SHOW is copying run first: the session gives up its turn and is
+ * queued again. Called by ems_show with no lock held.
+ */
+static void preempt_show(void) {
+  struct Session* session = coroutine_current()->arg;
+  struct timespec yielded;
+  clock_gettime(CLOCK_MONOTONIC, &yielded);
+
+  atomic_fetch_add(&shows_preempted, 1);
+  coroutine_yield(requeue_session, session);
+  opstats_add(&session->times, OP_PHASE_QUEUE, &yielded);
+}
 
-  return NULL;
+/**
+ * Gets the times of the operation the running session serves, so operations can add the phases they time.
+ *
+ * @return Times of the session, or NULL outside of a session.
+ */
+static struct OpTimes* session_times(void) {
+  struct Coroutine* coroutine = coroutine_current();
+  return coroutine != NULL ? &((struct Session*)coroutine->arg)->times : NULL;
 }
 
 /**
- * Retrieves a request from the buffer.
+ * Decides whether an operation whose arguments were read may run. A refused operation is answered with the
+ * reason right away; an admitted one enters its lane.
  *
- * @param request The pointer to the Request structure to store the retrieved request.
+ * @param channel Channel of the session.
+ * @param op_class Class of the operation.
+ * @param event_id Event the operation names, 0 if none.
+ * @param deadline When the client stops waiting for the reply, or NULL.
+ * @param admitted_at Pointer to store the time of the decision in.
+ * @return 1 if the operation may run, 0 if it was refused.
  */
-void retrieve_request(struct Request* request) {
-  if (pthread_mutex_lock(&buffer_mutex) != 0) {
-    print_error("Error locking mutex.\n");
+static int start_operation(struct Channel* channel, enum OpClass op_class, unsigned int event_id,
+                           const struct timespec* deadline, struct timespec* admitted_at) {
+  struct Session* session = coroutine_current()->arg;
+  session->times.trace.event_id = event_id;
+
+  int status = admission_check(op_class, deadline, admitted_at);
+  if (status != 0) {
+    if (channel_write(channel, &status, sizeof(int)) == -1) {
+      print_error("Error writing to named pipe.\n");
+    }
+    return 0;
   }
 
-  // Retrieve the request from the buffer
-  *request = buffer[out];               // Copy the request
-  out = (out + 1) % MAX_SESSION_COUNT;  // Update the out index
-  count--;
-
-  if (pthread_mutex_unlock(&buffer_mutex) != 0) {
-    print_error("Error unlocking mutex.\n");
+  lanes_enter(op_class);
+  opstats_add(&session->times, OP_PHASE_QUEUE, admitted_at);
+  if (trace_enabled()) {
+    trace_span(SPAN_DECODE, &session->times.trace, &session->span_start, admitted_at);
+    clock_gettime(CLOCK_MONOTONIC, &session->span_start);
   }
+  return 1;
 }
 
 /**
- * Handles a client request.
+ * Leaves the lane of an operation whose reply is ready, recording how long it took and where that time went.
  *
- * @param args The pointer to the Request structure containing the request details.
+ * @param op_class Class of the operation.
+ * @param op The operation.
+ * @param started When its op code was read.
+ * @param admitted_at When it was admitted.
  */
-void* handle_client(void* args) {
-  struct Request* thread_args = (struct Request*)args;
-
-  // Open the server pipe for writing
-  int server_pipe = open(thread_args->server_pipe_path, O_WRONLY);
-  if (server_pipe == -1) {
-    print_error("Error opening server pipe.\n");
-    free(thread_args);
-    pthread_exit(NULL);
+static void finish_operation(enum OpClass op_class, enum TimedOp op, const struct timespec* started,
+                             const struct timespec* admitted_at) {
+  static const enum SpanKind op_spans[TIMED_OP_COUNT] = {SPAN_CREATE, SPAN_RESERVE, SPAN_SHOW, SPAN_LIST};
+
+  lanes_leave(op_class, started);
+  admission_done(op_class, admitted_at);
+  struct Session* session = coroutine_current()->arg;
+  opstats_record(op, &session->times);
+  if (trace_enabled()) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    trace_span(SPAN_EXECUTE, &session->times.trace, &session->span_start, &now);
+    trace_span(op_spans[op], &session->times.trace, &session->times.started, &now);
   }
+}
 
-  // Open the request pipe for reading
-  int request_pipe = open(thread_args->request_pipe_path, O_RDONLY);
-  if (request_pipe == -1) {
-    print_error("Error opening request pipe.\n");
-    free(thread_args);
-    pthread_exit(NULL);
+/**
+ * Hands the result of an operation to the session channel, timing it as its response.
+ *
+ * @param channel Channel of the session.
+ * @param result The result.
+ */
+static void write_result(struct Channel* channel, int result) {
+  struct timespec since;
+  clock_gettime(CLOCK_MONOTONIC, &since);
+  if (channel_write(channel, &result, sizeof(int)) == -1) {
+    print_error("Error writing to named pipe.\n");
   }
+  opstats_add(session_times(), OP_PHASE_RESPOND, &since);
+}
 
-  // Open the response pipe for writing
-  int response_pipe = open(thread_args->response_pipe_path, O_WRONLY);
-  if (response_pipe == -1) {
-    print_error("Error opening response pipe.\n");
-    free(thread_args);
-    pthread_exit(NULL);
-  }
+/**
+ * Prints how long a finished session waited for a worker over its turns, so fairness between sessions can be
+ * checked.
+ *
+ * @param request The session.
+ */
+static void report_session(const struct Request* request) {
+  printf("Session %d: weight %u, %zu turns, queued %zuus on average, %zuus at most.\n", request->session_id,
+         request->weight, request->turns, request->turns ? request->total_queued_us / request->turns : 0,
+         request->max_queued_us);
+}
 
-  // Send the session id to the response pipe
-  if (my_write(response_pipe, &thread_args->session_id, sizeof(int)) == -1) {
-    print_error("Error writing to named pipe.\n");
-    free(thread_args); 
-    pthread_exit(NULL);
+/**
+ * Handles a client session. Runs as the session's coroutine, which is suspended whenever a session pipe
+ * is not ready, so the worker can serve other sessions meanwhile.
+ *
+ * @param args The pointer to the Session structure containing the request details.
+ */
+void handle_client(void* args) {
+  struct Session* session = (struct Session*)args;
+  struct Request* thread_args = &session->request;
+  struct Channel* channel = &session->channel;
+
+  // The admission thread already opened both session pipes
+  int request_pipe = thread_args->request_fd;
+  int response_pipe = thread_args->response_fd;
+
+  // Wait for the client to open its end of the request pipe
+  if (channel_open(channel, request_pipe, response_pipe) != 0) {
+    print_error("Client did not open request pipe.\n");
+    close(request_pipe);
+    close(response_pipe);
+    return;
   }
 
   printf("Session %d started.\n", thread_args->session_id);
+  session->times.trace.track = trace_track();
+  session->times.trace.session = (unsigned int)thread_args->session_id;
+  if (trace_enabled()) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    trace_span(SPAN_SETUP, &session->times.trace, &thread_args->admitted_at, &now);
+  }
 
   // Handle client requests
   char op_code;
@@ -218,18 +270,48 @@ void* handle_client(void* args) {
   size_t num_rows, num_cols, num_seats;
   size_t xs[MAX_RESERVATION_SIZE], ys[MAX_RESERVATION_SIZE];
   int result;  // result of the operation
+  size_t turn = 0, quantum = 0;
+  struct timespec op_start;               // When the op code of the current operation was read
+  struct timespec admitted_at;            // When the current operation was allowed to run
+  struct timespec deadline;               // When the client stops waiting for the next operation
+  int has_deadline = 0;                   // 1 if the client sent a deadline for the next operation
+  size_t read_turn = thread_args->turns;  // Turn the session was in when it started waiting for an op code
+
+  while (channel_read(channel, &op_code, sizeof(char)) > 0) {
+    clock_gettime(CLOCK_MONOTONIC, &op_start);
+
+    // A session that had to wait for its op code waited again for a worker once the poller woke it; the
+    // operation starts at the wake, and that wait is queueing like any other
+    const struct timespec* began = thread_args->turns != read_turn ? &thread_args->queued_at : &op_start;
+    opstats_begin(&session->times, began);
+
+    // A deadline only prefixes the operation it applies to, so it does not count against the turn
+    if (op_code != 7) {
+      session->times.trace.request++;
+      session->times.trace.event_id = 0;
+      charge_operation(session, &turn, &quantum);
+      opstats_add(&session->times, OP_PHASE_QUEUE, began);
+      if (trace_enabled()) {
+        clock_gettime(CLOCK_MONOTONIC, &session->span_start);
+      }
+    }
 
-  while (my_read(request_pipe, &op_code, sizeof(char)) > 0 && op_code != 2) {
+    enum OpClass op_class = lanes_classify(op_code);  // Lane the operation runs in, if it runs in one
     switch (op_code) {
       case 2:  // ems_quit
 
         // Read the session ID from the request pipe
-        if (my_read(request_pipe, &thread_args->session_id, sizeof(int)) == -1) {
+        if (channel_read(channel, &thread_args->session_id, sizeof(int)) == -1) {
           print_error("Error reading from named pipe.\n");
           result = 1;
         }
 
-        // Close the pipes
+        // Send any reply still buffered and close the pipes
+        if (channel_flush(channel) != 0) {
+          print_error("Error writing to named pipe.\n");
+          result = 1;
+        }
+
         if (close(request_pipe) == -1) {
           print_error("Error closing request pipe.\n");
           result = 1;
@@ -240,185 +322,243 @@ void* handle_client(void* args) {
           result = 1;
         }
 
-        if (close(server_pipe) == -1) {
-          print_error("Error closing server pipe.\n");
-          result = 1;
-        }
-
-        // Remove the session from the buffer
-        if (pthread_mutex_lock(&sessions_mutex) != 0) {
-          print_error("Error locking mutex.\n");
-        }
-
-        remove_session(thread_args->session_id);
-
-        if (pthread_mutex_unlock(&sessions_mutex) != 0) {
-          print_error("Error unlocking mutex.\n");
-        }
-
+        channel_destroy(channel);
         printf("Session %d terminated.\n", thread_args->session_id);
+        report_session(thread_args);
 
-        // Free the memory allocated for the thread arguments
-        free(thread_args);
-        // Send thread to worker function to handle the next request
-        pthread_exit(NULL);
+        // Finish the coroutine, so the worker frees the session
+        return;
 
       case 3:  // ems_create
 
-        if (my_read(request_pipe, &thread_args->session_id, sizeof(int)) == -1) {
+        if (channel_read(channel, &thread_args->session_id, sizeof(int)) == -1) {
           print_error("Error reading from named pipe.\n");
           result = 1;
-          if (my_write(response_pipe, &result, sizeof(int)) == -1) {
+          if (channel_write(channel, &result, sizeof(int)) == -1) {
             print_error("Error writing to named pipe.\n");
           }
           break;
         }
 
-        if (my_read(request_pipe, &event_id, sizeof(unsigned int)) == -1) {
+        if (channel_read(channel, &event_id, sizeof(unsigned int)) == -1) {
           print_error("Error reading from named pipe.\n");
           result = 1;
-          if (my_write(response_pipe, &result, sizeof(int)) == -1) {
+          if (channel_write(channel, &result, sizeof(int)) == -1) {
             print_error("Error writing to named pipe.\n");
           }
           break;
         }
 
-        if (my_read(request_pipe, &num_rows, sizeof(size_t)) == -1) {
+        if (channel_read(channel, &num_rows, sizeof(size_t)) == -1) {
           print_error("4Error reading from named pipe.\n");
           result = 1;
-          if (my_write(response_pipe, &result, sizeof(int)) == -1) {
+          if (channel_write(channel, &result, sizeof(int)) == -1) {
             print_error("Error writing to named pipe.\n");
           }
           break;
         }
 
-        if (my_read(request_pipe, &num_cols, sizeof(size_t)) == -1) {
+        if (channel_read(channel, &num_cols, sizeof(size_t)) == -1) {
           print_error("Error reading from named pipe.\n");
           result = 1;
-          if (my_write(response_pipe, &result, sizeof(int)) == -1) {
+          if (channel_write(channel, &result, sizeof(int)) == -1) {
             print_error("Error writing to named pipe.\n");
           }
           break;
         }
 
-        result = ems_create(event_id, num_rows, num_cols);
-
-        if (my_write(response_pipe, &result, sizeof(int)) == -1) {
-          print_error("Error writing to named pipe.\n");
-          break;
+        if (start_operation(channel, op_class, event_id, has_deadline ? &deadline : NULL, &admitted_at)) {
+          result = ems_create(event_id, num_rows, num_cols);
+          write_result(channel, result);
+          finish_operation(op_class, TIMED_CREATE, &op_start, &admitted_at);
         }
         break;
 
       case 4:  // ems_reserve
 
-        if (my_read(request_pipe, &thread_args->session_id, sizeof(int)) == -1) {
+        if (channel_read(channel, &thread_args->session_id, sizeof(int)) == -1) {
           print_error("Error reading from named pipe.\n");
           result = 1;
-          if (my_write(response_pipe, &result, sizeof(int)) == -1) {
+          if (channel_write(channel, &result, sizeof(int)) == -1) {
             print_error("Error writing to named pipe.\n");
           }
           break;
         }
 
-        if (my_read(request_pipe, &event_id, sizeof(unsigned int)) == -1) {
+        if (channel_read(channel, &event_id, sizeof(unsigned int)) == -1) {
           print_error("Error reading from named pipe.\n");
           result = 1;
-          if (my_write(response_pipe, &result, sizeof(int)) == -1) {
+          if (channel_write(channel, &result, sizeof(int)) == -1) {
             print_error("Error writing to named pipe.\n");
           }
           break;
         }
 
-        if (my_read(request_pipe, &num_seats, sizeof(size_t)) == -1) {
+        if (channel_read(channel, &num_seats, sizeof(size_t)) == -1) {
           print_error("Error reading from named pipe.\n");
           result = 1;
-          if (my_write(response_pipe, &result, sizeof(int)) == -1) {
+          if (channel_write(channel, &result, sizeof(int)) == -1) {
             print_error("Error writing to named pipe.\n");
           }
           break;
         }
 
-        if (my_read(request_pipe, xs, num_seats * sizeof(size_t)) == -1) {
+        if (channel_read(channel, xs, num_seats * sizeof(size_t)) == -1) {
           print_error("Error reading from named pipe.\n");
           result = 1;
-          if (my_write(response_pipe, &result, sizeof(int)) == -1) {
+          if (channel_write(channel, &result, sizeof(int)) == -1) {
             print_error("Error writing to named pipe.\n");
           }
           break;
         }
 
-        if (my_read(request_pipe, ys, num_seats * sizeof(size_t)) == -1) {
+        if (channel_read(channel, ys, num_seats * sizeof(size_t)) == -1) {
           print_error("Error reading from named pipe.\n");
           result = 1;
-          if (my_write(response_pipe, &result, sizeof(int)) == -1) {
+          if (channel_write(channel, &result, sizeof(int)) == -1) {
             print_error("Error writing to named pipe.\n");
           }
           break;
         }
 
-        result = ems_reserve(event_id, num_seats, xs, ys);
-
-        if (my_write(response_pipe, &result, sizeof(int)) == -1) {
-          print_error("Error writing to named pipe.\n");
-          break;
+        if (start_operation(channel, op_class, event_id, has_deadline ? &deadline : NULL, &admitted_at)) {
+          result = ems_reserve(event_id, num_seats, xs, ys);
+          write_result(channel, result);
+          finish_operation(op_class, TIMED_RESERVE, &op_start, &admitted_at);
         }
         break;
 
       case 5:  // ems_show
 
-        if (my_read(request_pipe, &thread_args->session_id, sizeof(int)) == -1) {
+        if (channel_read(channel, &thread_args->session_id, sizeof(int)) == -1) {
           print_error("Error reading from named pipe.\n");
           result = 1;
-          if (my_write(response_pipe, &result, sizeof(int)) == -1) {
+          if (channel_write(channel, &result, sizeof(int)) == -1) {
             print_error("Error writing to named pipe.\n");
           }
           break;
         }
 
-        if (my_read(request_pipe, &event_id, sizeof(unsigned int)) == -1) {
+        if (channel_read(channel, &event_id, sizeof(unsigned int)) == -1) {
           print_error("Error reading from named pipe.\n");
           result = 1;
-          if (my_write(response_pipe, &result, sizeof(int)) == -1) {
+          if (channel_write(channel, &result, sizeof(int)) == -1) {
             print_error("Error writing to named pipe.\n");
             break;
           }
           break;
         }
 
-        ems_show(response_pipe, event_id);
+        if (start_operation(channel, op_class, event_id, has_deadline ? &deadline : NULL, &admitted_at)) {
+          ems_show(channel, event_id);
+          finish_operation(op_class, TIMED_SHOW, &op_start, &admitted_at);
+        }
         break;
 
       case 6:  // ems_list_events
 
-        if (my_read(request_pipe, &thread_args->session_id, sizeof(int)) == -1) {
+        if (channel_read(channel, &thread_args->session_id, sizeof(int)) == -1) {
+          print_error("Error reading from named pipe.\n");
+          result = 1;
+          if (channel_write(channel, &result, sizeof(int)) == -1) {
+            print_error("Error writing to named pipe.\n");
+          }
+          break;
+        }
+
+        if (start_operation(channel, op_class, 0, has_deadline ? &deadline : NULL, &admitted_at)) {
+          ems_list_events(channel);
+          finish_operation(op_class, TIMED_LIST, &op_start, &admitted_at);
+        }
+        break;
+
+      case 7:  // deadline of the next operation
+
+        if (channel_read(channel, &thread_args->session_id, sizeof(int)) == -1 ||
+            channel_read(channel, &deadline, sizeof(struct timespec)) == -1) {
+          print_error("Error reading from named pipe.\n");
+          break;
+        }
+
+        // Keep the deadline for the operation that follows
+        has_deadline = 1;
+        continue;
+
+      case 8:  // ems_stats
+
+        if (channel_read(channel, &thread_args->session_id, sizeof(int)) == -1) {
           print_error("Error reading from named pipe.\n");
           result = 1;
-          if (my_write(response_pipe, &result, sizeof(int)) == -1) {
+          if (channel_write(channel, &result, sizeof(int)) == -1) {
             print_error("Error writing to named pipe.\n");
           }
           break;
         }
 
-        ems_list_events(response_pipe);
+        // result: (int) success (0 to 1) | (size_t[STATS_OPS * STATS_PHASES * STATS_VALUES]) latencies
+        {
+          size_t values[STATS_OPS * STATS_PHASES * STATS_VALUES];
+          result = opstats_report(values);
+          if (channel_write(channel, &result, sizeof(int)) == -1 ||
+              (result == 0 && channel_write(channel, values, sizeof(values)) == -1)) {
+            print_error("Error writing to named pipe.\n");
+          }
+        }
         break;
 
       default:
         print_error("Unknown operation code.\n");
         break;
     }
+
+    has_deadline = 0;
+    read_turn = thread_args->turns;
+  }
+
+  // The client went away without quitting
+  channel_destroy(channel);
+  close(request_pipe);
+  close(response_pipe);
+  report_session(thread_args);
+}
+
+/**
+ * Frees a session whose coroutine finished, and records the worker that served it.
+ *
+ * @param worker Index of the worker.
+ * @param session The finished session.
+ */
+static void end_session(size_t worker, struct Session* session) {
+  scheduler_release(worker, &session->request);
+  coroutine_destroy(&session->coroutine);
+  free(session);
+  atomic_fetch_sub(&live_sessions, 1);
+}
+
+/**
+ * Queues a suspended session again once the pipe it waits for is ready. Called by the poller thread.
+ *
+ * @param coroutine The coroutine of the session.
+ */
+static void wake_session(struct Coroutine* coroutine) {
+  struct Session* session = (struct Session*)coroutine->arg;
+  if (scheduler_resume(&session->request) != 0) {
+    abandon_session(session);
   }
-  return NULL;
 }
 
 /**
- * Worker thread function responsible for retrieving requests from the buffer and processing them.
+ * Worker thread function responsible for retrieving sessions from the scheduler and running them.
  *
- * This function runs in an infinite loop, retrieving requests from the buffer and passing them to the
- * handle_client function for further processing.
+ * This function runs in a loop, retrieving sessions from its own deque (or stealing them from other
+ * workers) and resuming their coroutine until it has to wait for a pipe or the session ends. Each worker
+ * thus carries any number of sessions. It returns when the pool shrinks below its index.
  *
+ * @param arg The index of the worker, cast to a pointer.
  * @return NULL
  */
-void* worker_function() {
+void* worker_function(void* arg) {
+  size_t worker = (size_t)arg;
 
   // Block SIGUSR1 in this thread
   sigset_t set;
@@ -426,128 +566,499 @@ void* worker_function() {
   sigaddset(&set, SIGUSR1);
   pthread_sigmask(SIG_BLOCK, &set, NULL); 
 
+  // Operations this worker runs are recorded in histograms of its own
+  opstats_attach(worker);
+
   while (1) {
-    struct Request current_request;  // Request to be processed
+    struct Request* current_request;  // Session to be run
+
+    // Retrieve the session from the scheduler and run it, unless the pool shrank
+    if (scheduler_retrieve(worker, &current_request) != 0) {
+      if (pool_retire(worker)) {
+        return NULL;
+      }
+      continue;
+    }
 
-    // Condition variable to wait for a request to be available
-    pthread_mutex_lock(&buffer_mutex);
+    // The request is the first member of its session
+    struct Session* session = (struct Session*)current_request;
 
-    // Wait if the buffer is empty
-    while (count == 0) {
-      pthread_cond_wait(&not_empty_cond, &buffer_mutex);
+    // The stack is only mapped once a worker starts the session, so queued sessions stay small
+    if (session->coroutine.stack == NULL && coroutine_create(&session->coroutine, handle_client, session) != 0) {
+      close(current_request->request_fd);
+      close(current_request->response_fd);
+      end_session(worker, session);
+      continue;
     }
-    pthread_mutex_unlock(&buffer_mutex);
 
-    // Retrieve the request from the buffer and handle it
-    retrieve_request(&current_request);
-    handle_client(&current_request);
+    if (coroutine_resume(&session->coroutine)) {
+      end_session(worker, session);
+    }
   }
 }
 
 /**
- * Prints the events from the event list.
+ * Writes a time in nanoseconds as microseconds with three decimals.
+ *
+ * @param out The writer.
+ * @param ns The time.
+ */
+static void write_micros(struct Writer* out, size_t ns) {
+  unsigned int fraction = (unsigned int)(ns % 1000);
+  writer_uint(out, (unsigned int)(ns / 1000));
+  writer_char(out, '.');
+  writer_char(out, (char)('0' + fraction / 100));
+  writer_char(out, (char)('0' + fraction / 10 % 10));
+  writer_char(out, (char)('0' + fraction % 10));
+}
+
+/**
+ * Writes the contention counters of a lock, or of several added up.
  *
- * This function retrieves the event list and iterates over it, printing each event.
- * If the event list is empty, it prints an error message.
+ * @param out The writer.
+ * @param counts The counters.
+ */
+static void write_lock_counts(struct Writer* out, const struct LockCounts* counts) {
+  writer_uint(out, (unsigned int)counts->acquisitions);
+  writer_str(out, " acquisitions, ");
+  writer_uint(out, (unsigned int)counts->contended);
+  writer_str(out, " contended, waited ");
+  write_micros(out, counts->wait_ns);
+  writer_str(out, "us, held at most ");
+  write_micros(out, counts->max_hold_ns);
+  writer_str(out, "us\n");
+}
+
+/**
+ * Prints the scheduler counters, so work distribution among workers and setup acceptance can be checked.
  *
- * @return Returns 1 if there are no events to print, 0 otherwise.
+ * @param out Writer to print them through, flushed by the caller.
  */
-int print_events() {
-  // Get event_list
-    struct EventList* events = get_event_list();
+static void print_scheduler_stats(struct Writer* out) {
+  struct SchedulerStats stats;
+  scheduler_get_stats(&stats);
+
+  writer_str(out, "Workers: ");
+  writer_uint(out, (unsigned int)pool_size());
+  writer_str(out, ", sessions: ");
+  writer_uint(out, (unsigned int)stats.submitted);
+  writer_str(out, ", busy: ");
+  writer_uint(out, (unsigned int)stats.rejected);
+  writer_str(out, ", avg wait: ");
+  writer_uint(out, stats.submitted ? (unsigned int)(stats.total_wait_us / stats.submitted) : 0);
+  writer_str(out, "us, max wait: ");
+  writer_uint(out, (unsigned int)stats.max_wait_us);
+  writer_str(out, "us, local hits: ");
+  writer_uint(out, (unsigned int)stats.local_hits);
+  writer_str(out, ", steals: ");
+  writer_uint(out, (unsigned int)stats.steals);
+  writer_str(out, ", resumed: ");
+  writer_uint(out, (unsigned int)stats.resumed);
+  writer_str(out, ", avg turn wait: ");
+  writer_uint(out, stats.resumed ? (unsigned int)(stats.total_resume_wait_us / stats.resumed) : 0);
+  writer_str(out, "us, max turn wait: ");
+  writer_uint(out, (unsigned int)stats.max_resume_wait_us);
+  writer_str(out, "us, yielded: ");
+  writer_uint(out, (unsigned int)atomic_load(&turns_yielded));
+  writer_str(out, ", live: ");
+  writer_uint(out, (unsigned int)atomic_load(&live_sessions));
+  writer_str(out, "\n");
+
+  const char* names[OP_CLASS_COUNT] = {"Reads", "Writes"};
+  for (int i = 0; i < OP_CLASS_COUNT; i++) {
+    struct LaneStats lane;
+    lanes_get_stats((enum OpClass)i, &lane);
+    writer_str(out, names[i]);
+    writer_str(out, ": ");
+    writer_uint(out, (unsigned int)lane.count);
+    writer_str(out, ", avg latency: ");
+    writer_uint(out, lane.count ? (unsigned int)(lane.total_us / lane.count) : 0);
+    writer_str(out, "us, p99 under: ");
+    writer_uint(out, (unsigned int)lane.p99_us);
+    writer_str(out, "us, max: ");
+    writer_uint(out, (unsigned int)lane.max_us);
+    writer_str(out, i == OP_CLASS_READ ? "us, preempted shows: " : "us");
+    if (i == OP_CLASS_READ) {
+      writer_uint(out, (unsigned int)atomic_load(&shows_preempted));
+    }
+    writer_str(out, "\n");
+  }
 
-    // Get the tail of the list
-    struct ListNode* to = events->tail;
-    struct ListNode* current = events->head;
+  struct WalStats log;
+  wal_get_stats(&log);
+  if (log.open) {
+    writer_str(out, "Log: ");
+    writer_uint(out, (unsigned int)log.records);
+    writer_str(out, " records, ");
+    writer_uint(out, (unsigned int)log.syncs);
+    writer_str(out, " syncs, last LSN: ");
+    writer_uint(out, (unsigned int)log.lsn);
+    writer_str(out, ", segments: ");
+    writer_uint(out, (unsigned int)log.segments);
+    writer_str(out, ", compacted: ");
+    writer_uint(out, (unsigned int)log.removed);
+    writer_str(out, "\n");
+  }
 
-    if (current == NULL) {
-      print_error("No event details to print.\n");
-      return 1;
+  struct ReplStats replication;
+  repl_get_stats(&replication);
+  if (replication.role == REPL_PRIMARY) {
+    writer_str(out, "Replication: primary, ");
+    writer_uint(out, (unsigned int)replication.followers);
+    writer_str(out, " followers, last sequence number: ");
+    writer_uint(out, (unsigned int)replication.seq);
+    writer_str(out, ", dropped: ");
+    writer_uint(out, (unsigned int)replication.dropped);
+    writer_str(out, "\n");
+  } else if (replication.role == REPL_FOLLOWER) {
+    writer_str(out, replication.connected ? "Replication: following, " : "Replication: not connected, ");
+    writer_str(out, replication.ready ? "snapshot applied, sequence number: " : "snapshot pending, sequence number: ");
+    writer_uint(out, (unsigned int)replication.seq);
+    writer_str(out, " of ");
+    writer_uint(out, (unsigned int)replication.primary_seq);
+    writer_str(out, ", changes applied: ");
+    writer_uint(out, (unsigned int)replication.applied);
+    writer_str(out, ", lag: ");
+    writer_uint(out, replication.lag_us > 0 ? (unsigned int)replication.lag_us : 0);
+    writer_str(out, "us\n");
+  }
+
+  struct SeatStoreStats seats;
+  seat_store_get_stats(&seats);
+  if (seats.open) {
+    writer_str(out, "Seat file: ");
+    writer_uint(out, (unsigned int)seats.events);
+    writer_str(out, " events, ");
+    writer_uint(out, (unsigned int)(seats.bytes / 1024));
+    writer_str(out, " KiB, cold: ");
+    writer_uint(out, (unsigned int)seats.cold_events);
+    writer_str(out, ", paged out: ");
+    writer_uint(out, (unsigned int)seats.page_outs);
+    writer_str(out, ", read back: ");
+    writer_uint(out, (unsigned int)seats.page_ins);
+    writer_str(out, "\n");
+  }
+
+  struct AdmissionStats admission;
+  admission_get_stats(&admission);
+  writer_str(out, "Admitted: ");
+  writer_uint(out, (unsigned int)admission.admitted);
+  writer_str(out, ", overloaded: ");
+  writer_uint(out, (unsigned int)admission.overloaded);
+  writer_str(out, ", expired: ");
+  writer_uint(out, (unsigned int)admission.expired);
+  writer_str(out, ", setups refused: ");
+  writer_uint(out, (unsigned int)admission.setups_refused);
+  writer_str(out, ", queue delay: ");
+  writer_uint(out, (unsigned int)admission.queue_delay_us);
+  writer_str(out, "us\n");
+
+  // Whether the event list lock or the mutex of a few events is what operations wait for
+  struct LockReport locks;
+  if (lockstats_enabled() && ems_lock_report(&locks) == 0) {
+    writer_str(out, "Event list lock: ");
+    write_lock_counts(out, &locks.list);
+    writer_str(out, "Event mutexes: ");
+    write_lock_counts(out, &locks.events);
+    for (size_t i = 0; i < locks.top_count; i++) {
+      writer_str(out, "Contended event ");
+      writer_uint(out, locks.top_ids[i]);
+      writer_str(out, ": ");
+      write_lock_counts(out, &locks.top[i]);
     }
+  }
 
-    while (1) {
-      if (current == to) {
-        break;
+  // Where the time of each operation went, for those that ran
+  size_t values[STATS_OPS * STATS_PHASES * STATS_VALUES];
+  if (opstats_report(values) == 0) {
+    const char* ops[STATS_OPS] = {"CREATE", "RESERVE", "SHOW", "LIST"};
+    const char* phases[STATS_PHASES] = {"queue", "lookup", "lock", "execute", "respond", "total"};
+    for (size_t op = 0; op < STATS_OPS; op++) {
+      const size_t* phase = values + op * STATS_PHASES * STATS_VALUES;
+      if (phase[0] == 0) {
+        continue;
       }
-      print_str(STDOUT_FILENO, "Event: ");
-      print_uint(STDOUT_FILENO, current->event->id);
-      print_str(STDOUT_FILENO, "\n");
-      if (ems_show_stdout(current->event->id) == 1) {
-        print_error("Error printing event.\n");
-        return 1;
+      writer_str(out, ops[op]);
+      writer_str(out, ": ");
+      writer_uint(out, (unsigned int)phase[0]);
+      writer_str(out, " ops, p50/p99/p999/max (us):");
+      for (size_t i = 0; i < STATS_PHASES; i++, phase += STATS_VALUES) {
+        writer_str(out, i == 0 ? " " : ", ");
+        writer_str(out, phases[i]);
+        for (size_t value = 1; value < STATS_VALUES; value++) {
+          writer_char(out, value == 1 ? ' ' : '/');
+          write_micros(out, phase[value]);
+        }
       }
-      current = current->next;
+      writer_str(out, "\n");
     }
-    return 0;
+  }
+}
+
+/**
+ * Tells a client the server is busy and closes its session pipes.
+ *
+ * @param request The request that was refused.
+ */
+static void reject_session(struct Request* request) {
+  int reply = SETUP_BUSY;
+  if (my_write(request->response_fd, &reply, sizeof(int)) == -1) {
+    print_error("Error writing to named pipe.\n");
+  }
+  close(request->request_fd);
+  close(request->response_fd);
 }
 
 /**
- * Main thread function responsible for extracting requests from the server pipe and inserting them into the buffer.
+ * Admits a new session without blocking the admission thread.
  *
- * This function runs in an infinite loop, extracting requests from the server pipe and inserting them into the buffer.
+ * Both session pipes are opened in non-blocking mode (the client already holds the read end of its
+ * response pipe) and the session is handed to the scheduler. The client is told right away whether
+ * the session was queued, along with its session ID, or whether the server is busy: too many sessions
+ * are live, or too many are waiting to start.
  *
- * @param args The pointer to the MainThreadArgs structure containing the server pipe path.
+ * @param request The request read from the server pipe.
+ */
+void admit_session(struct Request* request) {
+  request->response_fd = open(request->response_pipe_path, O_WRONLY | O_NONBLOCK);
+  if (request->response_fd == -1) {
+    print_error("Client is not listening on its response pipe.\n");
+    return;
+  }
+
+  request->request_fd = open(request->request_pipe_path, O_RDONLY | O_NONBLOCK);
+  if (request->request_fd == -1 || fcntl(request->response_fd, F_SETFL, 0) == -1) {
+    print_error("Error opening request pipe.\n");
+    if (request->request_fd != -1) {
+      close(request->request_fd);
+    }
+    close(request->response_fd);
+    return;
+  }
+
+  // Turn new sessions away while the queue is too long
+  if (admission_refuse_setup()) {
+    reject_session(request);
+    return;
+  }
+
+  // Claim a live session slot
+  size_t live = atomic_load(&live_sessions);
+  do {
+    if (live >= max_live_sessions) {
+      reject_session(request);
+      return;
+    }
+  } while (!atomic_compare_exchange_weak(&live_sessions, &live, live + 1));
+
+  int session_id;
+  struct Session* session = calloc(1, sizeof(struct Session));
+  if (session != NULL) {
+    session->request = *request;
+  }
+  if (session == NULL || scheduler_submit(&session->request, &session_id) != 0) {
+    free(session);
+    atomic_fetch_sub(&live_sessions, 1);
+    reject_session(request);
+    return;
+  }
+
+  // The worker only writes once the client sends an operation, which it does after reading this reply
+  int reply[2] = {SETUP_ACCEPTED, session_id};
+  if (my_write(request->response_fd, reply, sizeof(reply)) == -1) {
+    print_error("Error writing to named pipe.\n");
+  }
+}
+
+/**
+ * Admission thread function responsible for extracting requests from a server pipe and inserting them into the
+ * scheduler.
+ *
+ * This function runs in an infinite loop. Each setup message is read whole, in one call, since clients write
+ * it atomically.
+ *
+ * @param args The pointer to the MainThreadArgs structure describing the server pipe.
  * @return NULL
  */
-void extract_requests(void* args) {
+void* extract_requests(void* args) {
   struct MainThreadArgs* main_args = (struct MainThreadArgs*)args;  // Cast the arguments to the correct type
-  pthread_t host_thread;
 
   while (1) {
+    // op_code | request pipe path | response pipe path | weight
+    char message[SETUP_MESSAGE_SIZE];
 
-    char op_code = 0;
-    
-    // Read the operation code from the server pipe
-    ssize_t res = my_read(server_fd, &op_code, sizeof(char));
+    // Read the whole setup message from the server pipe
+    ssize_t res = my_read(main_args->server_fd, message, SETUP_MESSAGE_SIZE);
     if (res == -1) {
       print_error("Error reading from named pipe.\n");
       break;
     }
 
-    // Check if the print_flag is set
-    if (print_flag == 1) {
-      print_events();
-      // Reset print_flag
-      print_flag = 0;
+    if (res != SETUP_MESSAGE_SIZE || message[0] != 1) {  // ems_setup
       continue;
     }
 
-    if (op_code == 1) {  // ems_setup
+    struct Request request;
+    request.session_id = -1;
+    snprintf(request.request_pipe_path, MAX_PATH, "%.*s", MAX_PATH - 1, message + 1);
+    snprintf(request.response_pipe_path, MAX_PATH, "%.*s", MAX_PATH - 1, message + 1 + MAX_PATH);
+
+    // Clients that ask for no weight get the default of 1
+    request.weight = (unsigned char)message[1 + 2 * MAX_PATH];
+    if (request.weight == 0) {
+      request.weight = 1;
+    } else if (request.weight > SESSION_MAX_WEIGHT) {
+      request.weight = SESSION_MAX_WEIGHT;
+    }
 
-      // Obtain the first named pipe for the new session
-      char request_pipe_path[MAX_PATH];
+    // Insert the request into the scheduler, or tell the client the server is busy
+    admit_session(&request);
+  }
 
-      // Read the request pipe path from the server pipe
-      if (my_read(server_fd, &request_pipe_path, MAX_PATH) == -1) {
-        print_error("15Error reading from named pipe.\n");
-        break;
-      }
+  return NULL;
+}
 
-      // Obtain the second named pipe for the new session
-      char response_pipe_path[MAX_PATH];
-      if (my_read(server_fd, &response_pipe_path, MAX_PATH) == -1) {
-        print_error("16Error reading from named pipe.\n");
-        break;
-      }
+/**
+ * Checkpoints the state at a fixed interval, whenever it changed since the last checkpoint, and as soon as the
+ * write-ahead log filled WAL_COMPACT_SEGMENTS segments, so a restart maps the checkpoint and replays only the changes
+ * logged after it, and the log stays as small as the changes since then.
+ *
+ * @param arg Interval between checkpoints in seconds, cast to a pointer; 0 to only checkpoint as the log grows.
+ * @return NULL.
+ */
+static void* checkpoint_state(void* arg) {
+  // Leave SIGUSR1 to the dump thread
+  sigset_t set;
+  sigemptyset(&set);
+  sigaddset(&set, SIGUSR1);
+  pthread_sigmask(SIG_BLOCK, &set, NULL);
 
-      struct Request request;
-      request.session_id = -1;
-      snprintf(request.request_pipe_path, MAX_PATH, "%s", request_pipe_path);
-      snprintf(request.response_pipe_path, MAX_PATH, "%s", response_pipe_path);
-      snprintf(request.server_pipe_path, MAX_PATH, "%s", main_args->server_pipe_path);
+  size_t interval_s = (size_t)arg, waited_s = 0;
+  struct timespec poll = {CHECKPOINT_POLL_S, 0};
+  uint64_t checkpointed_lsn = 0;
+  while (1) {
+    nanosleep(&poll, NULL);
+    waited_s += CHECKPOINT_POLL_S;
 
-      // Insert the request into the requests array by creating an auxiliar thread
-      if (pthread_create(&host_thread, NULL, insert_request, (void*)&request) != 0) {
-        print_error("Error creating thread.\n");
-        break;
-      }
+    struct WalStats log;
+    wal_get_stats(&log);
+    int due = interval_s > 0 && waited_s >= interval_s && log.lsn != checkpointed_lsn;
+    if (!due && log.segments <= WAL_COMPACT_SEGMENTS) {
+      continue;
+    }
 
-      if (pthread_join(host_thread, NULL) != 0) {
-        print_error("Error joining thread.\n");
-        break;
-      }
+    waited_s = 0;
+    struct CheckpointStats stats;
+    if (ems_checkpoint(&stats) != 0) {
+      print_error("Failed to write a checkpoint.\n");
+      continue;
     }
+    checkpointed_lsn = stats.lsn;
+    printf("Checkpoint of %zu events (%zu bytes) up to LSN %llu written in %ldms, %zu log segments removed.\n",
+           stats.events, stats.bytes, (unsigned long long)stats.lsn, stats.elapsed_us / 1000, stats.compacted);
+  }
+
+  return NULL;
+}
+
+/**
+ * Pages out the seats of the events in the seat file that went unused for the given time, checking regularly.
+ *
+ * @param arg Seconds an event must go unused, cast to a pointer.
+ * @return NULL.
+ */
+static void* sweep_seats(void* arg) {
+  // Leave SIGUSR1 to the dump thread
+  sigset_t set;
+  sigemptyset(&set);
+  sigaddset(&set, SIGUSR1);
+  pthread_sigmask(SIG_BLOCK, &set, NULL);
+
+  unsigned int idle_s = (unsigned int)(size_t)arg;
+  struct timespec interval = {idle_s < SEAT_SWEEP_INTERVAL_S ? idle_s : SEAT_SWEEP_INTERVAL_S, 0};
+  while (1) {
+    nanosleep(&interval, NULL);
+    ems_sweep_cold_seats(idle_s);
   }
+
+  return NULL;
+}
+
+/**
+ * Writes the stats and every event. The stats are kept even when there are no events to write.
+ *
+ * @param out The writer.
+ * @return 0, as ems_dump reports its own errors.
+ */
+static int write_state(struct Writer* out) {
+  print_scheduler_stats(out);
+  ems_dump(out);
+  return 0;
+}
+
+/**
+ * Writes a dump to a file, or to the standard output. A dump file is written under a temporary name and renamed
+ * over the last one once complete, so it is never read half written.
+ *
+ * @param path The file, or NULL for the standard output.
+ * @param write_dump Writes the dump.
+ */
+static void dump_to(const char* path, int (*write_dump)(struct Writer*)) {
+  char temporary_path[PATH_MAX];
+  int fd = STDOUT_FILENO;
+  if (path != NULL) {
+    snprintf(temporary_path, sizeof(temporary_path), "%s.tmp", path);
+    fd = open(temporary_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd == -1) {
+      print_error("Error opening the dump file.\n");
+      return;
+    }
+  }
+
+  // The whole dump goes out a buffer at a time
+  char out_buffer[WRITER_BUFFER_SIZE];
+  struct Writer out;
+  writer_init(&out, fd, out_buffer, sizeof(out_buffer));
+  int failed = write_dump(&out) != 0;
+  failed = writer_flush(&out) != 0 || failed;
+
+  if (path != NULL) {
+    failed = close(fd) != 0 || failed;
+    if (failed || rename(temporary_path, path) != 0) {
+      print_error("Error writing the dump file.\n");
+      unlink(temporary_path);
+    }
+  }
+}
+
+/**
+ * Dumps the stats and every event, and the trace when tracing, each time SIGUSR1 arrives. Every thread leaves
+ * SIGUSR1 blocked, so it is only ever taken from the signalfd, here, and a dump never holds up admissions or
+ * sessions.
+ *
+ * @param arg The signalfd, cast to a pointer.
+ * @return NULL.
+ */
+static void* dump_on_signal(void* arg) {
+  int signal_fd = (int)(size_t)arg;
+  struct signalfd_siginfo info;
+  while (1) {
+    ssize_t res = read(signal_fd, &info, sizeof(info));
+    if (res == -1 && errno == EINTR) {
+      continue;
+    }
+    if (res != (ssize_t)sizeof(info)) {
+      print_error("Error reading the signalfd.\n");
+      break;
+    }
+    dump_to(dump_path, write_state);
+    if (trace_path != NULL) {
+      dump_to(trace_path, trace_export);
+    }
+  }
+
+  close(signal_fd);
+  return NULL;
 }
 
 /**
@@ -558,17 +1069,188 @@ void extract_requests(void* args) {
  * @return 0 if the program executed successfully, 1 otherwise.
  */
 int main(int argc, char* argv[]) {
+  // Worker pool and queue sizes, which default to MAX_SESSION_COUNT
+  struct PoolConfig pool_config = {MAX_SESSION_COUNT, 0, 0};
+  size_t queue_depth = MAX_SESSION_COUNT;
+  size_t num_listeners = 1;
+  enum IoEngine io_engine = IO_ENGINE_URING;
+  size_t reserved_workers = RESERVED_WRITE_WORKERS;
+  size_t show_preempt_seats = SHOW_PREEMPT_SEATS;
+  size_t max_queue_delay_us = MAX_QUEUE_DELAY_US;
+  const char* data_dir = NULL;
+  enum WalDurability durability = WAL_SYNC_GROUP;
+  size_t checkpoint_interval_s = CHECKPOINT_INTERVAL_S;
+  const char* seat_file = NULL;
+  int prefault_seats = 0;
+  size_t cold_after_s = SEAT_COLD_AFTER_S;
+  const char* replication_socket = NULL;
+  const char* primary_socket = NULL;
+
+  int option;
+  while ((option = getopt(argc, argv, "w:q:am:M:l:s:e:r:p:o:d:D:c:S:FC:R:f:Lu:T:")) != -1) {
+    unsigned long int value = 0;
+    // Workers kept for reservations, SHOW preemption interval, queueing delay limit, checkpoint interval and time
+    // before unused seats are paged out, which may all be 0
+    if (option == 'r' || option == 'p' || option == 'o' || option == 'c' || option == 'C') {
+      char* option_end;
+      value = strtoul(optarg, &option_end, 10);
+      if (*option_end != '\0' || value > INT_MAX) {
+        print_error("Invalid reserved worker count, preemption interval, queueing delay or interval.\n");
+        return 1;
+      }
+      size_t* setting = option == 'r'   ? &reserved_workers
+                        : option == 'p' ? &show_preempt_seats
+                        : option == 'o' ? &max_queue_delay_us
+                        : option == 'c' ? &checkpoint_interval_s
+                                        : &cold_after_s;
+      *setting = (size_t)value;
+      continue;
+    }
+
+    if (option == 'e') {  // Session I/O engine
+      if (strcmp(optarg, "uring") == 0) {
+        io_engine = IO_ENGINE_URING;
+      } else if (strcmp(optarg, "blocking") == 0) {
+        io_engine = IO_ENGINE_BLOCKING;
+      } else {
+        print_error("Invalid I/O engine, use uring or blocking.\n");
+        return 1;
+      }
+      continue;
+    }
+
+    if (option == 'd') {  // Directory the state is persisted in
+      data_dir = optarg;
+      continue;
+    }
+
+    if (option == 'S') {  // File the seats of events are kept in
+      seat_file = optarg;
+      continue;
+    }
+
+    if (option == 'F') {  // Fault in the seats of each event as it is created
+      prefault_seats = 1;
+      continue;
+    }
+
+    if (option == 'u') {  // File SIGUSR1 dumps are written to
+      dump_path = optarg;
+      continue;
+    }
+
+    if (option == 'L') {  // Count contention of the event list lock and of the event mutexes
+      lockstats_enable();
+      continue;
+    }
+
+    if (option == 'T') {  // Trace requests, writing the trace to a file on SIGUSR1
+      trace_path = optarg;
+      if (trace_enable() != 0) {
+        return 1;
+      }
+      continue;
+    }
+
+    if (option == 'R') {  // Socket followers connect to
+      replication_socket = optarg;
+      continue;
+    }
+
+    if (option == 'f') {  // Socket of the primary to follow
+      primary_socket = optarg;
+      continue;
+    }
+
+    if (option == 'D') {  // When logged changes are acknowledged
+      if (strcmp(optarg, "each") == 0) {
+        durability = WAL_SYNC_EACH;
+      } else if (strcmp(optarg, "group") == 0) {
+        durability = WAL_SYNC_GROUP;
+      } else if (strcmp(optarg, "async") == 0) {
+        durability = WAL_SYNC_ASYNC;
+      } else {
+        print_error("Invalid durability mode, use each, group or async.\n");
+        return 1;
+      }
+      continue;
+    }
+
+    if (option != 'a' && option != '?') {
+      char* option_end;
+      value = strtoul(optarg, &option_end, 10);
+      if (*option_end != '\0' || value == 0 || value > INT_MAX) {
+        print_error("Invalid pool, queue, listener or session count.\n");
+        return 1;
+      }
+    }
+
+    switch (option) {
+      case 'w':  // Fixed number of workers
+      case 'm':  // Minimum number of workers in adaptive mode
+        pool_config.min_workers = (size_t)value;
+        break;
+      case 'M':  // Maximum number of workers in adaptive mode
+        pool_config.max_workers = (size_t)value;
+        break;
+      case 'q':
+        queue_depth = (size_t)value;
+        break;
+      case 'a':
+        pool_config.adaptive = 1;
+        break;
+      case 'l':  // Number of server pipes
+        num_listeners = (size_t)value;
+        break;
+      case 's':  // Maximum number of live sessions
+        max_live_sessions = (size_t)value;
+        break;
+      default:
+        optind = argc + 1;
+        break;
+    }
+  }
+
   // Check if the required number of command-line arguments is provided
-  if (argc < 2 || argc > 3) {
-    fprintf(stderr, "Usage: %s\n <pipe_path> [delay].\n", argv[0]);
+  if (argc - optind < 1 || argc - optind > 2) {
+    fprintf(stderr,
+            "Usage: %s [-w workers] [-q queue_depth] [-a [-m min_workers] [-M max_workers]] [-l listeners] "
+            "[-s max_sessions] [-e uring|blocking] [-r reserved_workers] [-p preempt_seats] [-o max_queue_delay_us] "
+            "[-d data_dir [-D each|group|async] [-c checkpoint_interval_s]] [-S seat_file [-F] [-C cold_after_s]] "
+            "[-R replication_socket | -f primary_socket] [-L] [-u dump_file] [-T trace_file] <pipe_path> "
+            "[delay].\n",
+            argv[0]);
+    return 1;
+  }
+
+  // A follower takes its state from the primary alone
+  if (primary_socket != NULL && (data_dir != NULL || replication_socket != NULL)) {
+    print_error("A follower keeps no data directory and has no followers of its own.\n");
+    return 1;
+  }
+
+  // Adaptive pools grow up to four workers per core by default, since workers still block on state accesses
+  if (!pool_config.adaptive) {
+    pool_config.max_workers = pool_config.min_workers;
+  } else if (pool_config.max_workers == 0) {
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    pool_config.max_workers = 4 * (size_t)(cores > 0 ? cores : 1);
+  }
+  if (pool_config.max_workers < pool_config.min_workers) {
+    print_error("Maximum number of workers is below the minimum.\n");
     return 1;
   }
-  
+
+  // Reads always keep at least one worker
+  if (reserved_workers >= pool_config.min_workers) {
+    reserved_workers = pool_config.min_workers - 1;
+  }
+
   // Set the state access delay if provided
   char* endptr;
   unsigned int state_access_delay_us = STATE_ACCESS_DELAY_US;
-  if (argc == 3) {
-    unsigned long int delay = strtoul(argv[2], &endptr, 10);
+  if (argc - optind == 2) {
+    unsigned long int delay = strtoul(argv[optind + 1], &endptr, 10);
 
     if (*endptr != '\0' || delay > UINT_MAX) {
       print_error("Invalid delay value or value too large.\n");
@@ -578,68 +1260,173 @@ int main(int argc, char* argv[]) {
     state_access_delay_us = (unsigned int)delay;
   }
 
+  // Every thread started from here on leaves SIGUSR1 blocked, to be taken from the signalfd of the dump thread
+  sigset_t dump_signals;
+  sigemptyset(&dump_signals);
+  sigaddset(&dump_signals, SIGUSR1);
+  int signal_fd = -1;
+  if (pthread_sigmask(SIG_BLOCK, &dump_signals, NULL) != 0 ||
+      (signal_fd = signalfd(-1, &dump_signals, SFD_CLOEXEC)) == -1) {
+    print_error("Failed to create the signalfd.\n");
+    return 1;
+  }
+
   // Initialize the EMS
   if (ems_init(state_access_delay_us)) {
     print_error("Failed to initialize EMS.\n");
     return 1;
   }
 
-  char* server_pipe_path = argv[1];
-  // Create a named pipe for reading and writing
-  if (mkfifo(server_pipe_path, 0666) == -1) {
-    print_error("Error creating named pipe.\n");
+  // Seats go to the seat file from the first event on, replayed ones included
+  pthread_t sweeper;
+  if (seat_file != NULL &&
+      (ems_open_seat_file(seat_file, prefault_seats) != 0 ||
+       (cold_after_s > 0 && (pthread_create(&sweeper, NULL, sweep_seats, (void*)cold_after_s) != 0 ||
+                             pthread_detach(sweeper) != 0)))) {
+    print_error("Failed to open the seat file.\n");
     ems_terminate();
     return 1;
   }
 
-  signal(SIGUSR1, sigusr1_handler);
+  // The state of the last run is mapped from its checkpoint and the rest replayed from its log, which every change
+  // is then written to
+  if (data_dir != NULL && ems_recover(data_dir, durability) != 0) {
+    print_error("Failed to restore the state from the data directory.\n");
+    ems_terminate();
+    return 1;
+  }
 
-  // Open the pipe for reading and writing
-  server_fd = open(server_pipe_path, O_RDWR);
-  if (server_fd == -1) {
-    print_error("Error opening server pipe.\n");
+  pthread_t checkpointer;
+  if (data_dir != NULL &&
+      (pthread_create(&checkpointer, NULL, checkpoint_state, (void*)checkpoint_interval_s) != 0 ||
+       pthread_detach(checkpointer) != 0)) {
+    print_error("Error creating thread.\n");
     ems_terminate();
     return 1;
   }
 
-  // Create the main thread arguments
-  struct MainThreadArgs main_args;
+  // Reads leave workers to reservations, and long SHOW replies let them through
+  lanes_init(wake_session, reserved_workers);
+  ems_set_show_preemption(show_preempt_seats, preempt_show);
 
-  // Copy the server pipe path to the main thread arguments
-  snprintf(main_args.server_pipe_path, MAX_PATH, "%s", server_pipe_path);
+  // Operations are timed phase by phase, in histograms of the worker running them
+  if (opstats_init(pool_config.max_workers)) {
+    ems_terminate();
+    return 1;
+  }
+  ems_set_op_timing(session_times);
 
-  // Create worker threads
-  pthread_t worker_threads[MAX_SESSION_COUNT];
+  // Work that cannot finish in time is refused before it takes a worker
+  admission_init(max_queue_delay_us);
 
-  for (int i = 0; i < MAX_SESSION_COUNT; ++i) {
-    if (pthread_create(&worker_threads[i], NULL, worker_function, NULL) != 0) {
-      print_error("Error creating thread.\n");
-      return 1;
-    }
+  // Session pipes use io_uring unless it is unavailable or blocking I/O was asked for
+  enum IoEngine used_engine = channel_engine_init(io_engine);
+  if (used_engine != io_engine) {
+    fprintf(stderr, "%s is not available, using %s I/O.\n", channel_engine_name(io_engine),
+            channel_engine_name(used_engine));
   }
 
-  extract_requests(&main_args); 
+  // Each live session has at most a write and a read in flight
+  if (poller_init(wake_session, used_engine == IO_ENGINE_URING, 2 * max_live_sessions)) {
+    print_error("Failed to start poller.\n");
+    ems_terminate();
+    return 1;
+  }
 
-  // Wait for all threads to finish before exiting
-  for (int i = 0; i < MAX_SESSION_COUNT; ++i) {
-    pthread_join(worker_threads[i], NULL);
+  // Every live session holds two pipes, so allow as many files as the hard limit does
+  struct rlimit files;
+  if (getrlimit(RLIMIT_NOFILE, &files) == 0 && files.rlim_cur < files.rlim_max) {
+    files.rlim_cur = files.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &files);
   }
 
-  if (close(server_fd) == -1) {
-    print_error("Error closing server pipe.\n");
+  // Dumps run on a thread of their own
+  pthread_t dumper;
+  if (pthread_create(&dumper, NULL, dump_on_signal, (void*)(size_t)signal_fd) != 0 || pthread_detach(dumper) != 0) {
+    print_error("Error creating thread.\n");
     ems_terminate();
     return 1;
   }
 
-  if (unlink(server_pipe_path) == -1) {
-    print_error("Error unlinking server pipe.\n");
+  // Writing to a client that went away must not terminate the server
+  signal(SIGPIPE, SIG_IGN);
+
+  // Followers get the state from here on, and a follower serves reads of its primary's state as it comes
+  if ((replication_socket != NULL && ems_replicate(replication_socket) != 0) ||
+      (primary_socket != NULL && ems_follow(primary_socket) != 0)) {
+    print_error("Failed to start replication.\n");
     ems_terminate();
     return 1;
   }
-  if (unlink(server_pipe_path) == -1) {
-    print_error("Error unlinking server pipe.\n");
+
+  // Listener 0 uses the given path, listener k uses "<path>.k"; clients hash their pipe path to pick one
+  struct MainThreadArgs* listeners = calloc(num_listeners, sizeof(struct MainThreadArgs));
+  if (listeners == NULL) {
+    print_error("Error allocating listeners.\n");
     ems_terminate();
     return 1;
   }
+
+  for (size_t i = 0; i < num_listeners; i++) {
+    if (i == 0) {
+      snprintf(listeners[i].server_pipe_path, MAX_PATH, "%s", argv[optind]);
+    } else {
+      snprintf(listeners[i].server_pipe_path, MAX_PATH, "%s.%zu", argv[optind], i);
+    }
+
+    // Create a named pipe for reading and writing
+    if (mkfifo(listeners[i].server_pipe_path, 0666) == -1) {
+      print_error("Error creating named pipe.\n");
+      ems_terminate();
+      return 1;
+    }
+
+    // Open the pipe for reading and writing
+    listeners[i].server_fd = open(listeners[i].server_pipe_path, O_RDWR);
+    if (listeners[i].server_fd == -1) {
+      print_error("Error opening server pipe.\n");
+      ems_terminate();
+      return 1;
+    }
+  }
+
+  // Create the per-worker deques
+  if (scheduler_init(pool_config.max_workers, pool_config.min_workers, queue_depth)) {
+    print_error("Failed to initialize scheduler.\n");
+    ems_terminate();
+    return 1;
+  }
+
+  // Create worker threads
+  if (pool_start(worker_function, &pool_config)) {
+    print_error("Failed to start worker pool.\n");
+    ems_terminate();
+    return 1;
+  }
+
+  // Every listener but the first gets its own admission thread
+  for (size_t i = 1; i < num_listeners; i++) {
+    pthread_t listener_thread;
+    if (pthread_create(&listener_thread, NULL, extract_requests, &listeners[i]) != 0 ||
+        pthread_detach(listener_thread) != 0) {
+      print_error("Error creating thread.\n");
+      ems_terminate();
+      return 1;
+    }
+  }
+
+  extract_requests(&listeners[0]);
+
+  for (size_t i = 0; i < num_listeners; i++) {
+    if (close(listeners[i].server_fd) == -1) {
+      print_error("Error closing server pipe.\n");
+    }
+
+    if (unlink(listeners[i].server_pipe_path) == -1) {
+      print_error("Error unlinking server pipe.\n");
+    }
+  }
+
+  free(listeners);
   ems_terminate();
 }
\ No newline at end of file
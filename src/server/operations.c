@@ -1,16 +1,78 @@
 #include <fcntl.h>
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
 #include <unistd.h>
 
+#include "channel.h"
+#include "checkpoint.h"
+#include "common/constants.h"
 #include "common/io.h"
 #include "eventlist.h"
+#include "lockstats.h"
+#include "operations.h"
+#include "opstats.h"
+#include "replication.h"
+#include "seatstore.h"
+#include "snapshot.h"
+#include "wal.h"
 
 static struct EventList* event_list = NULL;
 static unsigned int state_access_delay_us = 0;
 
+// 1 once ems_recover replayed the write-ahead log: every later change is appended to it before it is acknowledged
+static int logging = 0;
+
+// 1 once every change is numbered, under the lock it is made under, and sent to the followers
+static int replicating = 0;
+
+// 1 on a follower, whose clients may only read the state, and the largest sequence number an event of its snapshot held
+static int read_only = 0;
+static uint64_t replica_max_seq = 0;
+
+// 1 on the thread applying the changes of the primary, which already paid for their state accesses
+static _Thread_local int applying_primary = 0;
+
+// Checkpoint of the data directory, and the largest LSN of a change it may hold; later records are all replayed
+static char checkpoint_path[PATH_MAX];
+static uint64_t checkpoint_max_lsn = 0;
+
+// Seats a SHOW copies between two preemption points, and what it calls at those points; 0 or NULL disables them
+static size_t show_preempt_seats = 0;
+static void (*show_preempt)(void) = NULL;
+
+// Gets the times of the operation the calling thread runs; NULL, or returning NULL, leaves it untimed
+static struct OpTimes* (*op_times)(void) = NULL;
+
+/**
+ * Starts timing a phase of the operation the calling thread runs.
+ *
+ * @param since Pointer to store the start of the phase in.
+ * @return Times of the operation, or NULL if it is not timed.
+ */
+static struct OpTimes* phase_start(struct timespec* since) {
+  struct OpTimes* times = op_times != NULL ? op_times() : NULL;
+  if (times != NULL) {
+    clock_gettime(CLOCK_MONOTONIC, since);
+  }
+  return times;
+}
+
+/**
+ * Ends timing a phase of the operation the calling thread runs.
+ *
+ * @param times Times of the operation, or NULL if it is not timed.
+ * @param phase The phase.
+ * @param since When the phase started.
+ */
+static void phase_end(struct OpTimes* times, enum OpPhase phase, const struct timespec* since) {
+  if (times != NULL) {
+    opstats_add(times, phase, since);
+  }
+}
+
 /**
  * Gets the event with the given ID from the state.
  *
@@ -21,10 +83,17 @@ static unsigned int state_access_delay_us = 0;
  * @return Pointer to the event if found, NULL otherwise.
  */
 static struct Event* get_event_with_delay(unsigned int event_id, struct ListNode* from, struct ListNode* to) {
+  struct timespec since;
+  struct OpTimes* times = phase_start(&since);
+
   struct timespec delay = {0, state_access_delay_us * 1000};
-  nanosleep(&delay, NULL);  // Should not be removed
+  if (!applying_primary) {
+    nanosleep(&delay, NULL);  // Should not be removed
+  }
 
-  return get_event(event_list, event_id, from, to);
+  struct Event* event = get_event(event_list, event_id, from, to);
+  phase_end(times, OP_PHASE_LOOKUP, &since);
+  return event;
 }
 
 /**
@@ -38,6 +107,65 @@ static struct Event* get_event_with_delay(unsigned int event_id, struct ListNode
  */
 static size_t seat_index(struct Event* event, size_t row, size_t col) { return (row - 1) * event->cols + col - 1; }
 
+/**
+ * Frees the seats of an event that was not created after all. Seats in the seat file are never handed out again.
+ *
+ * @param event The event.
+ */
+static void free_seats(struct Event* event) {
+  if (event->storage == SEATS_HEAP) {
+    free(event->data);
+  }
+}
+
+/**
+ * Allocates an event with every seat free, its seats in the seat file if it is open, on the heap otherwise.
+ *
+ * @param event_id The ID of the event.
+ * @param num_rows The number of rows in the event.
+ * @param num_cols The number of columns in the event.
+ * @return The event, or NULL on failure.
+ */
+static struct Event* new_event(unsigned int event_id, size_t num_rows, size_t num_cols) {
+  struct Event* event = malloc(sizeof(struct Event));
+  if (event == NULL) {
+    print_error("Error allocating memory for event.\n");
+    return NULL;
+  }
+
+  event->id = event_id;
+  event->rows = num_rows;
+  event->cols = num_cols;
+  event->reservations = 0;
+  event->lsn = 0;
+  event->seq = 0;
+  event->snapshot = NULL;
+  atomic_init(&event->waiting, 0);
+  atomic_init(&event->last_used, 0);
+  atomic_init(&event->cold, 0);
+  lockstats_init(&event->lock_stats);
+
+  if (pthread_mutex_init(&event->mutex, NULL) != 0) {
+    free(event);
+    return NULL;
+  }
+  // With a seat file, the kernel pages the seats of unused events out to it rather than keeping them in memory
+  event->storage = seat_store_is_open() ? SEATS_FILE : SEATS_HEAP;
+  if (event->storage == SEATS_FILE) {
+    event->data = seat_store_alloc(num_rows * num_cols);
+    seat_store_use(event);
+  } else {
+    event->data = calloc(num_rows * num_cols, sizeof(unsigned int));
+  }
+  if (event->data == NULL) {
+    print_error("Error allocating memory for event data.\n");
+    pthread_mutex_destroy(&event->mutex);
+    free(event);
+    return NULL;
+  }
+  return event;
+}
+
 /**
  * @brief Initializes the Event Management System (EMS) state.
  *
@@ -72,99 +200,293 @@ int ems_terminate() {
     return 1;
   }
 
-  if (pthread_rwlock_wrlock(&event_list->rwl) != 0) {
+  if (logging) {
+    wal_close();
+    logging = 0;
+  }
+
+  if (replicating) {
+    repl_close();
+    replicating = 0;
+  }
+
+  if (lockstats_wrlock(&event_list->rwl, &event_list->lock_stats) != 0) {
     print_error("Error locking list rwl.\n");
     return 1;
   }
 
-  free_list(event_list);
-
-  if (pthread_rwlock_unlock(&event_list->rwl) != 0) {
+  // The lock lives in the list, so it is released before the list is freed
+  struct EventList* list = event_list;
+  event_list = NULL;
+  if (lockstats_rwlock_unlock(&list->rwl, &list->lock_stats) != 0) {
     print_error("Error unlocking list rwl.\n");
     return 1;
   }
+
+  // Events loaded from a checkpoint or kept in the seat file point into their mappings
+  free_list(list);
+  checkpoint_unload();
+  seat_store_close();
   return 0;
 }
 
 struct EventList* get_event_list() { return event_list; }
 
 /**
- * Creates a new event with the specified ID, number of rows, and number of columns.
+ * Replays a change read from the write-ahead log, unless the checkpoint already holds it.
+ *
+ * @param record The change.
+ * @return 0 on success, 1 if the change does not apply to the state.
+ */
+static int replay_change(const struct WalRecord* record) {
+  // The checkpoint copied each event at its own time, so the changes after its LSN it holds differ by event
+  if (record->lsn <= checkpoint_max_lsn) {
+    struct Event* event = get_event(event_list, record->event_id, event_list->head, event_list->tail);
+    if (event != NULL && record->lsn <= event->lsn) {
+      return 0;
+    }
+  }
+
+  switch (record->type) {
+    case WAL_CREATE:
+      return ems_create(record->event_id, record->num_rows, record->num_cols);
+    case WAL_RESERVE:
+      return ems_reserve(record->event_id, record->num_seats, record->xs, record->ys);
+  }
+  return 1;
+}
+
+/**
+ * Restores the state from the data directory: maps its checkpoint, replays the segments of the write-ahead log from
+ * where the checkpoint ends, then appends every later change to the log before acknowledging it.
+ *
+ * @param data_dir Directory holding the checkpoint and the log, which are created if they do not exist.
+ * @param durability When logged changes are acknowledged.
+ * @return 0 on success, 1 on failure.
+ */
+int ems_recover(const char* data_dir, enum WalDurability durability) {
+  if (event_list == NULL || logging || event_list->head != NULL) {
+    print_error("EMS state must be initialized and empty, without a log.\n");
+    return 1;
+  }
+
+  if (snprintf(checkpoint_path, sizeof(checkpoint_path), "%s/checkpoint", data_dir) >= (int)sizeof(checkpoint_path)) {
+    print_error("The data directory path is too long.\n");
+    return 1;
+  }
+
+  uint64_t checkpoint_lsn;
+  if (checkpoint_load(checkpoint_path, event_list, &checkpoint_lsn, &checkpoint_max_lsn) != 0) {
+    return 1;
+  }
+
+  // The changes replayed already paid for their state accesses when they were made
+  unsigned int delay_us = state_access_delay_us;
+  state_access_delay_us = 0;
+  int failed = wal_open(data_dir, durability, checkpoint_lsn, checkpoint_max_lsn, replay_change);
+  state_access_delay_us = delay_us;
+
+  logging = !failed;
+  return failed;
+}
+
+/**
+ * Writes a checkpoint of the state to the data directory, without holding reservations back while it is written,
+ * then compacts the write-ahead log: the segments the checkpoint holds every change of are removed.
+ *
+ * @param stats Pointer to store what the checkpoint held in, or NULL.
+ * @return 0 on success, 1 on failure.
+ */
+int ems_checkpoint(struct CheckpointStats* stats) {
+  if (event_list == NULL || !logging) {
+    print_error("EMS state must be initialized, with a log.\n");
+    return 1;
+  }
+
+  // Every change up to the LSN read first is applied to the events found next: creates are logged under the list
+  // lock and reservations under the event mutex, which the checkpoint takes before copying each event
+  struct WalStats log;
+  wal_get_stats(&log);
+  if (lockstats_rdlock(&event_list->rwl, &event_list->lock_stats) != 0) {
+    print_error("Error locking list rwl.\n");
+    return 1;
+  }
+  struct ListNode* head = event_list->head;
+  struct ListNode* tail = event_list->tail;
+  if (lockstats_rwlock_unlock(&event_list->rwl, &event_list->lock_stats) != 0) {
+    print_error("Error unlocking list rwl.\n");
+    return 1;
+  }
+
+  if (checkpoint_write(checkpoint_path, head, tail, log.lsn, stats) != 0) {
+    return 1;
+  }
+
+  // The checkpoint is durable before the segments go. One that could not be removed is found again at the next
+  // start, and removed by the first compaction then
+  size_t compacted;
+  wal_compact(log.lsn, &compacted);
+  if (stats != NULL) {
+    stats->compacted = compacted;
+  }
+  return 0;
+}
+
+/**
+ * Keeps the seats of every event created from now on in a seat file, which the kernel pages them in from and out to,
+ * so that memory holds the events in use rather than all of them.
+ *
+ * @param path Path to the seat file.
+ * @param prefault 1 to fault in the seats of each event as it is created.
+ * @return 0 on success, 1 on failure.
+ */
+int ems_open_seat_file(const char* path, int prefault) {
+  if (event_list == NULL || event_list->head != NULL) {
+    print_error("EMS state must be initialized and empty.\n");
+    return 1;
+  }
+  return seat_store_open(path, prefault);
+}
+
+/**
+ * Pages out the seats of the events in the seat file that were not used for a while.
+ *
+ * @param idle_s Seconds an event must have gone unused.
+ * @return Number of events paged out.
+ */
+size_t ems_sweep_cold_seats(unsigned int idle_s) {
+  if (event_list == NULL || lockstats_rdlock(&event_list->rwl, &event_list->lock_stats) != 0) {
+    print_error("Error locking list rwl.\n");
+    return 0;
+  }
+  struct ListNode* head = event_list->head;
+  struct ListNode* tail = event_list->tail;
+  if (lockstats_rwlock_unlock(&event_list->rwl, &event_list->lock_stats) != 0) {
+    print_error("Error unlocking list rwl.\n");
+  }
+
+  // Events are only ever appended, so the nodes up to the tail stay put without the lock
+  return seat_store_sweep(head, tail, idle_s);
+}
+
+/**
+ * Sets the preemption points of SHOW replies.
+ *
+ * @param seats Number of seats copied between two points, or 0 to copy the seat map in one go.
+ * @param preempt Called at a point where a reservation waits for the event, with no lock held. It may suspend
+ *                the calling coroutine so the reservation runs first.
+ */
+void ems_set_show_preemption(size_t seats, void (*preempt)(void)) {
+  show_preempt_seats = seats;
+  show_preempt = preempt;
+}
+
+/**
+ * Sets where the time operations spend looking events up, waiting for locks and splicing replies is added.
+ *
+ * @param times Returns the times of the operation the calling thread runs, or NULL if it is not timed.
+ */
+void ems_set_op_timing(struct OpTimes* (*times)(void)) { op_times = times; }
+
+/**
+ * Creates a new event, whether a client or the primary asked for it.
  *
  * @param event_id The ID of the new event.
  * @param num_rows The number of rows in the event.
  * @param num_cols The number of columns in the event.
  * @return 0 on success, 1 on failure.
  */
-int ems_create(unsigned int event_id, size_t num_rows, size_t num_cols) {
+static int create_event(unsigned int event_id, size_t num_rows, size_t num_cols) {
   if (event_list == NULL) {
     print_error("EMS state must be initialized.\n");
     return 1;
   }
 
-  if (pthread_rwlock_wrlock(&event_list->rwl) != 0) {
+  struct timespec since;
+  struct OpTimes* times = phase_start(&since);
+  if (lockstats_wrlock(&event_list->rwl, &event_list->lock_stats) != 0) {
     print_error("Error locking list rwl.\n");
     return 1;
   }
+  phase_end(times, OP_PHASE_LOCK, &since);
 
   if (get_event_with_delay(event_id, event_list->head, event_list->tail) != NULL) {
     print_error("Event already exists\n");
-    if (pthread_rwlock_unlock(&event_list->rwl) != 0) {
+    if (lockstats_rwlock_unlock(&event_list->rwl, &event_list->lock_stats) != 0) {
       print_error("Error unlocking list rwl.\n");
     }
     return 1;
   }
 
-  struct Event* event = malloc(sizeof(struct Event));
-
+  struct Event* event = new_event(event_id, num_rows, num_cols);
   if (event == NULL) {
-    print_error("Error allocating memory for event.\n");
-    if (pthread_rwlock_unlock(&event_list->rwl) != 0) {
-      print_error( "Error unlocking list rwl.\n");
+    if (lockstats_rwlock_unlock(&event_list->rwl, &event_list->lock_stats) != 0) {
+      print_error("Error unlocking list rwl.\n");
     }
     return 1;
   }
 
-  event->id = event_id;
-  event->rows = num_rows;
-  event->cols = num_cols;
-  event->reservations = 0;
-
-  if (pthread_mutex_init(&event->mutex, NULL) != 0) {
-    if (pthread_rwlock_unlock(&event_list->rwl) != 0) {
-      print_error( "Error unlocking list rwl.\n");
-    }
-    free(event);
-    return 1;
-  }
-  event->data = calloc(num_rows * num_cols, sizeof(unsigned int));
-  if (event->data == NULL) {
-    print_error( "Error allocating memory for event data.\n");
-    if (pthread_rwlock_unlock(&event_list->rwl) != 0) {
-      print_error( "Error unlocking list rwl.\n");
+  uint64_t lsn = 0;
+  if (logging) {
+    struct WalRecord record = {WAL_CREATE, 0, event_id, num_rows, num_cols, 0, NULL, NULL};
+    lsn = wal_append(&record);
+    if (lsn == 0) {
+      if (lockstats_rwlock_unlock(&event_list->rwl, &event_list->lock_stats) != 0) {
+        print_error("Error unlocking list rwl.\n");
+      }
+      free_seats(event);
+      free(event);
+      return 1;
     }
-    free(event);
-    return 1;
+    event->lsn = lsn;
   }
 
   if (append_to_list(event_list, event) != 0) {
     print_error( "Error appending event to list.\n");
-    if (pthread_rwlock_unlock(&event_list->rwl) != 0) {
+    if (lockstats_rwlock_unlock(&event_list->rwl, &event_list->lock_stats) != 0) {
       print_error( "Error unlocking list rwl.\n");
     }
-    free(event->data);
+    free_seats(event);
     free(event);
     return 1;
   }
 
-  if (pthread_rwlock_unlock(&event_list->rwl) != 0) {
+  // Published under the list lock, so followers get each event before any reservation of it
+  if (replicating) {
+    struct WalRecord record = {WAL_CREATE, 0, event_id, num_rows, num_cols, 0, NULL, NULL};
+    event->seq = repl_publish(&record);
+  }
+
+  if (lockstats_rwlock_unlock(&event_list->rwl, &event_list->lock_stats) != 0) {
     print_error( "Error unlocking list rwl.\n");
   }
+
+  // Acknowledged once durable, without holding the list while the log is synced
+  if (lsn != 0 && wal_commit(lsn) != 0) {
+    print_error("Error syncing the write-ahead log.\n");
+    return 1;
+  }
   return 0;
 }
 
 /**
- * Reserves seats for a specified event.
+ * Creates a new event with the specified ID, number of rows, and number of columns.
+ *
+ * @param event_id The ID of the new event.
+ * @param num_rows The number of rows in the event.
+ * @param num_cols The number of columns in the event.
+ * @return 0 on success, 1 on failure.
+ */
+int ems_create(unsigned int event_id, size_t num_rows, size_t num_cols) {
+  if (read_only) {
+    print_error("Followers are read-only: events are created on the primary.\n");
+    return 1;
+  }
+  return create_event(event_id, num_rows, num_cols);
+}
+
+/**
+ * Reserves seats for a specified event, whether a client or the primary asked for them.
  *
  * @param event_id The ID of the event to reserve seats for.
  * @param num_seats The number of seats to reserve.
@@ -172,20 +494,29 @@ int ems_create(unsigned int event_id, size_t num_rows, size_t num_cols) {
  * @param ys An array containing the column indices of the seats.
  * @return 0 on success, 1 on failure.
  */
-int ems_reserve(unsigned int event_id, size_t num_seats, size_t* xs, size_t* ys) {
+static int reserve_seats(unsigned int event_id, size_t num_seats, const size_t* xs, const size_t* ys) {
   if (event_list == NULL) {
     print_error( "EMS state must be initialized.\n");
     return 1;
   }
 
-  if (pthread_rwlock_rdlock(&event_list->rwl) != 0) {
+  // Rejected before anything is logged or published, since neither the log nor the followers could apply it
+  if (num_seats == 0 || num_seats > MAX_RESERVATION_SIZE) {
+    print_error("Invalid number of seats.\n");
+    return 1;
+  }
+
+  struct timespec since;
+  struct OpTimes* times = phase_start(&since);
+  if (lockstats_rdlock(&event_list->rwl, &event_list->lock_stats) != 0) {
     print_error( "Error locking list rwl.\n");
     return 1;
   }
+  phase_end(times, OP_PHASE_LOCK, &since);
 
   struct Event* event = get_event_with_delay(event_id, event_list->head, event_list->tail);
 
-  if (pthread_rwlock_unlock(&event_list->rwl) != 0) {
+  if (lockstats_rwlock_unlock(&event_list->rwl, &event_list->lock_stats) != 0) {
     print_error( "Error unlocking list rwl.\n");
     return 1;
   }
@@ -195,7 +526,15 @@ int ems_reserve(unsigned int event_id, size_t num_seats, size_t* xs, size_t* ys)
     return 1;
   }
 
-  if (pthread_mutex_lock(&event->mutex) != 0) {
+  seat_store_use(event);
+
+  // Let SHOW replies copying the seats know a reservation is waiting
+  times = phase_start(&since);
+  atomic_fetch_add(&event->waiting, 1);
+  int locked = lockstats_mutex_lock(&event->mutex, &event->lock_stats) == 0;
+  atomic_fetch_sub(&event->waiting, 1);
+  phase_end(times, OP_PHASE_LOCK, &since);
+  if (!locked) {
     print_error("Error locking mutex.\n");
     return 1;
   }
@@ -203,7 +542,7 @@ int ems_reserve(unsigned int event_id, size_t num_seats, size_t* xs, size_t* ys)
   for (size_t i = 0; i < num_seats; i++) {
     if (xs[i] <= 0 || xs[i] > event->rows || ys[i] <= 0 || ys[i] > event->cols) {
       print_error("Seat out of bounds\n");
-      if (pthread_mutex_unlock(&event->mutex) != 0) {
+      if (lockstats_mutex_unlock(&event->mutex, &event->lock_stats) != 0) {
         print_error("Error unlocking mutex.\n");
       }
 
@@ -219,7 +558,7 @@ int ems_reserve(unsigned int event_id, size_t num_seats, size_t* xs, size_t* ys)
 
       if (event->data[i] != 0) {
         print_error("Seat already reserved.\n");
-        if (pthread_mutex_unlock(&event->mutex) != 0) {
+        if (lockstats_mutex_unlock(&event->mutex, &event->lock_stats) != 0) {
           print_error("Error unlocking mutex.\n");
         }
         return 1;
@@ -229,131 +568,370 @@ int ems_reserve(unsigned int event_id, size_t num_seats, size_t* xs, size_t* ys)
     }
   }
 
+  // Logged under the event mutex, so the log holds the reservations of an event in the order they were made
+  uint64_t lsn = 0;
+  if (logging) {
+    struct WalRecord record = {WAL_RESERVE, 0, event_id, 0, 0, num_seats, xs, ys};
+    lsn = wal_append(&record);
+    if (lsn == 0) {
+      if (lockstats_mutex_unlock(&event->mutex, &event->lock_stats) != 0) {
+        print_error("Error unlocking mutex.\n");
+      }
+      return 1;
+    }
+  }
+
   unsigned int reservation_id = ++event->reservations;
+  if (lsn != 0) {
+    event->lsn = lsn;
+  }
 
   for (size_t i = 0; i < num_seats; i++) {
     event->data[seat_index(event, xs[i], ys[i])] = reservation_id;
   }
 
-  if (pthread_mutex_unlock(&event->mutex) != 0) {
+  // SHOW replies still being sent keep their reference to the old snapshot
+  if (event->snapshot != NULL) {
+    snapshot_release(event->snapshot);
+    event->snapshot = NULL;
+  }
+
+  // Published under the event mutex, so followers number the reservations of an event as the primary did
+  if (replicating) {
+    struct WalRecord record = {WAL_RESERVE, 0, event_id, 0, 0, num_seats, xs, ys};
+    uint64_t seq = repl_publish(&record);
+    if (seq != 0) {
+      event->seq = seq;
+    }
+  }
+
+  if (lockstats_mutex_unlock(&event->mutex, &event->lock_stats) != 0) {
     print_error("Error unlocking mutex.\n");
   }
+
+  // Acknowledged once durable; with group commit, reservations made meanwhile share the sync
+  if (lsn != 0 && wal_commit(lsn) != 0) {
+    print_error("Error syncing the write-ahead log.\n");
+    return 1;
+  }
+  return 0;
+}
+
+/**
+ * Reserves seats for a specified event.
+ *
+ * @param event_id The ID of the event to reserve seats for.
+ * @param num_seats The number of seats to reserve.
+ * @param xs An array containing the row indices of the seats.
+ * @param ys An array containing the column indices of the seats.
+ * @return 0 on success, 1 on failure.
+ */
+int ems_reserve(unsigned int event_id, size_t num_seats, const size_t* xs, const size_t* ys) {
+  if (read_only) {
+    print_error("Followers are read-only: seats are reserved on the primary.\n");
+    return 1;
+  }
+  return reserve_seats(event_id, num_seats, xs, ys);
+}
+
+/**
+ * Sends every change made from now on to the followers that connect to a Unix socket, each after a snapshot of the
+ * state.
+ *
+ * @param path Path of the socket.
+ * @return 0 on success, 1 on failure.
+ */
+int ems_replicate(const char* path) {
+  if (event_list == NULL || read_only || replicating) {
+    print_error("EMS state must be initialized, neither following nor replicating.\n");
+    return 1;
+  }
+
+  // Changes are numbered from the start, so a follower connecting at once misses none
+  replicating = 1;
+  if (repl_listen(path) != 0) {
+    replicating = 0;
+    return 1;
+  }
   return 0;
 }
 
 /**
- * Sends information about a specified event to the client through a given file descriptor.
+ * Follows a primary: its snapshot and changes are applied to the state, while clients may only read it.
+ *
+ * @param path Path of the socket of the primary.
+ * @return 0 on success, 1 on failure.
+ */
+int ems_follow(const char* path) {
+  if (event_list == NULL || event_list->head != NULL || logging || replicating || read_only) {
+    print_error("EMS state must be initialized and empty, without a log, neither following nor replicating.\n");
+    return 1;
+  }
+
+  read_only = 1;
+  return repl_follow(path);
+}
+
+/**
+ * Adds an event of the snapshot of the primary to the state, seats and reservations included. It is only ever
+ * called from the thread applying the changes of the primary.
+ *
+ * @param event_id The ID of the event.
+ * @param num_rows The number of rows in the event.
+ * @param num_cols The number of columns in the event.
+ * @param reservations Number of reservations the event holds.
+ * @param seats Reservation of each seat.
+ * @param seq Sequence number of the last change the event holds.
+ * @return 0 on success, 1 on failure.
+ */
+int ems_restore_event(unsigned int event_id, size_t num_rows, size_t num_cols, unsigned int reservations,
+                      const unsigned int* seats, uint64_t seq) {
+  if (event_list == NULL || !read_only) {
+    print_error("EMS state must be initialized, following a primary.\n");
+    return 1;
+  }
+
+  // Events of a snapshot are distinct, and the primary already paid for its state accesses
+  struct Event* event = new_event(event_id, num_rows, num_cols);
+  if (event == NULL) {
+    return 1;
+  }
+  memcpy(event->data, seats, num_rows * num_cols * sizeof(unsigned int));
+  event->reservations = reservations;
+  event->seq = seq;
+
+  if (lockstats_wrlock(&event_list->rwl, &event_list->lock_stats) != 0) {
+    print_error("Error locking list rwl.\n");
+    free_seats(event);
+    free(event);
+    return 1;
+  }
+  int failed = append_to_list(event_list, event);
+  if (lockstats_rwlock_unlock(&event_list->rwl, &event_list->lock_stats) != 0) {
+    print_error("Error unlocking list rwl.\n");
+  }
+  if (failed) {
+    print_error("Error appending event to list.\n");
+    free_seats(event);
+    free(event);
+    return 1;
+  }
+
+  replica_max_seq = seq > replica_max_seq ? seq : replica_max_seq;
+  return 0;
+}
+
+/**
+ * Applies a change of the primary, unless the event it changes already held it when it was copied into the snapshot.
+ * It is only ever called from the thread applying the changes of the primary.
+ *
+ * @param record The change, its lsn being its sequence number.
+ * @return 0 on success, 1 if the change does not apply to the state.
+ */
+int ems_apply_change(const struct WalRecord* record) {
+  if (event_list == NULL || !read_only) {
+    print_error("EMS state must be initialized, following a primary.\n");
+    return 1;
+  }
+
+  // The snapshot copied each event at its own time, so the changes it holds differ by event. Only this thread adds
+  // events, so it reads the list without the lock
+  if (record->lsn <= replica_max_seq) {
+    struct Event* event = get_event(event_list, record->event_id, event_list->head, event_list->tail);
+    if (event != NULL && record->lsn <= event->seq) {
+      return 0;
+    }
+  }
+
+  applying_primary = 1;
+  int failed = 1;
+  switch (record->type) {
+    case WAL_CREATE:
+      failed = create_event(record->event_id, record->num_rows, record->num_cols);
+      break;
+    case WAL_RESERVE:
+      failed = reserve_seats(record->event_id, record->num_seats, record->xs, record->ys);
+      break;
+  }
+  applying_primary = 0;
+  return failed;
+}
+
+/**
+ * Sends information about a specified event to the client through its session channel.
  *
- * @param response_fd The file descriptor to send the information to.
+ * @param channel The session channel to send the information to.
  * @param event_id The ID of the event to get information about.
  * @return 0 on success, 1 on failure.
  */
-int ems_show(int response_fd, unsigned int event_id) {
+int ems_show(struct Channel* channel, unsigned int event_id) {
   // result: (int) success (0 to 1) | (size_t) num_rows | (size_t) num_cols | (unsigned int[num_rows * num_cols]) seats
   int result = 1;
 
   if (event_list == NULL) {
     print_error("EMS state must be initialized.\n");
-    if (my_write(response_fd, &result, sizeof(int)) == -1) {
+    if (channel_write(channel, &result, sizeof(int)) == -1) {
       print_error("Error writing to fd.\n");
     }
     return 1;
   }
 
-
-  if (pthread_rwlock_rdlock(&event_list->rwl) != 0) {
-    if (my_write(response_fd, &result, sizeof(int)) == -1) {
+  struct timespec since;
+  struct OpTimes* times = phase_start(&since);
+  if (lockstats_rdlock(&event_list->rwl, &event_list->lock_stats) != 0) {
+    if (channel_write(channel, &result, sizeof(int)) == -1) {
       print_error("Error writing to fd.\n");
     }
     return 1;
   }
+  phase_end(times, OP_PHASE_LOCK, &since);
 
   struct Event* event = get_event_with_delay(event_id, event_list->head, event_list->tail);
 
-  if (pthread_rwlock_unlock(&event_list->rwl) != 0) {
+  if (lockstats_rwlock_unlock(&event_list->rwl, &event_list->lock_stats) != 0) {
     print_error("Error unlocking list rwl.\n");
   }
 
   if (event == NULL) {
     print_error("Event not found.\n");
-    if (my_write(response_fd, &result, sizeof(int)) == -1) {
+    if (channel_write(channel, &result, sizeof(int)) == -1) {
       print_error("Error writing to fd.\n");
     }
     return 1;
   }
+  seat_store_use(event);
 
-  if (pthread_mutex_lock(&event->mutex) != 0) {
+  times = phase_start(&since);
+  if (lockstats_mutex_lock(&event->mutex, &event->lock_stats) != 0) {
     print_error("Error locking mutex.\n");
-    if (my_write(response_fd, &result, sizeof(int)) == -1) {
+    if (channel_write(channel, &result, sizeof(int)) == -1) {
       print_error("Error writing to fd.\n");
     }
     return 1;
   }
+  phase_end(times, OP_PHASE_LOCK, &since);
 
   // No more possible errors, write success code
   result = 0;
 
   // Write the result, rows, and cols to the buffer
-  if (my_write(response_fd, &result, sizeof(int)) == -1) {
+  if (channel_write(channel, &result, sizeof(int)) == -1) {
     print_error("Error writing to fd.\n");
-    if (pthread_mutex_unlock(&event->mutex) != 0) {
+    if (lockstats_mutex_unlock(&event->mutex, &event->lock_stats) != 0) {
       print_error("Error unlocking mutex.\n");
     }
     return 1;
   }
-  if (my_write(response_fd, &event->rows, sizeof(size_t)) == -1) {
+  if (channel_write(channel, &event->rows, sizeof(size_t)) == -1) {
     print_error("Error writing to fd.\n");
-    if (pthread_mutex_unlock(&event->mutex) != 0) {
+    if (lockstats_mutex_unlock(&event->mutex, &event->lock_stats) != 0) {
       print_error("Error unlocking mutex.\n");
     }
     return 1;
   }
-  if (my_write(response_fd, &event->cols, sizeof(size_t)) == -1) {
+  if (channel_write(channel, &event->cols, sizeof(size_t)) == -1) {
     print_error("Error writing to fd.\n");
-    if (pthread_mutex_unlock(&event->mutex) != 0) {
+    if (lockstats_mutex_unlock(&event->mutex, &event->lock_stats) != 0) {
       print_error("Error unlocking mutex.\n");
     }
     return 1;
   }
 
-  // Write the seat data to the buffer
-  for (size_t i = 0; i < event->rows * event->cols; i++) {
-    if (my_write(response_fd, &event->data[i], sizeof(unsigned int)) == -1) {
+  // Large seat maps are spliced into the pipe from a snapshot shared by every SHOW until the next reservation,
+  // so the event is not held while the client reads them
+  if (event->rows * event->cols * sizeof(unsigned int) >= SHOW_SPLICE_MIN_SIZE) {
+    if (event->snapshot == NULL) {
+      event->snapshot = snapshot_create(event->data, event->rows * event->cols);
+    }
+
+    struct SeatSnapshot* snapshot = event->snapshot;
+    if (snapshot != NULL) {
+      snapshot_acquire(snapshot);
+      if (lockstats_mutex_unlock(&event->mutex, &event->lock_stats) != 0) {
+        print_error("Error unlocking mutex.\n");
+      }
+
+      times = phase_start(&since);
+      int failed = channel_splice(channel, snapshot->seats, snapshot->size);
+      phase_end(times, OP_PHASE_RESPOND, &since);
+      snapshot_release(snapshot);
+      if (failed) {
+        print_error("Error writing to fd.\n");
+        return 1;
+      }
+      return 0;
+    }
+  }
+
+  // Write the seat data to the buffer, in chunks. Between two chunks, a waiting reservation is let through;
+  // if it changed the seats, the copy starts over, so the reply always shows the event at a single moment
+  size_t count = event->rows * event->cols;
+  size_t chunk = show_preempt_seats > 0 ? show_preempt_seats : count;
+  size_t seats_start = channel_pending(channel);
+  size_t restarts = 0;
+  size_t i = 0;
+  while (i < count) {
+    size_t size = count - i < chunk ? count - i : chunk;
+    if (channel_write(channel, &event->data[i], size * sizeof(unsigned int)) == -1) {
       print_error("Error writing to fd.\n");
-      if (pthread_mutex_unlock(&event->mutex) != 0) {
+      if (lockstats_mutex_unlock(&event->mutex, &event->lock_stats) != 0) {
         print_error("Error unlocking mutex.\n");
       }
       return 1;
     }
+    i += size;
+
+    if (i == count || show_preempt == NULL || restarts == SHOW_MAX_RESTARTS || atomic_load(&event->waiting) == 0) {
+      continue;
+    }
+
+    unsigned int reservations = event->reservations;
+    if (lockstats_mutex_unlock(&event->mutex, &event->lock_stats) != 0) {
+      print_error("Error unlocking mutex.\n");
+    }
+    show_preempt();
+    times = phase_start(&since);
+    if (lockstats_mutex_lock(&event->mutex, &event->lock_stats) != 0) {
+      print_error("Error locking mutex.\n");
+      return 1;
+    }
+    phase_end(times, OP_PHASE_LOCK, &since);
+
+    if (event->reservations != reservations) {
+      channel_truncate(channel, seats_start);
+      restarts++;
+      i = 0;
+    }
   }
 
-  if (pthread_mutex_unlock(&event->mutex) != 0) {
+  if (lockstats_mutex_unlock(&event->mutex, &event->lock_stats) != 0) {
     print_error("Error unlocking mutex.\n");
   }
   return 0;
 }
 
 /**
- * Sends information about a specified event to the standard output.
+ * Sends information about a specified event to the standard output, through a writer the caller flushes.
  *
+ * @param out The writer over the standard output.
  * @param event_id The ID of the event to get information about.
  * @return 0 on success, 1 on failure.
  */
-int ems_show_stdout(unsigned int event_id) {
+int ems_show_stdout(struct Writer* out, unsigned int event_id) {
 
   if (event_list == NULL) {
     print_error("EMS state must be initialized.\n");
     return 1;
   }
 
-  if (pthread_rwlock_rdlock(&event_list->rwl) != 0) {
+  if (lockstats_rdlock(&event_list->rwl, &event_list->lock_stats) != 0) {
     print_error("Error locking list rwl.\n");
     return 1;
   }
 
   struct Event* event = get_event_with_delay(event_id, event_list->head, event_list->tail);
 
-  if (pthread_rwlock_unlock(&event_list->rwl) != 0) {
+  if (lockstats_rwlock_unlock(&event_list->rwl, &event_list->lock_stats) != 0) {
     print_error("Error unlocking list rwl.\n");
   }
 
@@ -361,69 +939,197 @@ int ems_show_stdout(unsigned int event_id) {
     print_error("Event not found.\n");
     return 1;
   }
+  seat_store_use(event);
 
-  if (pthread_mutex_lock(&event->mutex) != 0) {
+  if (lockstats_mutex_lock(&event->mutex, &event->lock_stats) != 0) {
     print_error("Error locking mutex.\n");
     return 1;
   }
 
   for (size_t i = 1; i <= event->rows; i++) {
     for (size_t j = 1; j <= event->cols; j++) {
-      char buffer[16];
-      sprintf(buffer, "%u", event->data[seat_index(event, i, j)]);
-
-      if (print_str(STDOUT_FILENO, buffer)) {
+      if (writer_uint(out, event->data[seat_index(event, i, j)]) || (j < event->cols && writer_char(out, ' '))) {
         print_error("Error writing to file descriptor.\n");
-        pthread_mutex_unlock(&event->mutex);
+        lockstats_mutex_unlock(&event->mutex, &event->lock_stats);
         return 1;
       }
-
-      if (j < event->cols) {
-        if (print_str(STDOUT_FILENO, " ")) {
-          print_error("Error writing to file descriptor.\n");
-          pthread_mutex_unlock(&event->mutex);
-          return 1;
-        }
-      }
     }
 
-    if (print_str(STDOUT_FILENO, "\n")) {
+    if (writer_char(out, '\n')) {
       print_error("Error writing to file descriptor.\n");
-      pthread_mutex_unlock(&event->mutex);
+      lockstats_mutex_unlock(&event->mutex, &event->lock_stats);
       return 1;
     }
   }
 
-  pthread_mutex_unlock(&event->mutex);
+  lockstats_mutex_unlock(&event->mutex, &event->lock_stats);
   return 0;
 }
 
 /**
- * Lists all events and their IDs, sending the information to the specified file descriptor.
+ * @struct DumpedEvent
+ * @brief An event copied for a dump, whose seats follow those of the previous one in the copy.
+ */
+struct DumpedEvent {
+  unsigned int id;
+  size_t rows;
+  size_t cols;
+};
+
+/**
+ * Copies every event, each under its own mutex and without the state access delay, then prints the copies as
+ * ems_show_stdout does, each after an "Event: <id>" line.
  *
- * @param out_fd The file descriptor to send the information to.
+ * @param out Writer to print the events through, flushed by the caller.
+ * @return 0 on success, 1 if there were no events or on failure.
+ */
+int ems_dump(struct Writer* out) {
+  if (event_list == NULL) {
+    print_error("EMS state must be initialized.\n");
+    return 1;
+  }
+
+  if (lockstats_rdlock(&event_list->rwl, &event_list->lock_stats) != 0) {
+    print_error("Error locking list rwl.\n");
+    return 1;
+  }
+  struct ListNode* head = event_list->head;
+  struct ListNode* tail = event_list->tail;
+  if (lockstats_rwlock_unlock(&event_list->rwl, &event_list->lock_stats) != 0) {
+    print_error("Error unlocking list rwl.\n");
+  }
+
+  if (tail == NULL) {
+    print_error("No event details to print.\n");
+    return 1;
+  }
+
+  // Events are only ever appended, so the nodes up to the tail stay put while they are copied
+  struct DumpedEvent* events = NULL;
+  unsigned int* seats = NULL;
+  size_t count = 0, events_capacity = 0, seats_used = 0, seats_capacity = 0;
+  int failed = 0;
+  for (struct ListNode* node = head; node != NULL && !failed; node = node == tail ? NULL : node->next) {
+    struct Event* event = node->event;
+    size_t size = event->rows * event->cols;
+    if (count == events_capacity) {
+      events_capacity = events_capacity > 0 ? 2 * events_capacity : 64;
+      struct DumpedEvent* grown = realloc(events, events_capacity * sizeof(struct DumpedEvent));
+      failed = grown == NULL;
+      events = grown != NULL ? grown : events;
+    }
+    if (!failed && seats_used + size > seats_capacity) {
+      seats_capacity = seats_used + size > 2 * seats_capacity ? seats_used + size : 2 * seats_capacity;
+      unsigned int* grown = realloc(seats, seats_capacity * sizeof(unsigned int));
+      failed = grown == NULL;
+      seats = grown != NULL ? grown : seats;
+    }
+    if (failed) {
+      print_error("Error allocating memory for the dump.\n");
+      break;
+    }
+
+    // Cold seats in the seat file are read back in as a whole
+    seat_store_use(event);
+    if (lockstats_mutex_lock(&event->mutex, &event->lock_stats) != 0) {
+      print_error("Error locking mutex.\n");
+      failed = 1;
+      break;
+    }
+    memcpy(seats + seats_used, event->data, size * sizeof(unsigned int));
+    if (lockstats_mutex_unlock(&event->mutex, &event->lock_stats) != 0) {
+      print_error("Error unlocking mutex.\n");
+    }
+    events[count++] = (struct DumpedEvent){event->id, event->rows, event->cols};
+    seats_used += size;
+  }
+
+  // Printed with no lock held, so a slow output only holds up the dump
+  if (!failed) {
+    const unsigned int* seat = seats;
+    for (size_t i = 0; i < count && !failed; i++) {
+      failed = writer_str(out, "Event: ") || writer_uint(out, events[i].id) || writer_char(out, '\n');
+      for (size_t row = 0; row < events[i].rows && !failed; row++) {
+        for (size_t col = 0; col < events[i].cols && !failed; col++) {
+          failed = writer_uint(out, *seat++) || (col + 1 < events[i].cols && writer_char(out, ' '));
+        }
+        failed = failed || writer_char(out, '\n');
+      }
+    }
+    if (failed) {
+      print_error("Error printing event.\n");
+    }
+  }
+
+  free(events);
+  free(seats);
+  return failed;
+}
+
+/**
+ * Gathers the contention of the event list lock and of the event mutexes, and finds the most contended events.
+ *
+ * @param report Pointer to store the report in.
  * @return 0 on success, 1 on failure.
  */
-int ems_list_events(int out_fd) {
+int ems_lock_report(struct LockReport* report) {
+  memset(report, 0, sizeof(*report));
+  if (event_list == NULL) {
+    print_error("EMS state must be initialized.\n");
+    return 1;
+  }
+
+  // Taken without profiling, so the report does not count itself
+  lockstats_read(&event_list->lock_stats, &report->list);
+  if (pthread_rwlock_rdlock(&event_list->rwl) != 0) {
+    print_error("Error locking list rwl.\n");
+    return 1;
+  }
+  struct ListNode* head = event_list->head;
+  struct ListNode* tail = event_list->tail;
+  if (pthread_rwlock_unlock(&event_list->rwl) != 0) {
+    print_error("Error unlocking list rwl.\n");
+  }
+
+  // Events are only ever appended, so the nodes up to the tail stay put without the lock
+  for (struct ListNode* node = tail != NULL ? head : NULL; node != NULL; node = node == tail ? NULL : node->next) {
+    struct LockCounts counts;
+    lockstats_read(&node->event->lock_stats, &counts);
+    lockstats_add(&report->events, &counts);
+    lockstats_rank(report, node->event->id, &counts);
+  }
+  return 0;
+}
+
+/**
+ * Lists all events and their IDs, sending the information to the client through its session channel.
+ *
+ * @param channel The session channel to send the information to.
+ * @return 0 on success, 1 on failure.
+ */
+int ems_list_events(struct Channel* channel) {
   int result = 1;
   if (event_list == NULL) {
     print_error("EMS state must be initialized.\n");
 
-    if (my_write(out_fd, &result, sizeof(int)) == -1) {
+    if (channel_write(channel, &result, sizeof(int)) == -1) {
       print_error("Error writing to fd.\n");
     }
     return 1;
   }
 
-  if (pthread_rwlock_rdlock(&event_list->rwl) != 0) {
+  struct timespec since;
+  struct OpTimes* times = phase_start(&since);
+  if (lockstats_rdlock(&event_list->rwl, &event_list->lock_stats) != 0) {
     print_error("Error locking list rwl.\n");
 
-    if (my_write(out_fd, &result, sizeof(int)) == -1) {
+    if (channel_write(channel, &result, sizeof(int)) == -1) {
       print_error("Error writing to fd.\n");
     }
 
     return 1;
   }
+  phase_end(times, OP_PHASE_LOCK, &since);
 
   struct ListNode* to = event_list->tail;
   struct ListNode* current = event_list->head;
@@ -431,8 +1137,8 @@ int ems_list_events(int out_fd) {
   result = 2;
 
   if (current == NULL) {
-    my_write(out_fd, &result, sizeof(int));
-    if (pthread_rwlock_unlock(&event_list->rwl) != 0) {
+    channel_write(channel, &result, sizeof(int));
+    if (lockstats_rwlock_unlock(&event_list->rwl, &event_list->lock_stats) != 0) {
       print_error("Error unlocking list rwl.\n");
     }
     return 1;
@@ -440,9 +1146,9 @@ int ems_list_events(int out_fd) {
 
   result = 0;
   // If there are events, write 0 followed by the number of events followed by the event ids
-  if (my_write(out_fd, &result, sizeof(int)) == -1) {
+  if (channel_write(channel, &result, sizeof(int)) == -1) {
     print_error("Error writing to fd.\n");
-    if (pthread_rwlock_unlock(&event_list->rwl) != 0) {
+    if (lockstats_rwlock_unlock(&event_list->rwl, &event_list->lock_stats) != 0) {
       print_error("Error unlocking list rwl.\n");
     }
     return 1;
@@ -459,9 +1165,9 @@ int ems_list_events(int out_fd) {
     current = current->next;
   }
 
-  if (my_write(out_fd, &num_events, sizeof(size_t)) == -1) {
+  if (channel_write(channel, &num_events, sizeof(size_t)) == -1) {
     print_error("Error writing to fd.\n");
-    if (pthread_rwlock_unlock(&event_list->rwl) != 0) {
+    if (lockstats_rwlock_unlock(&event_list->rwl, &event_list->lock_stats) != 0) {
       print_error("Error unlocking list rwl.\n");
     }
     return 1;
@@ -470,9 +1176,9 @@ int ems_list_events(int out_fd) {
   current = event_list->head;
 
   while (1) {
-    if (my_write(out_fd, &(current->event)->id, sizeof(unsigned int)) == -1) {
+    if (channel_write(channel, &(current->event)->id, sizeof(unsigned int)) == -1) {
       print_error("Error writing to fd.\n");
-      if (pthread_rwlock_unlock(&event_list->rwl) != 0) {
+      if (lockstats_rwlock_unlock(&event_list->rwl, &event_list->lock_stats) != 0) {
         print_error("Error unlocking list rwl.\n");
       }
       return 1;
@@ -485,7 +1191,7 @@ int ems_list_events(int out_fd) {
     current = current->next;
   }
 
-  if (pthread_rwlock_unlock(&event_list->rwl) != 0) {
+  if (lockstats_rwlock_unlock(&event_list->rwl, &event_list->lock_stats) != 0) {
     print_error("Error unlocking list rwl.\n");
   }
   return 0;
@@ -2,12 +2,90 @@
 #define SERVER_OPERATIONS_H
 
 #include <stddef.h>
+#include <stdint.h>
+
+#include "wal.h"
+
+struct Channel;
+struct CheckpointStats;
+struct LockReport;
+struct OpTimes;
+struct Writer;
 
 /// Initializes the EMS state.
 /// @param delay_us Delay in microseconds.
 /// @return 0 if the EMS state was initialized successfully, 1 otherwise.
 int ems_init(unsigned int delay_us);
 
+/// Sets the points where SHOW replies copying a seat map let waiting reservations run first.
+/// @param seats Number of seats copied between two points, or 0 to copy the seat map in one go.
+/// @param preempt Called at each point where a reservation waits for the event, with no lock held.
+void ems_set_show_preemption(size_t seats, void (*preempt)(void));
+
+/// Gathers the contention of the event list lock and of the event mutexes, and finds the most contended events.
+/// The counters only move while lock profiling is on.
+/// @param report Pointer to store the report in.
+/// @return 0 on success, 1 on failure.
+int ems_lock_report(struct LockReport* report);
+
+/// Sets where the time operations spend looking events up, waiting for locks and splicing replies is added.
+/// @param times Returns the times of the operation the calling thread runs, or NULL if it is not timed.
+void ems_set_op_timing(struct OpTimes* (*times)(void));
+
+/// Restores the state from a data directory, by mapping its checkpoint and replaying its write-ahead log from there,
+/// then appends every create and reservation to the log before acknowledging them.
+/// @param data_dir Directory holding the checkpoint and the log, which are created if they do not exist.
+/// @param durability When logged changes are acknowledged.
+/// @return 0 if the state was restored and the log opened, 1 otherwise.
+int ems_recover(const char* data_dir, enum WalDurability durability);
+
+/// Writes a checkpoint of the state to the data directory, copying each event under its own mutex only, so the
+/// next restart maps it and replays just the changes logged after it. The log segments it makes obsolete are removed.
+/// @param stats Pointer to store what the checkpoint held in, or NULL.
+/// @return 0 if the checkpoint was written, 1 otherwise.
+int ems_checkpoint(struct CheckpointStats* stats);
+
+/// Keeps the seats of every event created from now on in a file-backed mapping, which the kernel pages out as
+/// memory runs short, instead of on the heap.
+/// @param path Path to the seat file, emptied and removed once open.
+/// @param prefault 1 to fault in the seats of each event as it is created.
+/// @return 0 if the seat file was opened, 1 otherwise.
+int ems_open_seat_file(const char* path, int prefault);
+
+/// Pages out the seats of the events in the seat file that were not used for a while, so memory holds the events in
+/// use. They are read back in as a whole when next used.
+/// @param idle_s Seconds an event must have gone unused.
+/// @return Number of events paged out.
+size_t ems_sweep_cold_seats(unsigned int idle_s);
+
+/// Numbers every change made from now on and sends it to the followers that connect to a Unix socket, after a
+/// snapshot of the state.
+/// @param path Path of the socket, which must not exist.
+/// @return 0 if the socket is listening, 1 otherwise.
+int ems_replicate(const char* path);
+
+/// Follows a primary from a thread of its own: applies its snapshot, then its changes as they come. Clients may still
+/// show and list events, but no longer create events or reserve seats.
+/// @param path Path of the socket of the primary.
+/// @return 0 if the thread was started, 1 otherwise.
+int ems_follow(const char* path);
+
+/// Adds an event of the snapshot of the primary, seats and reservations included, to the state of a follower.
+/// @param event_id Id of the event.
+/// @param num_rows Number of rows of the event.
+/// @param num_cols Number of columns of the event.
+/// @param reservations Number of reservations the event holds.
+/// @param seats Reservation of each seat.
+/// @param seq Sequence number of the last change the event holds.
+/// @return 0 if the event was added, 1 otherwise.
+int ems_restore_event(unsigned int event_id, size_t num_rows, size_t num_cols, unsigned int reservations,
+                      const unsigned int* seats, uint64_t seq);
+
+/// Applies a change of the primary to the state of a follower, unless the snapshot already held it.
+/// @param record The change, its lsn being its sequence number.
+/// @return 0 if the change was applied or skipped, 1 otherwise.
+int ems_apply_change(const struct WalRecord* record);
+
 /// Destroys the EMS state.
 int ems_terminate();
 
@@ -27,22 +105,29 @@ int ems_create(unsigned int event_id, size_t num_rows, size_t num_cols);
 /// @param xs Array of rows of the seats to reserve.
 /// @param ys Array of columns of the seats to reserve.
 /// @return 0 if the reservation was created successfully, 1 otherwise.
-int ems_reserve(unsigned int event_id, size_t num_seats, size_t *xs, size_t *ys);
+int ems_reserve(unsigned int event_id, size_t num_seats, const size_t *xs, const size_t *ys);
 
 /// Prints the given event.
-/// @param out_fd File descriptor to print the event to.
+/// @param channel Session channel to print the event to.
 /// @param event_id Id of the event to print.
 /// @return 0 if the event was printed successfully, 1 otherwise.
-int ems_show(int out_fd, unsigned int event_id);
+int ems_show(struct Channel* channel, unsigned int event_id);
 
 /// Prints the given event in standard output.
+/// @param out Writer over standard output to print the event through, flushed by the caller.
 /// @param event_id Id of the event to print.
 /// @return 0 if the event was printed successfully, 1 otherwise.
-int ems_show_stdout(unsigned int event_id);
+int ems_show_stdout(struct Writer* out, unsigned int event_id);
+
+/// Copies every event, each under its own mutex and without the state access delay, then prints the copies as
+/// ems_show_stdout does, each after an "Event: <id>" line. No lock is held while the copies are printed.
+/// @param out Writer to print the events through, flushed by the caller.
+/// @return 0 if the events were printed successfully, 1 if there were none or on failure.
+int ems_dump(struct Writer* out);
 
 /// Prints all the events.
-/// @param out_fd File descriptor to print the events to.
+/// @param channel Session channel to print the events to.
 /// @return 0 if the events were printed successfully, 1 otherwise.
-int ems_list_events(int out_fd);
+int ems_list_events(struct Channel* channel);
 
 #endif  // SERVER_OPERATIONS_H
\ No newline at end of file
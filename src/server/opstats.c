@@ -0,0 +1,170 @@
+#include "opstats.h"
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common/histogram.h"
+#include "common/io.h"
+
+/**
+ * @struct WorkerHistograms
+ * @brief Histograms a worker records its operations in. Each starts on a cache line of its own, so workers never
+ * write to the same line; its mutex is only ever contended by a report being merged.
+ */
+struct WorkerHistograms {
+  _Alignas(64) pthread_mutex_t mutex;
+  struct Histogram phases[TIMED_OP_COUNT][OP_PHASE_COUNT];
+};
+
+static struct WorkerHistograms* histograms = NULL;
+static size_t worker_count = 0;
+static _Thread_local struct WorkerHistograms* own = NULL;  // Histograms of the worker running on this thread
+
+// Span each phase added to an operation is traced as; execution and the total are worked out, never added
+static const enum SpanKind phase_spans[OP_PHASE_COUNT] = {
+    [OP_PHASE_QUEUE] = SPAN_QUEUE,
+    [OP_PHASE_LOOKUP] = SPAN_LOOKUP,
+    [OP_PHASE_LOCK] = SPAN_LOCK,
+    [OP_PHASE_RESPOND] = SPAN_RESPOND,
+};
+
+/**
+ * Gets the time between two instants in nanoseconds, 0 if the clock went backwards.
+ */
+static size_t between_ns(const struct timespec* from, const struct timespec* to) {
+  long long elapsed = (to->tv_sec - from->tv_sec) * 1000000000LL + (to->tv_nsec - from->tv_nsec);
+  return elapsed > 0 ? (size_t)elapsed : 0;
+}
+
+/**
+ * Gets the time elapsed since an instant in nanoseconds, 0 if the clock went backwards.
+ */
+static size_t elapsed_ns(const struct timespec* since) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return between_ns(since, &now);
+}
+
+/**
+ * Allocates the histograms of each worker, each on cache lines of its own.
+ *
+ * @param workers Number of workers, the most the pool may grow to.
+ * @return 0 on success, 1 on failure.
+ */
+int opstats_init(size_t workers) {
+  histograms = aligned_alloc(_Alignof(struct WorkerHistograms), workers * sizeof(struct WorkerHistograms));
+  if (histograms == NULL) {
+    print_error("Error allocating latency histograms.\n");
+    return 1;
+  }
+
+  for (size_t i = 0; i < workers; i++) {
+    pthread_mutex_init(&histograms[i].mutex, NULL);
+    for (size_t op = 0; op < TIMED_OP_COUNT; op++) {
+      for (size_t phase = 0; phase < OP_PHASE_COUNT; phase++) {
+        histogram_init(&histograms[i].phases[op][phase]);
+      }
+    }
+  }
+  worker_count = workers;
+  return 0;
+}
+
+/**
+ * Makes the calling thread record into the histograms of a worker.
+ *
+ * @param worker Index of the worker.
+ */
+void opstats_attach(size_t worker) { own = worker < worker_count ? &histograms[worker] : NULL; }
+
+/**
+ * Starts timing an operation whose op code was just read.
+ *
+ * @param times Times of the session.
+ * @param started When the op code was read, or when the poller woke the session for it.
+ */
+void opstats_begin(struct OpTimes* times, const struct timespec* started) {
+  times->started = *started;
+  memset(times->ns, 0, sizeof(times->ns));
+}
+
+/**
+ * Adds the time elapsed since an instant to a phase of the running operation, and records it as a span when
+ * tracing.
+ *
+ * @param times Times of the session.
+ * @param phase The phase.
+ * @param since When the phase started.
+ */
+void opstats_add(struct OpTimes* times, enum OpPhase phase, const struct timespec* since) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  times->ns[phase] += between_ns(since, &now);
+  if (trace_enabled()) {
+    trace_span(phase_spans[phase], &times->trace, since, &now);
+  }
+}
+
+/**
+ * Records the phases of an operation whose reply was handed over in the histograms of the calling worker.
+ *
+ * @param op The operation.
+ * @param times Times of the session.
+ */
+void opstats_record(enum TimedOp op, struct OpTimes* times) {
+  if (own == NULL) {
+    return;
+  }
+
+  size_t total = elapsed_ns(&times->started), accounted = 0;
+  for (size_t phase = 0; phase < OP_PHASE_EXECUTE; phase++) {
+    accounted += times->ns[phase];
+  }
+  accounted += times->ns[OP_PHASE_RESPOND];
+  times->ns[OP_PHASE_EXECUTE] = total > accounted ? total - accounted : 0;
+  times->ns[OP_PHASE_TOTAL] = total;
+
+  pthread_mutex_lock(&own->mutex);
+  for (size_t phase = 0; phase < OP_PHASE_COUNT; phase++) {
+    histogram_record(&own->phases[op][phase], times->ns[phase]);
+  }
+  pthread_mutex_unlock(&own->mutex);
+}
+
+/**
+ * Merges the histograms of every worker into the STATS reply.
+ *
+ * @param values Array of STATS_OPS * STATS_PHASES * STATS_VALUES values to store the report in.
+ * @return 0 on success, 1 on failure.
+ */
+int opstats_report(size_t* values) {
+  // Too large for the stack of a session coroutine
+  struct Histogram* merged = malloc(sizeof(struct Histogram));
+  if (merged == NULL) {
+    print_error("Error allocating latency histograms.\n");
+    return 1;
+  }
+
+  for (size_t op = 0; op < TIMED_OP_COUNT; op++) {
+    for (size_t phase = 0; phase < OP_PHASE_COUNT; phase++) {
+      histogram_init(merged);
+      for (size_t i = 0; i < worker_count; i++) {
+        pthread_mutex_lock(&histograms[i].mutex);
+        histogram_merge(merged, &histograms[i].phases[op][phase]);
+        pthread_mutex_unlock(&histograms[i].mutex);
+      }
+
+      size_t* value = values + (op * OP_PHASE_COUNT + phase) * STATS_VALUES;
+      value[0] = merged->count;
+      value[1] = histogram_percentile(merged, 50);
+      value[2] = histogram_percentile(merged, 99);
+      value[3] = histogram_percentile(merged, 99.9);
+      value[4] = merged->max;
+    }
+  }
+
+  free(merged);
+  return 0;
+}
@@ -0,0 +1,84 @@
+#ifndef SERVER_OPSTATS_H
+#define SERVER_OPSTATS_H
+
+#include <stddef.h>
+#include <time.h>
+
+#include "common/constants.h"
+#include "trace.h"
+
+/**
+ * @enum TimedOp
+ * @brief Operation whose latency is broken down, in the order of the STATS reply.
+ */
+enum TimedOp {
+  TIMED_CREATE,
+  TIMED_RESERVE,
+  TIMED_SHOW,
+  TIMED_LIST,
+  TIMED_OP_COUNT,  // Number of operations
+};
+
+/**
+ * @enum OpPhase
+ * @brief Where the time of an operation went, in the order of the STATS reply.
+ */
+enum OpPhase {
+  OP_PHASE_QUEUE,    // Waiting for a worker once the poller woke the session for its op code or its turn was spent,
+                     // for its lane, and while a SHOW let reservations through
+  OP_PHASE_LOOKUP,   // Finding the event in the state, the state access delay included
+  OP_PHASE_LOCK,     // Waiting for the list lock and the event mutex
+  OP_PHASE_EXECUTE,  // The rest: reading its arguments, running it and building its reply
+  OP_PHASE_RESPOND,  // Handing the reply to the session pipes, and splicing large seat maps into them
+  OP_PHASE_TOTAL,    // From its op code being read, or the session being woken for it, until its reply was handed over
+  OP_PHASE_COUNT,    // Number of phases
+};
+
+_Static_assert(TIMED_OP_COUNT == STATS_OPS && OP_PHASE_COUNT == STATS_PHASES, "STATS reply layout");
+
+/**
+ * @struct OpTimes
+ * @brief Time the running operation of a session spent in each phase so far, kept by the session since its
+ * coroutine may move between workers.
+ */
+struct OpTimes {
+  struct timespec started;    // When the op code was read, or when the session was woken for it
+  size_t ns[OP_PHASE_COUNT];  // Nanoseconds spent in each phase
+  struct TraceId trace;       // Request the spans of its phases belong to, when tracing
+};
+
+/// Allocates the histograms of each worker, each on cache lines of its own.
+/// @param workers Number of workers, the most the pool may grow to.
+/// @return 0 on success, 1 on failure.
+int opstats_init(size_t workers);
+
+/// Makes the calling thread record into the histograms of a worker.
+/// @param worker Index of the worker.
+void opstats_attach(size_t worker);
+
+/// Starts timing an operation whose op code was just read.
+/// @param times Times of the session.
+/// @param started When the op code was read, or when the poller woke the session for it if the session had to
+///                wait for it.
+void opstats_begin(struct OpTimes* times, const struct timespec* started);
+
+/// Adds the time elapsed since an instant to a phase of the running operation, and records it as a span when
+/// tracing.
+/// @param times Times of the session.
+/// @param phase The phase.
+/// @param since When the phase started.
+void opstats_add(struct OpTimes* times, enum OpPhase phase, const struct timespec* since);
+
+/// Records the phases of an operation whose reply was handed over in the histograms of the calling worker. Its
+/// execution is the time not spent in any other phase.
+/// @param op The operation.
+/// @param times Times of the session.
+void opstats_record(enum TimedOp op, struct OpTimes* times);
+
+/// Merges the histograms of every worker into the STATS reply: for each operation and phase, the number of
+/// operations recorded, then the p50, p99, p999 and largest times in nanoseconds.
+/// @param values Array of STATS_OPS * STATS_PHASES * STATS_VALUES values to store the report in.
+/// @return 0 on success, 1 on failure.
+int opstats_report(size_t* values);
+
+#endif  // SERVER_OPSTATS_H
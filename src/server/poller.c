@@ -0,0 +1,352 @@
+#include "poller.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <time.h>
+
+#include "common/constants.h"
+#include "common/io.h"
+#include "uring.h"
+
+/**
+ * @struct PollerWait
+ * @brief What a suspended coroutine is waiting for. It lives on the coroutine's stack until it is resumed.
+ */
+struct PollerWait {
+  struct Coroutine* coroutine;  // Coroutine to resume
+  int fd;                       // File descriptor being watched
+  uint32_t events;              // Events being watched for
+  int timed;                    // 1 if the wait is in the timed list
+  struct timespec deadline;     // When a timed wait gives up
+  int failed;                   // Set to 1 when the wait timed out or could not be registered
+  struct PollerWait* prev;      // Previous timed wait
+  struct PollerWait* next;      // Next timed wait
+  struct PollerOp* ops;         // io_uring operations being waited for
+  unsigned remaining;           // Number of operations not completed yet
+};
+
+static void (*wake_function)(struct Coroutine*) = NULL;
+static int epoll_fd = -1;
+
+// Waits with a timeout, checked by the poller thread on every tick
+static pthread_mutex_t timed_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct PollerWait* timed_waits = NULL;
+
+// Ring shared by every carrier thread. Carriers submit under the mutex; only the poller thread reaps.
+static struct Uring ring;
+static int ring_ready = 0;
+static pthread_mutex_t ring_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * Adds a wait to the timed list.
+ *
+ * @note timed_mutex must be held.
+ */
+static void link_timed(struct PollerWait* wait) {
+  wait->prev = NULL;
+  wait->next = timed_waits;
+  if (timed_waits != NULL) {
+    timed_waits->prev = wait;
+  }
+  timed_waits = wait;
+}
+
+/**
+ * Removes a wait from the timed list.
+ *
+ * @note timed_mutex must be held.
+ */
+static void unlink_timed(struct PollerWait* wait) {
+  if (wait->prev != NULL) {
+    wait->prev->next = wait->next;
+  } else {
+    timed_waits = wait->next;
+  }
+  if (wait->next != NULL) {
+    wait->next->prev = wait->prev;
+  }
+}
+
+/**
+ * Watches the file descriptor of a wait, once its coroutine is suspended.
+ *
+ * The registration is one-shot, so the poller thread resumes the coroutine exactly once. Timed waits are
+ * listed and registered under the same lock the poller thread takes to expire them, so a wait can never
+ * expire before it is registered.
+ *
+ * @param arg The wait.
+ */
+static void park_wait(void* arg) {
+  // The coroutine may run again as soon as the file descriptor is watched, so its fields are copied first
+  struct PollerWait* wait = arg;
+  struct Coroutine* coroutine = wait->coroutine;
+  int fd = wait->fd;
+  int timed = wait->timed;
+  struct epoll_event event = {.events = wait->events | EPOLLONESHOT, .data.ptr = wait};
+
+  if (timed) {
+    pthread_mutex_lock(&timed_mutex);
+    link_timed(wait);
+  }
+
+  // Session pipes are watched many times, so try re-arming first
+  int registered = epoll_ctl(epoll_fd, EPOLL_CTL_MOD, fd, &event) == 0 ||
+                   (errno == ENOENT && epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event) == 0);
+
+  if (timed) {
+    if (!registered) {
+      unlink_timed(wait);
+    }
+    pthread_mutex_unlock(&timed_mutex);
+  }
+
+  if (!registered) {
+    print_error("Error watching session pipe.\n");
+    wait->failed = 1;
+    wake_function(coroutine);
+  }
+}
+
+/**
+ * Submits the io_uring operations of a wait, once its coroutine is suspended.
+ *
+ * The submission ring is empty whenever the lock is free, so the operations only fail to queue if there
+ * are more of them than ring entries. They are then all dropped, so a linked operation is never followed
+ * by another coroutine's.
+ *
+ * @param arg The wait.
+ */
+static void park_submit(void* arg) {
+  struct PollerWait* wait = arg;
+  struct Coroutine* coroutine = wait->coroutine;
+  unsigned count = wait->remaining;
+  int failed = 0;
+
+  pthread_mutex_lock(&ring_mutex);
+  unsigned queued = ring.queued;
+  for (unsigned i = 0; i < count && !failed; i++) {
+    struct PollerOp* op = &wait->ops[i];
+    op->wait = wait;
+    uint64_t user_data = (uint64_t)(uintptr_t)op;
+    if (op->write) {
+      failed = uring_queue_write(&ring, op->fd, op->buffer, op->size, user_data, op->link);
+    } else {
+      failed = uring_queue_read(&ring, op->fd, op->buffer, op->size, user_data, op->link);
+    }
+  }
+
+  // Once submitted, the operations may complete and the coroutine run again before the lock is released
+  if (failed) {
+    ring.queued = queued;
+    wait->failed = 1;
+  } else if (uring_submit_and_wait(&ring, 0) != 0) {
+    // Published entries are still picked up by the next submission
+    print_error("Error submitting session I/O.\n");
+  }
+  pthread_mutex_unlock(&ring_mutex);
+
+  if (failed) {
+    print_error("Too many session I/O operations at once.\n");
+    wake_function(coroutine);
+  }
+}
+
+/**
+ * Resumes the coroutine of a ready or expired wait.
+ *
+ * @note Runs on the poller thread. The wait must not be touched after this returns, since the coroutine
+ * may already be running again.
+ * @param wait The wait.
+ * @param failed 1 if the wait timed out.
+ */
+static void finish_wait(struct PollerWait* wait, int failed) {
+  if (wait->timed) {
+    pthread_mutex_lock(&timed_mutex);
+    unlink_timed(wait);
+    pthread_mutex_unlock(&timed_mutex);
+  }
+
+  wait->failed = failed;
+  wake_function(wait->coroutine);
+}
+
+/**
+ * Takes every completion from the ring and resumes the coroutines whose operations all completed.
+ */
+static void reap_completions(void) {
+  uint64_t user_data;
+  int result;
+  while (uring_reap(&ring, &user_data, &result) == 0) {
+    struct PollerOp* op = (struct PollerOp*)(uintptr_t)user_data;
+    struct PollerWait* wait = op->wait;
+    op->result = result;
+    if (--wait->remaining == 0) {
+      wake_function(wait->coroutine);
+    }
+  }
+}
+
+/**
+ * Stops watching the timed waits past their deadline and resumes their coroutines.
+ *
+ * @param now The current time.
+ */
+static void expire_waits(const struct timespec* now) {
+  struct PollerWait* expired = NULL;
+
+  pthread_mutex_lock(&timed_mutex);
+  struct PollerWait* wait = timed_waits;
+  while (wait != NULL) {
+    struct PollerWait* next = wait->next;
+    if (now->tv_sec > wait->deadline.tv_sec ||
+        (now->tv_sec == wait->deadline.tv_sec && now->tv_nsec >= wait->deadline.tv_nsec)) {
+      unlink_timed(wait);
+      epoll_ctl(epoll_fd, EPOLL_CTL_DEL, wait->fd, NULL);
+      wait->next = expired;
+      expired = wait;
+    }
+    wait = next;
+  }
+  pthread_mutex_unlock(&timed_mutex);
+
+  while (expired != NULL) {
+    wait = expired;
+    expired = wait->next;
+    wait->timed = 0;
+    finish_wait(wait, 1);
+  }
+}
+
+/**
+ * Poller thread function: waits for session pipes and ring completions, and resumes the coroutines
+ * waiting for them.
+ *
+ * @return NULL
+ */
+static void* poller_loop() {
+  // Leave SIGUSR1 to the dump thread
+  sigset_t set;
+  sigemptyset(&set);
+  sigaddset(&set, SIGUSR1);
+  pthread_sigmask(SIG_BLOCK, &set, NULL);
+
+  struct epoll_event events[POLLER_BATCH];
+  struct timespec last_check;
+  clock_gettime(CLOCK_MONOTONIC, &last_check);
+  while (1) {
+    int count = epoll_wait(epoll_fd, events, POLLER_BATCH, POLLER_TICK_MS);
+    if (count == -1 && errno != EINTR) {
+      print_error("Error waiting for session pipes.\n");
+    }
+
+    for (int i = 0; i < count; i++) {
+      if (events[i].data.ptr == NULL) {
+        reap_completions();
+      } else {
+        finish_wait(events[i].data.ptr, 0);
+      }
+    }
+
+    // Timeouts only need tick precision, and checking them walks every timed wait
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if ((now.tv_sec - last_check.tv_sec) * 1000 + (now.tv_nsec - last_check.tv_nsec) / 1000000 >= POLLER_TICK_MS) {
+      expire_waits(&now);
+      last_check = now;
+    }
+  }
+
+  return NULL;
+}
+
+/**
+ * Creates the epoll instance and, with io_uring, the shared ring, then starts the poller thread.
+ *
+ * @param wake Called with each coroutine that can run again.
+ * @param use_uring 1 to create the ring.
+ * @param max_operations Maximum number of io_uring operations in flight, used to size the completion ring.
+ * @return 0 on success, 1 on failure.
+ */
+int poller_init(void (*wake)(struct Coroutine*), int use_uring, size_t max_operations) {
+  wake_function = wake;
+  epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+  if (epoll_fd == -1) {
+    print_error("Error creating epoll instance.\n");
+    return 1;
+  }
+
+  if (use_uring) {
+    // Every in-flight operation needs a completion slot, or completions pile up in the kernel
+    unsigned cq_entries = max_operations > 2 * POLLER_RING_ENTRIES ? (unsigned)max_operations : 0;
+    struct epoll_event event = {.events = EPOLLIN, .data.ptr = NULL};
+    if (uring_init(&ring, POLLER_RING_ENTRIES, cq_entries) != 0 ||
+        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, ring.fd, &event) != 0) {
+      print_error("Error creating io_uring.\n");
+      return 1;
+    }
+    ring_ready = 1;
+  }
+
+  pthread_t thread;
+  if (pthread_create(&thread, NULL, poller_loop, NULL) != 0 || pthread_detach(thread) != 0) {
+    print_error("Error creating poller thread.\n");
+    return 1;
+  }
+
+  return 0;
+}
+
+/**
+ * Suspends the calling coroutine until a file descriptor is ready, or until the timeout expires.
+ *
+ * @param fd File descriptor to watch.
+ * @param events EPOLLIN or EPOLLOUT.
+ * @param timeout_ms Maximum time to wait in milliseconds, or -1 to wait forever.
+ * @return 0 once the file descriptor is ready, 1 on timeout or failure.
+ */
+int poller_wait(int fd, uint32_t events, int timeout_ms) {
+  struct PollerWait wait;
+  memset(&wait, 0, sizeof(wait));
+  wait.coroutine = coroutine_current();
+  wait.fd = fd;
+  wait.events = events;
+
+  if (timeout_ms >= 0) {
+    wait.timed = 1;
+    clock_gettime(CLOCK_MONOTONIC, &wait.deadline);
+    wait.deadline.tv_sec += timeout_ms / 1000;
+    wait.deadline.tv_nsec += (timeout_ms % 1000) * 1000000L;
+    if (wait.deadline.tv_nsec >= 1000000000L) {
+      wait.deadline.tv_sec++;
+      wait.deadline.tv_nsec -= 1000000000L;
+    }
+  }
+
+  coroutine_yield(park_wait, &wait);
+  return wait.failed;
+}
+
+/**
+ * Submits io_uring operations and suspends the calling coroutine until all of them complete.
+ *
+ * @param ops Operations to submit.
+ * @param count Number of operations.
+ * @return 0 once the operations completed, 1 if they could not be submitted.
+ */
+int poller_submit(struct PollerOp* ops, unsigned count) {
+  if (!ring_ready || count == 0) {
+    return 1;
+  }
+
+  struct PollerWait wait;
+  memset(&wait, 0, sizeof(wait));
+  wait.coroutine = coroutine_current();
+  wait.ops = ops;
+  wait.remaining = count;
+
+  coroutine_yield(park_submit, &wait);
+  return wait.failed;
+}
@@ -0,0 +1,43 @@
+#ifndef SERVER_POLLER_H
+#define SERVER_POLLER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "coroutine.h"
+
+/**
+ * @struct PollerOp
+ * @brief A read or write submitted to the poller's io_uring on behalf of a coroutine.
+ */
+struct PollerOp {
+  int write;     // 1 for a write, 0 for a read
+  int fd;        // File descriptor to read from or write to
+  void* buffer;  // Buffer to read into or write from
+  size_t size;   // Number of bytes to transfer
+  int link;      // 1 if the next operation must only start once this one completes in full
+  int result;    // Bytes transferred, or a negative errno, once the operation completed
+  void* wait;    // Used by the poller
+};
+
+/// Starts the poller thread, which resumes suspended coroutines when their file descriptors become ready.
+/// @param wake Called from the poller thread with each coroutine that can run again.
+/// @param use_uring 1 to also run io_uring operations for coroutines, 0 to only watch file descriptors.
+/// @param max_operations Maximum number of io_uring operations in flight at once.
+/// @return 0 if the poller was started successfully, 1 otherwise.
+int poller_init(void (*wake)(struct Coroutine*), int use_uring, size_t max_operations);
+
+/// Suspends the calling coroutine until a file descriptor is ready.
+/// @param fd File descriptor to watch.
+/// @param events EPOLLIN or EPOLLOUT.
+/// @param timeout_ms Maximum time to wait in milliseconds, or -1 to wait forever.
+/// @return 0 once the file descriptor is ready or was closed on the other end, 1 on timeout or failure.
+int poller_wait(int fd, uint32_t events, int timeout_ms);
+
+/// Submits io_uring operations and suspends the calling coroutine until all of them complete.
+/// @param ops Operations to submit, in order. Their results are filled in.
+/// @param count Number of operations.
+/// @return 0 once the operations completed, 1 if they could not be submitted.
+int poller_submit(struct PollerOp* ops, unsigned count);
+
+#endif  // SERVER_POLLER_H
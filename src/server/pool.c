@@ -0,0 +1,199 @@
+#include "pool.h"
+
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "common/constants.h"
+#include "common/io.h"
+#include "scheduler.h"
+
+static void* (*worker_function)(void*) = NULL;
+static struct PoolConfig pool_config;
+
+// Protects running and running_count, and serializes resizes with retiring workers
+static pthread_mutex_t pool_mutex = PTHREAD_MUTEX_INITIALIZER;
+static int* running = NULL;  // 1 for each worker index whose thread is alive
+static size_t running_count = 0;
+static struct timespec started_at;
+
+/**
+ * Starts a detached worker thread for the given index.
+ *
+ * @note pool_mutex must be held.
+ * @param index Index of the worker.
+ * @return 0 on success, 1 on failure.
+ */
+static int spawn_worker(size_t index) {
+  pthread_attr_t attr;
+  pthread_t thread;
+
+  pthread_attr_init(&attr);
+  pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+  int error = pthread_create(&thread, &attr, worker_function, (void*)index);
+  pthread_attr_destroy(&attr);
+
+  if (error != 0) {
+    print_error("Error creating thread.\n");
+    return 1;
+  }
+
+  running[index] = 1;
+  running_count++;
+  return 0;
+}
+
+/**
+ * Changes the number of active workers, starting threads for new indexes, and reports the change.
+ *
+ * @note pool_mutex must be held.
+ * @param count The new number of active workers.
+ * @param wait_us Average queue wait that triggered the change.
+ * @param pending Number of sessions waiting when the change was made.
+ */
+static void resize(size_t count, size_t wait_us, size_t pending) {
+  size_t previous = scheduler_active();
+  scheduler_set_active(count);
+
+  // A retiring worker that has not exited yet simply keeps serving
+  for (size_t i = previous; i < count; i++) {
+    if (!running[i] && spawn_worker(i) != 0) {
+      scheduler_set_active(i);
+      count = i;
+      break;
+    }
+  }
+
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  double elapsed = (double)(now.tv_sec - started_at.tv_sec) + (double)(now.tv_nsec - started_at.tv_nsec) / 1e9;
+  printf("Pool resized from %zu to %zu workers at %.1fs (queue wait %zuus, %zu pending).\n", previous, count,
+         elapsed, wait_us, pending);
+  fflush(stdout);
+}
+
+/**
+ * Samples the queue periodically and grows or shrinks the pool.
+ *
+ * The pool grows when sessions wait longer than POOL_GROW_WAIT_US on average, or when sessions are pending
+ * and no worker is idle. It shrinks by one worker after POOL_IDLE_SAMPLES samples in a row with idle
+ * workers and nothing pending.
+ *
+ * @return NULL
+ */
+static void* pool_controller() {
+  // Leave SIGUSR1 to the dump thread
+  sigset_t set;
+  sigemptyset(&set);
+  sigaddset(&set, SIGUSR1);
+  pthread_sigmask(SIG_BLOCK, &set, NULL);
+
+  struct SchedulerStats previous;
+  scheduler_get_stats(&previous);
+  size_t idle_samples = 0;
+
+  while (1) {
+    struct timespec interval = {POOL_SAMPLE_MS / 1000, (POOL_SAMPLE_MS % 1000) * 1000000L};
+    nanosleep(&interval, NULL);
+
+    struct SchedulerStats stats;
+    scheduler_get_stats(&stats);
+    size_t served = stats.retrieved - previous.retrieved;
+    size_t wait_us = served ? (stats.total_wait_us - previous.total_wait_us) / served : 0;
+    previous = stats;
+
+    size_t pending = scheduler_pending();
+    size_t idle = scheduler_idle_workers();
+
+    pthread_mutex_lock(&pool_mutex);
+    size_t active = scheduler_active();
+
+    if ((wait_us > POOL_GROW_WAIT_US || (pending > 0 && idle == 0)) && active < pool_config.max_workers) {
+      // Grow by the backlog at once, so a burst does not take one sample per worker
+      size_t grow = pending > idle ? pending - idle : 1;
+      size_t count = active + grow < pool_config.max_workers ? active + grow : pool_config.max_workers;
+      resize(count, wait_us, pending);
+      idle_samples = 0;
+    } else if (idle > 0 && pending == 0 && active > pool_config.min_workers) {
+      if (++idle_samples >= POOL_IDLE_SAMPLES) {
+        resize(active - 1, wait_us, pending);
+        idle_samples = 0;
+      }
+    } else {
+      idle_samples = 0;
+    }
+
+    pthread_mutex_unlock(&pool_mutex);
+  }
+
+  return NULL;
+}
+
+/**
+ * Starts min_workers worker threads, and the controller thread in adaptive mode.
+ *
+ * @param worker Function run by each worker thread.
+ * @param config Pool parameters.
+ * @return 0 on success, 1 on failure.
+ */
+int pool_start(void* (*worker)(void*), const struct PoolConfig* config) {
+  worker_function = worker;
+  pool_config = *config;
+  clock_gettime(CLOCK_MONOTONIC, &started_at);
+
+  running = calloc(config->max_workers, sizeof(int));
+  if (running == NULL) {
+    print_error("Error allocating worker pool.\n");
+    return 1;
+  }
+
+  pthread_mutex_lock(&pool_mutex);
+  for (size_t i = 0; i < config->min_workers; i++) {
+    if (spawn_worker(i) != 0) {
+      pthread_mutex_unlock(&pool_mutex);
+      return 1;
+    }
+  }
+  pthread_mutex_unlock(&pool_mutex);
+
+  if (config->adaptive) {
+    pthread_t controller;
+    if (pthread_create(&controller, NULL, pool_controller, NULL) != 0 || pthread_detach(controller) != 0) {
+      print_error("Error creating thread.\n");
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+/**
+ * Lets a worker exit, unless the pool grew back over its index in the meantime.
+ *
+ * @param worker Index of the calling worker.
+ * @return 1 if the worker must exit, 0 otherwise.
+ */
+int pool_retire(size_t worker) {
+  pthread_mutex_lock(&pool_mutex);
+  if (worker < scheduler_active()) {
+    pthread_mutex_unlock(&pool_mutex);
+    return 0;
+  }
+
+  running[worker] = 0;
+  running_count--;
+  pthread_mutex_unlock(&pool_mutex);
+  return 1;
+}
+
+/**
+ * Returns the number of worker threads currently running.
+ */
+size_t pool_size(void) {
+  pthread_mutex_lock(&pool_mutex);
+  size_t count = running_count;
+  pthread_mutex_unlock(&pool_mutex);
+  return count;
+}
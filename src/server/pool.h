@@ -0,0 +1,31 @@
+#ifndef SERVER_POOL_H
+#define SERVER_POOL_H
+
+#include <stddef.h>
+
+/**
+ * @struct PoolConfig
+ * @brief Startup parameters of the worker pool.
+ */
+struct PoolConfig {
+  size_t min_workers;  // Workers started at startup, and the lower bound in adaptive mode
+  size_t max_workers;  // Upper bound on the number of workers in adaptive mode
+  int adaptive;        // 1 to grow and shrink the pool with the load, 0 to keep min_workers
+};
+
+/// Starts the worker threads and, in adaptive mode, the thread that resizes the pool.
+/// The scheduler must be initialized with the same bounds.
+/// @param worker Function run by each worker thread. Its argument is the worker index.
+/// @param config Pool parameters.
+/// @return 0 if the pool was started successfully, 1 otherwise.
+int pool_start(void* (*worker)(void*), const struct PoolConfig* config);
+
+/// Called by a worker when the scheduler tells it to exit.
+/// @param worker Index of the calling worker.
+/// @return 1 if the worker must exit, 0 if the pool grew again and it must keep serving.
+int pool_retire(size_t worker);
+
+/// Returns the number of worker threads currently running.
+size_t pool_size(void);
+
+#endif  // SERVER_POOL_H
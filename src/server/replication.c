@@ -0,0 +1,622 @@
+#include "replication.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "common/constants.h"
+#include "common/io.h"
+#include "eventlist.h"
+#include "lockstats.h"
+#include "operations.h"
+#include "seatstore.h"
+
+// Largest message of a change, a RESERVE of as many seats as a request holds
+#define REPL_MAX_CHANGE_SIZE (sizeof(struct ReplHeader) + 2 * MAX_RESERVATION_SIZE * sizeof(uint64_t))
+
+/**
+ * @struct Follower
+ * @brief A follower connected to the primary, and the changes queued for it.
+ */
+struct Follower {
+  int fd;
+  char* queue;      // Messages of the changes published since the follower connected, not yet taken by its sender
+  size_t queued;    // Bytes in the queue
+  size_t capacity;  // Size of the queue
+  int dropped;      // 1 once the queue would outgrow REPL_MAX_BACKLOG; the sender then disconnects the follower
+  struct Follower* next;
+};
+
+static pthread_mutex_t repl_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t repl_queued = PTHREAD_COND_INITIALIZER;  // Signaled when changes were queued for followers
+static enum ReplRole role = REPL_NONE;
+static char socket_path[sizeof(((struct sockaddr_un*)NULL)->sun_path)];
+static int listen_fd = -1;
+static int closing = 0;
+static uint64_t last_seq = 0;  // Last sequence number published, on a primary, or applied, on a follower
+
+static struct Follower* followers = NULL;
+static size_t follower_count = 0;
+static size_t dropped_count = 0;
+
+static int connected = 0;
+static int ready = 0;
+static uint64_t primary_seq = 0;
+static size_t applied = 0;
+static long lag_us = 0;
+
+/**
+ * Gets the wall-clock time, which primary and followers on one host share, in nanoseconds.
+ */
+static uint64_t now_ns(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_REALTIME, &now);
+  return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
+
+/**
+ * Fills in the address of a Unix socket.
+ *
+ * @return 0 on success, 1 if the path is too long.
+ */
+static int socket_address(const char* path, struct sockaddr_un* address) {
+  memset(address, 0, sizeof(*address));
+  address->sun_family = AF_UNIX;
+  if (strlen(path) >= sizeof(address->sun_path)) {
+    print_error("The replication socket path is too long.\n");
+    return 1;
+  }
+  strcpy(address->sun_path, path);
+  strcpy(socket_path, path);
+  return 0;
+}
+
+/**
+ * Lays out the message of a change, but for its sequence number.
+ *
+ * @param record The change.
+ * @param buffer Buffer of REPL_MAX_CHANGE_SIZE bytes to lay the message out in.
+ * @return Size of the message.
+ */
+static size_t encode_change(const struct WalRecord* record, uint64_t* buffer) {
+  enum ReplMessageType type = record->type == WAL_CREATE ? REPL_CREATE : REPL_RESERVE;
+  struct ReplHeader header = {type, record->event_id, 0, now_ns(), 0};
+  uint64_t* values = buffer + sizeof(header) / sizeof(uint64_t);
+  size_t count = 0;
+  if (record->type == WAL_CREATE) {
+    values[count++] = record->num_rows;
+    values[count++] = record->num_cols;
+  } else {
+    for (size_t i = 0; i < record->num_seats; i++) {
+      values[count++] = record->xs[i];
+    }
+    for (size_t i = 0; i < record->num_seats; i++) {
+      values[count++] = record->ys[i];
+    }
+  }
+  header.size = count * sizeof(uint64_t);
+  memcpy(buffer, &header, sizeof(header));
+  return sizeof(header) + header.size;
+}
+
+/**
+ * Queues a message for a follower. Called with the mutex held.
+ *
+ * @return 0 on success, 1 if the follower is too far behind to take it.
+ */
+static int queue_message(struct Follower* follower, const void* message, size_t size) {
+  if (follower->queued + size > REPL_MAX_BACKLOG) {
+    return 1;
+  }
+
+  if (follower->queued + size > follower->capacity) {
+    size_t capacity = follower->capacity > 0 ? follower->capacity : WRITER_BUFFER_SIZE;
+    while (capacity < follower->queued + size) {
+      capacity *= 2;
+    }
+    char* grown = realloc(follower->queue, capacity);
+    if (grown == NULL) {
+      return 1;
+    }
+    follower->queue = grown;
+    follower->capacity = capacity;
+  }
+
+  memcpy(follower->queue + follower->queued, message, size);
+  follower->queued += size;
+  return 0;
+}
+
+/**
+ * Assigns the next sequence number to a change and queues it for every follower.
+ *
+ * @param record The change.
+ * @return The sequence number of the change, or 0 if followers could not apply it.
+ */
+uint64_t repl_publish(const struct WalRecord* record) {
+  if (record->type == WAL_RESERVE && (record->num_seats == 0 || record->num_seats > MAX_RESERVATION_SIZE)) {
+    print_error("Reservation followers could not apply.\n");
+    return 0;
+  }
+
+  // The message is laid out before the lock is taken; only the sequence number depends on the order
+  uint64_t buffer[REPL_MAX_CHANGE_SIZE / sizeof(uint64_t)];
+  size_t size = encode_change(record, buffer);
+
+  pthread_mutex_lock(&repl_mutex);
+  uint64_t seq = ++last_seq;
+  memcpy((char*)buffer + offsetof(struct ReplHeader, seq), &seq, sizeof(seq));
+  for (struct Follower* follower = followers; follower != NULL; follower = follower->next) {
+    if (!follower->dropped && queue_message(follower, buffer, size) != 0) {
+      follower->dropped = 1;
+    }
+  }
+  if (followers != NULL) {
+    pthread_cond_broadcast(&repl_queued);
+  }
+  pthread_mutex_unlock(&repl_mutex);
+  return seq;
+}
+
+/**
+ * Sends every event of the state to a follower, then the end of the snapshot.
+ *
+ * Each event is copied under its own mutex only, so changes keep being made while the snapshot is sent. An event
+ * may then hold changes published after the follower connected, which are queued for it as well; the follower skips
+ * those whose sequence number the event it got already holds.
+ *
+ * @param out Writer over the socket of the follower.
+ * @param seq Last sequence number published before the follower connected.
+ * @return 0 on success, 1 on failure.
+ */
+static int send_snapshot(struct Writer* out, uint64_t seq) {
+  struct EventList* list = get_event_list();
+  if (list == NULL || lockstats_rdlock(&list->rwl, &list->lock_stats) != 0) {
+    return 1;
+  }
+  struct ListNode* head = list->head;
+  struct ListNode* tail = list->tail;
+  lockstats_rwlock_unlock(&list->rwl, &list->lock_stats);
+
+  // Events are only ever appended, so the nodes up to the tail stay put while they are sent
+  unsigned int* seats = NULL;
+  size_t capacity = 0;
+  int failed = 0;
+  for (struct ListNode* node = tail != NULL ? head : NULL; node != NULL && !failed;
+       node = node == tail ? NULL : node->next) {
+    struct Event* event = node->event;
+    size_t count = event->rows * event->cols;
+    if (count > capacity) {
+      unsigned int* grown = realloc(seats, count * sizeof(unsigned int));
+      if (grown == NULL) {
+        failed = 1;
+        break;
+      }
+      seats = grown;
+      capacity = count;
+    }
+
+    // Cold seats in the seat file are read back in as a whole
+    seat_store_use(event);
+    uint64_t values[3] = {event->rows, event->cols, 0};
+    struct ReplHeader header = {REPL_EVENT, event->id, 0, now_ns(), sizeof(values) + count * sizeof(unsigned int)};
+    if (lockstats_mutex_lock(&event->mutex, &event->lock_stats) != 0) {
+      failed = 1;
+      break;
+    }
+    memcpy(seats, event->data, count * sizeof(unsigned int));
+    values[2] = event->reservations;
+    header.seq = event->seq;
+    lockstats_mutex_unlock(&event->mutex, &event->lock_stats);
+
+    failed = writer_write(out, &header, sizeof(header)) != 0 || writer_write(out, values, sizeof(values)) != 0 ||
+             writer_write(out, seats, count * sizeof(unsigned int)) != 0;
+  }
+  free(seats);
+
+  struct ReplHeader end = {REPL_READY, 0, seq, now_ns(), 0};
+  return failed || writer_write(out, &end, sizeof(end)) != 0 || writer_flush(out) != 0;
+}
+
+/**
+ * Feeds a follower: sends it a snapshot, then the changes queued for it as they come, and heartbeats while there
+ * are none, until it goes away or falls too far behind.
+ *
+ * @param arg The Follower, which the thread frees.
+ * @return NULL.
+ */
+static void* feed_follower(void* arg) {
+  // Leave SIGUSR1 to the dump thread
+  sigset_t set;
+  sigemptyset(&set);
+  sigaddset(&set, SIGUSR1);
+  pthread_sigmask(SIG_BLOCK, &set, NULL);
+
+  // Changes published from now on are queued for the follower; the snapshot holds every one before
+  struct Follower* follower = arg;
+  pthread_mutex_lock(&repl_mutex);
+  follower->next = followers;
+  followers = follower;
+  follower_count++;
+  uint64_t seq = last_seq;
+  pthread_mutex_unlock(&repl_mutex);
+  printf("Follower connected, sending a snapshot up to sequence number %llu.\n", (unsigned long long)seq);
+
+  char buffer[WRITER_BUFFER_SIZE];
+  struct Writer out;
+  writer_init(&out, follower->fd, buffer, sizeof(buffer));
+  int failed = send_snapshot(&out, seq);
+
+  // The queue is taken whole and sent while the next changes are queued
+  char* sending = NULL;
+  size_t sending_capacity = 0;
+  pthread_mutex_lock(&repl_mutex);
+  while (!failed && !follower->dropped && !closing) {
+    if (follower->queued == 0) {
+      struct timespec deadline;
+      clock_gettime(CLOCK_REALTIME, &deadline);
+      deadline.tv_nsec += REPL_HEARTBEAT_MS * 1000000L;
+      deadline.tv_sec += deadline.tv_nsec / 1000000000L;
+      deadline.tv_nsec %= 1000000000L;
+      if (pthread_cond_timedwait(&repl_queued, &repl_mutex, &deadline) != ETIMEDOUT || follower->queued > 0) {
+        continue;
+      }
+
+      struct ReplHeader heartbeat = {REPL_HEARTBEAT, 0, last_seq, now_ns(), 0};
+      pthread_mutex_unlock(&repl_mutex);
+      failed = my_write(follower->fd, &heartbeat, sizeof(heartbeat)) == -1;
+      pthread_mutex_lock(&repl_mutex);
+      continue;
+    }
+
+    char* queue = follower->queue;
+    size_t capacity = follower->capacity, size = follower->queued;
+    follower->queue = sending;
+    follower->capacity = sending_capacity;
+    follower->queued = 0;
+    sending = queue;
+    sending_capacity = capacity;
+    pthread_mutex_unlock(&repl_mutex);
+    failed = my_write(follower->fd, sending, size) == -1;
+    pthread_mutex_lock(&repl_mutex);
+  }
+
+  struct Follower** link = &followers;
+  while (*link != follower) {
+    link = &(*link)->next;
+  }
+  *link = follower->next;
+  follower_count--;
+  int dropped = follower->dropped;
+  dropped_count += (size_t)dropped;
+  pthread_mutex_unlock(&repl_mutex);
+
+  if (dropped) {
+    print_error("Follower dropped: it fell too far behind.\n");
+  } else {
+    printf("Follower disconnected.\n");
+  }
+  close(follower->fd);
+  free(follower->queue);
+  free(sending);
+  free(follower);
+  return NULL;
+}
+
+/**
+ * Accepts followers on the replication socket, each fed by a thread of its own, until the socket is closed.
+ *
+ * @param arg Unused.
+ * @return NULL.
+ */
+static void* accept_followers(void* arg) {
+  (void)arg;
+
+  // Leave SIGUSR1 to the dump thread
+  sigset_t set;
+  sigemptyset(&set);
+  sigaddset(&set, SIGUSR1);
+  pthread_sigmask(SIG_BLOCK, &set, NULL);
+
+  while (1) {
+    int fd = accept(listen_fd, NULL, NULL);
+    if (fd == -1 && (errno == EINTR || errno == ECONNABORTED)) {
+      continue;
+    }
+    if (fd == -1) {
+      break;
+    }
+
+    struct Follower* follower = calloc(1, sizeof(struct Follower));
+    pthread_t feeder;
+    if (follower == NULL) {
+      print_error("Error allocating memory for follower.\n");
+      close(fd);
+      continue;
+    }
+    follower->fd = fd;
+    if (pthread_create(&feeder, NULL, feed_follower, follower) != 0) {
+      print_error("Error creating thread.\n");
+      close(fd);
+      free(follower);
+      continue;
+    }
+    pthread_detach(feeder);
+  }
+  return NULL;
+}
+
+/**
+ * Listens for followers on a Unix socket.
+ *
+ * @param path Path of the socket.
+ * @return 0 on success, 1 on failure.
+ */
+int repl_listen(const char* path) {
+  struct sockaddr_un address;
+  if (socket_address(path, &address) != 0) {
+    return 1;
+  }
+
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd == -1 || bind(fd, (struct sockaddr*)&address, sizeof(address)) != 0 || listen(fd, SOMAXCONN) != 0) {
+    print_error("Failed to listen for followers.\n");
+    if (fd != -1) {
+      close(fd);
+    }
+    return 1;
+  }
+
+  listen_fd = fd;
+  role = REPL_PRIMARY;
+  pthread_t acceptor;
+  if (pthread_create(&acceptor, NULL, accept_followers, NULL) != 0) {
+    print_error("Error creating thread.\n");
+    repl_close();
+    return 1;
+  }
+  pthread_detach(acceptor);
+  return 0;
+}
+
+/**
+ * Connects to the socket of the primary, retrying every REPL_RETRY_MS until it is up.
+ *
+ * @return File descriptor of the connection.
+ */
+static int connect_primary(void) {
+  struct sockaddr_un address;
+  socket_address(socket_path, &address);
+  struct timespec retry = {0, REPL_RETRY_MS * 1000000L};
+  int waiting = 0;
+  while (1) {
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd != -1 && connect(fd, (struct sockaddr*)&address, sizeof(address)) == 0) {
+      return fd;
+    }
+    if (fd != -1) {
+      close(fd);
+    }
+    if (!waiting) {
+      printf("Waiting for the primary at %s.\n", socket_path);
+      waiting = 1;
+    }
+    nanosleep(&retry, NULL);
+  }
+}
+
+/**
+ * Checks that the header of a message fits its type, so its size can be trusted.
+ *
+ * @return 1 if the header is valid, 0 otherwise.
+ */
+static int valid_header(const struct ReplHeader* header) {
+  switch ((enum ReplMessageType)header->type) {
+    case REPL_EVENT:
+      return header->size >= 3 * sizeof(uint64_t) && (header->size - 3 * sizeof(uint64_t)) % sizeof(unsigned int) == 0;
+    case REPL_CREATE:
+      return header->size == 2 * sizeof(uint64_t);
+    case REPL_RESERVE:
+      return header->size > 0 && header->size % (2 * sizeof(uint64_t)) == 0 &&
+             header->size / (2 * sizeof(uint64_t)) <= MAX_RESERVATION_SIZE;
+    case REPL_READY:
+    case REPL_HEARTBEAT:
+      return header->size == 0;
+  }
+  return 0;
+}
+
+/**
+ * Applies a message of the primary to the state.
+ *
+ * @param header Header of the message.
+ * @param values Values that follow the header.
+ * @return 0 on success, 1 if the message does not apply to the state.
+ */
+static int apply_message(const struct ReplHeader* header, const uint64_t* values) {
+  size_t xs[MAX_RESERVATION_SIZE], ys[MAX_RESERVATION_SIZE];
+  struct WalRecord record = {WAL_CREATE, header->seq, header->event_id, 0, 0, 0, xs, ys};
+  switch ((enum ReplMessageType)header->type) {
+    case REPL_EVENT: {
+      size_t rows = (size_t)values[0], cols = (size_t)values[1];
+      size_t count = (header->size - 3 * sizeof(uint64_t)) / sizeof(unsigned int);
+      if (cols != 0 && (rows > count / cols || rows * cols != count)) {
+        return 1;
+      }
+      return ems_restore_event(header->event_id, rows, cols, (unsigned int)values[2],
+                               (const unsigned int*)(const void*)(values + 3), header->seq);
+    }
+
+    case REPL_READY:
+      pthread_mutex_lock(&repl_mutex);
+      ready = 1;
+      last_seq = header->seq;
+      primary_seq = header->seq > primary_seq ? header->seq : primary_seq;
+      pthread_mutex_unlock(&repl_mutex);
+      printf("Snapshot of the primary applied, up to sequence number %llu.\n", (unsigned long long)header->seq);
+      return 0;
+
+    case REPL_CREATE:
+    case REPL_RESERVE:
+      if (header->type == REPL_CREATE) {
+        record.num_rows = (size_t)values[0];
+        record.num_cols = (size_t)values[1];
+      } else {
+        record.type = WAL_RESERVE;
+        record.num_seats = header->size / (2 * sizeof(uint64_t));
+        for (size_t i = 0; i < record.num_seats; i++) {
+          xs[i] = (size_t)values[i];
+          ys[i] = (size_t)values[record.num_seats + i];
+        }
+      }
+      if (ems_apply_change(&record) != 0) {
+        return 1;
+      }
+
+      pthread_mutex_lock(&repl_mutex);
+      last_seq = header->seq;
+      primary_seq = header->seq > primary_seq ? header->seq : primary_seq;
+      applied++;
+      lag_us = (long)((int64_t)(now_ns() - header->time_ns) / 1000);
+      pthread_mutex_unlock(&repl_mutex);
+      return 0;
+
+    case REPL_HEARTBEAT:
+      pthread_mutex_lock(&repl_mutex);
+      primary_seq = header->seq > primary_seq ? header->seq : primary_seq;
+      pthread_mutex_unlock(&repl_mutex);
+      return 0;
+  }
+  return 1;
+}
+
+/**
+ * Follows the primary: connects to it, then applies its snapshot and its changes until it goes away.
+ *
+ * @param arg Unused.
+ * @return NULL.
+ */
+static void* follow_primary(void* arg) {
+  (void)arg;
+
+  // Leave SIGUSR1 to the dump thread
+  sigset_t set;
+  sigemptyset(&set);
+  sigaddset(&set, SIGUSR1);
+  pthread_sigmask(SIG_BLOCK, &set, NULL);
+
+  int fd = connect_primary();
+  pthread_mutex_lock(&repl_mutex);
+  connected = 1;
+  pthread_mutex_unlock(&repl_mutex);
+  printf("Following the primary at %s.\n", socket_path);
+
+  char buffer[READER_BUFFER_SIZE];
+  struct Reader reader;
+  reader_init(&reader, fd, buffer, sizeof(buffer));
+  uint64_t* values = NULL;
+  size_t capacity = 0;
+  int failed = 0;
+  struct ReplHeader header;
+  while (!failed && reader_read(&reader, (char*)&header, sizeof(header)) == (ssize_t)sizeof(header)) {
+    if (!valid_header(&header)) {
+      failed = 1;
+      break;
+    }
+
+    // Snapshots of large events take more than the largest change
+    if (header.size > capacity) {
+      uint64_t* grown = realloc(values, header.size);
+      if (grown == NULL) {
+        failed = 1;
+        break;
+      }
+      values = grown;
+      capacity = header.size;
+    }
+    if (reader_read(&reader, (char*)values, header.size) != (ssize_t)header.size) {
+      break;
+    }
+    failed = apply_message(&header, values);
+  }
+  free(values);
+  close(fd);
+
+  if (failed) {
+    print_error("Failed to apply a message of the primary.\n");
+  }
+  pthread_mutex_lock(&repl_mutex);
+  connected = 0;
+  uint64_t seq = last_seq;
+  pthread_mutex_unlock(&repl_mutex);
+  printf("No longer following the primary; serving the state up to sequence number %llu.\n",
+         (unsigned long long)seq);
+  return NULL;
+}
+
+/**
+ * Follows a primary from a thread of its own.
+ *
+ * @param path Path of the socket of the primary.
+ * @return 0 if the thread was started, 1 otherwise.
+ */
+int repl_follow(const char* path) {
+  struct sockaddr_un address;
+  if (socket_address(path, &address) != 0) {
+    return 1;
+  }
+
+  role = REPL_FOLLOWER;
+  pthread_t follower;
+  if (pthread_create(&follower, NULL, follow_primary, NULL) != 0) {
+    print_error("Error creating thread.\n");
+    return 1;
+  }
+  pthread_detach(follower);
+  return 0;
+}
+
+/**
+ * Copies the counters of replication.
+ *
+ * @param stats Pointer to store the counters in.
+ */
+void repl_get_stats(struct ReplStats* stats) {
+  pthread_mutex_lock(&repl_mutex);
+  stats->role = role;
+  stats->seq = last_seq;
+  stats->followers = follower_count;
+  stats->dropped = dropped_count;
+  stats->connected = connected;
+  stats->ready = ready;
+  stats->primary_seq = primary_seq;
+  stats->applied = applied;
+  stats->lag_us = lag_us;
+  pthread_mutex_unlock(&repl_mutex);
+}
+
+/**
+ * Stops listening for followers, tells their feeders to stop and removes the socket.
+ */
+void repl_close(void) {
+  pthread_mutex_lock(&repl_mutex);
+  closing = 1;
+  pthread_cond_broadcast(&repl_queued);
+  pthread_mutex_unlock(&repl_mutex);
+
+  // Shutting the socket down wakes the acceptor up
+  if (listen_fd != -1) {
+    shutdown(listen_fd, SHUT_RDWR);
+    close(listen_fd);
+    listen_fd = -1;
+    unlink(socket_path);
+  }
+}
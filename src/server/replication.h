@@ -0,0 +1,86 @@
+#ifndef SERVER_REPLICATION_H
+#define SERVER_REPLICATION_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "wal.h"
+
+/**
+ * @enum ReplRole
+ * @brief Part a server plays in replication.
+ */
+enum ReplRole {
+  REPL_NONE,      // Not replicating
+  REPL_PRIMARY,   // Sends every change to the followers connected to its socket
+  REPL_FOLLOWER,  // Applies the changes of a primary, and refuses changes of its own clients
+};
+
+/**
+ * @enum ReplMessageType
+ * @brief Kind of message on the replication stream from a primary to a follower.
+ */
+enum ReplMessageType {
+  REPL_EVENT = 1,      // An event of the snapshot: its rows, columns and reservations, then its seats
+  REPL_READY = 2,      // End of the snapshot, after which changes follow
+  REPL_CREATE = 3,     // An event was created: its rows and columns
+  REPL_RESERVE = 4,    // Seats of an event were reserved: their rows, then their columns
+  REPL_HEARTBEAT = 5,  // No change for REPL_HEARTBEAT_MS
+};
+
+/**
+ * @struct ReplHeader
+ * @brief Header of a message on the replication stream, followed by size bytes of uint64_t values, and for
+ * REPL_EVENT by the seats as unsigned ints.
+ */
+struct ReplHeader {
+  uint32_t type;      // The enum ReplMessageType
+  uint32_t event_id;  // Event changed or copied, 0 otherwise
+  uint64_t seq;       // Sequence number of the change, of the last change an event holds, or of the last change sent
+  uint64_t time_ns;   // CLOCK_REALTIME when the change was made or the message sent
+  uint64_t size;      // Bytes after the header
+};
+
+/**
+ * @struct ReplStats
+ * @brief Counters of replication, from the side of a primary or of a follower.
+ */
+struct ReplStats {
+  enum ReplRole role;
+  uint64_t seq;          // Last sequence number sent, on a primary, or applied, on a follower
+  size_t followers;      // Followers connected, on a primary
+  size_t dropped;        // Followers disconnected for falling REPL_MAX_BACKLOG behind, on a primary
+  int connected;         // 1 while a follower is connected to its primary
+  int ready;             // 1 once a follower applied the snapshot of its primary
+  uint64_t primary_seq;  // Last sequence number a follower knows its primary sent
+  size_t applied;        // Changes a follower applied, the snapshot left out
+  long lag_us;           // Time between the last change a follower applied being made and being applied
+};
+
+/// Listens for followers on a Unix socket. Each one gets a snapshot of the state, each event copied under its own
+/// mutex, then every change published from the moment it connected, in order.
+/// @param path Path of the socket, which must not exist.
+/// @return 0 on success, 1 on failure.
+int repl_listen(const char* path);
+
+/// Assigns the next sequence number to a change and queues it for every follower. Called under the lock the change
+/// is made under, so followers get the changes of each event in the order they were made.
+/// A reservation of no seats or of more than MAX_RESERVATION_SIZE is refused, since followers would reject it.
+/// @param record The change, whose lsn is ignored.
+/// @return The sequence number of the change, or 0 if it was refused.
+uint64_t repl_publish(const struct WalRecord* record);
+
+/// Follows a primary: connects to its socket, retrying until it is up, then applies its snapshot and its changes
+/// from a thread of its own. Once the primary goes away, the state replicated so far keeps being served.
+/// @param path Path of the socket of the primary.
+/// @return 0 if the thread was started, 1 otherwise.
+int repl_follow(const char* path);
+
+/// Copies the counters of replication.
+/// @param stats Pointer to store the counters in.
+void repl_get_stats(struct ReplStats* stats);
+
+/// Stops listening for followers and removes the socket.
+void repl_close(void);
+
+#endif  // SERVER_REPLICATION_H
@@ -0,0 +1,491 @@
+#include "scheduler.h"
+
+#include <pthread.h>
+#include <stdalign.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "common/io.h"
+
+#define AFFINITY_SLOTS 256  // Number of entries in the session-to-worker affinity table
+
+/**
+ * @struct WorkerQueue
+ * @brief Per-worker deque of pending sessions.
+ *
+ * Sessions are pushed to the back, and both the owner and thieves take the front, the session that waited
+ * longest. A queued session is a whole client waiting for its turn rather than a subtask, so serving it in
+ * order matters more than running the one whose state is warmest in the owner's cache, and a stolen session
+ * never runs ahead of sessions queued before it. Each queue sits on its own cache line so that workers
+ * touching their own deque do not contend with each other.
+ */
+struct WorkerQueue {
+  alignas(64) pthread_mutex_t mutex;  // Protects the deque
+  pthread_cond_t cond;                // Signaled when work may be available for this worker
+  struct Request** items;             // Ring buffer of queued sessions
+  size_t capacity;                    // Number of entries in items, doubled when the deque is full
+  size_t head;                        // Index of the front element
+  size_t size;                        // Number of queued elements
+  atomic_int idle;                    // 1 while the worker is waiting for work
+};
+
+static struct WorkerQueue* queues = NULL;
+static size_t worker_count = 0;    // Number of allocated deques, the maximum pool size
+static size_t queue_capacity = 0;  // Maximum number of pending sessions overall
+static size_t deque_capacity = 0;  // Initial number of entries of each deque
+
+// Workers with an index below this take new sessions; the others drain their deque and retire
+static atomic_size_t active_workers = 0;
+
+// Number of new sessions waiting in all deques, bounded by queue_capacity
+static atomic_size_t pending = 0;
+
+// Number of resumed sessions waiting in all deques, bounded by the number of live sessions
+static atomic_size_t ready = 0;
+
+// Incremented on every push, so idle workers can detect work published while they were scanning
+static atomic_size_t push_version = 0;
+
+// Last worker (plus one) that served a session whose pipe path hashes to each slot
+static atomic_size_t affinity[AFFINITY_SLOTS];
+static atomic_size_t next_worker = 0;
+static atomic_int next_session_id = 0;
+
+static atomic_size_t submitted = 0;
+static atomic_size_t retrieved = 0;
+static atomic_size_t resumed = 0;
+static atomic_size_t rejected = 0;
+static atomic_size_t local_hits = 0;
+static atomic_size_t steals = 0;
+static atomic_size_t total_wait_us = 0;
+static atomic_size_t max_wait_us = 0;
+static atomic_size_t total_resume_wait_us = 0;
+static atomic_size_t max_resume_wait_us = 0;
+
+// Moving average of the time sessions spent queued before their turns
+static atomic_size_t queue_delay_us = 0;
+
+/**
+ * Hashes a request pipe path to a slot of the affinity table (FNV-1a).
+ *
+ * @param path The request pipe path identifying the client.
+ * @return Index of the affinity slot.
+ */
+static size_t affinity_slot(const char* path) {
+  uint32_t hash = 2166136261u;
+  for (size_t i = 0; i < MAX_PATH && path[i] != '\0'; i++) {
+    hash ^= (unsigned char)path[i];
+    hash *= 16777619u;
+  }
+  return hash % AFFINITY_SLOTS;
+}
+
+/**
+ * Raises a maximum counter to a new value, if it is larger.
+ */
+static void update_max(atomic_size_t* max, size_t value) {
+  size_t current = atomic_load(max);
+  while (value > current && !atomic_compare_exchange_weak(max, &current, value))
+    ;
+}
+
+/**
+ * Removes the front element of a worker deque, the oldest one, for its owner and thieves alike.
+ *
+ * @param queue The deque to pop from. Its mutex must be held.
+ * @param request Pointer to store the element in.
+ * @return 1 if an element was removed, 0 if the deque was empty.
+ */
+static int deque_pop(struct WorkerQueue* queue, struct Request** request) {
+  if (queue->size == 0) {
+    return 0;
+  }
+
+  *request = queue->items[queue->head];
+  queue->head = (queue->head + 1) % queue->capacity;
+  queue->size--;
+  return 1;
+}
+
+/**
+ * Doubles the capacity of a full worker deque, moving its elements to the start of the new ring.
+ *
+ * @param queue The deque to grow. Its mutex must be held.
+ * @return 1 if the deque grew, 0 if memory ran out.
+ */
+static int deque_grow(struct WorkerQueue* queue) {
+  struct Request** items = malloc(2 * queue->capacity * sizeof(struct Request*));
+  if (items == NULL) {
+    return 0;
+  }
+
+  for (size_t i = 0; i < queue->size; i++) {
+    items[i] = queue->items[(queue->head + i) % queue->capacity];
+  }
+  free(queue->items);
+  queue->items = items;
+  queue->capacity *= 2;
+  queue->head = 0;
+  return 1;
+}
+
+/**
+ * Appends an element to the back of a worker deque, growing it when it is full.
+ *
+ * @param queue The deque to push to.
+ * @param request The element to append.
+ * @return 1 if the element was appended, 0 if the deque could not grow.
+ */
+static int deque_push(struct WorkerQueue* queue, struct Request* request) {
+  pthread_mutex_lock(&queue->mutex);
+  if (queue->size == queue->capacity && !deque_grow(queue)) {
+    pthread_mutex_unlock(&queue->mutex);
+    return 0;
+  }
+
+  queue->items[(queue->head + queue->size) % queue->capacity] = request;
+  queue->size++;
+  pthread_cond_signal(&queue->cond);
+  pthread_mutex_unlock(&queue->mutex);
+  return 1;
+}
+
+/**
+ * Tries to take a session from the worker's own deque, then from the other workers' deques, oldest first in
+ * each.
+ *
+ * @param worker Index of the calling worker.
+ * @param request Pointer to store the session in.
+ * @return 1 if a session was found, 0 otherwise.
+ */
+static int try_take(size_t worker, struct Request** request) {
+  struct WorkerQueue* own = &queues[worker];
+
+  pthread_mutex_lock(&own->mutex);
+  int found = deque_pop(own, request);
+  pthread_mutex_unlock(&own->mutex);
+
+  if (found) {
+    atomic_fetch_add(&local_hits, 1);
+    return 1;
+  }
+
+  for (size_t i = 1; i < worker_count; i++) {
+    struct WorkerQueue* victim = &queues[(worker + i) % worker_count];
+
+    pthread_mutex_lock(&victim->mutex);
+    found = deque_pop(victim, request);
+    pthread_mutex_unlock(&victim->mutex);
+
+    if (found) {
+      atomic_fetch_add(&steals, 1);
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+/**
+ * Initializes the per-worker deques.
+ *
+ * Deques are allocated for the largest pool size. Each one starts with room for an equal share of the
+ * pending sessions of the smallest pool, and grows when resumed sessions pile up on it.
+ *
+ * @param max_workers Maximum number of worker threads.
+ * @param min_workers Minimum number of worker threads.
+ * @param capacity Maximum number of pending sessions.
+ * @return 0 on success, 1 on failure.
+ */
+int scheduler_init(size_t max_workers, size_t min_workers, size_t capacity) {
+  if (min_workers == 0 || max_workers < min_workers || capacity == 0) {
+    print_error("Scheduler needs at least one worker and one queue slot.\n");
+    return 1;
+  }
+
+  queues = aligned_alloc(alignof(struct WorkerQueue), max_workers * sizeof(struct WorkerQueue));
+  if (queues == NULL) {
+    print_error("Error allocating worker queues.\n");
+    return 1;
+  }
+
+  deque_capacity = (capacity + min_workers - 1) / min_workers;
+  for (size_t i = 0; i < max_workers; i++) {
+    struct WorkerQueue* queue = &queues[i];
+    queue->items = malloc(deque_capacity * sizeof(struct Request*));
+    if (queue->items == NULL || pthread_mutex_init(&queue->mutex, NULL) != 0 ||
+        pthread_cond_init(&queue->cond, NULL) != 0) {
+      print_error("Error initializing worker queue.\n");
+      return 1;
+    }
+    queue->capacity = deque_capacity;
+    queue->head = 0;
+    queue->size = 0;
+    atomic_init(&queue->idle, 0);
+  }
+
+  for (size_t i = 0; i < AFFINITY_SLOTS; i++) {
+    atomic_init(&affinity[i], 0);
+  }
+
+  worker_count = max_workers;
+  queue_capacity = capacity;
+  atomic_store(&active_workers, min_workers);
+  return 0;
+}
+
+/**
+ * Changes the number of workers that take new sessions.
+ *
+ * Workers at or above the new count are woken up so they can drain their deque and retire.
+ *
+ * @param count The new number of active workers.
+ */
+void scheduler_set_active(size_t count) {
+  size_t previous = atomic_exchange(&active_workers, count);
+
+  for (size_t i = count; i < previous; i++) {
+    pthread_mutex_lock(&queues[i].mutex);
+    pthread_cond_signal(&queues[i].cond);
+    pthread_mutex_unlock(&queues[i].mutex);
+  }
+}
+
+/**
+ * Returns the number of workers that take new sessions.
+ */
+size_t scheduler_active(void) { return atomic_load(&active_workers); }
+
+/**
+ * Returns the number of active workers currently waiting for a session.
+ */
+size_t scheduler_idle_workers(void) {
+  size_t active = atomic_load(&active_workers);
+  size_t idle = 0;
+  for (size_t i = 0; i < active; i++) {
+    idle += (size_t)atomic_load(&queues[i].idle);
+  }
+  return idle;
+}
+
+/**
+ * Returns the number of sessions waiting for a worker, new or resumed.
+ */
+size_t scheduler_pending(void) { return atomic_load(&pending) + atomic_load(&ready); }
+
+/**
+ * Returns the delay a session queued now is expected to wait for a worker: the moving average of recent waits,
+ * or 0 when no session is waiting.
+ */
+size_t scheduler_queue_delay_us(void) { return scheduler_pending() > 0 ? atomic_load(&queue_delay_us) : 0; }
+
+/**
+ * Frees the per-worker deques.
+ */
+void scheduler_destroy(void) {
+  for (size_t i = 0; i < worker_count; i++) {
+    pthread_mutex_destroy(&queues[i].mutex);
+    pthread_cond_destroy(&queues[i].cond);
+    free(queues[i].items);
+  }
+  free(queues);
+  queues = NULL;
+  worker_count = 0;
+}
+
+/**
+ * Publishes a push to a worker deque. If that worker is busy, an idle worker is woken so it can steal
+ * the session.
+ *
+ * @param target Index of the worker whose deque was pushed to.
+ */
+static void wake_idle(size_t target) {
+  atomic_fetch_add(&push_version, 1);
+  if (atomic_load(&queues[target].idle)) {
+    return;
+  }
+
+  for (size_t i = 1; i < worker_count; i++) {
+    struct WorkerQueue* other = &queues[(target + i) % worker_count];
+    if (atomic_load(&other->idle)) {
+      pthread_mutex_lock(&other->mutex);
+      pthread_cond_signal(&other->cond);
+      pthread_mutex_unlock(&other->mutex);
+      break;
+    }
+  }
+}
+
+/**
+ * Inserts a request, preferably into the deque of the worker that last served the same client.
+ *
+ * @param request The request to insert. Its session ID and admission time are assigned here.
+ * @param session_id Pointer to store the session ID in, since the request may be gone once queued.
+ * @return 0 if the request was queued, 1 if every slot is taken.
+ */
+int scheduler_submit(struct Request* request, int* session_id) {
+  // Claim a slot without blocking the admission thread
+  size_t current = atomic_load(&pending);
+  do {
+    if (current >= queue_capacity) {
+      atomic_fetch_add(&rejected, 1);
+      return 1;
+    }
+  } while (!atomic_compare_exchange_weak(&pending, &current, current + 1));
+
+  request->session_id = atomic_fetch_add(&next_session_id, 1);
+  request->started = 0;
+  request->turns = 0;
+  request->total_queued_us = 0;
+  request->max_queued_us = 0;
+  clock_gettime(CLOCK_MONOTONIC, &request->admitted_at);
+  request->queued_at = request->admitted_at;
+  *session_id = request->session_id;
+
+  size_t active = atomic_load(&active_workers);
+  size_t target = atomic_load(&affinity[affinity_slot(request->request_pipe_path)]);
+  if (target == 0 || target > active) {
+    target = atomic_fetch_add(&next_worker, 1) % active;
+  } else {
+    target--;
+  }
+
+  if (!deque_push(&queues[target], request)) {
+    print_error("Error queuing session.\n");
+    atomic_fetch_sub(&pending, 1);
+    atomic_fetch_add(&rejected, 1);
+    return 1;
+  }
+
+  atomic_fetch_add(&submitted, 1);
+  wake_idle(target);
+  return 0;
+}
+
+/**
+ * Queues a started session again, preferably on the worker that last ran it, whose cache still holds
+ * its state. It goes to the back of the deque, and its owner and thieves both take the front, so a session
+ * that spent its quantum runs again only once every session queued before it on that deque had its turn,
+ * whichever worker takes them.
+ *
+ * @param request The session to queue.
+ * @return 0 if the session was queued, 1 if no deque could take it.
+ */
+int scheduler_resume(struct Request* request) {
+  atomic_fetch_add(&ready, 1);
+  clock_gettime(CLOCK_MONOTONIC, &request->queued_at);
+
+  size_t active = atomic_load(&active_workers);
+  size_t target = request->worker < active ? request->worker : atomic_fetch_add(&next_worker, 1) % active;
+
+  // The deque only fails to grow when memory runs out; any other deque may still take the session
+  size_t attempts = 1;
+  while (!deque_push(&queues[target], request)) {
+    if (attempts++ == worker_count) {
+      print_error("Error queuing session.\n");
+      atomic_fetch_sub(&ready, 1);
+      atomic_fetch_add(&rejected, 1);
+      return 1;
+    }
+    target = (target + 1) % worker_count;
+  }
+
+  atomic_fetch_add(&resumed, 1);
+  wake_idle(target);
+  return 0;
+}
+
+/**
+ * Retrieves the next session for a worker, sleeping while no deque has work.
+ *
+ * @param worker Index of the calling worker.
+ * @param request Pointer to store the session in.
+ * @return 0 if a session was retrieved, 1 if the worker is no longer active and its deque is empty.
+ */
+int scheduler_retrieve(size_t worker, struct Request** request) {
+  struct WorkerQueue* own = &queues[worker];
+
+  while (1) {
+    size_t version = atomic_load(&push_version);
+    if (try_take(worker, request)) {
+      break;
+    }
+
+    pthread_mutex_lock(&own->mutex);
+    if (own->size == 0 && worker >= atomic_load(&active_workers)) {
+      pthread_mutex_unlock(&own->mutex);
+      return 1;
+    }
+
+    atomic_store(&own->idle, 1);
+    // Only sleep if nothing was pushed since the scan started
+    if (own->size == 0 && atomic_load(&push_version) == version && worker < atomic_load(&active_workers)) {
+      pthread_cond_wait(&own->cond, &own->mutex);
+    }
+    atomic_store(&own->idle, 0);
+    pthread_mutex_unlock(&own->mutex);
+  }
+
+  struct Request* session = *request;
+  session->worker = worker;
+  session->turns++;
+
+  // Record how long the session waited for a worker
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  long long waited = (now.tv_sec - session->queued_at.tv_sec) * 1000000LL +
+                     (now.tv_nsec - session->queued_at.tv_nsec) / 1000;
+  size_t wait_us = waited > 0 ? (size_t)waited : 0;
+
+  session->total_queued_us += wait_us;
+  if (wait_us > session->max_queued_us) {
+    session->max_queued_us = wait_us;
+  }
+
+  // Updates racing between workers are lost, which only smooths the average further
+  size_t delay = atomic_load(&queue_delay_us);
+  atomic_store(&queue_delay_us, delay - delay / QUEUE_DELAY_SMOOTHING + wait_us / QUEUE_DELAY_SMOOTHING);
+
+  if (session->started) {
+    atomic_fetch_sub(&ready, 1);
+    atomic_fetch_add(&total_resume_wait_us, wait_us);
+    update_max(&max_resume_wait_us, wait_us);
+    return 0;
+  }
+
+  session->started = 1;
+  atomic_fetch_sub(&pending, 1);
+  atomic_fetch_add(&retrieved, 1);
+  atomic_fetch_add(&total_wait_us, wait_us);
+  update_max(&max_wait_us, wait_us);
+  return 0;
+}
+
+/**
+ * Records the worker that served a session, so the client's next session is queued on it.
+ *
+ * @param worker Index of the worker that served the session.
+ * @param request The finished request.
+ */
+void scheduler_release(size_t worker, const struct Request* request) {
+  atomic_store(&affinity[affinity_slot(request->request_pipe_path)], worker + 1);
+}
+
+/**
+ * Copies the scheduler counters.
+ *
+ * @param stats Pointer to store the counters in.
+ */
+void scheduler_get_stats(struct SchedulerStats* stats) {
+  stats->submitted = atomic_load(&submitted);
+  stats->retrieved = atomic_load(&retrieved);
+  stats->resumed = atomic_load(&resumed);
+  stats->rejected = atomic_load(&rejected);
+  stats->local_hits = atomic_load(&local_hits);
+  stats->steals = atomic_load(&steals);
+  stats->total_wait_us = atomic_load(&total_wait_us);
+  stats->max_wait_us = atomic_load(&max_wait_us);
+  stats->total_resume_wait_us = atomic_load(&total_resume_wait_us);
+  stats->max_resume_wait_us = atomic_load(&max_resume_wait_us);
+}
@@ -0,0 +1,104 @@
+#ifndef SERVER_SCHEDULER_H
+#define SERVER_SCHEDULER_H
+
+#include <stddef.h>
+#include <time.h>
+
+#include "common/constants.h"
+
+/**
+ * @struct Request
+ * @brief A session, as read from the server pipe. The scheduler queues it when it is admitted, and again
+ * every time its coroutine is ready to run after waiting for a pipe.
+ */
+struct Request {
+  int session_id;                     // Session ID
+  char request_pipe_path[MAX_PATH];   // Request pipe path
+  char response_pipe_path[MAX_PATH];  // Response pipe path
+  int request_fd;                     // Request pipe, opened for reading by the admission thread
+  int response_fd;                    // Response pipe, opened for writing by the admission thread
+  unsigned int weight;                // Scheduling weight, between 1 and SESSION_MAX_WEIGHT
+  struct timespec admitted_at;        // When the setup was accepted
+  int started;                        // 1 once a worker took the session for the first time
+  size_t worker;                      // Worker that last ran the session
+  struct timespec queued_at;          // When the session was last queued
+  size_t turns;                       // Number of times a worker took the session
+  size_t total_queued_us;             // Time the session spent queued, over all its turns
+  size_t max_queued_us;               // Longest time the session spent queued before a turn
+};
+
+/**
+ * @struct SchedulerStats
+ * @brief Counters describing how sessions were distributed among workers.
+ */
+struct SchedulerStats {
+  size_t submitted;             // Sessions inserted into the scheduler
+  size_t retrieved;             // Sessions taken by a worker for the first time
+  size_t resumed;               // Sessions queued again after waiting for a pipe or ending their turn
+  size_t rejected;              // Setups refused because every queue slot was taken
+  size_t local_hits;            // Sessions run by the worker whose deque they were queued on
+  size_t steals;                // Sessions taken from another worker's deque
+  size_t total_wait_us;         // Sum of the time sessions spent queued before a worker took them
+  size_t max_wait_us;           // Longest time a session spent queued before it started
+  size_t total_resume_wait_us;  // Sum of the time resumed sessions spent queued before their next turn
+  size_t max_resume_wait_us;    // Longest time a resumed session spent queued
+};
+
+/// Initializes the scheduler with min_workers active workers.
+/// @param max_workers Maximum number of worker threads that will retrieve sessions.
+/// @param min_workers Minimum number of worker threads that will retrieve sessions.
+/// @param capacity Maximum number of sessions waiting to be served.
+/// @return 0 if the scheduler was initialized successfully, 1 otherwise.
+int scheduler_init(size_t max_workers, size_t min_workers, size_t capacity);
+
+/// Destroys the scheduler state.
+void scheduler_destroy(void);
+
+/// Inserts a request, assigning it a session ID. Never blocks.
+/// @param request Request to be inserted. Its session_id, admitted_at and turn counters are filled in. Once queued,
+///                it belongs to the worker that retrieves it and may be freed at any time.
+/// @param session_id Pointer to store the session ID in.
+/// @return 0 if the request was queued, 1 if the scheduler is full.
+int scheduler_submit(struct Request* request, int* session_id);
+
+/// Queues a started session again, behind every session already queued on the worker that last ran it. Never
+/// blocks, and only fails when no deque can grow to take it.
+/// @param request The session, which must stay allocated until a worker retrieves it.
+/// @return 0 if the session was queued, 1 if it could not be, in which case it is counted as rejected.
+int scheduler_resume(struct Request* request);
+
+/// Retrieves the next session for a worker, stealing from other workers when its own deque is empty.
+/// Blocks until a session is available or the worker is retired. The time the session spent queued is added
+/// to its counters.
+/// @param worker Index of the calling worker.
+/// @param request Pointer to store the retrieved session in.
+/// @return 0 if a session was retrieved, 1 if the worker should exit.
+int scheduler_retrieve(size_t worker, struct Request** request);
+
+/// Marks a session as finished, remembering which worker served it.
+/// @param worker Index of the worker that served the session.
+/// @param request The finished request.
+void scheduler_release(size_t worker, const struct Request* request);
+
+/// Changes the number of workers that take new sessions. Workers above it retire once their deque is empty.
+/// @param count New number of active workers, between the minimum and maximum given to scheduler_init.
+void scheduler_set_active(size_t count);
+
+/// Returns the number of workers that take new sessions.
+size_t scheduler_active(void);
+
+/// Returns the number of active workers waiting for a session.
+size_t scheduler_idle_workers(void);
+
+/// Returns the number of sessions waiting for a worker, new or resumed.
+size_t scheduler_pending(void);
+
+/// Returns the delay a session queued now is expected to wait for a worker: a moving average of the waits of
+/// recent turns, or 0 when no session is waiting.
+size_t scheduler_queue_delay_us(void);
+
+/// Copies the current scheduler counters.
+/// @param stats Pointer to store the counters in.
+void scheduler_get_stats(struct SchedulerStats* stats);
+
+#endif  // SERVER_SCHEDULER_H
@@ -0,0 +1,292 @@
+// madvise and MAP_NORESERVE are not part of POSIX
+#define _DEFAULT_SOURCE
+
+#include "seatstore.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "common/constants.h"
+#include "common/io.h"
+
+static pthread_mutex_t store_mutex = PTHREAD_MUTEX_INITIALIZER;
+static int store_fd = -1;
+static char* base = NULL;     // Mapping of the whole reserved range, of which the file backs the first file_size bytes
+static size_t file_size = 0;  // Bytes allocated to the file
+static size_t used = 0;       // Bytes handed out to events
+static size_t page_size = 0;
+static int prefault_seats = 0;
+static struct timespec opened_at;
+
+static size_t events = 0;
+static atomic_size_t cold_events = 0;
+static atomic_size_t page_outs = 0;
+static atomic_size_t page_ins = 0;
+
+/**
+ * Gets the time since the seat file was opened, as event use times are kept.
+ */
+static unsigned int seconds_open(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (unsigned int)(now.tv_sec - opened_at.tv_sec);
+}
+
+/**
+ * Gets the pages the seats of an event have to themselves, leaving out the pages they share with smaller neighbours.
+ *
+ * @param event The event.
+ * @param start Pointer to store the start of the pages in.
+ * @return Size of the pages, 0 if the event has no page of its own.
+ */
+static size_t own_pages(struct Event* event, void** start) {
+  uintptr_t first = ((uintptr_t)event->data + page_size - 1) / page_size * page_size;
+  uintptr_t end = ((uintptr_t)event->data + event->rows * event->cols * sizeof(unsigned int)) / page_size * page_size;
+  *start = (void*)first;
+  return end > first ? end - first : 0;
+}
+
+/**
+ * Writes the seats of an event back to the seat file and frees their pages.
+ *
+ * @param event The event.
+ * @return 0 on success, 1 if the event has no page of its own or its pages could not be written.
+ */
+static int page_out(struct Event* event) {
+  void* start;
+  size_t size = own_pages(event, &start);
+
+  // Reclaim on request skips dirty pages of files, which only the kernel's own writeback may write out
+  if (size == 0 || msync(start, size, MS_SYNC) != 0) {
+    return 1;
+  }
+
+  // Kernels before 5.4 cannot reclaim on request, but still let go of the pages, which stay in the page cache
+  if (madvise(start, size, MADV_PAGEOUT) != 0 && (errno != EINVAL || madvise(start, size, MADV_DONTNEED) != 0)) {
+    return 1;
+  }
+  return 0;
+}
+
+/**
+ * Faults in the pages of new seats, writable, so that their first uses do not take page faults.
+ *
+ * @param seats The seats.
+ * @param size Size of the seats in bytes.
+ */
+static void prefault(unsigned int* seats, size_t size) {
+  uintptr_t start = (uintptr_t)seats / page_size * page_size;
+  uintptr_t end = (uintptr_t)seats + size;
+  if (madvise((void*)start, end - start, MADV_POPULATE_WRITE) == 0) {
+    return;
+  }
+
+  // Kernels before 5.14 fault each page in when it is first written
+  for (uintptr_t page = start; page < end; page += page_size) {
+    *(volatile char*)(page > (uintptr_t)seats ? page : (uintptr_t)seats) = 0;
+  }
+}
+
+/**
+ * Opens the seat file and maps the whole range it may grow to, so that seats never move once handed out.
+ *
+ * @param path Path to the seat file.
+ * @param prefault 1 to fault in the seats of new events.
+ * @return 0 on success, 1 on failure.
+ */
+int seat_store_open(const char* path, int prefault) {
+  pthread_mutex_lock(&store_mutex);
+  if (store_fd != -1) {
+    pthread_mutex_unlock(&store_mutex);
+    print_error("The seat file is already open.\n");
+    return 1;
+  }
+
+  // Nothing in the file outlives the server: the state is restored from the data directory instead
+  int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0600);
+  if (fd == -1 || unlink(path) != 0) {
+    pthread_mutex_unlock(&store_mutex);
+    print_error("Failed to create the seat file.\n");
+    if (fd != -1) {
+      close(fd);
+    }
+    return 1;
+  }
+
+  // Pages past the end of the file are never handed out, so the reservation needs no memory of its own
+  void* pages = mmap(NULL, SEAT_STORE_MAX_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_NORESERVE, fd, 0);
+  if (pages == MAP_FAILED) {
+    pthread_mutex_unlock(&store_mutex);
+    print_error("Failed to map the seat file.\n");
+    close(fd);
+    return 1;
+  }
+
+  store_fd = fd;
+  base = pages;
+  file_size = 0;
+  used = 0;
+  page_size = (size_t)sysconf(_SC_PAGESIZE);
+  prefault_seats = prefault;
+  clock_gettime(CLOCK_MONOTONIC, &opened_at);
+  events = 0;
+  atomic_store(&cold_events, 0);
+  atomic_store(&page_outs, 0);
+  atomic_store(&page_ins, 0);
+  pthread_mutex_unlock(&store_mutex);
+  return 0;
+}
+
+/**
+ * Tells whether the seat file is open.
+ *
+ * @return 1 if it is open, 0 otherwise.
+ */
+int seat_store_is_open(void) {
+  pthread_mutex_lock(&store_mutex);
+  int open = store_fd != -1;
+  pthread_mutex_unlock(&store_mutex);
+  return open;
+}
+
+/**
+ * Allocates seats at the end of the used part of the seat file, growing it if needed. Seats are never freed, as
+ * events are never deleted.
+ *
+ * @param count Number of seats.
+ * @return The seats, zeroed, or NULL on failure.
+ */
+unsigned int* seat_store_alloc(size_t count) {
+  size_t size = count * sizeof(unsigned int);
+
+  // Seat maps of a page or more get pages of their own, so hints about them leave other events alone
+  size_t alignment = size >= page_size ? page_size : SEAT_STORE_ALIGNMENT;
+
+  pthread_mutex_lock(&store_mutex);
+  size_t offset = (used + alignment - 1) / alignment * alignment;
+  if (store_fd == -1 || count > SEAT_STORE_MAX_SIZE / sizeof(unsigned int) || offset > SEAT_STORE_MAX_SIZE - size) {
+    pthread_mutex_unlock(&store_mutex);
+    print_error("The seat file is full.\n");
+    return NULL;
+  }
+
+  // Blocks are allocated as the file grows, so writing to the seats later cannot fail for lack of disk space
+  if (offset + size > file_size) {
+    size_t grown = (offset + size + SEAT_STORE_GROW_SIZE - 1) / SEAT_STORE_GROW_SIZE * SEAT_STORE_GROW_SIZE;
+    if (grown > SEAT_STORE_MAX_SIZE) {
+      grown = SEAT_STORE_MAX_SIZE;
+    }
+    if (posix_fallocate(store_fd, (off_t)file_size, (off_t)(grown - file_size)) != 0) {
+      pthread_mutex_unlock(&store_mutex);
+      print_error("Failed to grow the seat file.\n");
+      return NULL;
+    }
+    file_size = grown;
+  }
+
+  used = offset + size;
+  events++;
+  unsigned int* seats = (unsigned int*)(void*)(base + offset);
+  int prefault_new = prefault_seats;
+  pthread_mutex_unlock(&store_mutex);
+
+  if (prefault_new && size > 0) {
+    prefault(seats, size);
+  }
+  return seats;
+}
+
+/**
+ * Marks the seats of an event as used now. Seats that were paged out are read back in as a whole, rather than a
+ * page at each fault.
+ *
+ * @param event The event.
+ */
+void seat_store_use(struct Event* event) {
+  if (event->storage != SEATS_FILE) {
+    return;
+  }
+
+  atomic_store_explicit(&event->last_used, seconds_open(), memory_order_relaxed);
+  if (atomic_load_explicit(&event->cold, memory_order_relaxed) && atomic_exchange(&event->cold, 0)) {
+    atomic_fetch_sub(&cold_events, 1);
+    void* start;
+    size_t size = own_pages(event, &start);
+    if (size > 0 && madvise(start, size, MADV_WILLNEED) == 0) {
+      atomic_fetch_add(&page_ins, 1);
+    }
+  }
+}
+
+/**
+ * Pages out the seats of the events that were not used for a while. Their pages are written back to the seat file
+ * and freed, so the memory of the server follows the events in use rather than all of them.
+ *
+ * @param head First node of the events.
+ * @param tail Last node of the events, or NULL if there are none.
+ * @param idle_s Seconds an event must have gone unused.
+ * @return Number of events paged out.
+ */
+size_t seat_store_sweep(struct ListNode* head, struct ListNode* tail, unsigned int idle_s) {
+  unsigned int now = seconds_open();
+  size_t paged_out = 0;
+  for (struct ListNode* node = tail != NULL ? head : NULL; node != NULL; node = node == tail ? NULL : node->next) {
+    struct Event* event = node->event;
+    if (event->storage != SEATS_FILE || atomic_load(&event->cold) ||
+        now - atomic_load_explicit(&event->last_used, memory_order_relaxed) < idle_s) {
+      continue;
+    }
+
+    // An event used meanwhile is read back in on its next use. Events without a page of their own are left to the
+    // kernel, which reclaims the pages of the file they share once no event in them is used
+    int hot = 0;
+    if (!atomic_compare_exchange_strong(&event->cold, &hot, 1)) {
+      continue;
+    }
+    if (page_out(event) != 0) {
+      atomic_store(&event->cold, 0);
+      continue;
+    }
+    atomic_fetch_add(&cold_events, 1);
+    paged_out++;
+  }
+
+  atomic_fetch_add(&page_outs, paged_out);
+  return paged_out;
+}
+
+/**
+ * Copies the counters of the seat file.
+ *
+ * @param stats Pointer to store the counters in.
+ */
+void seat_store_get_stats(struct SeatStoreStats* stats) {
+  pthread_mutex_lock(&store_mutex);
+  stats->open = store_fd != -1;
+  stats->events = events;
+  stats->bytes = used;
+  pthread_mutex_unlock(&store_mutex);
+  stats->cold_events = atomic_load(&cold_events);
+  stats->page_outs = atomic_load(&page_outs);
+  stats->page_ins = atomic_load(&page_ins);
+}
+
+/**
+ * Unmaps and closes the seat file.
+ */
+void seat_store_close(void) {
+  pthread_mutex_lock(&store_mutex);
+  if (store_fd != -1) {
+    munmap(base, SEAT_STORE_MAX_SIZE);
+    close(store_fd);
+    store_fd = -1;
+    base = NULL;
+  }
+  pthread_mutex_unlock(&store_mutex);
+}
@@ -0,0 +1,56 @@
+#ifndef SERVER_SEATSTORE_H
+#define SERVER_SEATSTORE_H
+
+#include <stddef.h>
+
+#include "eventlist.h"
+
+/**
+ * @struct SeatStoreStats
+ * @brief Counters of the seat file.
+ */
+struct SeatStoreStats {
+  int open;            // 1 if seats of new events are stored in the seat file
+  size_t events;       // Events whose seats are in the file
+  size_t bytes;        // Bytes of the file handed out to events
+  size_t cold_events;  // Events whose seats are paged out
+  size_t page_outs;    // Times unused events were paged out
+  size_t page_ins;     // Times cold events were read back in ahead of use
+};
+
+/// Opens the seat file, which the seats of every event created from then on live in, through a shared mapping the
+/// kernel pages in and out as memory runs short. The file only backs memory: it is emptied on open and removed
+/// right away, so its space is given back once the server exits.
+/// @param path Path to the seat file.
+/// @param prefault 1 to fault the seats of each event in as it is created, so its first uses do not wait for it.
+/// @return 0 on success, 1 on failure.
+int seat_store_open(const char* path, int prefault);
+
+/// Tells whether the seat file is open.
+/// @return 1 if the seats of new events go to the seat file, 0 otherwise.
+int seat_store_is_open(void);
+
+/// Allocates zeroed seats in the seat file. Seat maps of a page or more start on a page of their own.
+/// @param count Number of seats.
+/// @return The seats, or NULL if the file could not grow.
+unsigned int* seat_store_alloc(size_t count);
+
+/// Marks the seats of an event in the seat file as used, reading them back in at once if they were paged out.
+/// @param event The event.
+void seat_store_use(struct Event* event);
+
+/// Pages out the seats of the events from head to tail that are in the seat file and were not used for a while.
+/// @param head First node of the events.
+/// @param tail Last node of the events, or NULL if there are none.
+/// @param idle_s Seconds an event must have gone unused.
+/// @return Number of events paged out.
+size_t seat_store_sweep(struct ListNode* head, struct ListNode* tail, unsigned int idle_s);
+
+/// Copies the counters of the seat file.
+/// @param stats Pointer to store the counters in.
+void seat_store_get_stats(struct SeatStoreStats* stats);
+
+/// Unmaps and closes the seat file, once the events using it were freed.
+void seat_store_close(void);
+
+#endif  // SERVER_SEATSTORE_H
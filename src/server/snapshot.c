@@ -0,0 +1,56 @@
+// MAP_ANONYMOUS is not part of POSIX
+#define _DEFAULT_SOURCE
+
+#include "snapshot.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+/**
+ * Copies seats into a new snapshot.
+ *
+ * The copy lives in its own anonymous mapping, so it starts on a page boundary and shares no page with
+ * other heap data, as needed to splice it into a pipe.
+ *
+ * @param seats Seats to copy.
+ * @param count Number of seats.
+ * @return The snapshot, with one reference, or NULL if it could not be allocated.
+ */
+struct SeatSnapshot* snapshot_create(const unsigned int* seats, size_t count) {
+  struct SeatSnapshot* snapshot = malloc(sizeof(struct SeatSnapshot));
+  if (snapshot == NULL) {
+    return NULL;
+  }
+
+  size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+  snapshot->size = count * sizeof(unsigned int);
+  snapshot->mapped_size = (snapshot->size + page_size - 1) / page_size * page_size;
+
+  void* pages = mmap(NULL, snapshot->mapped_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (pages == MAP_FAILED) {
+    free(snapshot);
+    return NULL;
+  }
+
+  memcpy(pages, seats, snapshot->size);
+
+  // Nothing may write to the pages from here on
+  mprotect(pages, snapshot->mapped_size, PROT_READ);
+
+  snapshot->seats = pages;
+  atomic_init(&snapshot->refs, 1);
+  return snapshot;
+}
+
+void snapshot_acquire(struct SeatSnapshot* snapshot) { atomic_fetch_add(&snapshot->refs, 1); }
+
+void snapshot_release(struct SeatSnapshot* snapshot) {
+  if (atomic_fetch_sub(&snapshot->refs, 1) != 1) {
+    return;
+  }
+
+  munmap(snapshot->seats, snapshot->mapped_size);
+  free(snapshot);
+}
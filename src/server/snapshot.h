@@ -0,0 +1,37 @@
+#ifndef SERVER_SNAPSHOT_H
+#define SERVER_SNAPSHOT_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+
+/**
+ * @struct SeatSnapshot
+ * @brief Immutable, page-aligned copy of an event's seats, shared by the SHOW replies that send it.
+ *
+ * Its pages are spliced into response pipes, where the kernel keeps referencing them until the client
+ * reads them, so they are never written again once the snapshot is created. A reservation makes the event
+ * drop its snapshot; the pages are unmapped when the last SHOW using them releases it.
+ */
+struct SeatSnapshot {
+  unsigned int* seats;  // Copy of the event's seats, at the start of a private mapping
+  size_t size;          // Number of bytes of seats
+  size_t mapped_size;   // Size of the mapping, rounded up to whole pages
+  atomic_size_t refs;   // The event's reference, while it is current, plus one per SHOW sending it
+};
+
+/// Copies seats into a new snapshot, with a single reference held by the caller.
+/// @param seats Seats to copy.
+/// @param count Number of seats.
+/// @return The snapshot, or NULL if it could not be allocated.
+struct SeatSnapshot* snapshot_create(const unsigned int* seats, size_t count);
+
+/// Takes a reference to a snapshot.
+/// @param snapshot The snapshot.
+void snapshot_acquire(struct SeatSnapshot* snapshot);
+
+/// Drops a reference to a snapshot, unmapping it when it was the last one.
+/// Pages already spliced into a pipe stay valid until they are read.
+/// @param snapshot The snapshot.
+void snapshot_release(struct SeatSnapshot* snapshot);
+
+#endif  // SERVER_SNAPSHOT_H
@@ -0,0 +1,246 @@
+#include "trace.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "common/constants.h"
+
+/**
+ * @struct TraceSlot
+ * @brief One span of a ring. Its fields are only written by the thread owning the ring, and read by exports
+ * without any lock: seq is odd while the span is written, so a reader copying it can tell when it was overwritten.
+ */
+struct TraceSlot {
+  atomic_uint_least64_t seq;       // 2 * position + 2 once the span at that position is written
+  atomic_uint_least64_t start_ns;  // When the span started, since tracing was turned on
+  atomic_uint_least64_t dur_ns;    // How long it lasted
+  atomic_uint_least64_t ids;       // Track in the high half, request in the low half
+  atomic_uint_least64_t detail;    // Event ID in the high half, then session ID, then kind in the lowest byte
+};
+
+/**
+ * @struct TraceRing
+ * @brief Spans recorded by one thread. A thread that exits gives its ring back, to be taken over by the next thread
+ * that records a span, so rings follow the threads alive rather than every thread ever started.
+ */
+struct TraceRing {
+  struct TraceSlot slots[TRACE_RING_SPANS];
+  atomic_uint_least64_t head;  // Spans ever written to the ring
+  atomic_int owned;            // 1 while a thread records into the ring
+  unsigned int thread;         // Index of the ring, shown as the thread of its spans
+  struct TraceRing* next;      // Ring registered before it
+};
+
+// Set once before any span is recorded; when 0, recording a span costs a branch
+static int enabled = 0;
+static struct timespec epoch;   // When tracing was turned on
+static atomic_uint tracks = 0;  // Tracks given to sessions
+
+// Every ring registered, newest first; rings are never freed
+static _Atomic(struct TraceRing*) rings = NULL;
+static atomic_uint ring_count = 0;
+
+// Gives the ring of an exiting thread back
+static pthread_key_t ring_key;
+static _Thread_local struct TraceRing* own = NULL;
+
+/**
+ * Gets the time between two instants in nanoseconds, 0 if the clock went backwards.
+ */
+static uint64_t between_ns(const struct timespec* from, const struct timespec* to) {
+  long long elapsed = (to->tv_sec - from->tv_sec) * 1000000000LL + (to->tv_nsec - from->tv_nsec);
+  return elapsed > 0 ? (uint64_t)elapsed : 0;
+}
+
+/**
+ * Gives the ring of a thread that exits back, for another thread to take over.
+ *
+ * @param arg The ring.
+ */
+static void release_ring(void* arg) {
+  struct TraceRing* ring = arg;
+  atomic_store_explicit(&ring->owned, 0, memory_order_release);
+}
+
+/**
+ * Takes over a ring given back by a thread that exited, or registers a new one.
+ *
+ * @return The ring, or NULL if it could not be allocated.
+ */
+static struct TraceRing* claim_ring(void) {
+  struct TraceRing* ring = atomic_load_explicit(&rings, memory_order_acquire);
+  for (; ring != NULL; ring = ring->next) {
+    int free_ring = 0;
+    if (atomic_compare_exchange_strong_explicit(&ring->owned, &free_ring, 1, memory_order_acq_rel,
+                                                memory_order_relaxed)) {
+      break;
+    }
+  }
+
+  if (ring == NULL) {
+    ring = calloc(1, sizeof(struct TraceRing));
+    if (ring == NULL) {
+      return NULL;
+    }
+    atomic_init(&ring->owned, 1);
+    ring->thread = atomic_fetch_add(&ring_count, 1);
+    ring->next = atomic_load_explicit(&rings, memory_order_relaxed);
+    while (!atomic_compare_exchange_weak_explicit(&rings, &ring->next, ring, memory_order_release,
+                                                  memory_order_relaxed)) {
+    }
+  }
+
+  pthread_setspecific(ring_key, ring);
+  return ring;
+}
+
+/**
+ * Turns tracing on. Called before any span is recorded; it then stays on.
+ *
+ * @return 0 on success, 1 on failure.
+ */
+int trace_enable(void) {
+  if (pthread_key_create(&ring_key, release_ring) != 0) {
+    print_error("Error setting up tracing.\n");
+    return 1;
+  }
+  clock_gettime(CLOCK_MONOTONIC, &epoch);
+  enabled = 1;
+  return 0;
+}
+
+/**
+ * Tells whether tracing is on.
+ *
+ * @return 1 if it is, 0 otherwise.
+ */
+int trace_enabled(void) { return enabled; }
+
+/**
+ * Gets a track of its own for a session.
+ *
+ * @return The track.
+ */
+unsigned int trace_track(void) { return atomic_fetch_add_explicit(&tracks, 1, memory_order_relaxed) + 1; }
+
+/**
+ * Records a span in the ring of the calling thread, overwriting its oldest span once the ring is full.
+ *
+ * @param kind What the span covers.
+ * @param id Request it belongs to.
+ * @param start When it started.
+ * @param end When it ended.
+ */
+void trace_span(enum SpanKind kind, const struct TraceId* id, const struct timespec* start,
+                const struct timespec* end) {
+  if (!enabled || (own == NULL && (own = claim_ring()) == NULL)) {
+    return;
+  }
+
+  // Only this thread writes to the ring, so the slot is marked as being written, filled, then published
+  uint64_t position = atomic_load_explicit(&own->head, memory_order_relaxed);
+  struct TraceSlot* slot = &own->slots[position % TRACE_RING_SPANS];
+  atomic_store_explicit(&slot->seq, 2 * position + 1, memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+  atomic_store_explicit(&slot->start_ns, between_ns(&epoch, start), memory_order_relaxed);
+  atomic_store_explicit(&slot->dur_ns, between_ns(start, end), memory_order_relaxed);
+  atomic_store_explicit(&slot->ids, (uint64_t)id->track << 32 | id->request, memory_order_relaxed);
+  uint64_t detail = (uint64_t)id->event_id << 32 | (uint64_t)(id->session & 0xffffffu) << 8 | (uint64_t)kind;
+  atomic_store_explicit(&slot->detail, detail, memory_order_relaxed);
+  atomic_store_explicit(&slot->seq, 2 * position + 2, memory_order_release);
+  atomic_store_explicit(&own->head, position + 1, memory_order_release);
+}
+
+/**
+ * Writes a time in nanoseconds as microseconds with three decimals, the unit of Chrome trace timestamps.
+ *
+ * @param out The writer.
+ * @param ns The time.
+ * @return 0 on success, 1 on failure.
+ */
+static int write_micros(struct Writer* out, uint64_t ns) {
+  char number[32];
+  snprintf(number, sizeof(number), "%llu.%03u", (unsigned long long)(ns / 1000), (unsigned int)(ns % 1000));
+  return writer_str(out, number);
+}
+
+/**
+ * Writes a span as a complete event of a Chrome trace, on the track of its session. The setup of a session also
+ * names its track.
+ *
+ * @param out The writer.
+ * @param thread Index of the ring it was recorded in.
+ * @param start_ns When it started.
+ * @param dur_ns How long it lasted.
+ * @param ids Its track and request.
+ * @param detail Its event ID, session ID and kind.
+ * @return 0 on success, 1 on failure.
+ */
+static int write_span(struct Writer* out, unsigned int thread, uint64_t start_ns, uint64_t dur_ns, uint64_t ids,
+                      uint64_t detail) {
+  static const char* const names[SPAN_KIND_COUNT] = {"setup",   "queue",  "decode",  "lookup", "lock", "execute",
+                                                     "respond", "CREATE", "RESERVE", "SHOW",   "LIST"};
+  uint64_t kind = detail & 0xffu;
+  int failed = 0;
+  if (kind == SPAN_SETUP) {
+    failed = writer_str(out, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":") != 0;
+    failed = writer_uint(out, (unsigned int)(ids >> 32)) != 0 || failed;
+    failed = writer_str(out, ",\"args\":{\"name\":\"Session ") != 0 || failed;
+    failed = writer_uint(out, (unsigned int)(detail >> 8 & 0xffffffu)) != 0 || failed;
+    failed = writer_str(out, "\"}}") != 0 || failed;
+  }
+
+  failed = writer_str(out, ",\n{\"name\":\"") != 0 || failed;
+  failed = writer_str(out, kind < SPAN_KIND_COUNT ? names[kind] : "unknown") != 0 || failed;
+  failed = writer_str(out, "\",\"cat\":\"ems\",\"ph\":\"X\",\"pid\":1,\"tid\":") != 0 || failed;
+  failed = writer_uint(out, (unsigned int)(ids >> 32)) != 0 || failed;
+  failed = writer_str(out, ",\"ts\":") != 0 || failed;
+  failed = write_micros(out, start_ns) != 0 || failed;
+  failed = writer_str(out, ",\"dur\":") != 0 || failed;
+  failed = write_micros(out, dur_ns) != 0 || failed;
+  failed = writer_str(out, ",\"args\":{\"request\":") != 0 || failed;
+  failed = writer_uint(out, (unsigned int)(ids & 0xffffffffu)) != 0 || failed;
+  failed = writer_str(out, ",\"session\":") != 0 || failed;
+  failed = writer_uint(out, (unsigned int)(detail >> 8 & 0xffffffu)) != 0 || failed;
+  failed = writer_str(out, ",\"event\":") != 0 || failed;
+  failed = writer_uint(out, (unsigned int)(detail >> 32)) != 0 || failed;
+  failed = writer_str(out, ",\"thread\":") != 0 || failed;
+  failed = writer_uint(out, thread) != 0 || failed;
+  return writer_str(out, "}}") != 0 || failed;
+}
+
+/**
+ * Writes the spans in every ring as Chrome trace-event JSON, one track per session. Each span is copied, then kept
+ * only if its slot was not overwritten meanwhile, so threads recording spans are never waited for.
+ *
+ * @param out Writer to write them through, flushed by the caller.
+ * @return 0 on success, 1 on failure.
+ */
+int trace_export(struct Writer* out) {
+  int failed = writer_str(out, "{\"traceEvents\":[\n{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,"
+                               "\"args\":{\"name\":\"ems\"}}") != 0;
+
+  for (struct TraceRing* ring = atomic_load_explicit(&rings, memory_order_acquire); ring != NULL;
+       ring = ring->next) {
+    uint64_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    uint64_t position = head > TRACE_RING_SPANS ? head - TRACE_RING_SPANS : 0;
+    for (; position < head; position++) {
+      struct TraceSlot* slot = &ring->slots[position % TRACE_RING_SPANS];
+      uint64_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+      uint64_t start_ns = atomic_load_explicit(&slot->start_ns, memory_order_relaxed);
+      uint64_t dur_ns = atomic_load_explicit(&slot->dur_ns, memory_order_relaxed);
+      uint64_t ids = atomic_load_explicit(&slot->ids, memory_order_relaxed);
+      uint64_t detail = atomic_load_explicit(&slot->detail, memory_order_relaxed);
+      atomic_thread_fence(memory_order_acquire);
+      if (seq != 2 * position + 2 || atomic_load_explicit(&slot->seq, memory_order_relaxed) != seq) {
+        continue;  // Overwritten by a newer span
+      }
+      failed = write_span(out, ring->thread, start_ns, dur_ns, ids, detail) != 0 || failed;
+    }
+  }
+
+  return writer_str(out, "\n],\"displayTimeUnit\":\"ns\"}\n") != 0 || failed;
+}
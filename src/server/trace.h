@@ -0,0 +1,65 @@
+#ifndef SERVER_TRACE_H
+#define SERVER_TRACE_H
+
+#include <time.h>
+
+#include "common/io.h"
+
+/**
+ * @enum SpanKind
+ * @brief What a span of a request covers.
+ */
+enum SpanKind {
+  SPAN_SETUP,       // From the setup being accepted until the session pipes were open
+  SPAN_QUEUE,       // Waiting for a worker, for a lane, or while a SHOW let reservations through
+  SPAN_DECODE,      // Reading the arguments of an operation from the session buffer
+  SPAN_LOOKUP,      // Finding the event in the state, the state access delay included
+  SPAN_LOCK,        // Waiting for the list lock or the event mutex
+  SPAN_EXECUTE,     // From entering its lane until the reply was handed over
+  SPAN_RESPOND,     // Handing the reply to the session pipes
+  SPAN_CREATE,      // A whole CREATE, from its op code being read until its reply was handed over
+  SPAN_RESERVE,     // A whole RESERVE
+  SPAN_SHOW,        // A whole SHOW
+  SPAN_LIST,        // A whole LIST
+  SPAN_KIND_COUNT,  // Number of kinds
+};
+
+/**
+ * @struct TraceId
+ * @brief Identifies the request a span belongs to.
+ */
+struct TraceId {
+  unsigned int track;     // Track of the session in the trace, never shared with another session
+  unsigned int session;   // ID of the session, which a later session may reuse
+  unsigned int request;   // Number of the request within the session, from 1
+  unsigned int event_id;  // Event it names, 0 if none
+};
+
+/// Turns tracing on. Called before any span is recorded; it then stays on.
+/// @return 0 on success, 1 on failure.
+int trace_enable(void);
+
+/// Tells whether tracing is on.
+/// @return 1 if it is, 0 otherwise.
+int trace_enabled(void);
+
+/// Gets a track of its own for a session.
+/// @return The track.
+unsigned int trace_track(void);
+
+/// Records a span in the ring of the calling thread, overwriting its oldest span once the ring is full. Never
+/// blocks; a span the ring could not be allocated for is dropped.
+/// @param kind What the span covers.
+/// @param id Request it belongs to.
+/// @param start When it started.
+/// @param end When it ended.
+void trace_span(enum SpanKind kind, const struct TraceId* id, const struct timespec* start,
+                const struct timespec* end);
+
+/// Writes the spans in every ring as Chrome trace-event JSON, one track per session, named after its ID. Spans
+/// recorded meanwhile may be left out, but never torn.
+/// @param out Writer to write them through, flushed by the caller.
+/// @return 0 on success, 1 on failure.
+int trace_export(struct Writer* out);
+
+#endif  // SERVER_TRACE_H
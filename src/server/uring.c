@@ -0,0 +1,296 @@
+// syscall() is not part of POSIX
+#define _DEFAULT_SOURCE
+
+#include "uring.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "common/io.h"
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#define HAVE_IO_URING 1
+#endif
+
+#ifdef HAVE_IO_URING
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+// Older headers lack the flag, which kernels without it never set
+#ifndef IORING_SQ_CQ_OVERFLOW
+#define IORING_SQ_CQ_OVERFLOW (1U << 1)
+#endif
+
+/**
+ * Thin wrappers around the io_uring system calls, which have no libc wrappers.
+ */
+static int sys_io_uring_setup(unsigned entries, struct io_uring_params* params) {
+  return (int)syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int sys_io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags) {
+  return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+static int sys_io_uring_register(int fd, unsigned opcode, void* arg, unsigned nr_args) {
+  return (int)syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+/**
+ * Checks whether the kernel supports io_uring with read and write operations.
+ *
+ * Creating a ring fails on kernels without io_uring and where it is disabled (for instance by seccomp
+ * filters in containers). Read and write operations are checked with the probe interface.
+ *
+ * @return 1 if io_uring can be used, 0 otherwise.
+ */
+int uring_supported(void) {
+  struct Uring ring;
+  if (uring_init(&ring, 2, 0) != 0) {
+    return 0;
+  }
+
+  size_t probe_size = sizeof(struct io_uring_probe) + IORING_OP_LAST * sizeof(struct io_uring_probe_op);
+  struct io_uring_probe* probe = calloc(1, probe_size);
+  int supported = 0;
+  if (probe != NULL && sys_io_uring_register(ring.fd, IORING_REGISTER_PROBE, probe, IORING_OP_LAST) == 0) {
+    supported = probe->ops_len > IORING_OP_WRITE && (probe->ops[IORING_OP_READ].flags & IO_URING_OP_SUPPORTED) &&
+                (probe->ops[IORING_OP_WRITE].flags & IO_URING_OP_SUPPORTED);
+  }
+
+  free(probe);
+  uring_destroy(&ring);
+  return supported;
+}
+
+/**
+ * Creates an io_uring instance and maps its submission ring, completion ring and submission queue entries.
+ *
+ * @param ring Pointer to the ring to initialize.
+ * @param entries Minimum number of submission queue entries.
+ * @param cq_entries Minimum number of completion queue entries, or 0 for the kernel default.
+ * @return 0 if the ring was created successfully, 1 otherwise.
+ */
+int uring_init(struct Uring* ring, unsigned entries, unsigned cq_entries) {
+  memset(ring, 0, sizeof(struct Uring));
+
+  struct io_uring_params params;
+  memset(&params, 0, sizeof(params));
+  if (cq_entries > 0) {
+    params.flags = IORING_SETUP_CQSIZE;
+    params.cq_entries = cq_entries;
+  }
+  ring->fd = sys_io_uring_setup(entries, &params);
+  if (ring->fd < 0) {
+    return 1;
+  }
+
+  ring->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  ring->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+
+  // Recent kernels share a single mapping between both rings
+  if (params.features & IORING_FEAT_SINGLE_MMAP) {
+    if (ring->cq_ring_size > ring->sq_ring_size) {
+      ring->sq_ring_size = ring->cq_ring_size;
+    }
+    ring->cq_ring_size = ring->sq_ring_size;
+  }
+
+  ring->sq_ring = mmap(NULL, ring->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED, ring->fd, IORING_OFF_SQ_RING);
+  if (ring->sq_ring == MAP_FAILED) {
+    close(ring->fd);
+    return 1;
+  }
+
+  if (params.features & IORING_FEAT_SINGLE_MMAP) {
+    ring->cq_ring = ring->sq_ring;
+  } else {
+    ring->cq_ring = mmap(NULL, ring->cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED, ring->fd, IORING_OFF_CQ_RING);
+    if (ring->cq_ring == MAP_FAILED) {
+      munmap(ring->sq_ring, ring->sq_ring_size);
+      close(ring->fd);
+      return 1;
+    }
+  }
+
+  ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+  ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED, ring->fd, IORING_OFF_SQES);
+  if (ring->sqes == MAP_FAILED) {
+    if (ring->cq_ring != ring->sq_ring) {
+      munmap(ring->cq_ring, ring->cq_ring_size);
+    }
+    munmap(ring->sq_ring, ring->sq_ring_size);
+    close(ring->fd);
+    return 1;
+  }
+
+  char* sq = ring->sq_ring;
+  ring->sq_head = (unsigned*)(void*)(sq + params.sq_off.head);
+  ring->sq_tail = (unsigned*)(void*)(sq + params.sq_off.tail);
+  ring->sq_mask = (unsigned*)(void*)(sq + params.sq_off.ring_mask);
+  ring->sq_array = (unsigned*)(void*)(sq + params.sq_off.array);
+  ring->sq_flags = (unsigned*)(void*)(sq + params.sq_off.flags);
+  ring->sq_entries = params.sq_entries;
+
+  char* cq = ring->cq_ring;
+  ring->cq_head = (unsigned*)(void*)(cq + params.cq_off.head);
+  ring->cq_tail = (unsigned*)(void*)(cq + params.cq_off.tail);
+  ring->cq_mask = (unsigned*)(void*)(cq + params.cq_off.ring_mask);
+  ring->cqes = (struct io_uring_cqe*)(void*)(cq + params.cq_off.cqes);
+
+  return 0;
+}
+
+/**
+ * Unmaps the rings and closes the io_uring instance.
+ *
+ * @param ring Pointer to the ring to destroy.
+ */
+void uring_destroy(struct Uring* ring) {
+  munmap(ring->sqes, ring->sqes_size);
+  if (ring->cq_ring != ring->sq_ring) {
+    munmap(ring->cq_ring, ring->cq_ring_size);
+  }
+  munmap(ring->sq_ring, ring->sq_ring_size);
+  close(ring->fd);
+}
+
+/**
+ * Fills the next free submission queue entry and appends it to the submission ring.
+ *
+ * The new tail is only published to the kernel by uring_submit_and_wait.
+ *
+ * @return 0 if the operation was queued, 1 if the submission ring is full.
+ */
+static int queue_rw(struct Uring* ring, __u8 opcode, int fd, const void* buffer, size_t size, uint64_t user_data,
+                    int link) {
+  unsigned head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+  unsigned tail = *ring->sq_tail + ring->queued;
+  if (tail - head >= ring->sq_entries) {
+    return 1;
+  }
+
+  unsigned index = tail & *ring->sq_mask;
+  struct io_uring_sqe* sqe = &ring->sqes[index];
+  memset(sqe, 0, sizeof(struct io_uring_sqe));
+  sqe->opcode = opcode;
+  sqe->fd = fd;
+  sqe->addr = (__u64)(uintptr_t)buffer;
+  sqe->len = (__u32)size;
+  sqe->off = (__u64)-1;  // Pipes have no file position
+  sqe->user_data = user_data;
+  if (link) {
+    sqe->flags = IOSQE_IO_LINK;
+  }
+
+  ring->sq_array[index] = index;
+  ring->queued++;
+  return 0;
+}
+
+int uring_queue_read(struct Uring* ring, int fd, void* buffer, size_t size, uint64_t user_data, int link) {
+  return queue_rw(ring, IORING_OP_READ, fd, buffer, size, user_data, link);
+}
+
+int uring_queue_write(struct Uring* ring, int fd, const void* buffer, size_t size, uint64_t user_data, int link) {
+  return queue_rw(ring, IORING_OP_WRITE, fd, buffer, size, user_data, link);
+}
+
+/**
+ * Publishes the queued operations to the kernel and waits for completions, in one io_uring_enter call.
+ *
+ * @param ring Pointer to the ring.
+ * @param wait_count Number of completions to wait for.
+ * @return 0 on success, 1 on failure.
+ */
+int uring_submit_and_wait(struct Uring* ring, unsigned wait_count) {
+  unsigned to_submit = ring->queued;
+  __atomic_store_n(ring->sq_tail, *ring->sq_tail + to_submit, __ATOMIC_RELEASE);
+  ring->queued = 0;
+
+  while (to_submit > 0 || wait_count > 0) {
+    int submitted = sys_io_uring_enter(ring->fd, to_submit, wait_count, IORING_ENTER_GETEVENTS);
+    if (submitted < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      print_error("Error submitting to io_uring.\n");
+      return 1;
+    }
+
+    // Whatever was submitted has been waited for along with it
+    to_submit -= (unsigned)submitted;
+    wait_count = 0;
+  }
+
+  return 0;
+}
+
+/**
+ * Takes the next completion from the completion ring. The ring lives in shared memory, so no system
+ * call is needed, unless more operations completed than the ring holds: the kernel then keeps the extra
+ * completions aside until it is entered again.
+ *
+ * @param ring Pointer to the ring.
+ * @param user_data Pointer to store the user_data of the operation in.
+ * @param result Pointer to store the result of the operation in.
+ * @return 0 if a completion was taken, 1 if the completion ring is empty.
+ */
+int uring_reap(struct Uring* ring, uint64_t* user_data, int* result) {
+  unsigned head = *ring->cq_head;
+  if (head == __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE)) {
+    if (!(__atomic_load_n(ring->sq_flags, __ATOMIC_ACQUIRE) & IORING_SQ_CQ_OVERFLOW) ||
+        sys_io_uring_enter(ring->fd, 0, 0, IORING_ENTER_GETEVENTS) < 0 ||
+        head == __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE)) {
+      return 1;
+    }
+  }
+
+  struct io_uring_cqe* cqe = &ring->cqes[head & *ring->cq_mask];
+  *user_data = cqe->user_data;
+  *result = cqe->res;
+  __atomic_store_n(ring->cq_head, head + 1, __ATOMIC_RELEASE);
+  return 0;
+}
+
+#else  // HAVE_IO_URING
+
+int uring_supported(void) {
+  return 0;
+}
+
+int uring_init(struct Uring* ring, unsigned entries, unsigned cq_entries) {
+  (void)entries, (void)cq_entries;
+  memset(ring, 0, sizeof(struct Uring));
+  return 1;
+}
+
+void uring_destroy(struct Uring* ring) {
+  (void)ring;
+}
+
+int uring_queue_read(struct Uring* ring, int fd, void* buffer, size_t size, uint64_t user_data, int link) {
+  (void)ring, (void)fd, (void)buffer, (void)size, (void)user_data, (void)link;
+  return 1;
+}
+
+int uring_queue_write(struct Uring* ring, int fd, const void* buffer, size_t size, uint64_t user_data, int link) {
+  (void)ring, (void)fd, (void)buffer, (void)size, (void)user_data, (void)link;
+  return 1;
+}
+
+int uring_submit_and_wait(struct Uring* ring, unsigned wait_count) {
+  (void)ring, (void)wait_count;
+  return 1;
+}
+
+int uring_reap(struct Uring* ring, uint64_t* user_data, int* result) {
+  (void)ring, (void)user_data, (void)result;
+  return 1;
+}
+
+#endif  // HAVE_IO_URING
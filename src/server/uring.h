@@ -0,0 +1,83 @@
+#ifndef SERVER_URING_H
+#define SERVER_URING_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+/**
+ * @struct Uring
+ * @brief An io_uring instance, with its submission and completion rings mapped into the process.
+ */
+struct Uring {
+  int fd;                      // io_uring file descriptor
+  unsigned* sq_head;           // Submission ring head, advanced by the kernel
+  unsigned* sq_tail;           // Submission ring tail, advanced by us
+  unsigned* sq_mask;           // Submission ring index mask
+  unsigned* sq_array;          // Submission ring, holding indexes into sqes
+  unsigned* sq_flags;          // Submission ring flags, set by the kernel
+  struct io_uring_sqe* sqes;   // Submission queue entries
+  unsigned* cq_head;           // Completion ring head, advanced by us
+  unsigned* cq_tail;           // Completion ring tail, advanced by the kernel
+  unsigned* cq_mask;           // Completion ring index mask
+  struct io_uring_cqe* cqes;   // Completion queue entries
+  unsigned sq_entries;         // Size of the submission ring
+  unsigned queued;             // Entries added to the submission ring but not submitted yet
+  void* sq_ring;               // Mapping of the submission ring
+  size_t sq_ring_size;         // Size of the submission ring mapping
+  void* cq_ring;               // Mapping of the completion ring, the same as sq_ring on recent kernels
+  size_t cq_ring_size;         // Size of the completion ring mapping
+  size_t sqes_size;            // Size of the submission queue entries mapping
+};
+
+/// Checks whether the kernel supports io_uring with read and write operations.
+/// @return 1 if io_uring can be used, 0 otherwise.
+int uring_supported(void);
+
+/// Creates an io_uring instance and maps its rings.
+/// @param ring Pointer to the ring to initialize.
+/// @param entries Minimum number of submission queue entries.
+/// @param cq_entries Minimum number of completion queue entries, or 0 for twice the submission entries.
+/// @return 0 if the ring was created successfully, 1 otherwise.
+int uring_init(struct Uring* ring, unsigned entries, unsigned cq_entries);
+
+/// Unmaps the rings and closes the io_uring instance.
+/// @param ring Pointer to the ring to destroy.
+void uring_destroy(struct Uring* ring);
+
+/// Queues a read, without submitting it.
+/// @param ring Pointer to the ring.
+/// @param fd File descriptor to read from.
+/// @param buffer Buffer to read into.
+/// @param size Maximum number of bytes to read.
+/// @param user_data Value returned with the completion.
+/// @param link 1 if the next queued operation must only start once this one completes in full.
+/// @return 0 if the read was queued, 1 if the submission ring is full.
+int uring_queue_read(struct Uring* ring, int fd, void* buffer, size_t size, uint64_t user_data, int link);
+
+/// Queues a write, without submitting it.
+/// @param ring Pointer to the ring.
+/// @param fd File descriptor to write to.
+/// @param buffer Buffer to write from.
+/// @param size Number of bytes to write.
+/// @param user_data Value returned with the completion.
+/// @param link 1 if the next queued operation must only start once this one completes in full.
+/// @return 0 if the write was queued, 1 if the submission ring is full.
+int uring_queue_write(struct Uring* ring, int fd, const void* buffer, size_t size, uint64_t user_data, int link);
+
+/// Submits every queued operation and waits for completions, with a single system call.
+/// @param ring Pointer to the ring.
+/// @param wait_count Number of completions to wait for.
+/// @return 0 on success, 1 on failure.
+int uring_submit_and_wait(struct Uring* ring, unsigned wait_count);
+
+/// Takes the next completion from the completion ring, without a system call unless completions overflowed it.
+/// @param ring Pointer to the ring.
+/// @param user_data Pointer to store the user_data of the operation in.
+/// @param result Pointer to store the result of the operation in: bytes transferred, or a negative errno.
+/// @return 0 if a completion was taken, 1 if the completion ring is empty.
+int uring_reap(struct Uring* ring, uint64_t* user_data, int* result);
+
+#endif  // SERVER_URING_H
@@ -0,0 +1,712 @@
+#include "wal.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "common/constants.h"
+#include "common/io.h"
+
+#define FNV_OFFSET_BASIS 2166136261u
+#define FNV_PRIME 16777619u
+
+/**
+ * @struct WalFileHeader
+ * @brief Header at the start of each segment of the write-ahead log.
+ */
+struct WalFileHeader {
+  uint32_t magic;     // WAL_MAGIC
+  uint16_t version;   // WAL_VERSION
+  uint16_t reserved;  // Zero
+};
+
+/**
+ * @struct WalRecordHeader
+ * @brief Header of a record of the write-ahead log, followed by its values.
+ */
+struct WalRecordHeader {
+  uint32_t checksum;  // FNV-1a hash of the record from the size on
+  uint32_t size;      // Bytes of the record, this header included
+  uint64_t lsn;       // LSN of the record
+  uint32_t type;      // The enum WalRecordType
+  uint32_t event_id;  // Event changed
+};
+
+// Largest record, a RESERVE of as many seats as a request holds
+#define WAL_MAX_RECORD_SIZE (sizeof(struct WalRecordHeader) + 2 * MAX_RESERVATION_SIZE * sizeof(uint64_t))
+
+// Segments are named after the LSN they start at, padded so that they sort by name as they do by LSN
+#define WAL_SEGMENT_PREFIX "wal."
+#define WAL_SEGMENT_DIGITS 20
+
+static pthread_mutex_t wal_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t wal_synced = PTHREAD_COND_INITIALIZER;  // Signaled when an fdatasync returned
+static char wal_dir[PATH_MAX];
+static int wal_fd = -1;  // The last segment, which records are appended to
+static enum WalDurability wal_durability = WAL_SYNC_GROUP;
+static size_t segment_limit = WAL_SEGMENT_SIZE;
+static uint64_t* segments = NULL;  // First LSN of each segment, oldest first
+static size_t segment_count = 0;
+static size_t segment_capacity = 0;
+static size_t segment_size = 0;    // Bytes written to the last segment
+static uint64_t appended_lsn = 0;  // LSN of the last record written
+static uint64_t synced_lsn = 0;    // LSN of the last record known to be durable
+static int syncing = 0;            // 1 while a thread runs the fdatasync of a group
+static int open_syncs = 0;         // fdatasync calls running on the last segment without the mutex
+static int broken = 0;             // 1 once a write or a sync failed; nothing is appended after that
+static int closing = 0;            // 1 once the log is being closed, to stop the flusher
+static size_t records = 0;
+static size_t syncs = 0;
+static size_t removed = 0;
+static pthread_t flusher;
+
+/**
+ * Hashes bytes into a running FNV-1a hash.
+ */
+static uint32_t fnv1a(uint32_t hash, const unsigned char* bytes, size_t size) {
+  for (size_t i = 0; i < size; i++) {
+    hash ^= bytes[i];
+    hash *= FNV_PRIME;
+  }
+  return hash;
+}
+
+/**
+ * Syncs every record written so far, as the leader of a group, or waits for the thread already doing so, whose
+ * group may not hold the caller's record. Called and returns with the mutex held.
+ */
+static void sync_group(void) {
+  if (syncing) {
+    pthread_cond_wait(&wal_synced, &wal_mutex);
+    return;
+  }
+
+  // Records appended while the sync runs wait for the next group
+  syncing = 1;
+  open_syncs++;
+  uint64_t target = appended_lsn;
+  int fd = wal_fd;
+  pthread_mutex_unlock(&wal_mutex);
+  int failed = fdatasync(fd) != 0;
+  pthread_mutex_lock(&wal_mutex);
+
+  syncing = 0;
+  open_syncs--;
+  syncs++;
+  if (failed) {
+    broken = 1;
+  } else if (target > synced_lsn) {
+    synced_lsn = target;
+  }
+  pthread_cond_broadcast(&wal_synced);
+}
+
+/**
+ * Syncs the log every WAL_ASYNC_SYNC_MS in async durability mode, until it is closed.
+ *
+ * @param arg Unused.
+ * @return NULL.
+ */
+static void* flush_log(void* arg) {
+  (void)arg;
+  struct timespec interval = {0, WAL_ASYNC_SYNC_MS * 1000000L};
+
+  pthread_mutex_lock(&wal_mutex);
+  while (!closing) {
+    pthread_mutex_unlock(&wal_mutex);
+    nanosleep(&interval, NULL);
+    pthread_mutex_lock(&wal_mutex);
+    if (appended_lsn > synced_lsn && !broken) {
+      sync_group();
+    }
+  }
+  pthread_mutex_unlock(&wal_mutex);
+  return NULL;
+}
+
+/**
+ * Checks a record read from the log and decodes it.
+ *
+ * @param header Header of the record.
+ * @param values Values of the record.
+ * @param record The record to fill in.
+ * @param xs Array to store the rows of the seats of a RESERVE in.
+ * @param ys Array to store the columns of the seats of a RESERVE in.
+ * @return 0 if the record is valid, 1 otherwise.
+ */
+static int decode_record(const struct WalRecordHeader* header, const uint64_t* values, struct WalRecord* record,
+                         size_t* xs, size_t* ys) {
+  size_t count = (header->size - sizeof(*header)) / sizeof(uint64_t);
+  uint32_t checksum = fnv1a(FNV_OFFSET_BASIS, (const unsigned char*)header + sizeof(uint32_t),
+                            sizeof(*header) - sizeof(uint32_t));
+  if (fnv1a(checksum, (const unsigned char*)values, count * sizeof(uint64_t)) != header->checksum) {
+    return 1;
+  }
+
+  record->type = (enum WalRecordType)header->type;
+  record->lsn = header->lsn;
+  record->event_id = header->event_id;
+  switch (record->type) {
+    case WAL_CREATE:
+      record->num_rows = (size_t)values[0];
+      record->num_cols = (size_t)values[1];
+      return count != 2;
+
+    case WAL_RESERVE:
+      record->num_seats = count / 2;
+      for (size_t i = 0; i < record->num_seats; i++) {
+        xs[i] = (size_t)values[i];
+        ys[i] = (size_t)values[record->num_seats + i];
+      }
+      record->xs = xs;
+      record->ys = ys;
+      return count == 0 || count % 2 != 0;
+  }
+  return 1;
+}
+
+
+/**
+ * Builds the path of a segment of the log.
+ *
+ * @param path Buffer of PATH_MAX bytes to store the path in.
+ * @param first_lsn LSN the segment starts at.
+ * @return 0 on success, 1 if the path is too long, which wal_open already ruled out.
+ */
+static int segment_path(char* path, uint64_t first_lsn) {
+  return snprintf(path, PATH_MAX, "%s/" WAL_SEGMENT_PREFIX "%0*llu", wal_dir, WAL_SEGMENT_DIGITS,
+                  (unsigned long long)first_lsn) >= PATH_MAX;
+}
+
+/**
+ * Compares two LSNs, for qsort.
+ */
+static int compare_lsns(const void* a, const void* b) {
+  uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+  return (x > y) - (x < y);
+}
+
+/**
+ * Adds a segment after the others.
+ *
+ * @param first_lsn LSN the segment starts at.
+ * @return 0 on success, 1 on failure.
+ */
+static int add_segment(uint64_t first_lsn) {
+  if (segment_count == segment_capacity) {
+    size_t capacity = segment_capacity > 0 ? 2 * segment_capacity : 16;
+    uint64_t* grown = realloc(segments, capacity * sizeof(uint64_t));
+    if (grown == NULL) {
+      return 1;
+    }
+    segments = grown;
+    segment_capacity = capacity;
+  }
+  segments[segment_count++] = first_lsn;
+  return 0;
+}
+
+/**
+ * Forgets the segments of the log.
+ */
+static void free_segments(void) {
+  free(segments);
+  segments = NULL;
+  segment_count = 0;
+  segment_capacity = 0;
+}
+
+/**
+ * Finds the segments of the log in its directory and sorts them by the LSN they start at.
+ *
+ * @return 0 on success, 1 on failure.
+ */
+static int list_segments(void) {
+  DIR* directory = opendir(wal_dir);
+  if (directory == NULL) {
+    print_error("Failed to open the write-ahead log directory.\n");
+    return 1;
+  }
+
+  size_t prefix = strlen(WAL_SEGMENT_PREFIX);
+  int failed = 0;
+  struct dirent* entry;
+  while (!failed && (entry = readdir(directory)) != NULL) {
+    const char* name = entry->d_name;
+    if (strlen(name) != prefix + WAL_SEGMENT_DIGITS || strncmp(name, WAL_SEGMENT_PREFIX, prefix) != 0 ||
+        strspn(name + prefix, "0123456789") != WAL_SEGMENT_DIGITS) {
+      continue;
+    }
+
+    // LSNs start at 1
+    uint64_t first_lsn = strtoull(name + prefix, NULL, 10);
+    if (first_lsn > 0) {
+      failed = add_segment(first_lsn);
+    }
+  }
+  closedir(directory);
+
+  if (failed) {
+    print_error("Error allocating memory for the write-ahead log.\n");
+    free_segments();
+    return 1;
+  }
+  qsort(segments, segment_count, sizeof(uint64_t), compare_lsns);
+  return 0;
+}
+
+/**
+ * Replays the records of a segment, from the current position of its file descriptor. LSNs only grow along the log,
+ * but may skip the changes a checkpoint held and the log lost in a crash.
+ *
+ * @param fd File descriptor of the segment.
+ * @param replay_after LSN up to which records are checked but not replayed.
+ * @param replay Called with each later record.
+ * @param end Pointer to store the offset after the last valid record in.
+ * @param lsn Pointer to the LSN the records must follow, updated to the LSN of the last valid record.
+ * @return 0 on success, 1 if replay failed.
+ */
+static int replay_records(int fd, uint64_t replay_after, int (*replay)(const struct WalRecord* record), off_t* end,
+                          uint64_t* lsn) {
+  char buffer[READER_BUFFER_SIZE];
+  struct Reader reader;
+  reader_init(&reader, fd, buffer, sizeof(buffer));
+
+  *end = sizeof(struct WalFileHeader);
+  while (1) {
+    struct WalRecordHeader header;
+    uint64_t values[2 * MAX_RESERVATION_SIZE];
+    if (reader_read(&reader, (char*)&header, sizeof(header)) != (ssize_t)sizeof(header) ||
+        header.size < sizeof(header) || header.size > WAL_MAX_RECORD_SIZE ||
+        (header.size - sizeof(header)) % sizeof(uint64_t) != 0 || header.lsn <= *lsn) {
+      return 0;
+    }
+
+    size_t values_size = header.size - sizeof(header);
+    struct WalRecord record;
+    size_t xs[MAX_RESERVATION_SIZE], ys[MAX_RESERVATION_SIZE];
+    if (reader_read(&reader, (char*)values, values_size) != (ssize_t)values_size ||
+        decode_record(&header, values, &record, xs, ys) != 0) {
+      return 0;
+    }
+
+    if (record.lsn > replay_after && replay(&record) != 0) {
+      print_error("Failed to replay the write-ahead log.\n");
+      return 1;
+    }
+    *end += (off_t)header.size;
+    *lsn = header.lsn;
+  }
+}
+
+/**
+ * Replays a segment of the log. The last segment is kept open to append to.
+ *
+ * Records after the first one of the last segment that is cut short or does not match its checksum are discarded:
+ * they were written by the last run after the last sync, so none of their changes was acknowledged. Earlier segments
+ * were synced whole before the next one was created, so a bad record in them is damage.
+ *
+ * @param index Index of the segment.
+ * @param replay_after LSN up to which changes are already in the state.
+ * @param replay Called with each record after replay_after.
+ * @param lsn Pointer to the LSN of the last record replayed so far, updated past the segment.
+ * @return 0 on success, 1 on failure.
+ */
+static int replay_segment(size_t index, uint64_t replay_after, int (*replay)(const struct WalRecord* record),
+                          uint64_t* lsn) {
+  char path[PATH_MAX];
+  segment_path(path, segments[index]);
+  int last = index + 1 == segment_count;
+  int fd = open(path, O_RDWR);
+  struct stat info;
+  if (fd == -1 || fstat(fd, &info) == -1) {
+    print_error("Failed to open the write-ahead log.\n");
+    if (fd != -1) {
+      close(fd);
+    }
+    return 1;
+  }
+
+  // A last segment without a whole header was only just created
+  struct WalFileHeader file_header = {WAL_MAGIC, WAL_VERSION, 0};
+  if (last && (size_t)info.st_size < sizeof(file_header)) {
+    if (ftruncate(fd, 0) == -1 || my_write(fd, &file_header, sizeof(file_header)) == -1 || fdatasync(fd) == -1) {
+      print_error("Failed to create the write-ahead log.\n");
+      close(fd);
+      return 1;
+    }
+    info.st_size = sizeof(file_header);
+  } else if (my_read(fd, &file_header, sizeof(file_header)) != (ssize_t)sizeof(file_header) ||
+             file_header.magic != WAL_MAGIC || file_header.version != WAL_VERSION) {
+    print_error("The write-ahead log was written by another version or machine, or is damaged.\n");
+    close(fd);
+    return 1;
+  }
+
+  // Records of a segment all follow the LSN it is named after
+  off_t end;
+  if (*lsn < segments[index] - 1) {
+    *lsn = segments[index] - 1;
+  }
+  if (replay_records(fd, replay_after, replay, &end, lsn) != 0) {
+    close(fd);
+    return 1;
+  }
+
+  if (end < info.st_size && !last) {
+    print_error("The write-ahead log is damaged before its end.\n");
+    close(fd);
+    return 1;
+  }
+  if (end < info.st_size) {
+    print_error("Discarding changes the write-ahead log holds after the last complete record.\n");
+    if (ftruncate(fd, end) == -1 || fdatasync(fd) == -1) {
+      print_error("Failed to truncate the write-ahead log.\n");
+      close(fd);
+      return 1;
+    }
+  }
+
+  if (!last) {
+    close(fd);
+    return 0;
+  }
+  if (lseek(fd, end, SEEK_SET) == -1) {
+    close(fd);
+    return 1;
+  }
+  wal_fd = fd;
+  segment_size = (size_t)end;
+  return 0;
+}
+
+/**
+ * Creates a segment after the others, holding only its header, and makes it the one records are appended to.
+ *
+ * @param first_lsn LSN of the first record the segment will hold.
+ * @return 0 on success, 1 on failure.
+ */
+static int create_segment(uint64_t first_lsn) {
+  char path[PATH_MAX];
+  segment_path(path, first_lsn);
+  int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+  struct WalFileHeader file_header = {WAL_MAGIC, WAL_VERSION, 0};
+  if (fd == -1 || my_write(fd, &file_header, sizeof(file_header)) == -1 || fdatasync(fd) == -1 ||
+      add_segment(first_lsn) != 0) {
+    if (fd != -1) {
+      close(fd);
+      unlink(path);
+    }
+    return 1;
+  }
+  sync_directory(path);
+
+  if (wal_fd != -1) {
+    close(wal_fd);
+  }
+  wal_fd = fd;
+  segment_size = sizeof(file_header);
+  return 0;
+}
+
+/**
+ * Moves on to a new segment: syncs the last one, so that only the newest segment can ever end in a torn record,
+ * then creates the next. Called with the mutex held and no sync running on the last segment.
+ *
+ * @return 0 on success, 1 on failure.
+ */
+static int next_segment(void) {
+  if (fdatasync(wal_fd) != 0) {
+    return 1;
+  }
+  syncs++;
+  synced_lsn = appended_lsn;
+  pthread_cond_broadcast(&wal_synced);
+  return create_segment(appended_lsn + 1);
+}
+
+/**
+ * Opens the write-ahead log in its directory and replays the segments a checkpoint does not hold all of.
+ *
+ * @param directory Directory of the log.
+ * @param durability When appended changes may be acknowledged.
+ * @param replay_after LSN up to which changes are already in the state.
+ * @param min_lsn LSN the next record must follow at least.
+ * @param replay Called with each record of the log after replay_after.
+ * @return 0 on success, 1 on failure.
+ */
+int wal_open(const char* directory, enum WalDurability durability, uint64_t replay_after, uint64_t min_lsn,
+             int (*replay)(const struct WalRecord* record)) {
+  // Leave room for the name of a segment
+  int length = snprintf(wal_dir, sizeof(wal_dir), "%s", directory);
+  if (length < 0 || (size_t)length + sizeof("/" WAL_SEGMENT_PREFIX) + WAL_SEGMENT_DIGITS > sizeof(wal_dir)) {
+    print_error("The write-ahead log path is too long.\n");
+    return 1;
+  }
+  if (list_segments() != 0) {
+    return 1;
+  }
+
+  // Segments are only removed once a checkpoint holds every change in them
+  if (segment_count > 0 && segments[0] > replay_after + 1) {
+    print_error("The write-ahead log misses changes the checkpoint does not hold.\n");
+    free_segments();
+    return 1;
+  }
+
+  // Segments whose changes the checkpoint all holds are not even read
+  uint64_t lsn = 0;
+  int failed = 0;
+  for (size_t i = 0; i < segment_count && !failed; i++) {
+    if (i + 1 == segment_count || segments[i + 1] - 1 > replay_after) {
+      failed = replay_segment(i, replay_after, replay, &lsn);
+    }
+  }
+
+  if (lsn < min_lsn) {
+    lsn = min_lsn;
+  }
+  if (!failed && segment_count == 0 && create_segment(lsn + 1) != 0) {
+    print_error("Failed to create the write-ahead log.\n");
+    failed = 1;
+  }
+  if (failed) {
+    if (wal_fd != -1) {
+      close(wal_fd);
+      wal_fd = -1;
+    }
+    free_segments();
+    return 1;
+  }
+
+  wal_durability = durability;
+  appended_lsn = lsn;
+  synced_lsn = lsn;
+  syncing = 0;
+  open_syncs = 0;
+  broken = 0;
+  closing = 0;
+  records = 0;
+  syncs = 0;
+  removed = 0;
+
+  if (durability == WAL_SYNC_ASYNC && pthread_create(&flusher, NULL, flush_log, NULL) != 0) {
+    print_error("Failed to start the write-ahead log flusher.\n");
+    close(wal_fd);
+    wal_fd = -1;
+    free_segments();
+    return 1;
+  }
+  return 0;
+}
+
+/**
+ * Sets the size of the segments of the log.
+ *
+ * @param size Bytes after which records go to a new segment.
+ */
+void wal_set_segment_size(size_t size) {
+  pthread_mutex_lock(&wal_mutex);
+  segment_limit = size;
+  pthread_mutex_unlock(&wal_mutex);
+}
+
+/**
+ * Appends a record to the log.
+ *
+ * @param record The record.
+ * @return The LSN of the record, or 0 on failure.
+ */
+uint64_t wal_append(const struct WalRecord* record) {
+  uint64_t buffer[WAL_MAX_RECORD_SIZE / sizeof(uint64_t)];
+  struct WalRecordHeader header = {0, sizeof(header), 0, (uint32_t)record->type, record->event_id};
+
+  // The values are laid out before the lock is taken; only the LSN and the checksum depend on the order
+  uint64_t* values = buffer + sizeof(header) / sizeof(uint64_t);
+  size_t count = 0;
+  if (record->type == WAL_CREATE) {
+    values[count++] = record->num_rows;
+    values[count++] = record->num_cols;
+  } else {
+    if (record->num_seats == 0 || record->num_seats > MAX_RESERVATION_SIZE) {
+      print_error("Reservation the write-ahead log could not replay.\n");
+      return 0;
+    }
+    for (size_t i = 0; i < record->num_seats; i++) {
+      values[count++] = record->xs[i];
+    }
+    for (size_t i = 0; i < record->num_seats; i++) {
+      values[count++] = record->ys[i];
+    }
+  }
+  header.size = (uint32_t)(sizeof(header) + count * sizeof(uint64_t));
+
+  // A full segment is closed once the syncs running on it returned, and the record goes to the next one
+  pthread_mutex_lock(&wal_mutex);
+  while (wal_fd != -1 && !broken && segment_size > sizeof(struct WalFileHeader) &&
+         segment_size + header.size > segment_limit) {
+    if (open_syncs > 0) {
+      pthread_cond_wait(&wal_synced, &wal_mutex);
+    } else if (next_segment() != 0) {
+      broken = 1;
+      pthread_mutex_unlock(&wal_mutex);
+      print_error("Failed to start a new segment of the write-ahead log.\n");
+      return 0;
+    }
+  }
+  if (wal_fd == -1 || broken) {
+    pthread_mutex_unlock(&wal_mutex);
+    return 0;
+  }
+
+  header.lsn = appended_lsn + 1;
+  memcpy(buffer, &header, sizeof(header));
+  header.checksum = fnv1a(FNV_OFFSET_BASIS, (unsigned char*)buffer + sizeof(uint32_t), header.size - sizeof(uint32_t));
+  memcpy(buffer, &header.checksum, sizeof(uint32_t));
+
+  // A record written in part would hide every later one from the replay, so the log takes no more
+  if (my_write(wal_fd, buffer, header.size) == -1) {
+    broken = 1;
+    pthread_mutex_unlock(&wal_mutex);
+    print_error("Failed to write to the write-ahead log.\n");
+    return 0;
+  }
+
+  appended_lsn = header.lsn;
+  segment_size += header.size;
+  records++;
+  pthread_mutex_unlock(&wal_mutex);
+  return header.lsn;
+}
+
+/**
+ * Waits until a record is durable, as the durability mode asks.
+ *
+ * @param lsn LSN of the record.
+ * @return 0 on success, 1 if the log could not be synced.
+ */
+int wal_commit(uint64_t lsn) {
+  pthread_mutex_lock(&wal_mutex);
+  if (wal_durability == WAL_SYNC_EACH && !broken) {
+    // A record in a segment closed meanwhile was synced with it, so syncing the next one is merely wasted
+    open_syncs++;
+    int fd = wal_fd;
+    pthread_mutex_unlock(&wal_mutex);
+    int failed = fdatasync(fd) != 0;
+    pthread_mutex_lock(&wal_mutex);
+
+    open_syncs--;
+    syncs++;
+    if (failed) {
+      broken = 1;
+    } else if (lsn > synced_lsn) {
+      synced_lsn = lsn;
+    }
+    pthread_cond_broadcast(&wal_synced);
+  }
+
+  while (wal_durability == WAL_SYNC_GROUP && synced_lsn < lsn && !broken) {
+    sync_group();
+  }
+  int failed = broken;
+  pthread_mutex_unlock(&wal_mutex);
+  return failed;
+}
+
+/**
+ * Removes the segments of the log that hold no change after an LSN, as a checkpoint holds every change up to it.
+ * The segment records are appended to is always kept.
+ *
+ * @param lsn LSN up to which a checkpoint holds every change.
+ * @param count Pointer to store the number of segments removed in.
+ * @return 0 on success, 1 if a segment could not be removed.
+ */
+int wal_compact(uint64_t lsn, size_t* count) {
+  *count = 0;
+  pthread_mutex_lock(&wal_mutex);
+  size_t covered = 0;
+  while (covered + 1 < segment_count && segments[covered + 1] - 1 <= lsn) {
+    covered++;
+  }
+  uint64_t* obsolete = covered > 0 ? malloc(covered * sizeof(uint64_t)) : NULL;
+  if (covered > 0 && obsolete == NULL) {
+    pthread_mutex_unlock(&wal_mutex);
+    print_error("Error allocating memory for the write-ahead log.\n");
+    return 1;
+  }
+  if (covered > 0) {
+    memcpy(obsolete, segments, covered * sizeof(uint64_t));
+    memmove(segments, segments + covered, (segment_count - covered) * sizeof(uint64_t));
+    segment_count -= covered;
+    removed += covered;
+  }
+  pthread_mutex_unlock(&wal_mutex);
+
+  // Oldest first, so that whatever a failure leaves behind is still followed by every later segment
+  char path[PATH_MAX];
+  int failed = 0;
+  for (size_t i = 0; i < covered && !failed; i++) {
+    segment_path(path, obsolete[i]);
+    failed = unlink(path) != 0;
+  }
+  if (covered > 0) {
+    sync_directory(path);
+  }
+  free(obsolete);
+
+  if (failed) {
+    print_error("Failed to remove a segment of the write-ahead log.\n");
+    return 1;
+  }
+  *count = covered;
+  return 0;
+}
+
+/**
+ * Copies the counters of the log.
+ *
+ * @param stats Pointer to store the counters in.
+ */
+void wal_get_stats(struct WalStats* stats) {
+  pthread_mutex_lock(&wal_mutex);
+  stats->open = wal_fd != -1;
+  stats->records = records;
+  stats->syncs = syncs;
+  stats->lsn = appended_lsn;
+  stats->segments = segment_count;
+  stats->removed = removed;
+  pthread_mutex_unlock(&wal_mutex);
+}
+
+/**
+ * Stops the flusher, syncs the log and closes it.
+ */
+void wal_close(void) {
+  pthread_mutex_lock(&wal_mutex);
+  if (wal_fd == -1) {
+    pthread_mutex_unlock(&wal_mutex);
+    return;
+  }
+  closing = 1;
+  pthread_mutex_unlock(&wal_mutex);
+
+  if (wal_durability == WAL_SYNC_ASYNC) {
+    pthread_join(flusher, NULL);
+  }
+
+  if (fdatasync(wal_fd) != 0 || close(wal_fd) != 0) {
+    print_error("Failed to close the write-ahead log.\n");
+  }
+
+  pthread_mutex_lock(&wal_mutex);
+  wal_fd = -1;
+  free_segments();
+  pthread_mutex_unlock(&wal_mutex);
+}
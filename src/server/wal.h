@@ -0,0 +1,103 @@
+#ifndef SERVER_WAL_H
+#define SERVER_WAL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define WAL_MAGIC 0x57534d45u  // "EMSW" when written in little-endian order
+#define WAL_VERSION 1          // Version of the write-ahead log format
+
+/**
+ * @enum WalDurability
+ * @brief When a change appended to the write-ahead log may be acknowledged.
+ */
+enum WalDurability {
+  WAL_SYNC_EACH,   // Once an fdatasync of its own returned
+  WAL_SYNC_GROUP,  // Once an fdatasync returned, shared with every change appended while the previous one ran
+  WAL_SYNC_ASYNC,  // Right away; the log is synced every WAL_ASYNC_SYNC_MS, so a crash loses at most that much
+};
+
+/**
+ * @enum WalRecordType
+ * @brief Kind of change a record of the write-ahead log holds.
+ */
+enum WalRecordType {
+  WAL_CREATE = 1,   // An event was created
+  WAL_RESERVE = 2,  // Seats of an event were reserved
+};
+
+/**
+ * @struct WalRecord
+ * @brief A change to the state, as appended to the write-ahead log and as replayed from it.
+ *
+ * On disk, a record is a 24-byte header holding an FNV-1a checksum of the rest of the record, its size, its LSN,
+ * its type and its event id, followed by the rows and columns of a CREATE or by the rows of the seats of a RESERVE
+ * and then their columns, each a uint64_t.
+ */
+struct WalRecord {
+  enum WalRecordType type;  // Kind of change
+  uint64_t lsn;             // Position of the record in the log, from 1, assigned when it is appended
+  unsigned int event_id;    // Event changed
+  size_t num_rows;          // Rows of a created event
+  size_t num_cols;          // Columns of a created event
+  size_t num_seats;         // Seats of a reservation
+  const size_t* xs;         // Rows of the seats of a reservation
+  const size_t* ys;         // Columns of the seats of a reservation
+};
+
+/**
+ * @struct WalStats
+ * @brief Counters of the write-ahead log.
+ */
+struct WalStats {
+  int open;         // 1 if a log is open
+  size_t records;   // Records appended since the log was opened
+  size_t syncs;     // fdatasync calls since the log was opened
+  uint64_t lsn;     // LSN of the last record appended or replayed
+  size_t segments;  // Segment files the log spans, the one appended to included
+  size_t removed;   // Segments removed by compaction since the log was opened
+};
+
+/// Opens the write-ahead log in the given directory, creating it if it holds none, and replays its records in order.
+/// The log is a series of segment files named wal.<LSN of their first record>; segments the checkpoint holds every
+/// change of are skipped unread. A record cut short by a crash at the end of the last segment is discarded.
+/// @param directory Directory of the log.
+/// @param durability When appended changes may be acknowledged.
+/// @param replay_after LSN up to which changes are already in the state, from a checkpoint; older records are skipped.
+/// @param min_lsn LSN the next record must follow at least, since a checkpoint may hold changes the log lost.
+/// @param replay Called with each record of the log; its coordinates are only valid during the call.
+/// @return 0 on success, 1 if the log could not be opened, is damaged before its end, misses changes after
+/// replay_after, or replay failed.
+int wal_open(const char* directory, enum WalDurability durability, uint64_t replay_after, uint64_t min_lsn,
+             int (*replay)(const struct WalRecord* record));
+
+/// Sets the size after which the log moves on to a new segment, WAL_SEGMENT_SIZE unless changed.
+/// @param size Size of a segment in bytes; a record larger than that gets a segment of its own.
+void wal_set_segment_size(size_t size);
+
+/// Appends a record to the log, in the order changes are applied. The record is not durable until wal_commit.
+/// A reservation of no seats or of more than MAX_RESERVATION_SIZE is refused, since replaying it would fail.
+/// @param record The record, whose lsn is ignored.
+/// @return The LSN of the record, or 0 if it was refused or could not be written, after which every append fails.
+uint64_t wal_append(const struct WalRecord* record);
+
+/// Waits until a record is as durable as the durability mode asks, to acknowledge its change.
+/// @param lsn LSN wal_append returned.
+/// @return 0 on success, 1 if the log could not be synced.
+int wal_commit(uint64_t lsn);
+
+/// Removes the segments of the log that hold no change after the given LSN, once a checkpoint holds every change up
+/// to it. The segment records are appended to is kept.
+/// @param lsn LSN of a durable checkpoint.
+/// @param count Pointer to store the number of segments removed in.
+/// @return 0 on success, 1 if a segment could not be removed.
+int wal_compact(uint64_t lsn, size_t* count);
+
+/// Copies the counters of the log.
+/// @param stats Pointer to store the counters in.
+void wal_get_stats(struct WalStats* stats);
+
+/// Syncs and closes the log.
+void wal_close(void);
+
+#endif  // SERVER_WAL_H